@@ -0,0 +1,166 @@
+//
+// DoubleBuffer - two copies of a small trivially copyable value, read by pinning
+//
+// Read-copy-update over two slots. One slot holds the published value; Store()
+// writes the other one and then publishes it. A reader pins the published slot
+// (View): while pinned the slot is not written again, so a View is an
+// immutable snapshot that can be read in place, without copying it out:
+//
+//   m_current          slot of the newest value
+//   m_pins[slot]       Views (and Load() calls) reading the slot
+//
+// Pin() never waits: it counts itself on the published slot and checks the
+// slot is still published, retrying only if a Store() published the other one
+// meanwhile. Store() waits until no View pins the slot it is about to write,
+// which is the slot published before the last Store(). Readers are not held up
+// by a writer they preempted, whatever their priority.
+//
+// Each slot carries the version it was stored with: Version() of a View
+// tells which Store() it shows.
+//
+// Store() calls must be serialized by the caller, and a task holding a View
+// must not call Store(): after one Store() the next would wait for that View.
+// Views are meant to live for one operation (a decrypt), not across changes.
+// No heap, no OS dependency beyond std::this_thread::sleep_for().
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+template <typename T>
+class DoubleBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "DoubleBuffer value must be trivially copyable");
+
+    // Yields of a Store() waiting for a View before it sleeps
+    static constexpr uint32_t STORE_YIELDS = 16;
+
+    struct Slot
+    {
+        T        value;
+        uint32_t version;
+    };
+
+public:
+    // Pinned snapshot; unpins when destroyed. Move-only.
+    class View
+    {
+    public:
+        View(View &&other) noexcept
+            : m_owner(other.m_owner)
+            , m_slot(other.m_slot)
+        {
+            other.m_owner = nullptr;
+        }
+
+        View(const View&)            = delete;
+        View& operator=(const View&) = delete;
+        View& operator=(View&&)      = delete;
+
+        ~View()
+        {
+            if (m_owner)
+                m_owner->m_pins[m_slot].fetch_sub(1, std::memory_order_release);
+        }
+
+        [[nodiscard]] const T& operator*() const noexcept { return m_owner->m_slots[m_slot].value; }
+        [[nodiscard]] const T* operator->() const noexcept { return &m_owner->m_slots[m_slot].value; }
+        [[nodiscard]] uint32_t Version() const noexcept { return m_owner->m_slots[m_slot].version; }
+
+    private:
+        friend class DoubleBuffer;
+
+        View(const DoubleBuffer *owner, uint32_t slot) noexcept
+            : m_owner(owner)
+            , m_slot(slot)
+        {
+        }
+
+        const DoubleBuffer *m_owner;
+        uint32_t            m_slot;
+    };
+
+    DoubleBuffer() noexcept
+    {
+        Store(T{});
+    }
+
+    DoubleBuffer(const DoubleBuffer&)            = delete;
+    DoubleBuffer& operator=(const DoubleBuffer&) = delete;
+
+    [[nodiscard]] View Pin() const noexcept
+    {
+        for (;;)
+        {
+            const uint32_t slot = m_current.load(std::memory_order_seq_cst);
+            m_pins[slot].fetch_add(1, std::memory_order_seq_cst);
+            if (m_current.load(std::memory_order_seq_cst) == slot)
+                return View(this, slot);
+            m_pins[slot].fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    [[nodiscard]] T Load() const noexcept
+    {
+        const View view = Pin();
+        return *view;
+    }
+
+    // Copies size bytes at offset of the value (offsetof(T, field)); offset +
+    // size must not exceed sizeof(T)
+    void LoadBytes(size_t offset, void *out, size_t size) const noexcept
+    {
+        const View view = Pin();
+        std::memcpy(out, reinterpret_cast<const uint8_t*>(&*view) + offset, size);
+    }
+
+    // Publishes value; Store() calls must not overlap
+    void Store(const T &value) noexcept
+    {
+        const uint32_t next = m_current.load(std::memory_order_relaxed) ^ 1u;
+        // Readers that pinned it before the last Store() published the other
+        // slot. Yield first: a reader of equal priority is usually done by
+        // then; sleep if not, so a lower priority one gets to finish.
+        for (uint32_t spins = 0; m_pins[next].load(std::memory_order_seq_cst) != 0; ++spins)
+        {
+            if (spins < STORE_YIELDS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            m_waits.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        m_slots[next].value   = value;
+        m_slots[next].version = ++m_version;
+        m_current.store(next, std::memory_order_seq_cst);
+    }
+
+    // Number of Store() calls, the one of the constructor included
+    [[nodiscard]] uint32_t Version() const noexcept
+    {
+        return Pin().Version();
+    }
+
+    // Times Store() slept waiting for a View to go
+    [[nodiscard]] uint32_t Waits() const noexcept
+    {
+        return m_waits.load(std::memory_order_relaxed);
+    }
+
+private:
+    Slot                          m_slots[2]{};
+    mutable std::atomic<uint32_t> m_pins[2]{};
+    std::atomic<uint32_t>         m_current{0};
+    uint32_t                      m_version = 0;      // Store() only
+    std::atomic<uint32_t>         m_waits{0};
+
+}; // class DoubleBuffer
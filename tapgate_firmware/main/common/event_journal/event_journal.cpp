@@ -0,0 +1,614 @@
+#include "event_journal.h"
+
+#include "esp_attr.h"
+#include "esp_littlefs.h"
+#include "esp_private/cache_utils.h"
+#include "esp_private/panic_internal.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sys/time.h>
+
+#include "journal_args.h"
+#include "journal_codec.h"
+#include "journal_crash.h"
+#include "journal_cursor.h"
+#include "journal_emit.h"
+#include "journal_limiter.h"
+#include "journal_record.h"
+#include "journal_staging.h"
+#include "journal_store.h"
+#include "journal_tiers.h"
+
+static const char* TAG = "EventJournal";
+
+#ifdef CONFIG_EVENT_JOURNAL_RING_CAPACITY
+static constexpr std::size_t JOURNAL_RING_CAPACITY = CONFIG_EVENT_JOURNAL_RING_CAPACITY;
+#else
+static constexpr std::size_t JOURNAL_RING_CAPACITY = 32;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_FLUSH_PERIOD_MS
+static constexpr uint32_t JOURNAL_FLUSH_PERIOD_MS = CONFIG_EVENT_JOURNAL_FLUSH_PERIOD_MS;
+#else
+static constexpr uint32_t JOURNAL_FLUSH_PERIOD_MS = 1000;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_SEGMENT_SIZE
+static constexpr std::size_t JOURNAL_SEGMENT_SIZE = CONFIG_EVENT_JOURNAL_SEGMENT_SIZE;
+#else
+static constexpr std::size_t JOURNAL_SEGMENT_SIZE = 16384;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_QUOTA_KB
+static constexpr std::size_t JOURNAL_QUOTA_BYTES = CONFIG_EVENT_JOURNAL_QUOTA_KB * 1024;
+#else
+static constexpr std::size_t JOURNAL_QUOTA_BYTES = 1280 * 1024;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_RETAINED_QUOTA_KB
+static constexpr std::size_t JOURNAL_RETAINED_QUOTA_BYTES = CONFIG_EVENT_JOURNAL_RETAINED_QUOTA_KB * 1024;
+#else
+static constexpr std::size_t JOURNAL_RETAINED_QUOTA_BYTES = 256 * 1024;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_INDEX_INTERVAL
+static constexpr uint16_t JOURNAL_INDEX_INTERVAL = CONFIG_EVENT_JOURNAL_INDEX_INTERVAL;
+#else
+static constexpr uint16_t JOURNAL_INDEX_INTERVAL = 16;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_COALESCE_MS
+static constexpr uint32_t JOURNAL_COALESCE_MS = CONFIG_EVENT_JOURNAL_COALESCE_MS;
+#else
+static constexpr uint32_t JOURNAL_COALESCE_MS = 5000;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_RATE_INFO
+static constexpr uint16_t JOURNAL_RATE_INFO    = CONFIG_EVENT_JOURNAL_RATE_INFO;
+static constexpr uint16_t JOURNAL_RATE_WARNING = CONFIG_EVENT_JOURNAL_RATE_WARNING;
+static constexpr uint16_t JOURNAL_RATE_ERROR   = CONFIG_EVENT_JOURNAL_RATE_ERROR;
+static constexpr uint16_t JOURNAL_RATE_BURST   = CONFIG_EVENT_JOURNAL_RATE_BURST;
+#else
+static constexpr uint16_t JOURNAL_RATE_INFO    = 60;
+static constexpr uint16_t JOURNAL_RATE_WARNING = 60;
+static constexpr uint16_t JOURNAL_RATE_ERROR   = 120;
+static constexpr uint16_t JOURNAL_RATE_BURST   = 10;
+#endif
+
+#ifdef CONFIG_EVENT_JOURNAL_CRASH_TAIL_RECORDS
+static constexpr std::size_t JOURNAL_CRASH_TAIL_RECORDS = CONFIG_EVENT_JOURNAL_CRASH_TAIL_RECORDS;
+#else
+static constexpr std::size_t JOURNAL_CRASH_TAIL_RECORDS = 16;
+#endif
+
+// keep in sync with partitions.csv
+static constexpr char JOURNAL_PARTITION_LABEL[] = "littlefs";
+static constexpr char JOURNAL_MOUNT_POINT[]     = "/littlefs";
+static constexpr char JOURNAL_DIR[]             = "/littlefs/journal";            // rolling tier
+static constexpr char JOURNAL_RETAINED_DIR[]    = "/littlefs/journal_retained";   // retained tier
+
+// Records moved from the staging rings per persistence call
+static constexpr std::size_t JOURNAL_FLUSH_BATCH = 8;
+
+// Flush task configuration — lowest useful priority, journal must never
+// compete with message processing.
+static constexpr uint32_t    JOURNAL_FLUSH_TASK_STACK    = 4096;
+static constexpr UBaseType_t JOURNAL_FLUSH_TASK_PRIORITY = tskIDLE_PRIORITY + 1;
+
+// One staging ring per core (see journal_staging.h), merged by timestamp
+// and staging sequence (JournalRecordBefore)
+// Statically allocated: the rings accept events before event_journal_init()
+// so nothing logged during early boot is lost.
+static JournalStaging<journal_record_t, JOURNAL_RING_CAPACITY, portNUM_PROCESSORS, JournalRecordBefore> s_staging;
+
+// Coalescing and rate limiting — consulted by every producer, so guarded by
+// a spinlock rather than a mutex: the critical section is a hash and two
+// table probes.
+static JournalLimiter s_limiter({
+    JOURNAL_COALESCE_MS,
+    {
+        { JOURNAL_RATE_INFO,    JOURNAL_RATE_BURST },
+        { JOURNAL_RATE_WARNING, JOURNAL_RATE_BURST },
+        { JOURNAL_RATE_ERROR,   JOURNAL_RATE_BURST },
+        { 0,                    0 },
+    },
+});
+static portMUX_TYPE s_limiter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Copy of the newest records that survives a panic or watchdog reset (see
+// journal_crash.h). Armed by event_journal_init() once the previous boot's
+// tail has been merged; until then nothing overwrites it.
+RTC_NOINIT_ATTR static JournalCrashRegion<JOURNAL_CRASH_TAIL_RECORDS> s_crash_region;
+static JournalCrashTail s_crash(s_crash_region);
+static bool             s_crash_armed = false;
+
+// journal_record_t::seq of the next staged record
+static std::atomic<uint32_t> s_stage_seq{0};
+
+static TaskHandle_t      s_flush_task = nullptr;
+static journal_record_t  s_flush_batch[JOURNAL_FLUSH_BATCH];
+
+// Retention tiers (see journal_tiers.h): INFO/WARNING rotate within the
+// general quota, ERROR/ALERT have their own
+static constexpr JournalStore::Config JOURNAL_STORE_CONFIG = {
+    JOURNAL_SEGMENT_SIZE, JOURNAL_QUOTA_BYTES / JOURNAL_SEGMENT_SIZE, JOURNAL_INDEX_INTERVAL
+};
+static constexpr JournalStore::Config JOURNAL_RETAINED_CONFIG = {
+    JOURNAL_SEGMENT_SIZE, JOURNAL_RETAINED_QUOTA_BYTES / JOURNAL_SEGMENT_SIZE, JOURNAL_INDEX_INTERVAL
+};
+static_assert(EVENT_JOURNAL_TIERS == JournalTiers::COUNT, "event_journal_cursor_t must hold one position per tier");
+
+// Persistent stores — written by the flush task, read by event_journal_query();
+// s_store_mutex serializes both.
+static JournalFileStorage s_storage(JOURNAL_DIR);
+static JournalFileStorage s_retained_storage(JOURNAL_RETAINED_DIR);
+static JournalStore       s_store(s_storage, JOURNAL_STORE_CONFIG);
+static JournalStore       s_retained_store(s_retained_storage, JOURNAL_RETAINED_CONFIG);
+static JournalTiers       s_tiers(s_store, s_retained_store);
+static std::mutex         s_store_mutex;
+static bool               s_storage_ready = false;
+static uint8_t            s_persist_buf[JOURNAL_CODEC_RECORD_MAX];
+static uint8_t            s_query_buf[JournalTiers::COUNT * JOURNAL_CODEC_RECORD_MAX];
+
+// Sparse index tables (see journal_store.h)
+static JournalStore::SegmentSummary s_index_summaries[JOURNAL_STORE_CONFIG.max_segments + 1];
+static JournalStore::IndexBlock     s_index_blocks[JournalStore::MaxBlocks(JOURNAL_STORE_CONFIG, JOURNAL_CODEC_RECORD_MIN)];
+static JournalStore::SegmentSummary s_retained_summaries[JOURNAL_RETAINED_CONFIG.max_segments + 1];
+static JournalStore::IndexBlock     s_retained_blocks[JournalStore::MaxBlocks(JOURNAL_RETAINED_CONFIG, JOURNAL_CODEC_RECORD_MIN)];
+
+static int64_t journal_now_ms()
+{
+    struct timeval tv{};
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+// Limiter windows use monotonic time: the wall clock jumps on SNTP sync
+static int64_t journal_uptime_ms()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Number a record and stage it in the ring of the current core, waking
+ * the flush task when that ring fills up.
+ */
+static void journal_stage(journal_record_t &record)
+{
+    record.seq = s_stage_seq.fetch_add(1, std::memory_order_relaxed);
+    if (s_crash_armed)
+        s_crash.Record(record);
+    const size_t lane = s_staging.current_lane();
+    if (s_staging.push(record, lane) && s_flush_task && s_staging.size(lane) >= JOURNAL_RING_CAPACITY / 2) {
+        xTaskNotifyGive(s_flush_task);
+    }
+}
+
+/**
+ * @brief Stage the summaries of repeat runs that went idle.
+ *
+ * Called from the flush task before draining the ring.
+ */
+static void journal_expire_repeats()
+{
+    const int64_t now = journal_uptime_ms();
+    for (;;) {
+        journal_record_t summary;
+        portENTER_CRITICAL(&s_limiter_lock);
+        const bool has_summary = s_limiter.Expire(now, summary);
+        portEXIT_CRITICAL(&s_limiter_lock);
+        if (!has_summary)
+            break;
+        journal_stage(summary);
+    }
+
+    portENTER_CRITICAL(&s_limiter_lock);
+    const uint32_t suppressed = s_limiter.TakeSuppressed();
+    portEXIT_CRITICAL(&s_limiter_lock);
+    if (suppressed != 0) {
+        ESP_LOGW(TAG, "Rate limit: %lu event(s) suppressed", static_cast<unsigned long>(suppressed));
+    }
+}
+
+/**
+ * @brief Mount the littlefs partition and recover the journal tail.
+ */
+static esp_err_t journal_mount_storage()
+{
+    esp_vfs_littlefs_conf_t conf = {};
+    conf.base_path              = JOURNAL_MOUNT_POINT;
+    conf.partition_label        = JOURNAL_PARTITION_LABEL;
+    conf.format_if_mount_failed = true;
+
+    esp_err_t err = esp_vfs_littlefs_register(&conf);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to mount partition \"%s\": " ERR_FORMAT,
+                 JOURNAL_PARTITION_LABEL, esp_err_to_str(err), err);
+        return err;
+    }
+
+    s_store.AttachIndex(journal_codec_key, s_index_summaries, s_index_blocks);
+    s_retained_store.AttachIndex(journal_codec_key, s_retained_summaries, s_retained_blocks);
+    err = s_storage.Prepare();
+    if (err == ESP_OK)
+        err = s_retained_storage.Prepare();
+    if (err == ESP_OK)
+        err = s_tiers.Mount();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open journal store: " ERR_FORMAT, esp_err_to_str(err), err);
+        return err;
+    }
+
+    for (size_t tier = 0; tier < JournalTiers::COUNT; ++tier) {
+        const JournalStore::RecoveryInfo &info = s_tiers.Store(tier).Recovery();
+        if (info.truncated != 0 || info.dropped_tail) {
+            ESP_LOGW(TAG, "Recovered torn journal tail of tier %u (%u byte(s) discarded%s)", static_cast<unsigned>(tier),
+                     static_cast<unsigned>(info.truncated), info.dropped_tail ? ", empty segment removed" : "");
+        }
+    }
+    ESP_LOGI(TAG, "Store mounted: %u + %u retained segment(s)", static_cast<unsigned>(s_store.SegmentCount()),
+             static_cast<unsigned>(s_retained_store.SegmentCount()));
+    s_storage_ready = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Write a batch of records to persistent storage.
+ *
+ * Called only from the flush task. One sync per batch.
+ */
+static esp_err_t journal_persist_batch(const journal_record_t *records, size_t count)
+{
+    if (!s_storage_ready)
+        return ESP_ERR_INVALID_STATE;
+
+    std::lock_guard<std::mutex> lock(s_store_mutex);
+
+    // A failed write leaves its tier unmounted; recover before retrying
+    esp_err_t err = s_tiers.Mount();
+    if (err != ESP_OK)
+        return err;
+
+    for (size_t i = 0; i < count; ++i) {
+        err = s_tiers.Append(records[i], s_persist_buf, sizeof(s_persist_buf));
+        if (err != ESP_OK)
+            return err;
+    }
+    return s_tiers.Sync();
+}
+
+static bool journal_discard_persisted(const journal_record_t *record, void *ctx)
+{
+    (void)ctx;
+    s_crash.Discard(*record);
+    return true;
+}
+
+/**
+ * @brief Append the records the previous boot staged but never persisted.
+ *
+ * Runs in event_journal_init() before the flush task starts. The crash tail
+ * also holds records that did reach flash; those are found in the journal
+ * and skipped. Without storage the tail is left untouched for a later boot.
+ *
+ * @return Number of records recovered.
+ */
+static size_t journal_recover_crash_tail()
+{
+    if (!s_crash.Valid()) {
+        s_crash.Reset();
+        s_crash_armed = true;
+        return 0;
+    }
+    if (!s_storage_ready)
+        return 0;
+
+    const int64_t since = s_crash.OldestTimestamp();
+    if (since != INT64_MAX) {
+        const esp_err_t err = event_journal_query(since, UINT32_MAX, journal_discard_persisted, nullptr);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Crash tail: failed to read journal tail: " ERR_FORMAT, esp_err_to_str(err), err);
+        }
+    }
+
+    size_t total = 0;
+    size_t count = 0;
+    uint16_t id  = 0;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK && s_crash.Take(s_flush_batch[count], id)) {
+        if (++count == JOURNAL_FLUSH_BATCH) {
+            err = journal_persist_batch(s_flush_batch, count);
+            total += count;
+            count = 0;
+        }
+    }
+    if (err == ESP_OK && count != 0) {
+        err = journal_persist_batch(s_flush_batch, count);
+        total += count;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Crash tail: failed to persist recovered records: " ERR_FORMAT, esp_err_to_str(err), err);
+    }
+
+    s_crash.Reset();
+    s_crash_armed = true;
+    return total;
+}
+
+/**
+ * @brief Drain the staging rings into persistent storage.
+ *
+ * Records of both cores are merged by timestamp and staging sequence on the
+ * way out.
+ *
+ * @return Number of records moved out of the rings.
+ */
+static size_t journal_drain()
+{
+    size_t total = 0;
+    for (;;) {
+        const size_t count = s_staging.pop(s_flush_batch, JOURNAL_FLUSH_BATCH);
+        if (count == 0)
+            break;
+
+        const esp_err_t err = journal_persist_batch(s_flush_batch, count);
+        // INVALID_STATE: storage failed to mount, already reported at init
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            ESP_LOGE(TAG, "Failed to persist %u record(s): " ERR_FORMAT,
+                     static_cast<unsigned>(count), esp_err_to_str(err), err);
+        }
+        total += count;
+    }
+
+    const uint32_t dropped = s_staging.take_dropped();
+    if (dropped != 0) {
+        ESP_LOGW(TAG, "Ring overflow: %lu event(s) dropped", static_cast<unsigned long>(dropped));
+    }
+    return total;
+}
+
+static void journal_flush_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        // Woken early by producers when a ring passes half capacity
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(JOURNAL_FLUSH_PERIOD_MS));
+        journal_expire_repeats();
+        journal_drain();
+    }
+}
+
+esp_err_t event_journal_init(void)
+{
+    if (s_flush_task)
+        return ESP_OK;
+
+    // Without storage the ring and console output keep working; the error
+    // is still returned so the caller can report it.
+    const esp_err_t storage_err = journal_mount_storage();
+
+    // Before the flush task runs and before anything new is mirrored
+    const size_t recovered = journal_recover_crash_tail();
+    if (recovered != 0) {
+        ESP_LOGW(TAG, "Recovered %u record(s) from the crash tail", static_cast<unsigned>(recovered));
+    }
+
+    const BaseType_t res = xTaskCreate(journal_flush_task, "ej_flush",
+                                       JOURNAL_FLUSH_TASK_STACK, nullptr,
+                                       JOURNAL_FLUSH_TASK_PRIORITY, &s_flush_task);
+    if (res != pdPASS) {
+        s_flush_task = nullptr;
+        ESP_LOGE(TAG, "Failed to create flush task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const size_t collisions = journal_event_collisions();
+    if (collisions != 0) {
+        ESP_LOGE(TAG, "%u event ID collision(s) — change the tag or format of a colliding event",
+                 static_cast<unsigned>(collisions));
+    }
+
+    ESP_LOGI(TAG, "Initialized (%u ring(s) of %u records, %u event(s))",
+             static_cast<unsigned>(s_staging.lanes()), static_cast<unsigned>(JOURNAL_RING_CAPACITY), static_cast<unsigned>(journal_event_count()));
+    return storage_err;
+}
+
+uint32_t event_journal_dropped(void)
+{
+    return s_staging.dropped();
+}
+
+uint32_t event_journal_suppressed(enum event_journal_type type)
+{
+    portENTER_CRITICAL(&s_limiter_lock);
+    const uint32_t n = s_limiter.Suppressed(static_cast<uint8_t>(type));
+    portEXIT_CRITICAL(&s_limiter_lock);
+    return n;
+}
+
+uint32_t event_journal_coalesced(void)
+{
+    portENTER_CRITICAL(&s_limiter_lock);
+    const uint32_t n = s_limiter.Coalesced();
+    portEXIT_CRITICAL(&s_limiter_lock);
+    return n;
+}
+
+esp_err_t event_journal_query(int64_t since_ms, uint32_t type_mask,
+                              event_journal_visit_fn visit, void *ctx)
+{
+    if (!visit)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_storage_ready)
+        return ESP_ERR_INVALID_STATE;
+
+    std::lock_guard<std::mutex> lock(s_store_mutex);
+    const esp_err_t err = s_tiers.Mount();
+    if (err != ESP_OK)
+        return err;
+
+    // Records are decoded relative to the start of their block, so whole
+    // blocks are read and filtered here after decoding.
+    const JournalStore::Filter filter = { since_ms, static_cast<uint8_t>(type_mask), true };
+    JournalTiers::Reader reader = s_tiers.Query(filter, nullptr, s_query_buf, JOURNAL_CODEC_RECORD_MAX);
+    for (;;) {
+        const JournalTiers::Entry *entry = nullptr;
+        const esp_err_t next_err = reader.Next(entry);
+        if (next_err == ESP_ERR_NOT_FOUND)
+            break;
+        if (next_err != ESP_OK)
+            return next_err;
+        const journal_record_t &record = entry->record;
+        if (!entry->decoded || record.timestamp_ms < since_ms || !(type_mask & EVENT_JOURNAL_TYPE_BIT(record.type)))
+            continue;
+        if (!visit(&record, ctx))
+            break;
+    }
+
+    if (reader.Corrupted() != 0) {
+        ESP_LOGW(TAG, "Query skipped %u corrupted frame(s)", static_cast<unsigned>(reader.Corrupted()));
+    }
+    return ESP_OK;
+}
+
+esp_err_t event_journal_read(const event_journal_cursor_t *since, uint32_t type_mask, size_t max_records,
+                             event_journal_read_fn visit, void *ctx, event_journal_cursor_t *cursor)
+{
+    if (!since || !visit || !cursor)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_storage_ready)
+        return ESP_ERR_INVALID_STATE;
+
+    std::lock_guard<std::mutex> lock(s_store_mutex);
+    esp_err_t err = s_tiers.Mount();
+    if (err != ESP_OK)
+        return err;
+
+    struct ReadContext
+    {
+        event_journal_read_fn visit;
+        void                 *ctx;
+    } read_ctx = { visit, ctx };
+
+    JournalCursor position{};
+    for (size_t tier = 0; tier < JournalTiers::COUNT; ++tier)
+        position.next_seq[tier] = since->next_seq[tier];
+    err = journal_cursor_read(
+        s_tiers, position, static_cast<uint8_t>(type_mask), max_records, s_query_buf, JOURNAL_CODEC_RECORD_MAX,
+        [](size_t tier, uint64_t seq, const journal_record_t &record, uint16_t, void *arg) {
+            const ReadContext *read = static_cast<const ReadContext *>(arg);
+            return read->visit(static_cast<uint8_t>(tier), seq, &record, read->ctx);
+        },
+        &read_ctx, position);
+    if (err != ESP_OK)
+        return err;
+
+    for (size_t tier = 0; tier < JournalTiers::COUNT; ++tier)
+        cursor->next_seq[tier] = position.next_seq[tier];
+    cursor->gap = position.gap;
+    return ESP_OK;
+}
+
+/**
+ * @brief Persistent side of _event_journal_emit()
+ *
+ * Stages the event in the RAM ring; the flush task persists it later.
+ * Never blocks and never touches flash. Repeats of a recent identical event
+ * are folded into a summary and events over their tag's rate are dropped
+ * (see journal_limiter.h).
+ *
+ * The message text was formatted once by the emit path and is only copied
+ * here. With CONFIG_EVENT_JOURNAL_DEFERRED_FORMAT it is not used: only the
+ * format string pointer and the raw argument values are captured.
+ *
+ * @param type Event journal type
+ * @param event Call-site descriptor (event ID, tag, format string)
+ * @param text Formatted message, not terminated (nullptr if not formatted)
+ * @param length Length of text
+ * @param args Variable arguments
+ */
+void journal_emit_record(enum event_journal_type type, const journal_event_desc_t *event,
+                         const char *text, size_t length, va_list args)
+{
+    journal_record_t record;
+    record.timestamp_ms = journal_now_ms();
+    record.event        = event;
+    record.seq          = 0;
+    record.type         = static_cast<uint8_t>(type);
+    record.repeat       = 0;
+    record.span_ms      = 0;
+
+#ifdef CONFIG_EVENT_JOURNAL_DEFERRED_FORMAT
+    (void)text;
+    (void)length;
+    record.flags  = JOURNAL_RECORD_DEFERRED;
+    record.length = static_cast<uint8_t>(journal_args_pack(event->fmt, args, record.data, sizeof(record.data)));
+#else
+    (void)args;
+    record.flags = 0;
+    if (!text)
+        length = 0;
+    if (length > sizeof(record.data) - 1)
+        length = sizeof(record.data) - 1;
+    if (length != 0)
+        std::memcpy(record.data, text, length);
+    record.data[length] = '\0';
+    record.length       = static_cast<uint8_t>(length);
+#endif
+
+    journal_record_t summary;
+    bool has_summary = false;
+    portENTER_CRITICAL(&s_limiter_lock);
+    const JournalLimiter::Verdict verdict = s_limiter.Admit(record, journal_uptime_ms(), summary, has_summary);
+    portEXIT_CRITICAL(&s_limiter_lock);
+
+    if (has_summary)
+        journal_stage(summary);
+    if (verdict == JournalLimiter::ADMIT)
+        journal_stage(record);
+}
+
+/**
+ * @brief Record the panic itself in the crash tail.
+ *
+ * Linked in place of esp_panic_handler() (-Wl,--wrap, see main/CMakeLists.txt).
+ * Only plain memory accesses, no formatting and no locks: the arguments are
+ * packed as in the deferred format (whatever CONFIG_EVENT_JOURNAL_DEFERRED_FORMAT
+ * says, records carry their format in flags) and the record is merged at the
+ * next boot. The wall clock cannot be read safely here, so the record carries
+ * the timestamp of the newest record in the crash tail.
+ *
+ * The handler itself is in IRAM. The packing code, crc32 and the format
+ * string are in flash: with the flash cache disabled (a panic during a flash
+ * write or erase, or in an IRAM ISR running meanwhile) they cannot be reached,
+ * so the panic is not recorded and the tail is left as it was. Records staged
+ * before the panic are still recovered.
+ */
+extern "C" void __real_esp_panic_handler(panic_info_t *info);
+
+extern "C" void IRAM_ATTR __wrap_esp_panic_handler(panic_info_t *info)
+{
+    static constexpr char PANIC_TAG[] = "Panic";
+    _EJ_EVENT_DECL(PANIC_TAG, "Core %d: %s at %p")
+
+    if (s_crash_armed && info && spi_flash_cache_enabled()) {
+        journal_record_t record{};
+        record.timestamp_ms = s_crash.NewestTimestamp();
+        record.event        = &_ej_event;
+        record.type         = EVENT_JOURNAL_ALERT;
+        record.flags        = JOURNAL_RECORD_DEFERRED;
+        const char *reason  = info->reason ? info->reason : "unknown";
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), _ej_event.fmt,
+                                                                 info->core, reason, info->addr));
+        s_crash.Record(record);
+    }
+    __real_esp_panic_handler(info);
+}
@@ -12,6 +12,16 @@
  * remain available during development and debugging, while critical
  * information is still retained for post-reboot inspection.
  *
+ * Recording is non-blocking: events are staged in lock-free RAM rings (one
+ * per CPU core) and a low-priority flush task merges them into persistent
+ * storage in batches. When a ring is full new events are dropped and counted
+ * rather than stalling the caller.
+ * Identical events repeated within a short window are folded into one
+ * summary record, and a per-tag rate limit keeps a noisy component from
+ * flooding the journal; ALERT events are exempt from both.
+ * ERROR and ALERT events are persisted in a separate retention tier with
+ * its own quota, so routine traffic never rotates them out.
+ *
  * The persistent storage backend is treated as an internal implementation
  * detail and must not be accessed directly by application code. All interaction
  * with the journal is performed through a single macro, which guarantees
@@ -23,8 +33,12 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "device_err.h"
 #include "esp_log.h"
+#include "journal_event.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,54 +55,93 @@ enum event_journal_type {
     EVENT_JOURNAL_ALERT     // Alert message
 };
 
-// Internal function for persistent storage (private, do not use directly)
-void _event_journal_store(enum event_journal_type type, const char *tag, const char *fmt, ...);
+// Start the background flush task. Events added before this call are kept
+// in the RAM ring and persisted once the task is running. Records left in
+// the crash tail by a panic or watchdog reset are merged into the journal
+// first.
+esp_err_t event_journal_init(void);
+
+// Number of events dropped because the RAM ring was full.
+uint32_t event_journal_dropped(void);
+
+// Number of events of a type dropped by the per-tag rate limit.
+uint32_t event_journal_suppressed(enum event_journal_type type);
+
+// Number of repeated events folded into a summary record.
+uint32_t event_journal_coalesced(void);
+
+// Bit of an event_journal_type in an event_journal_query() type mask
+#define EVENT_JOURNAL_TYPE_BIT(type) (1u << (type))
+
+struct journal_record_t;
+
+// Called for each record matched by event_journal_query(); return false to stop.
+typedef bool (*event_journal_visit_fn)(const struct journal_record_t *record, void *ctx);
+
+// Visit persisted records with timestamp >= since_ms and a type in type_mask,
+// oldest first. Uses the store's sparse index, so the cost depends on the
+// number of matching blocks rather than on the journal size. Records still
+// staged in the RAM ring are not visible yet. Runs in the caller's task and
+// blocks the flush task while it runs.
+esp_err_t event_journal_query(int64_t since_ms, uint32_t type_mask,
+                              event_journal_visit_fn visit, void *ctx);
+
+// Retention tiers: INFO/WARNING rotate in the rolling tier (0), ERROR/ALERT
+// are kept longer in the retained tier (1). Each tier numbers its records.
+#define EVENT_JOURNAL_TIERS 2
+
+// Position of an incremental reader in the journal (see event_journal_read())
+typedef struct {
+    uint64_t next_seq[EVENT_JOURNAL_TIERS]; // Per tier: sequence number to resume from
+    bool     gap;                           // Records after `since` and before those visited are gone
+} event_journal_cursor_t;
+
+// Called for each record read by event_journal_read(); return false to stop.
+typedef bool (*event_journal_read_fn)(uint8_t tier, uint64_t seq, const struct journal_record_t *record, void *ctx);
+
+// Visit at most max_records persisted records at or after the `since`
+// cursor with a type in type_mask, oldest first across tiers, for
+// incremental sync: a client keeps *cursor and asks only for what it has not
+// seen yet (a zeroed cursor reads everything). cursor->gap is set when
+// records the client never received were rotated out, corrupted, or lost to
+// a journal reset (a position beyond the newest record restarts that tier
+// from its oldest one). cursor may point to since. Same context rules as
+// event_journal_query().
+esp_err_t event_journal_read(const event_journal_cursor_t *since, uint32_t type_mask, size_t max_records,
+                             event_journal_read_fn visit, void *ctx, event_journal_cursor_t *cursor);
+
+// Internal emit path (private, do not use directly): formats the message
+// once and hands the same text to the console and the journal (see
+// journal_emit.h). `event` is the call-site descriptor (ID, tag, format); the
+// variadic arguments match event->fmt.
+void _event_journal_emit(enum event_journal_type type, const journal_event_desc_t *event, ...);
+
+// Never called (private): gives EVENT_JOURNAL_ADD the printf format check
+// ESP_LOGx did. _event_journal_emit() takes the format from the descriptor,
+// out of the compiler's sight, and the journal packs the arguments by it.
+#if defined(__GNUC__)
+__attribute__((format(printf, 1, 2)))
+#endif
+static inline void _event_journal_check_format(const char *fmt, ...) { (void)fmt; }
 
 #if defined(APP_DEBUG_MODE) || defined(CONFIG_APP_DEBUG_MODE)
-#include <stdio.h>
+    // Number of events emitted this session; the console tag of each event is
+    // ">> EVENT N <<" instead of EVENT_JOURNAL_TAG.
     extern unsigned int global_events_counter_per_session;
-    // Cross-platform atomic post-increment (returns old value).
-    // Firmware target (GCC) uses the GCC built-in; MSVC host tests are
-    // single-threaded so a plain post-increment is sufficient.
-    #if defined(_MSC_VER)
-        #define _EJ_COUNTER_INC(p) ((unsigned)(*(p))++)
-    #else
-        #define _EJ_COUNTER_INC(p) __atomic_fetch_add((p), 1u, __ATOMIC_RELAXED)
-    #endif
-    // Formats ">> EVENT N <<" into a local buffer and binds _ej_tag to it.
-#define _EVENT_JOURNAL_TAG_DECL \
-    char _ej_buf[32]; \
-    snprintf(_ej_buf, sizeof(_ej_buf), ">> EVENT %u <<", \
-             _EJ_COUNTER_INC(&global_events_counter_per_session) + 1u); \
-    const char* const _ej_tag = _ej_buf;
-#else
-#define _EVENT_JOURNAL_TAG_DECL \
-    const char* const _ej_tag = EVENT_JOURNAL_TAG;
 #endif
 
 // Add an event to the journal (macro implementation)
 // This macro logs an event with the specified type, tag, and formatted message.
+// Console output uses EVENT_JOURNAL_TAG with the message as "<tag>: <message>".
+// tag must be a constant expression; each call site gets a compile-time event
+// ID (see journal_event.h). The arguments are checked against fmt as for
+// printf. C++ only.
 #define EVENT_JOURNAL_ADD(type, tag, fmt, ...) \
     do { \
-        _event_journal_store(type, tag, fmt, ##__VA_ARGS__); \
-        _EVENT_JOURNAL_TAG_DECL \
-        switch (type) { \
-            case EVENT_JOURNAL_INFO: \
-                ESP_LOGI(_ej_tag, "%s: " fmt, tag, ##__VA_ARGS__); \
-                break; \
-            case EVENT_JOURNAL_WARNING: \
-                ESP_LOGW(_ej_tag, "%s: " fmt, tag, ##__VA_ARGS__); \
-                break; \
-            case EVENT_JOURNAL_ERROR: \
-                ESP_LOGE(_ej_tag, "%s: " fmt, tag, ##__VA_ARGS__); \
-                break; \
-            case EVENT_JOURNAL_ALERT: \
-                ESP_LOGW(_ej_tag, "%s: " fmt, tag, ##__VA_ARGS__); \
-                break; \
-            default: \
-                ESP_LOGW(_ej_tag, "Unknown event journal type: %d", type); \
-                break; \
-        } \
+        if (false) \
+            _event_journal_check_format(fmt, ##__VA_ARGS__); \
+        _EJ_EVENT_DECL(tag, fmt) \
+        _event_journal_emit(type, &_ej_event, ##__VA_ARGS__); \
     } while(0)
 
 #ifdef __cplusplus
@@ -0,0 +1,429 @@
+#include "journal_args.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Length modifiers relevant for argument width
+enum class LenMod : uint8_t { None, hh, h, l, ll, j, z, t, L };
+
+// One parsed conversion specification: "%[flags][width][.precision][length]conv"
+struct FmtSpec
+{
+    const char *begin;      // points at '%'
+    const char *end;        // one past the conversion character
+    bool        width_star;
+    bool        prec_star;
+    int         prec;       // literal precision, -1 if none (or '*')
+    LenMod      len;
+    char        conv;
+};
+
+// Finds the next conversion in fmt. Literal text before it is [fmt, spec.begin).
+// Returns false when no further conversion exists. "%%" is reported as conv '%'.
+static bool next_spec(const char *fmt, FmtSpec &spec)
+{
+    const char *p = std::strchr(fmt, '%');
+    if (!p)
+        return false;
+
+    spec.begin      = p++;
+    spec.width_star = false;
+    spec.prec_star  = false;
+    spec.prec       = -1;
+    spec.len        = LenMod::None;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+        ++p;
+    if (*p == '*') {
+        spec.width_star = true;
+        ++p;
+    } else {
+        while (*p >= '0' && *p <= '9') ++p;
+    }
+    if (*p == '.') {
+        ++p;
+        if (*p == '*') {
+            spec.prec_star = true;
+            ++p;
+        } else {
+            spec.prec = 0;
+            for (; *p >= '0' && *p <= '9'; ++p)
+                if (spec.prec < UINT8_MAX) spec.prec = spec.prec * 10 + (*p - '0');
+        }
+    }
+
+    switch (*p) {
+        case 'h': ++p; if (*p == 'h') { ++p; spec.len = LenMod::hh; } else { spec.len = LenMod::h; } break;
+        case 'l': ++p; if (*p == 'l') { ++p; spec.len = LenMod::ll; } else { spec.len = LenMod::l; } break;
+        case 'j': ++p; spec.len = LenMod::j; break;
+        case 'z': ++p; spec.len = LenMod::z; break;
+        case 't': ++p; spec.len = LenMod::t; break;
+        case 'L': ++p; spec.len = LenMod::L; break;
+        default: break;
+    }
+
+    spec.conv = *p;
+    spec.end  = *p ? p + 1 : p;
+    return true;
+}
+
+static bool is_int_conv(char c)
+{
+    return c == 'd' || c == 'i' || c == 'u' || c == 'x' || c == 'X' || c == 'o' || c == 'c';
+}
+
+static bool is_float_conv(char c)
+{
+    return c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+}
+
+// Byte size of the integer argument selected by the length modifier.
+static size_t int_arg_size(LenMod len)
+{
+    switch (len) {
+        case LenMod::l:  return sizeof(long);
+        case LenMod::ll: return sizeof(long long);
+        case LenMod::j:  return sizeof(intmax_t);
+        case LenMod::z:  return sizeof(size_t);
+        case LenMod::t:  return sizeof(ptrdiff_t);
+        default:         return sizeof(int); // hh/h/none are promoted to int
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Packing
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class Packer
+{
+public:
+    Packer(uint8_t *out, size_t cap) : m_out(out), m_cap(cap) {}
+
+    size_t size() const { return m_pos; }
+
+    void put_i32(uint32_t v)
+    {
+        if (!reserve(1 + 4)) return;
+        m_out[m_pos++] = JOURNAL_ARG_I32;
+        put_le(v, 4);
+    }
+
+    void put_i64(uint64_t v)
+    {
+        if (!reserve(1 + 8)) return;
+        m_out[m_pos++] = JOURNAL_ARG_I64;
+        put_le(v, 8);
+    }
+
+    void put_f64(double v)
+    {
+        if (!reserve(1 + 8)) return;
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        m_out[m_pos++] = JOURNAL_ARG_F64;
+        put_le(bits, 8);
+    }
+
+    // prec: printf precision, at most that many bytes of s are read; -1 for
+    // none (s is then NUL-terminated)
+    void put_str(const char *s, int prec)
+    {
+        if (!reserve(1 + 1)) return;
+        if (!s) s = "(null)";
+        size_t room = m_cap - m_pos - 2;
+        if (room > UINT8_MAX) room = UINT8_MAX;
+        if (prec >= 0 && static_cast<size_t>(prec) < room) room = static_cast<size_t>(prec);
+        const size_t n = strnlen(s, room);
+        m_out[m_pos++] = JOURNAL_ARG_STR;
+        m_out[m_pos++] = static_cast<uint8_t>(n);
+        std::memcpy(&m_out[m_pos], s, n);
+        m_pos += n;
+    }
+
+private:
+    // Once an argument does not fit, later (possibly smaller) ones are not
+    // stored either, so positions in the format string never shift.
+    bool reserve(size_t n)
+    {
+        if (m_full || m_cap - m_pos < n) {
+            m_full = true;
+            return false;
+        }
+        return true;
+    }
+
+    void put_le(uint64_t v, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            m_out[m_pos++] = static_cast<uint8_t>(v >> (8 * i));
+    }
+
+    uint8_t *m_out;
+    size_t   m_cap;
+    size_t   m_pos  = 0;
+    bool     m_full = false;
+};
+
+} // namespace
+
+size_t journal_args_pack(const char *fmt, va_list args, uint8_t *out, size_t cap)
+{
+    if (!fmt || !out)
+        return 0;
+
+    Packer packer(out, cap);
+    FmtSpec spec;
+    while (next_spec(fmt, spec)) {
+        fmt = spec.end;
+        if (spec.conv == '\0')
+            break;
+        if (spec.conv == '%')
+            continue;
+
+        if (spec.width_star)
+            packer.put_i32(static_cast<uint32_t>(va_arg(args, int)));
+        int prec = spec.prec;
+        if (spec.prec_star) {
+            prec = va_arg(args, int);   // negative: as if omitted
+            packer.put_i32(static_cast<uint32_t>(prec));
+        }
+
+        if (is_int_conv(spec.conv)) {
+            if (int_arg_size(spec.len) == 8)
+                packer.put_i64(static_cast<uint64_t>(va_arg(args, long long)));
+            else if (spec.len == LenMod::l)
+                packer.put_i32(static_cast<uint32_t>(va_arg(args, long)));
+            else
+                packer.put_i32(static_cast<uint32_t>(va_arg(args, int)));
+        } else if (is_float_conv(spec.conv)) {
+            if (spec.len == LenMod::L)
+                packer.put_f64(static_cast<double>(va_arg(args, long double)));
+            else
+                packer.put_f64(va_arg(args, double));
+        } else if (spec.conv == 's') {
+            packer.put_str(va_arg(args, const char *), prec);
+        } else if (spec.conv == 'p') {
+            packer.put_i64(reinterpret_cast<uintptr_t>(va_arg(args, void *)));
+        } else if (spec.conv == 'n') {
+            (void)va_arg(args, void *); // never written back — journal is not a scanf
+        }
+    }
+    return packer.size();
+}
+
+size_t journal_args_pack_v(uint8_t *out, size_t cap, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const size_t n = journal_args_pack(fmt, args, out, cap);
+    va_end(args);
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Formatting
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class Unpacker
+{
+public:
+    Unpacker(const uint8_t *in, size_t len) : m_in(in), m_len(len) {}
+
+    // Reads the next entry. Returns its kind, or 0 when the buffer is exhausted
+    // or malformed.
+    uint8_t next(uint64_t &value, const char *&str, size_t &str_len)
+    {
+        if (m_pos >= m_len)
+            return 0;
+        const uint8_t kind = m_in[m_pos++];
+        switch (kind) {
+            case JOURNAL_ARG_I32: return get_le(value, 4) ? kind : 0;
+            case JOURNAL_ARG_I64:
+            case JOURNAL_ARG_F64: return get_le(value, 8) ? kind : 0;
+            case JOURNAL_ARG_STR:
+                if (m_pos >= m_len) return 0;
+                str_len = m_in[m_pos++];
+                if (m_len - m_pos < str_len) return 0;
+                str = reinterpret_cast<const char *>(&m_in[m_pos]);
+                m_pos += str_len;
+                return kind;
+            default:
+                m_pos = m_len;
+                return 0;
+        }
+    }
+
+private:
+    bool get_le(uint64_t &v, size_t n)
+    {
+        if (m_len - m_pos < n) return false;
+        v = 0;
+        for (size_t i = 0; i < n; ++i)
+            v |= static_cast<uint64_t>(m_in[m_pos++]) << (8 * i);
+        return true;
+    }
+
+    const uint8_t *m_in;
+    size_t         m_len;
+    size_t         m_pos = 0;
+};
+
+class TextOut
+{
+public:
+    TextOut(char *out, size_t cap) : m_out(out), m_cap(cap)
+    {
+        if (m_cap) m_out[0] = '\0';
+    }
+
+    size_t size() const { return m_pos; }
+
+    void append(const char *s, size_t n)
+    {
+        if (m_cap == 0) return;
+        const size_t room = m_cap - 1 - m_pos;
+        if (n > room) n = room;
+        std::memcpy(&m_out[m_pos], s, n);
+        m_pos += n;
+        m_out[m_pos] = '\0';
+    }
+
+    template <typename... Args>
+    void appendf(const char *spec, Args... args)
+    {
+        if (m_cap == 0) return;
+        const int n = std::snprintf(&m_out[m_pos], m_cap - m_pos, spec, args...);
+        if (n > 0)
+            m_pos += (static_cast<size_t>(n) < m_cap - m_pos) ? static_cast<size_t>(n) : m_cap - 1 - m_pos;
+    }
+
+private:
+    char  *m_out;
+    size_t m_cap;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+// Rebuilds a printf spec with '*' replaced by stored values and the length
+// modifier normalised to the stored width ("" for 32-bit, "ll" for 64-bit).
+static void build_spec(const FmtSpec &spec, int width, int prec, const char *len_mod,
+                       char *out, size_t cap)
+{
+    size_t pos = 0;
+    auto put = [&](const char *s, size_t n) {
+        if (pos + n >= cap) n = cap - 1 - pos;
+        std::memcpy(&out[pos], s, n);
+        pos += n;
+    };
+
+    const char *p = spec.begin;
+    put(p++, 1); // '%'
+    const char *flags = p;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') ++p;
+    put(flags, static_cast<size_t>(p - flags));
+
+    char num[16];
+    if (spec.width_star) {
+        put(num, static_cast<size_t>(std::snprintf(num, sizeof(num), "%d", width)));
+        ++p;
+    } else {
+        const char *w = p;
+        while (*p >= '0' && *p <= '9') ++p;
+        put(w, static_cast<size_t>(p - w));
+    }
+    if (*p == '.') {
+        ++p;
+        if (spec.prec_star) {
+            if (prec >= 0) // negative: as if omitted
+                put(num, static_cast<size_t>(std::snprintf(num, sizeof(num), ".%d", prec)));
+            ++p;
+        } else {
+            const char *d = p - 1;
+            while (*p >= '0' && *p <= '9') ++p;
+            put(d, static_cast<size_t>(p - d));
+        }
+    }
+    put(len_mod, std::strlen(len_mod));
+    put(&spec.conv, 1);
+    out[pos] = '\0';
+}
+
+size_t journal_args_format(const char *fmt, const uint8_t *packed, size_t len, char *out, size_t cap)
+{
+    if (!out || cap == 0)
+        return 0;
+    TextOut text(out, cap);
+    if (!fmt)
+        return 0;
+
+    Unpacker args(packed, packed ? len : 0);
+    FmtSpec spec;
+    char spec_buf[32];
+    char str_buf[UINT8_MAX + 1];
+
+    while (next_spec(fmt, spec)) {
+        text.append(fmt, static_cast<size_t>(spec.begin - fmt));
+        fmt = spec.end;
+        if (spec.conv == '\0')
+            break;
+        if (spec.conv == '%') {
+            text.append("%", 1);
+            continue;
+        }
+        if (spec.conv == 'n')
+            continue;
+
+        uint64_t    value   = 0;
+        const char *str     = nullptr;
+        size_t      str_len = 0;
+        int width = 0;
+        int prec  = 0;
+        bool ok = true;
+        if (spec.width_star) {
+            ok = args.next(value, str, str_len) == JOURNAL_ARG_I32;
+            width = static_cast<int>(static_cast<uint32_t>(value));
+        }
+        if (ok && spec.prec_star) {
+            ok = args.next(value, str, str_len) == JOURNAL_ARG_I32;
+            prec = static_cast<int>(static_cast<uint32_t>(value));
+        }
+        const uint8_t kind = ok ? args.next(value, str, str_len) : 0;
+
+        if (kind == JOURNAL_ARG_I32 && is_int_conv(spec.conv)) {
+            // hh/h truncate the promoted value when printed
+            const char *len_mod = spec.len == LenMod::hh ? "hh" : spec.len == LenMod::h ? "h" : "";
+            build_spec(spec, width, prec, len_mod, spec_buf, sizeof(spec_buf));
+            if (spec.conv == 'd' || spec.conv == 'i' || spec.conv == 'c')
+                text.appendf(spec_buf, static_cast<int>(static_cast<int32_t>(value)));
+            else
+                text.appendf(spec_buf, static_cast<unsigned>(static_cast<uint32_t>(value)));
+        } else if (kind == JOURNAL_ARG_I64 && is_int_conv(spec.conv)) {
+            build_spec(spec, width, prec, "ll", spec_buf, sizeof(spec_buf));
+            if (spec.conv == 'd' || spec.conv == 'i')
+                text.appendf(spec_buf, static_cast<long long>(value));
+            else
+                text.appendf(spec_buf, static_cast<unsigned long long>(value));
+        } else if (kind == JOURNAL_ARG_I64 && spec.conv == 'p') {
+            text.appendf("0x%llx", static_cast<unsigned long long>(value));
+        } else if (kind == JOURNAL_ARG_F64 && is_float_conv(spec.conv)) {
+            double d;
+            std::memcpy(&d, &value, sizeof(d));
+            build_spec(spec, width, prec, "", spec_buf, sizeof(spec_buf));
+            text.appendf(spec_buf, d);
+        } else if (kind == JOURNAL_ARG_STR && spec.conv == 's') {
+            std::memcpy(str_buf, str, str_len);
+            str_buf[str_len] = '\0';
+            build_spec(spec, width, prec, "", spec_buf, sizeof(spec_buf));
+            text.appendf(spec_buf, static_cast<const char *>(str_buf));
+        } else {
+            text.append(JOURNAL_ARG_MISSING, sizeof(JOURNAL_ARG_MISSING) - 1);
+        }
+    }
+    text.append(fmt, std::strlen(fmt));
+    return text.size();
+}
@@ -0,0 +1,75 @@
+//
+// Journal argument codec - deferred (defmt-style) formatting support
+//
+// Instead of running printf at record time, the journal walks the format
+// string once, copies the raw argument values into a compact byte buffer and
+// keeps the format string pointer (which lives in flash rodata). The text is
+// produced only when a record is exported or dumped, by replaying the same
+// format string against the stored values.
+//
+// Packed layout — one entry per consumed argument, no padding:
+//
+//   kind (1 byte) | payload
+//
+//   JOURNAL_ARG_I32  4 bytes, little-endian   (%d %i %u %x %X %o %c, '*' width/precision)
+//   JOURNAL_ARG_I64  8 bytes, little-endian   (%ll.. %j.. and 64-bit %l/%z/%t, %p)
+//   JOURNAL_ARG_F64  8 bytes, IEEE-754 double (%f %F %e %E %g %G %a %A)
+//   JOURNAL_ARG_STR  1 byte length + bytes    (%s, truncated to fit and to its precision, no '\0')
+//
+// Every entry carries its kind, so the decoder never depends on the writer's
+// sizeof(long) — records from the 32-bit target decode the same on a 64-bit host.
+// When the buffer is full the remaining arguments are not stored; the decoder
+// renders them as "<?>".
+//
+// Pure C++, no ESP-IDF dependency — shared by firmware and host tools.
+//
+
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+enum journal_arg_kind : uint8_t
+{
+    JOURNAL_ARG_I32 = 1,
+    JOURNAL_ARG_I64 = 2,
+    JOURNAL_ARG_F64 = 3,
+    JOURNAL_ARG_STR = 4,
+};
+
+// Placeholder rendered for arguments that did not fit into the record
+#define JOURNAL_ARG_MISSING "<?>"
+
+/**
+ * @brief Pack printf arguments into a compact binary buffer.
+ *
+ * Parses only the conversion specifiers of fmt — no number-to-text
+ * conversion is done, so this is several times cheaper than vsnprintf.
+ *
+ * @param fmt  printf-style format string (must stay valid until decoding).
+ * @param args Arguments matching fmt.
+ * @param out  Destination buffer.
+ * @param cap  Size of out in bytes.
+ * @return Number of bytes written to out.
+ */
+size_t journal_args_pack(const char *fmt, va_list args, uint8_t *out, size_t cap);
+
+/**
+ * @brief Convenience variadic wrapper around journal_args_pack().
+ */
+size_t journal_args_pack_v(uint8_t *out, size_t cap, const char *fmt, ...);
+
+/**
+ * @brief Render fmt against arguments produced by journal_args_pack().
+ *
+ * Output is always NUL-terminated (when cap > 0) and truncated to fit.
+ *
+ * @param fmt     Same format string that was used for packing.
+ * @param packed  Packed argument buffer.
+ * @param len     Number of valid bytes in packed.
+ * @param out     Destination text buffer.
+ * @param cap     Size of out in bytes.
+ * @return Number of characters written, excluding the terminating '\0'.
+ */
+size_t journal_args_format(const char *fmt, const uint8_t *packed, size_t len, char *out, size_t cap);
@@ -0,0 +1,410 @@
+#include "journal_codec.h"
+#include "journal_args.h"
+#include "journal_store.h"
+
+#include <cstring>
+
+static constexpr uint8_t HDR_TYPE_MASK  = 0x03;
+static constexpr uint8_t HDR_DEFERRED   = 0x04;
+static constexpr uint8_t HDR_RESTART    = 0x08;
+static constexpr uint8_t HDR_REF        = 0x10;
+static constexpr uint8_t HDR_IDX_SHIFT  = 5;
+static constexpr uint8_t HDR_IDX_EXT    = 7;
+static constexpr uint8_t HDR_REPEAT     = 0x20;     // inline definitions only
+
+static constexpr size_t VARINT_MAX = 10;
+
+static uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+static uint64_t get_le(const uint8_t *p, size_t n)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; ++i)
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void put_le(uint8_t *p, uint64_t v, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+namespace {
+
+class Writer
+{
+public:
+    Writer(uint8_t *out, size_t cap) : m_out(out), m_cap(cap) {}
+
+    bool ok() const { return !m_overflow; }
+    size_t size() const { return m_pos; }
+
+    void byte(uint8_t v)
+    {
+        if (reserve(1))
+            m_out[m_pos++] = v;
+    }
+
+    void bytes(const uint8_t *p, size_t n)
+    {
+        if (reserve(n)) {
+            std::memcpy(m_out + m_pos, p, n);
+            m_pos += n;
+        }
+    }
+
+    void varint(uint64_t v)
+    {
+        do {
+            const uint8_t b = static_cast<uint8_t>(v & 0x7F);
+            v >>= 7;
+            byte(v ? (b | 0x80) : b);
+        } while (v);
+    }
+
+    uint8_t *at(size_t pos) { return m_out + pos; }
+
+private:
+    bool reserve(size_t n)
+    {
+        if (m_overflow || m_cap - m_pos < n)
+            m_overflow = true;
+        return !m_overflow;
+    }
+
+    uint8_t *m_out;
+    size_t   m_cap;
+    size_t   m_pos      = 0;
+    bool     m_overflow = false;
+};
+
+class Reader
+{
+public:
+    Reader(const uint8_t *in, size_t len) : m_in(in), m_len(len) {}
+
+    bool ok() const { return !m_underflow; }
+    bool done() const { return m_pos >= m_len; }
+    size_t left() const { return m_len - m_pos; }
+    const uint8_t *here() const { return m_in + m_pos; }
+
+    uint8_t byte()
+    {
+        if (!take(1))
+            return 0;
+        return m_in[m_pos++];
+    }
+
+    uint64_t le(size_t n)
+    {
+        if (!take(n))
+            return 0;
+        const uint64_t v = get_le(m_in + m_pos, n);
+        m_pos += n;
+        return v;
+    }
+
+    void skip(size_t n)
+    {
+        if (take(n))
+            m_pos += n;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (size_t i = 0; i < VARINT_MAX; ++i) {
+            const uint8_t b = byte();
+            v |= static_cast<uint64_t>(b & 0x7F) << (7 * i);
+            if (!(b & 0x80))
+                return v;
+        }
+        m_underflow = true;
+        return 0;
+    }
+
+private:
+    bool take(size_t n)
+    {
+        if (m_underflow || m_len - m_pos < n)
+            m_underflow = true;
+        return !m_underflow;
+    }
+
+    const uint8_t *m_in;
+    size_t         m_len;
+    size_t         m_pos       = 0;
+    bool           m_underflow = false;
+};
+
+} // namespace
+
+// Re-encodes journal_args_pack() entries. Stops at the first malformed
+// entry: journal_args_format() renders the missing arguments as "<?>".
+static void encode_args(const uint8_t *packed, size_t len, Writer &w)
+{
+    Reader r(packed, len);
+    while (!r.done()) {
+        const uint8_t kind = r.byte();
+        switch (kind) {
+            case JOURNAL_ARG_I32: {
+                const uint64_t v = r.le(4);
+                if (!r.ok())
+                    return;
+                w.byte(kind);
+                w.varint(zigzag(static_cast<int32_t>(static_cast<uint32_t>(v))));
+                break;
+            }
+            case JOURNAL_ARG_I64: {
+                const uint64_t v = r.le(8);
+                if (!r.ok())
+                    return;
+                w.byte(kind);
+                w.varint(zigzag(static_cast<int64_t>(v)));
+                break;
+            }
+            case JOURNAL_ARG_F64: {
+                const uint8_t *p = r.here();
+                r.skip(8);
+                if (!r.ok())
+                    return;
+                w.byte(kind);
+                w.bytes(p, 8);
+                break;
+            }
+            case JOURNAL_ARG_STR: {
+                const uint8_t n = r.byte();
+                const uint8_t *p = r.here();
+                r.skip(n);
+                if (!r.ok())
+                    return;
+                w.byte(kind);
+                w.byte(n);
+                w.bytes(p, n);
+                break;
+            }
+            default:
+                return;
+        }
+    }
+}
+
+static bool decode_args(Reader &r, Writer &w)
+{
+    while (!r.done()) {
+        const uint8_t kind = r.byte();
+        switch (kind) {
+            case JOURNAL_ARG_I32: {
+                uint8_t raw[4];
+                put_le(raw, static_cast<uint32_t>(static_cast<int32_t>(unzigzag(r.varint()))), 4);
+                w.byte(kind);
+                w.bytes(raw, sizeof(raw));
+                break;
+            }
+            case JOURNAL_ARG_I64: {
+                uint8_t raw[8];
+                put_le(raw, static_cast<uint64_t>(unzigzag(r.varint())), 8);
+                w.byte(kind);
+                w.bytes(raw, sizeof(raw));
+                break;
+            }
+            case JOURNAL_ARG_F64: {
+                const uint8_t *p = r.here();
+                r.skip(8);
+                if (!r.ok())
+                    return false;
+                w.byte(kind);
+                w.bytes(p, 8);
+                break;
+            }
+            case JOURNAL_ARG_STR: {
+                const uint8_t n = r.byte();
+                const uint8_t *p = r.here();
+                r.skip(n);
+                if (!r.ok())
+                    return false;
+                w.byte(kind);
+                w.byte(n);
+                w.bytes(p, n);
+                break;
+            }
+            default:
+                return false;
+        }
+        if (!r.ok() || !w.ok())
+            return false;
+    }
+    return true;
+}
+
+static int dict_find(const JournalCodecState &state, uint16_t id)
+{
+    for (size_t i = 0; i < state.count; ++i) {
+        if (state.ids[i] == id)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+static void dict_add(JournalCodecState &state, uint16_t id)
+{
+    if (state.count < JOURNAL_CODEC_DICT_MAX)
+        state.ids[state.count++] = id;
+}
+
+size_t journal_codec_encode(const journal_record_t &record, bool restart,
+                            JournalCodecState &state, uint8_t *out, size_t cap)
+{
+    if (!out)
+        return 0;
+
+    JournalCodecState next = state;
+    restart = restart || !next.valid;
+    if (restart) {
+        next.count = 0;
+        next.valid = true;
+    }
+
+    const uint16_t id = record.event ? record.event->id : JOURNAL_EVENT_ID_NONE;
+    // Repeat summaries are rare: always inline, kept out of the dictionary
+    const bool repeat = record.flags & JOURNAL_RECORD_REPEAT;
+    const int index = repeat ? -1 : dict_find(next, id);
+
+    uint8_t header = static_cast<uint8_t>(record.type & HDR_TYPE_MASK);
+    if (record.flags & JOURNAL_RECORD_DEFERRED)
+        header |= HDR_DEFERRED;
+    if (restart)
+        header |= HDR_RESTART;
+    if (repeat)
+        header |= HDR_REPEAT;
+    if (index >= 0) {
+        header |= HDR_REF;
+        header |= static_cast<uint8_t>((index < HDR_IDX_EXT ? index : HDR_IDX_EXT) << HDR_IDX_SHIFT);
+    }
+
+    Writer w(out, cap);
+    w.byte(header);
+    w.varint(zigzag(restart ? record.timestamp_ms : record.timestamp_ms - next.timestamp_ms));
+    if (index < 0) {
+        uint8_t raw[2];
+        put_le(raw, id, sizeof(raw));
+        w.bytes(raw, sizeof(raw));
+        if (repeat) {
+            w.varint(record.repeat);
+            w.varint(record.span_ms);
+        } else {
+            dict_add(next, id);
+        }
+    } else if (index >= HDR_IDX_EXT) {
+        w.varint(static_cast<uint64_t>(index - HDR_IDX_EXT));
+    }
+
+    const size_t length = record.length < sizeof(record.data) ? record.length : sizeof(record.data);
+    if (record.flags & JOURNAL_RECORD_DEFERRED)
+        encode_args(record.data, length, w);
+    else
+        w.bytes(record.data, length);
+
+    if (!w.ok())
+        return 0;
+
+    next.timestamp_ms = record.timestamp_ms;
+    state = next;
+    return w.size();
+}
+
+bool journal_codec_decode(const uint8_t *in, size_t len, JournalCodecState &state,
+                          journal_record_t &record, uint16_t &event_id)
+{
+    if (!in || len < JOURNAL_CODEC_RECORD_MIN)
+        return false;
+
+    Reader r(in, len);
+    const uint8_t header = r.byte();
+    JournalCodecState next = state;
+    if (header & HDR_RESTART) {
+        next.count = 0;
+        next.valid = true;
+    } else if (!next.valid) {
+        return false;
+    }
+
+    const int64_t ts = unzigzag(r.varint());
+    record.timestamp_ms = (header & HDR_RESTART) ? ts : next.timestamp_ms + ts;
+
+    if (header & HDR_REF) {
+        size_t index = header >> HDR_IDX_SHIFT;
+        if (index == HDR_IDX_EXT)
+            index += static_cast<size_t>(r.varint());
+        if (index >= next.count)
+            return false;
+        event_id = next.ids[index];
+    } else {
+        event_id = static_cast<uint16_t>(r.le(2));
+        record.repeat  = 0;
+        record.span_ms = 0;
+        if (header & HDR_REPEAT) {
+            record.repeat  = static_cast<uint16_t>(r.varint());
+            record.span_ms = static_cast<uint32_t>(r.varint());
+        } else {
+            dict_add(next, event_id);
+        }
+    }
+    if (!r.ok())
+        return false;
+
+    record.event = journal_event_find(event_id);
+    record.seq   = 0;
+    record.type  = header & HDR_TYPE_MASK;
+    record.flags = (header & HDR_DEFERRED) ? JOURNAL_RECORD_DEFERRED : 0;
+    if (!(header & HDR_REF) && (header & HDR_REPEAT)) {
+        record.flags |= JOURNAL_RECORD_REPEAT;
+    } else {
+        record.repeat  = 0;
+        record.span_ms = 0;
+    }
+
+    if (header & HDR_DEFERRED) {
+        Writer w(record.data, sizeof(record.data));
+        if (!decode_args(r, w))
+            return false;
+        record.length = static_cast<uint8_t>(w.size());
+    } else {
+        if (r.left() > sizeof(record.data))
+            return false;
+        record.length = static_cast<uint8_t>(r.left());
+        std::memcpy(record.data, r.here(), r.left());
+        // Text records are stored without the terminator
+        if (record.length < sizeof(record.data))
+            record.data[record.length] = '\0';
+    }
+
+    next.timestamp_ms = record.timestamp_ms;
+    state = next;
+    return true;
+}
+
+bool journal_codec_key(const uint8_t *in, size_t len, const JournalKey *prev, JournalKey &key)
+{
+    if (!in || len < JOURNAL_CODEC_RECORD_MIN)
+        return false;
+
+    Reader r(in, len);
+    const uint8_t header = r.byte();
+    const int64_t ts = unzigzag(r.varint());
+    if (!r.ok() || (!(header & HDR_RESTART) && !prev))
+        return false;
+
+    key.timestamp_ms = (header & HDR_RESTART) ? ts : prev->timestamp_ms + ts;
+    key.severity     = header & HDR_TYPE_MASK;
+    return true;
+}
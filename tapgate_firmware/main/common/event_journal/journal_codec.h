@@ -0,0 +1,90 @@
+//
+// Journal record codec - compact persisted form of journal_record_t
+//
+// Records are small and repetitive: the timestamp grows by a few hundred
+// milliseconds, a handful of events make up most of the traffic and the
+// arguments are small integers (esp_err_t codes, counters, lengths). The
+// codec stores them as:
+//
+//   byte 0     bits 0-1  event type
+//              bit  2    deferred (body holds arguments, else text)
+//              bit  3    restart: absolute timestamp, dictionary reset
+//              bit  4    event is a dictionary reference, else defined inline
+//              bits 5-7  reference: dictionary index 0..6, 7: index - 7
+//                        follows as varint; definition: bit 5 marks a
+//                        repeat summary (JOURNAL_RECORD_REPEAT)
+//   varint     zig-zag timestamp: absolute on restart, else delta to the
+//              previous record
+//   [u16]      event ID (inline definition, appended to the dictionary
+//              unless it is a repeat summary)
+//   [varint]   repeat count, then varint span in ms (repeat summary)
+//   [varint]   dictionary index - 7 (reference with index >= 7)
+//   body       text bytes, or per argument: kind byte + zig-zag varint
+//              (I32/I64), 8 bytes (F64), length + bytes (STR)
+//
+// A record can only be decoded after the records since the last restart, so
+// the writer emits a restart whenever the store starts a segment or an index
+// block (JournalStore::StartsBlock()) and after a reboot. Readers may begin
+// at any such record; a restart is always valid, it only costs bytes.
+//
+// Pure C++, no ESP-IDF dependency — shared by firmware and host tools.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "journal_record.h"
+
+struct JournalKey;
+
+// Event IDs remembered per restart interval
+constexpr std::size_t JOURNAL_CODEC_DICT_MAX = 32;
+
+// Smallest and largest encoded record
+constexpr std::size_t JOURNAL_CODEC_RECORD_MIN = 2;
+constexpr std::size_t JOURNAL_CODEC_RECORD_MAX = 16 + JOURNAL_DATA_MAX_SIZE + JOURNAL_DATA_MAX_SIZE / 4;
+
+// Encoder or decoder state: previous timestamp and event dictionary.
+// Value-initialize ({}) before first use.
+struct JournalCodecState
+{
+    int64_t  timestamp_ms;
+    bool     valid;         // false: next record must be a restart
+    uint8_t  count;
+    uint16_t ids[JOURNAL_CODEC_DICT_MAX];
+};
+
+/**
+ * @brief Encode a record.
+ *
+ * state is updated only when the record was encoded. A restart is forced if
+ * the state is not valid.
+ *
+ * @return Bytes written, or 0 if cap is too small.
+ */
+size_t journal_codec_encode(const journal_record_t &record, bool restart,
+                            JournalCodecState &state, uint8_t *out, size_t cap);
+
+/**
+ * @brief Decode a record produced by journal_codec_encode().
+ *
+ * record.event is looked up by ID (nullptr if unknown to this build); the ID
+ * itself is returned in event_id. Deferred arguments are restored in the
+ * journal_args_pack() layout, so journal_record_render() works unchanged.
+ *
+ * @return false if the input is malformed or needs a restart first.
+ */
+bool journal_codec_decode(const uint8_t *in, size_t len, JournalCodecState &state,
+                          journal_record_t &record, uint16_t &event_id);
+
+/**
+ * @brief Index key of an encoded record (JournalKeyFn for JournalStore).
+ *
+ * Needs only the leading bytes of the record. prev is the key of the
+ * preceding record, nullptr if unknown.
+ *
+ * @return false if the timestamp cannot be resolved.
+ */
+bool journal_codec_key(const uint8_t *in, size_t len, const JournalKey *prev, JournalKey &key);
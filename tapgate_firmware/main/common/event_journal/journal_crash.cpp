@@ -0,0 +1,181 @@
+#include "journal_crash.h"
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+
+#include "crc32.h"
+
+static constexpr uint32_t CRASH_MAGIC   = 0x54434A45;     // "EJCT"
+static constexpr uint32_t CRASH_VERSION = 1;
+
+static_assert(offsetof(JournalCrashSlot, data) == offsetof(JournalCrashSlot, length) + 1,
+              "JournalCrashSlot must not have padding before data[]");
+
+static constexpr size_t SLOT_CRC_BEGIN = offsetof(JournalCrashSlot, seq);
+
+static uint32_t slot_crc(const JournalCrashSlot &slot)
+{
+    const size_t length = slot.length < sizeof(slot.data) ? slot.length : sizeof(slot.data);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&slot) + SLOT_CRC_BEGIN;
+    return crc32_calculate(p, offsetof(JournalCrashSlot, data) - SLOT_CRC_BEGIN + length);
+}
+
+static uint32_t header_crc(const JournalCrashHeader &header)
+{
+    uint8_t raw[8];
+    std::memcpy(raw, &header.magic, 4);
+    std::memcpy(raw + 4, &header.layout, 4);
+    return crc32_calculate(raw, sizeof(raw));
+}
+
+static bool same_record(const JournalCrashSlot &slot, const journal_record_t &record)
+{
+    const uint16_t id = record.event ? record.event->id : JOURNAL_EVENT_ID_NONE;
+    const size_t length = record.length < sizeof(record.data) ? record.length : sizeof(record.data);
+    return slot.timestamp_ms == record.timestamp_ms && slot.event_id == id && slot.type == record.type
+        && slot.flags == record.flags && slot.length == length && std::memcmp(slot.data, record.data, length) == 0;
+}
+
+JournalCrashTail::JournalCrashTail(JournalCrashHeader &header, std::span<JournalCrashSlot> slots) noexcept
+    : m_header(header)
+    , m_slots(slots)
+    , m_layout((CRASH_VERSION << 28) | (static_cast<uint32_t>(sizeof(JournalCrashSlot)) << 12)
+               | static_cast<uint32_t>(slots.size()))
+{
+}
+
+bool JournalCrashTail::Valid() const noexcept
+{
+    return m_header.magic == CRASH_MAGIC && m_header.layout == m_layout && m_header.crc == header_crc(m_header);
+}
+
+bool JournalCrashTail::SlotValid(const JournalCrashSlot &slot) const noexcept
+{
+    return slot.length <= sizeof(slot.data) && slot.crc == slot_crc(slot);
+}
+
+size_t JournalCrashTail::Pending() const noexcept
+{
+    if (!Valid())
+        return 0;
+    size_t n = 0;
+    for (const JournalCrashSlot &slot : m_slots)
+        n += SlotValid(slot) ? 1 : 0;
+    return n;
+}
+
+int64_t JournalCrashTail::OldestTimestamp() const noexcept
+{
+    int64_t oldest = INT64_MAX;
+    if (!Valid())
+        return oldest;
+    for (const JournalCrashSlot &slot : m_slots) {
+        if (SlotValid(slot) && slot.timestamp_ms < oldest)
+            oldest = slot.timestamp_ms;
+    }
+    return oldest;
+}
+
+int64_t JournalCrashTail::NewestTimestamp() const noexcept
+{
+    if (!Valid())
+        return 0;
+    const JournalCrashSlot *newest = nullptr;
+    uint32_t newest_age = 0;
+    for (const JournalCrashSlot &slot : m_slots) {
+        if (!SlotValid(slot))
+            continue;
+        const uint32_t age = m_header.head - slot.seq;
+        if (!newest || age < newest_age) {
+            newest     = &slot;
+            newest_age = age;
+        }
+    }
+    return newest ? newest->timestamp_ms : 0;
+}
+
+bool JournalCrashTail::Discard(const journal_record_t &persisted) noexcept
+{
+    if (!Valid())
+        return false;
+    for (JournalCrashSlot &slot : m_slots) {
+        if (SlotValid(slot) && same_record(slot, persisted)) {
+            slot.crc = ~slot.crc;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JournalCrashTail::Take(journal_record_t &record, uint16_t &event_id) noexcept
+{
+    if (!Valid())
+        return false;
+
+    // Oldest = furthest behind head, modulo 2^32
+    JournalCrashSlot *oldest = nullptr;
+    uint32_t oldest_age = 0;
+    for (JournalCrashSlot &slot : m_slots) {
+        if (!SlotValid(slot))
+            continue;
+        const uint32_t age = m_header.head - slot.seq;
+        if (!oldest || age > oldest_age) {
+            oldest     = &slot;
+            oldest_age = age;
+        }
+    }
+    if (!oldest)
+        return false;
+
+    event_id = oldest->event_id;
+    record = {};
+    record.timestamp_ms = oldest->timestamp_ms;
+    record.event        = journal_event_find(oldest->event_id);
+    record.type         = oldest->type;
+    record.flags        = oldest->flags;
+    record.length       = oldest->length;
+    record.repeat       = oldest->repeat;
+    record.span_ms      = oldest->span_ms;
+    std::memcpy(record.data, oldest->data, oldest->length);
+    if (!(record.flags & JOURNAL_RECORD_DEFERRED) && record.length < sizeof(record.data))
+        record.data[record.length] = '\0';
+
+    oldest->crc = ~oldest->crc;
+    return true;
+}
+
+void JournalCrashTail::Reset() noexcept
+{
+    std::memset(m_slots.data(), 0, m_slots.size_bytes());
+    // Cleared slots must fail their CRC
+    for (JournalCrashSlot &slot : m_slots)
+        slot.crc = ~slot_crc(slot);
+
+    m_header.magic  = CRASH_MAGIC;
+    m_header.layout = m_layout;
+    m_header.crc    = header_crc(m_header);
+    m_header.head   = 0;
+}
+
+void JournalCrashTail::Record(const journal_record_t &record) noexcept
+{
+    if (m_header.magic != CRASH_MAGIC || m_header.layout != m_layout)
+        return;
+
+    const uint32_t seq = std::atomic_ref<uint32_t>(m_header.head).fetch_add(1, std::memory_order_relaxed);
+    JournalCrashSlot &slot = m_slots[seq % m_slots.size()];
+
+    const size_t length = record.length < sizeof(record.data) ? record.length : sizeof(record.data);
+    slot.seq          = seq;
+    slot.timestamp_ms = record.timestamp_ms;
+    slot.span_ms      = record.span_ms;
+    slot.event_id     = record.event ? record.event->id : JOURNAL_EVENT_ID_NONE;
+    slot.repeat       = record.repeat;
+    slot.type         = record.type;
+    slot.flags        = record.flags;
+    slot.length       = static_cast<uint8_t>(length);
+    std::memcpy(slot.data, record.data, length);
+    slot.crc          = slot_crc(slot);
+}
@@ -0,0 +1,127 @@
+//
+// JournalCrashTail - last journal records kept in memory that survives a reset
+//
+// Records staged in the RAM ring are lost when the device panics or a
+// watchdog fires before the flush task persisted them, and those are the
+// records that explain the reset. Every staged record is therefore also
+// mirrored into a small region that the startup code does not clear
+// (RTC_NOINIT_ATTR on the target, an mmap'd file in host tests):
+//
+//   header     magic, layout word (slot size, capacity), header CRC-32,
+//              next sequence number
+//   slots[N]   overwritten round-robin; each holds one record (event ID
+//              instead of the descriptor pointer) with its sequence number
+//              and a CRC-32 over both
+//
+// Record() is a slot reservation, a few stores and a CRC over at most
+// JOURNAL_DATA_MAX_SIZE bytes: no locks, no allocation, no OS calls, so it
+// may run from the panic handler. A slot torn by the reset fails its CRC and
+// is skipped; garbage after a power-on fails the header check.
+//
+// At the next boot, before the region is written again, the journal discards
+// the slots that already reached flash (Discard()), appends the rest
+// (Take(), oldest first) and re-arms the region (Reset()).
+//
+// Pure C++, no ESP-IDF dependency — shared by firmware and host tests.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "journal_record.h"
+
+struct JournalCrashHeader
+{
+    uint32_t magic;
+    uint32_t layout;
+    uint32_t crc;           // over magic and layout
+    uint32_t head;          // sequence number of the next record
+};
+
+// No padding before data[]: the slot CRC covers seq .. data[length - 1]
+struct JournalCrashSlot
+{
+    uint32_t crc;
+    uint32_t seq;
+    int64_t  timestamp_ms;
+    uint32_t span_ms;
+    uint16_t event_id;
+    uint16_t repeat;
+    uint8_t  type;
+    uint8_t  flags;
+    uint8_t  length;
+    uint8_t  data[JOURNAL_DATA_MAX_SIZE];
+};
+
+// Retained region. Must stay trivial: a constructor would clear it at boot.
+template <std::size_t N>
+struct JournalCrashRegion
+{
+    JournalCrashHeader header;
+    JournalCrashSlot   slots[N];
+};
+
+class JournalCrashTail
+{
+public:
+    template <std::size_t N>
+    explicit JournalCrashTail(JournalCrashRegion<N> &region) noexcept
+        : JournalCrashTail(region.header, region.slots)
+    {
+        static_assert(std::is_trivial_v<JournalCrashRegion<N>>, "retained region must not be initialized");
+        static_assert(N >= 1 && N <= 64, "crash tail holds 1..64 records");
+    }
+
+    JournalCrashTail(JournalCrashHeader &header, std::span<JournalCrashSlot> slots) noexcept;
+
+    JournalCrashTail(const JournalCrashTail&) = delete;
+    JournalCrashTail& operator=(const JournalCrashTail&) = delete;
+
+    // Header intact and written by a build with the same layout.
+    [[nodiscard]] bool Valid() const noexcept;
+
+    // Slots holding a record that passes its CRC (0 if !Valid()).
+    [[nodiscard]] size_t Pending() const noexcept;
+
+    // Oldest timestamp among the pending slots, INT64_MAX if none.
+    [[nodiscard]] int64_t OldestTimestamp() const noexcept;
+
+    // Timestamp of the newest pending slot (highest sequence number), 0 if
+    // none. Plain reads and CRCs only, for the panic handler: a slot another
+    // core was writing fails its CRC and the one before it is used.
+    [[nodiscard]] int64_t NewestTimestamp() const noexcept;
+
+    // Drops one pending slot equal to `persisted` (a record read back from
+    // the journal). Returns false if there is none.
+    bool Discard(const journal_record_t &persisted) noexcept;
+
+    /**
+     * @brief Remove the oldest pending record.
+     *
+     * record.event is looked up by ID (nullptr if unknown to this build); the
+     * ID itself is returned in event_id.
+     *
+     * @return false when no record is pending.
+     */
+    bool Take(journal_record_t &record, uint16_t &event_id) noexcept;
+
+    // Formats the header and clears every slot. Record() is a no-op on a
+    // region that is not Valid(), so recovery must finish before this call.
+    void Reset() noexcept;
+
+    // Mirrors a record into the next slot. Safe from any task and from the
+    // panic handler; concurrent callers get distinct slots.
+    void Record(const journal_record_t &record) noexcept;
+
+private:
+    [[nodiscard]] bool SlotValid(const JournalCrashSlot &slot) const noexcept;
+
+    JournalCrashHeader         &m_header;
+    std::span<JournalCrashSlot> m_slots;
+    uint32_t                    m_layout;
+
+}; // class JournalCrashTail
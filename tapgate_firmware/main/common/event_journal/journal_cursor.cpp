@@ -0,0 +1,74 @@
+#include "journal_cursor.h"
+
+#include <climits>
+
+esp_err_t journal_cursor_read(JournalTiers &tiers, const JournalCursor &since, uint8_t severities,
+                              size_t max_records, uint8_t *scratch, size_t cap, JournalCursorVisit visit,
+                              void *ctx, JournalCursor &cursor)
+{
+    constexpr size_t TIERS = JournalTiers::COUNT;
+
+    uint64_t end_seq[TIERS];
+    uint64_t expected[TIERS];
+    bool gap = false;
+    bool behind = false;
+    for (size_t tier = 0; tier < TIERS; ++tier) {
+        const esp_err_t err = tiers.Store(tier).NextSeq(end_seq[tier]);
+        if (err != ESP_OK)
+            return err;
+        expected[tier] = since.next_seq[tier];
+        // A cursor from the future: the journal was erased since the
+        // client's last read and numbering started over
+        if (expected[tier] > end_seq[tier]) {
+            expected[tier] = 0;
+            gap = true;
+        }
+        behind |= expected[tier] < end_seq[tier];
+    }
+
+    const auto finish = [&]() {
+        for (size_t tier = 0; tier < TIERS; ++tier)
+            cursor.next_seq[tier] = expected[tier];
+        cursor.gap = gap;
+        return ESP_OK;
+    };
+    if (!behind || max_records == 0)
+        return finish();
+
+    // Every severity is read: a block skipped for its severities would look
+    // like a gap
+    const JournalStore::Filter filter = { INT64_MIN, 0xFF, true };
+    JournalTiers::Reader reader = tiers.Query(filter, expected, scratch, cap);
+    size_t delivered = 0;
+    for (;;) {
+        const JournalTiers::Entry *entry = nullptr;
+        const esp_err_t err = reader.Next(entry);
+        if (err == ESP_ERR_NOT_FOUND)
+            break;
+        if (err != ESP_OK)
+            return err;
+
+        uint64_t &next = expected[entry->tier];
+        if (entry->seq < next)
+            continue;
+        if (delivered == max_records)
+            return finish();
+
+        gap |= entry->seq != next;
+        next = entry->seq + 1;
+        if (!entry->decoded || !(severities & (1u << entry->record.type)))
+            continue;
+        ++delivered;
+        if (!visit(entry->tier, entry->seq, entry->record, entry->event_id, ctx))
+            return finish();
+    }
+
+    // The newest records of a tier are unreadable
+    for (size_t tier = 0; tier < TIERS; ++tier) {
+        if (expected[tier] < end_seq[tier]) {
+            gap            = true;
+            expected[tier] = end_seq[tier];
+        }
+    }
+    return finish();
+}
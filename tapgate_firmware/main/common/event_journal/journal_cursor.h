@@ -0,0 +1,57 @@
+//
+// Journal cursor - incremental reads by record sequence number
+//
+// Every persisted record has a 64-bit sequence number, assigned by its
+// tier's store on append and never reused (it survives reboots and segment
+// rotation). A cursor holds one position per retention tier
+// (journal_tiers.h). A client that remembers the cursor of its last read
+// asks for "records after my cursor, at most K" and receives only the
+// delta, merged across tiers by timestamp:
+//
+//   since       first sequence number per tier the client has not seen yet
+//               (0 for everything still stored)
+//   next_seq    returned cursor: pass it as since of the next read
+//   gap         records between since and the first one visited no longer
+//               exist (rotated out, corrupted, or the journal was reset),
+//               so the client knows its copy has a hole
+//
+// The store's index skips every segment and block that ends before the
+// cursor, so a read costs the blocks holding the delta, not the journal.
+// Records filtered out by severity still advance the cursor.
+//
+// Not thread-safe: the caller serializes access to the stores. Pure C++, no
+// ESP-IDF dependency.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "journal_record.h"
+#include "journal_tiers.h"
+
+struct JournalCursor
+{
+    uint64_t next_seq[JournalTiers::COUNT];
+    bool     gap;
+};
+
+// Called for each record read; return false to stop after this record.
+// record.event is nullptr for IDs unknown to this build (event_id is kept).
+using JournalCursorVisit = bool (*)(size_t tier, uint64_t seq, const journal_record_t &record,
+                                    uint16_t event_id, void *ctx);
+
+/**
+ * @brief Visit up to max_records records at or after the since cursor with
+ * a severity in the bitmap, oldest first.
+ *
+ * scratch holds JournalTiers::COUNT buffers of cap bytes
+ * (JOURNAL_CODEC_RECORD_MAX) each. since.gap is ignored; cursor may alias
+ * since.
+ *
+ * @return ESP_OK with cursor set, or a storage error.
+ */
+esp_err_t journal_cursor_read(JournalTiers &tiers, const JournalCursor &since, uint8_t severities,
+                              size_t max_records, uint8_t *scratch, size_t cap, JournalCursorVisit visit,
+                              void *ctx, JournalCursor &cursor);
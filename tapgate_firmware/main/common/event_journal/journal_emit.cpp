@@ -0,0 +1,164 @@
+#include "journal_emit.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "esp_log.h"
+#include "journal_record.h"
+
+#if defined(APP_DEBUG_MODE) || defined(CONFIG_APP_DEBUG_MODE)
+#define JOURNAL_EMIT_DEBUG_TAG 1
+unsigned int global_events_counter_per_session = 0;
+#endif
+
+static_assert(JOURNAL_EMIT_LINE_MAX >= JOURNAL_MSG_MAX_SIZE + 32,
+              "The line buffer must hold a caller tag and a full journal message");
+
+static const char LEVEL_LETTER[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+int journal_emit_format(char *out, size_t cap, const char *tag, const char *fmt, va_list args,
+                        size_t &message_offset)
+{
+    size_t prefix = std::strlen(tag);
+    if (prefix + 2 >= cap)
+        prefix = cap > 3 ? cap - 3 : 0;
+    std::memcpy(out, tag, prefix);
+    out[prefix++] = ':';
+    out[prefix++] = ' ';
+    message_offset = prefix;
+
+    const int len = vsnprintf(out + prefix, cap - prefix, fmt, args);
+    if (len < 0) {
+        out[prefix] = '\0';
+        return len;
+    }
+    return static_cast<int>(prefix) + len;
+}
+
+const char *journal_emit_debug_tag(char *out, size_t cap, unsigned n)
+{
+    static constexpr char HEAD[] = ">> EVENT ";
+    static constexpr char TAIL[] = " <<";
+
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+
+    const size_t total = sizeof(HEAD) - 1 + count + sizeof(TAIL);
+    if (total > cap) {
+        out[0] = '\0';
+        return out;
+    }
+    char *p = out;
+    std::memcpy(p, HEAD, sizeof(HEAD) - 1);
+    p += sizeof(HEAD) - 1;
+    while (count != 0)
+        *p++ = digits[--count];
+    std::memcpy(p, TAIL, sizeof(TAIL));
+    return out;
+}
+
+static esp_log_level_t journal_console_level(enum event_journal_type type)
+{
+    switch (type) {
+        case EVENT_JOURNAL_INFO:    return ESP_LOG_INFO;
+        case EVENT_JOURNAL_ERROR:   return ESP_LOG_ERROR;
+        case EVENT_JOURNAL_WARNING:
+        case EVENT_JOURNAL_ALERT:
+        default:                    return ESP_LOG_WARN;
+    }
+}
+
+static bool journal_console_enabled(esp_log_level_t level)
+{
+#ifdef ESP_PLATFORM
+    return LOG_LOCAL_LEVEL >= level && esp_log_level_get(EVENT_JOURNAL_TAG) >= level;
+#else
+    (void)level;
+    return true;
+#endif
+}
+
+/**
+ * @brief Console output of a line that did not fit the line buffer.
+ *
+ * Formatted straight into the log sink, in three writes.
+ */
+static void journal_console_long(esp_log_level_t level, const char *log_tag, const char *tag,
+                                 const char *fmt, va_list args)
+{
+    esp_log_write(level, log_tag, "%c (%lu) %s: %s: ", LEVEL_LETTER[level],
+                  static_cast<unsigned long>(esp_log_timestamp()), log_tag, tag);
+    esp_log_writev(level, log_tag, fmt, args);
+    esp_log_write(level, log_tag, "\n");
+}
+
+/**
+ * @brief Record an event and print it, formatting the message at most once.
+ *
+ * Backend of EVENT_JOURNAL_ADD.
+ *
+ * @param type Event journal type
+ * @param event Call-site descriptor (event ID, tag, format string)
+ * @param ... Variable arguments matching event->fmt
+ */
+void _event_journal_emit(enum event_journal_type type, const journal_event_desc_t *event, ...)
+{
+#ifdef JOURNAL_EMIT_DEBUG_TAG
+    char debug_tag[24];
+    const unsigned n = std::atomic_ref<unsigned>(global_events_counter_per_session).fetch_add(1, std::memory_order_relaxed);
+    const char *const log_tag = journal_emit_debug_tag(debug_tag, sizeof(debug_tag), n + 1u);
+#else
+    const char *const log_tag = EVENT_JOURNAL_TAG;
+#endif
+
+    if (type > EVENT_JOURNAL_ALERT) {
+        ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, log_tag, "Unknown event journal type: %d", type);
+        return;
+    }
+
+    const esp_log_level_t level = journal_console_level(type);
+    const bool console = journal_console_enabled(level);
+#ifdef CONFIG_EVENT_JOURNAL_DEFERRED_FORMAT
+    const bool format = console;
+#else
+    const bool format = true;
+#endif
+
+    va_list args;
+    va_start(args, event);
+
+    char line[JOURNAL_EMIT_LINE_MAX];
+    const char *text = nullptr;
+    size_t length = 0;
+    bool truncated = false;
+    if (format) {
+        va_list format_args;
+        va_copy(format_args, args);
+        size_t offset = 0;
+        const int len = journal_emit_format(line, sizeof(line), event->tag, event->fmt, format_args, offset);
+        va_end(format_args);
+
+        const size_t line_len = len < 0 ? offset : static_cast<size_t>(len);
+        truncated = line_len >= sizeof(line);
+        text      = line + offset;
+        length    = (truncated ? sizeof(line) - 1 : line_len) - offset;
+    }
+
+    va_list record_args;
+    va_copy(record_args, args);
+    journal_emit_record(type, event, text, length, record_args);
+    va_end(record_args);
+
+    if (console) {
+        if (!truncated)
+            ESP_LOG_LEVEL_LOCAL(level, log_tag, "%s", line);
+        else
+            journal_console_long(level, log_tag, event->tag, event->fmt, args);
+    }
+    va_end(args);
+}
@@ -0,0 +1,61 @@
+//
+// Journal emit path - one formatting pass shared by console and journal
+//
+// EVENT_JOURNAL_ADD used to format every event twice: vsnprintf() into the
+// record, then ESP_LOGx parsing the same format and arguments again for the
+// console (and, in debug mode, snprintf() for the ">> EVENT N <<" tag).
+// _event_journal_emit() formats "<tag>: <message>" once into a line buffer
+// and hands the same bytes to both sinks:
+//
+//   console   ESP_LOG_LEVEL_LOCAL(level, tag, "%s", line), i.e. esp_log_write
+//             with a preformatted string
+//   journal   journal_emit_record() copies the message part of the line
+//             (with deferred formatting it packs the raw arguments instead)
+//
+// With deferred formatting and the console level filtering the event out,
+// nothing is formatted at all. A line longer than the buffer (the boot
+// banner) is written to the console straight from the arguments.
+//
+// The line buffer is on the stack of the emitting task: no locking, no heap,
+// and no cost for tasks that never log.
+//
+
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+
+#include "event_journal.h"
+
+// Line buffer on the emitting task's stack: "<tag>: <message>", including '\0'
+#ifdef CONFIG_EVENT_JOURNAL_LINE_MAX
+constexpr std::size_t JOURNAL_EMIT_LINE_MAX = CONFIG_EVENT_JOURNAL_LINE_MAX;
+#else
+constexpr std::size_t JOURNAL_EMIT_LINE_MAX = 192;
+#endif
+
+/**
+ * @brief Format "<tag>: <message>" into out.
+ *
+ * @param message_offset Set to the offset of the message in out.
+ * @return Length of the complete line (as vsnprintf: may exceed cap - 1),
+ *         or a negative value on an encoding error.
+ */
+int journal_emit_format(char *out, size_t cap, const char *tag, const char *fmt, va_list args,
+                        size_t &message_offset);
+
+/**
+ * @brief Write ">> EVENT <n> <<" (debug-mode console tag) into out.
+ *
+ * @return out
+ */
+const char *journal_emit_debug_tag(char *out, size_t cap, unsigned n);
+
+/**
+ * @brief Persist one event. Implemented by the journal core.
+ *
+ * text is the formatted message (length bytes, not terminated) or nullptr if
+ * it was not formatted; args are the raw arguments matching event->fmt.
+ */
+void journal_emit_record(enum event_journal_type type, const journal_event_desc_t *event,
+                         const char *text, size_t length, va_list args);
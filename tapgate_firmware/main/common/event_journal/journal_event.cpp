@@ -0,0 +1,60 @@
+#include "journal_event.h"
+
+#include <cstring>
+
+// Section bounds. Declared weak so a link without any EVENT_JOURNAL_ADD call
+// site resolves them to null instead of failing.
+#if defined(_MSC_VER)
+static const journal_event_desc_t *const *const s_begin = nullptr;
+static const journal_event_desc_t *const *const s_end   = nullptr;
+#elif defined(ESP_PLATFORM)
+extern "C" const journal_event_desc_t *const _ej_events_start[] __attribute__((weak));
+extern "C" const journal_event_desc_t *const _ej_events_end[]   __attribute__((weak));
+static const journal_event_desc_t *const *const s_begin = _ej_events_start;
+static const journal_event_desc_t *const *const s_end   = _ej_events_end;
+#else
+extern "C" const journal_event_desc_t *const __start_ej_events[] __attribute__((weak));
+extern "C" const journal_event_desc_t *const __stop_ej_events[]  __attribute__((weak));
+static const journal_event_desc_t *const *const s_begin = __start_ej_events;
+static const journal_event_desc_t *const *const s_end   = __stop_ej_events;
+#endif
+
+size_t journal_event_count(void)
+{
+    return (s_begin && s_end) ? static_cast<size_t>(s_end - s_begin) : 0;
+}
+
+const journal_event_desc_t *journal_event_at(size_t index)
+{
+    return index < journal_event_count() ? s_begin[index] : nullptr;
+}
+
+const journal_event_desc_t *journal_event_find(uint16_t id)
+{
+    const size_t count = journal_event_count();
+    for (size_t i = 0; i < count; ++i) {
+        if (s_begin[i]->id == id)
+            return s_begin[i];
+    }
+    return nullptr;
+}
+
+static bool same_text(const char *a, const char *b)
+{
+    return a == b || (a && b && std::strcmp(a, b) == 0);
+}
+
+size_t journal_event_collisions(void)
+{
+    const size_t count = journal_event_count();
+    size_t collisions = 0;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = i + 1; j < count; ++j) {
+            const journal_event_desc_t *a = s_begin[i];
+            const journal_event_desc_t *b = s_begin[j];
+            if (a->id == b->id && !(same_text(a->tag, b->tag) && same_text(a->fmt, b->fmt)))
+                ++collisions;
+        }
+    }
+    return collisions;
+}
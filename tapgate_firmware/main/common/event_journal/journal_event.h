@@ -0,0 +1,95 @@
+//
+// Journal event descriptors - compile-time interned event IDs
+//
+// Every EVENT_JOURNAL_ADD call site owns one constant descriptor holding a
+// stable 16-bit event ID, the caller tag and the format string. The ID is a
+// constexpr hash of the tag text and the format string, computed entirely at
+// compile time, so it is identical across builds for the same event.
+//
+// Persistent records store the ID instead of the text; filtering by event
+// type is an integer compare.
+//
+// A pointer to each descriptor is placed in the "ej_events" linker section so
+// the complete ID-to-format table can be enumerated at runtime, and read from
+// the firmware ELF by tools/journal_decode without running the device.
+//   - ESP-IDF: main/linker.lf keeps the section in flash rodata and emits
+//              _ej_events_start / _ej_events_end.
+//   - GCC/Clang host: the linker emits __start_ej_events / __stop_ej_events.
+//   - MSVC host: descriptors exist but are not enumerable (table is empty).
+//
+// Requirement: the tag passed to EVENT_JOURNAL_ADD must be a constant
+// expression (string literal or constexpr char array).
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reserved: never produced by journal_event_id()
+#define JOURNAL_EVENT_ID_NONE 0u
+
+typedef struct journal_event_desc
+{
+    uint16_t    id;     // Stable event ID (hash of tag + format)
+    const char *tag;    // Caller tag text
+    const char *fmt;    // printf-style format string
+} journal_event_desc_t;
+
+/**
+ * @brief Number of registered event descriptors.
+ */
+size_t journal_event_count(void);
+
+/**
+ * @brief Descriptor at position index (0 <= index < journal_event_count()).
+ */
+const journal_event_desc_t *journal_event_at(size_t index);
+
+/**
+ * @brief Find the descriptor for an event ID, or NULL if unknown.
+ */
+const journal_event_desc_t *journal_event_find(uint16_t id);
+
+/**
+ * @brief Count ID collisions: descriptors sharing an ID but not tag/format.
+ *
+ * Identical tag + format at several call sites intentionally share one ID
+ * and are not reported.
+ */
+size_t journal_event_collisions(void);
+
+#ifdef __cplusplus
+}
+
+// FNV-1a 32-bit over "<tag>\0<format>", folded to 16 bits.
+constexpr uint16_t journal_event_id(const char *tag, const char *fmt)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = tag; *p; ++p)
+        h = (h ^ static_cast<uint8_t>(*p)) * 16777619u;
+    h = (h ^ 0u) * 16777619u;
+    for (const char *p = fmt; *p; ++p)
+        h = (h ^ static_cast<uint8_t>(*p)) * 16777619u;
+
+    const uint16_t id = static_cast<uint16_t>((h >> 16) ^ (h & 0xFFFFu));
+    return id == JOURNAL_EVENT_ID_NONE ? 1u : id;
+}
+
+#if defined(_MSC_VER)
+    #define _EJ_EVENT_SECTION
+#else
+    #define _EJ_EVENT_SECTION __attribute__((used, section("ej_events"), aligned(sizeof(void *))))
+#endif
+
+// Declares the call-site descriptor `_ej_event` and registers it.
+#define _EJ_EVENT_DECL(tag, fmt) \
+    static constinit const journal_event_desc_t _ej_event = { \
+        journal_event_id((tag), (fmt)), (tag), (fmt) }; \
+    [[maybe_unused]] static const journal_event_desc_t *const _ej_event_ref _EJ_EVENT_SECTION = &_ej_event;
+
+#endif // __cplusplus
@@ -0,0 +1,189 @@
+#include "journal_limiter.h"
+
+#include <cstring>
+
+// Token bucket fill is kept in 1/60000 of a token: refilling at per_minute
+// tokens per 60000 ms then adds exactly per_minute units per millisecond.
+static constexpr uint32_t TOKEN = 60000;
+
+static constexpr uint32_t FNV_OFFSET = 2166136261u;
+static constexpr uint32_t FNV_PRIME  = 16777619u;
+
+static uint32_t fnv(uint32_t h, const uint8_t *p, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ p[i]) * FNV_PRIME;
+    return h;
+}
+
+static uint32_t signature(const journal_record_t &record)
+{
+    const uint16_t id = record.event ? record.event->id : JOURNAL_EVENT_ID_NONE;
+    const uint8_t head[] = {
+        static_cast<uint8_t>(id), static_cast<uint8_t>(id >> 8), record.type, record.flags, record.length
+    };
+    const size_t length = record.length < sizeof(record.data) ? record.length : sizeof(record.data);
+    return fnv(fnv(FNV_OFFSET, head, sizeof(head)), record.data, length);
+}
+
+static bool same_event(const journal_record_t &a, const journal_record_t &b)
+{
+    const size_t length = a.length < sizeof(a.data) ? a.length : sizeof(a.data);
+    return a.event == b.event && a.type == b.type && a.flags == b.flags && a.length == b.length
+        && std::memcmp(a.data, b.data, length) == 0;
+}
+
+JournalLimiter::JournalLimiter(const Config &config) noexcept
+    : m_config(config)
+{
+}
+
+JournalLimiter::Verdict JournalLimiter::Admit(const journal_record_t &record, int64_t now_ms,
+                                              journal_record_t &summary, bool &has_summary) noexcept
+{
+    has_summary = false;
+    if (record.type >= UNLIMITED_TYPE)
+        return ADMIT;
+
+    if (m_config.coalesce_ms == 0)
+        return Allow(record, now_ms) ? ADMIT : SUPPRESSED;
+
+    const uint32_t sig = signature(record);
+    Run &run = m_runs[sig % SIGNATURE_SLOTS];
+
+    if (run.active && run.signature == sig && now_ms - run.seen_ms < m_config.coalesce_ms
+        && same_event(run.first, record)) {
+        run.seen_ms = now_ms;
+        run.last_ts = record.timestamp_ms;
+        ++m_coalesced;
+        // Counter full: report what we have and keep folding
+        if (++run.count == UINT16_MAX) {
+            Summarize(run, summary);
+            run.active  = true;
+            has_summary = true;
+        }
+        return COALESCED;
+    }
+
+    // The slot's run ends here, whatever happens to this record
+    if (run.active && run.count != 0) {
+        Summarize(run, summary);
+        has_summary = true;
+    }
+    run.active = false;
+
+    if (!Allow(record, now_ms))
+        return SUPPRESSED;
+
+    run.active    = true;
+    run.signature = sig;
+    run.count     = 0;
+    run.seen_ms   = now_ms;
+    run.last_ts   = record.timestamp_ms;
+    run.first     = record;
+    return ADMIT;
+}
+
+bool JournalLimiter::Expire(int64_t now_ms, journal_record_t &summary) noexcept
+{
+    for (size_t n = 0; n < SIGNATURE_SLOTS; ++n) {
+        Run &run = m_runs[m_expire_cursor];
+        m_expire_cursor = (m_expire_cursor + 1) % SIGNATURE_SLOTS;
+        if (!run.active || now_ms - run.seen_ms < m_config.coalesce_ms)
+            continue;
+        run.active = false;
+        if (run.count != 0) {
+            Summarize(run, summary);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JournalLimiter::Drain(journal_record_t &summary) noexcept
+{
+    for (Run &run : m_runs) {
+        if (!run.active)
+            continue;
+        run.active = false;
+        if (run.count != 0) {
+            Summarize(run, summary);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JournalLimiter::Summarize(Run &run, journal_record_t &summary) noexcept
+{
+    const int64_t span = run.last_ts - run.first.timestamp_ms;
+
+    summary              = run.first;
+    summary.flags       |= JOURNAL_RECORD_REPEAT;
+    summary.repeat       = run.count;
+    summary.timestamp_ms = run.last_ts;
+    summary.span_ms      = span < 0 ? 0 : span > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(span);
+
+    // A continuing run counts again from its last occurrence
+    run.count              = 0;
+    run.first.timestamp_ms = run.last_ts;
+    run.active             = false;
+}
+
+bool JournalLimiter::Allow(const journal_record_t &record, int64_t now_ms) noexcept
+{
+    const uint8_t type = record.type % SEVERITIES;
+    const Rate &rate = m_config.rates[type];
+    if (rate.per_minute == 0)
+        return true;
+
+    const char *tag = record.event && record.event->tag ? record.event->tag : "";
+    const uint8_t sev = type;
+    uint32_t key = fnv(fnv(FNV_OFFSET, reinterpret_cast<const uint8_t *>(tag), std::strlen(tag)), &sev, 1);
+    if (key == 0)
+        key = 1;
+
+    // Two-way set: reuse the matching slot, else the least recently refilled
+    const size_t i = key % BUCKET_SLOTS;
+    Bucket *bucket = &m_buckets[i];
+    if (bucket->key != key) {
+        Bucket *other = &m_buckets[i ^ 1];
+        if (other->key == key)
+            bucket = other;
+        else if (bucket->key != 0 && (other->key == 0 || other->refill_ms < bucket->refill_ms))
+            bucket = other;
+    }
+    if (bucket->key != key) {
+        bucket->key       = key;
+        bucket->tokens    = static_cast<uint32_t>(rate.burst) * TOKEN;
+        bucket->refill_ms = now_ms;
+    }
+
+    const uint64_t cap = static_cast<uint64_t>(rate.burst) * TOKEN;
+    if (now_ms > bucket->refill_ms) {
+        const uint64_t fill = bucket->tokens + static_cast<uint64_t>(now_ms - bucket->refill_ms) * rate.per_minute;
+        bucket->tokens    = static_cast<uint32_t>(fill < cap ? fill : cap);
+        bucket->refill_ms = now_ms;
+    }
+
+    if (bucket->tokens >= TOKEN) {
+        bucket->tokens -= TOKEN;
+        return true;
+    }
+
+    ++m_suppressed[type];
+    ++m_suppressed_pending;
+    return false;
+}
+
+uint32_t JournalLimiter::Suppressed(uint8_t type) const noexcept
+{
+    return type < SEVERITIES ? m_suppressed[type] : 0;
+}
+
+uint32_t JournalLimiter::TakeSuppressed() noexcept
+{
+    const uint32_t n = m_suppressed_pending;
+    m_suppressed_pending = 0;
+    return n;
+}
@@ -0,0 +1,127 @@
+//
+// JournalLimiter - coalescing of repeated events and per-tag rate limiting
+//
+// A flapping fault (NVM commit failing in a retry loop, a noisy BLE peer
+// sending invalid frames) must not flood the journal or wear the flash.
+// Every record passes through Admit() before it is staged:
+//
+//   Coalescing  Records are hashed (event ID, type, arguments) into a small
+//               direct-mapped table of recent signatures. A record identical
+//               to one seen less than coalesce_ms ago is folded into it. When
+//               the run ends (another signature takes the slot, or Expire()
+//               finds it idle) one summary record is emitted: the same event
+//               flagged JOURNAL_RECORD_REPEAT, with the number of folded
+//               occurrences and the time from the first to the last one.
+//
+//   Rate limit  A token bucket per (tag, severity) admits `burst` records
+//               and refills at `per_minute`. Records arriving on an empty
+//               bucket are suppressed and counted per severity.
+//
+// ALERT records bypass both. Admit() is O(1): one hash over at most
+// JOURNAL_DATA_MAX_SIZE bytes and two table probes.
+//
+// Not thread-safe: the caller serializes access (a short critical section
+// on the target). Pure C++, no ESP-IDF dependency.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "journal_record.h"
+
+class JournalLimiter
+{
+public:
+    static constexpr size_t SIGNATURE_SLOTS = 16;
+    static constexpr size_t BUCKET_SLOTS    = 16;
+    static constexpr size_t SEVERITIES      = 4;     // enum event_journal_type
+    static constexpr uint8_t UNLIMITED_TYPE = 3;     // EVENT_JOURNAL_ALERT
+
+    struct Rate
+    {
+        uint16_t per_minute;    // refill rate, 0: no limit
+        uint16_t burst;         // bucket size
+    };
+
+    struct Config
+    {
+        uint32_t coalesce_ms;           // 0 disables coalescing
+        Rate     rates[SEVERITIES];     // indexed by record type
+    };
+
+    enum Verdict : uint8_t
+    {
+        ADMIT,          // stage the record
+        COALESCED,      // folded into an earlier identical record
+        SUPPRESSED,     // rate limit exceeded, dropped
+    };
+
+    explicit JournalLimiter(const Config &config) noexcept;
+
+    JournalLimiter(const JournalLimiter&) = delete;
+    JournalLimiter& operator=(const JournalLimiter&) = delete;
+
+    /**
+     * @brief Decide what happens to a record.
+     *
+     * @param record  Record about to be staged.
+     * @param now_ms  Monotonic time (not the record's wall-clock timestamp).
+     * @param summary Filled with a summary record to stage before `record`
+     *                when has_summary is set.
+     */
+    Verdict Admit(const journal_record_t &record, int64_t now_ms,
+                  journal_record_t &summary, bool &has_summary) noexcept;
+
+    /**
+     * @brief Emit the summary of one run idle for coalesce_ms.
+     *
+     * Call periodically until it returns false.
+     */
+    bool Expire(int64_t now_ms, journal_record_t &summary) noexcept;
+
+    /**
+     * @brief Emit the summary of every pending run regardless of age.
+     *
+     * Call until it returns false.
+     */
+    bool Drain(journal_record_t &summary) noexcept;
+
+    // Cumulative counters
+    [[nodiscard]] uint32_t Suppressed(uint8_t type) const noexcept;
+    [[nodiscard]] uint32_t Coalesced() const noexcept { return m_coalesced; }
+
+    // Suppressed records since the last call
+    uint32_t TakeSuppressed() noexcept;
+
+private:
+    struct Run
+    {
+        bool             active;
+        uint32_t         signature;
+        uint16_t         count;         // occurrences folded after `first`
+        int64_t          seen_ms;       // monotonic time of the last occurrence
+        int64_t          last_ts;       // wall-clock time of the last occurrence
+        journal_record_t first;
+    };
+
+    struct Bucket
+    {
+        uint32_t key;           // 0: free
+        uint32_t tokens;        // 1/60000 of a token
+        int64_t  refill_ms;
+    };
+
+    bool Allow(const journal_record_t &record, int64_t now_ms) noexcept;
+    void Summarize(Run &run, journal_record_t &summary) noexcept;
+
+    Config   m_config;
+    Run      m_runs[SIGNATURE_SLOTS]    = {};
+    Bucket   m_buckets[BUCKET_SLOTS]    = {};
+    uint32_t m_suppressed[SEVERITIES]   = {};
+    uint32_t m_suppressed_pending       = 0;
+    uint32_t m_coalesced                = 0;
+    size_t   m_expire_cursor            = 0;
+
+}; // class JournalLimiter
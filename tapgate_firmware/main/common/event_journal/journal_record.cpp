@@ -0,0 +1,35 @@
+#include "journal_record.h"
+#include "journal_args.h"
+
+#include <cstdio>
+#include <cstring>
+
+static size_t render_message(const journal_record_t &record, char *out, size_t cap)
+{
+    if (record.flags & JOURNAL_RECORD_DEFERRED)
+        return journal_args_format(record.event ? record.event->fmt : nullptr,
+                                   record.data, record.length, out, cap);
+
+    size_t n = record.length < sizeof(record.data) ? record.length : sizeof(record.data) - 1;
+    if (n > cap - 1)
+        n = cap - 1;
+    std::memcpy(out, record.data, n);
+    out[n] = '\0';
+    return n;
+}
+
+size_t journal_record_render(const journal_record_t &record, char *out, size_t cap)
+{
+    if (!out || cap == 0)
+        return 0;
+
+    size_t n = render_message(record, out, cap);
+    if (record.flags & JOURNAL_RECORD_REPEAT) {
+        const int added = std::snprintf(out + n, cap - n, " [repeated %u times in %lu ms]",
+                                        static_cast<unsigned>(record.repeat),
+                                        static_cast<unsigned long>(record.span_ms));
+        if (added > 0)
+            n += static_cast<size_t>(added) < cap - n ? static_cast<size_t>(added) : cap - n - 1;
+    }
+    return n;
+}
@@ -0,0 +1,87 @@
+//
+// Journal record - fixed-size unit staged in RAM by EVENT_JOURNAL_ADD
+//
+// Records are trivially copyable so the producer hot path is a single
+// memcpy into a pre-reserved ring slot and the flush task can hand whole
+// batches to the persistent store without per-field marshalling.
+//
+// A record references its call-site descriptor (event ID, tag, format) and
+// holds its payload in one of two forms:
+//   - deferred (JOURNAL_RECORD_DEFERRED): data[] holds arguments packed by
+//     journal_args_pack(); text is produced by journal_record_render().
+//   - text: data[] holds the formatted, NUL-terminated message.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "journal_event.h"
+
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+
+// Maximum message length stored per event (bytes, includes '\0').
+// Matches the "Message" field limit of MsgRspDeviceLogs in docs/protocol.md.
+constexpr std::size_t JOURNAL_MSG_MAX_SIZE = 128;
+
+// Payload capacity of one record. Deferred records only carry raw argument
+// words, so they need roughly half the room of a formatted message.
+#if defined(CONFIG_EVENT_JOURNAL_DEFERRED_FORMAT)
+constexpr std::size_t JOURNAL_DATA_MAX_SIZE = 64;
+#else
+constexpr std::size_t JOURNAL_DATA_MAX_SIZE = JOURNAL_MSG_MAX_SIZE;
+#endif
+
+// journal_record_t::flags
+constexpr uint8_t JOURNAL_RECORD_DEFERRED = 0x01;  // data[] holds packed arguments
+constexpr uint8_t JOURNAL_RECORD_REPEAT   = 0x02;  // summary of repeated identical events
+
+struct journal_record_t
+{
+    int64_t                     timestamp_ms;   // Wall-clock time (ms since Unix epoch)
+    const journal_event_desc_t* event;          // Call-site descriptor (static storage)
+    uint32_t                    seq;            // Staging order (wraps); not persisted
+    uint8_t                     type;           // enum event_journal_type
+    uint8_t                     flags;          // JOURNAL_RECORD_*
+    uint8_t                     length;         // Bytes used in data[] (text: excluding '\0')
+    uint16_t                    repeat;         // REPEAT: occurrences folded into this summary
+    uint32_t                    span_ms;        // REPEAT: time from the first to the last occurrence
+    uint8_t                     data[JOURNAL_DATA_MAX_SIZE];
+};
+
+static_assert(std::is_trivially_copyable_v<journal_record_t>,
+              "journal_record_t must be trivially copyable — it is moved with memcpy");
+static_assert(JOURNAL_DATA_MAX_SIZE <= UINT8_MAX + 1u,
+              "journal_record_t::length is uint8_t");
+
+/**
+ * @brief Produce the message text of a record (formats deferred records).
+ *
+ * Repeat summaries get a " [repeated N times in S ms]" suffix.
+ *
+ * @param record Record to render.
+ * @param out    Destination buffer, always NUL-terminated when cap > 0.
+ * @param cap    Size of out in bytes.
+ * @return Number of characters written, excluding '\0'.
+ */
+size_t journal_record_render(const journal_record_t &record, char *out, size_t cap);
+
+// Merge order of the staging rings: timestamp, then staging sequence. The
+// timestamp has ms resolution and steps back when SNTP corrects the clock;
+// records with equal timestamps keep the order they were staged in, whatever
+// core staged them.
+struct JournalRecordBefore
+{
+    bool operator()(const journal_record_t &a, const journal_record_t &b) const noexcept
+    {
+        if (a.timestamp_ms != b.timestamp_ms)
+            return a.timestamp_ms < b.timestamp_ms;
+        return static_cast<int32_t>(a.seq - b.seq) < 0;
+    }
+};
+
+// Persisted form of a record: see journal_codec.h
@@ -0,0 +1,136 @@
+//
+// JournalRing - bounded multi-producer / single-consumer lock-free ring
+//
+// Based on the sequence-per-slot bounded queue (D. Vyukov). Every slot carries
+// a sequence number that tells producers and the consumer whose turn it is:
+//
+//   seq == pos         slot is free for the producer that reserves `pos`
+//   seq == pos + 1     slot holds data published for position `pos`
+//   seq == pos + N     slot was consumed and is free for the next lap
+//
+// Producer hot path: one CAS on m_head to reserve a position, one memcpy of
+// the value into the slot, one release-store of the slot sequence. Producers
+// never wait: when the ring is full the value is dropped and m_dropped is
+// incremented so the loss is reported instead of stalling the caller.
+//
+// Consumer: exactly one task (the journal flush task) may call pop().
+//
+// No heap, no locks, no OS dependency — usable from any task and from host tests.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Size used to keep producer and consumer indices on separate cache lines.
+// ESP32 has no data cache for internal DRAM, but the padding is harmless there
+// and avoids false sharing when the same code runs on host.
+constexpr std::size_t JOURNAL_RING_CACHE_LINE = 64;
+
+template <typename T, std::size_t N>
+class JournalRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "JournalRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "JournalRing value must be trivially copyable");
+
+public:
+    JournalRing() noexcept
+    {
+        for (std::size_t i = 0; i < N; ++i)
+            m_slots[i].seq.store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+
+    JournalRing(const JournalRing&)            = delete;
+    JournalRing& operator=(const JournalRing&) = delete;
+
+    static constexpr std::size_t capacity() noexcept { return N; }
+
+    // Copies value into the ring. Returns false (and counts a drop) when full.
+    bool push(const T& value) noexcept
+    {
+        uint32_t pos = m_head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_slots[pos & MASK];
+            const uint32_t seq  = slot->seq.load(std::memory_order_acquire);
+            const int32_t  diff = static_cast<int32_t>(seq - pos);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::memcpy(&slot->value, &value, sizeof(T));
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to max_count published values into out. Single consumer only.
+    // Stops at the first slot that is reserved but not yet published, so
+    // values are always returned in reservation order.
+    std::size_t pop(T* out, std::size_t max_count) noexcept
+    {
+        std::size_t count = 0;
+        uint32_t pos = m_tail.load(std::memory_order_relaxed);
+        while (count < max_count) {
+            Slot& slot = m_slots[pos & MASK];
+            const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+            if (static_cast<int32_t>(seq - (pos + 1)) < 0)
+                break; // empty, or producer still copying
+
+            std::memcpy(&out[count], &slot.value, sizeof(T));
+            slot.seq.store(pos + static_cast<uint32_t>(N), std::memory_order_release);
+            ++pos;
+            ++count;
+        }
+        m_tail.store(pos, std::memory_order_relaxed);
+        return count;
+    }
+
+    // Approximate number of reserved slots (published or in flight).
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t used = head - tail;
+        return used > N ? N : used;
+    }
+
+    // Number of values dropped because the ring was full.
+    [[nodiscard]] uint32_t dropped() const noexcept
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    // Returns the drop counter and resets it to zero (used by the flush task
+    // to report losses once per batch).
+    uint32_t take_dropped() noexcept
+    {
+        return m_dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t MASK = static_cast<uint32_t>(N - 1);
+
+    struct Slot
+    {
+        std::atomic<uint32_t> seq;
+        T                     value;
+    };
+
+    Slot m_slots[N];
+
+    alignas(JOURNAL_RING_CACHE_LINE) std::atomic<uint32_t> m_head{0};
+    alignas(JOURNAL_RING_CACHE_LINE) std::atomic<uint32_t> m_tail{0};
+    alignas(JOURNAL_RING_CACHE_LINE) std::atomic<uint32_t> m_dropped{0};
+
+}; // class JournalRing
@@ -0,0 +1,134 @@
+//
+// JournalStaging - per-CPU staging rings merged in order by the consumer
+//
+// With a single JournalRing every producer on both cores reserves slots with
+// a CAS on the same head index; under load the cores keep stealing that
+// word (and its cache line on the host) from each other. JournalStaging
+// gives every CPU its own ring, aligned to its own cache line, so producers
+// running on different cores never touch the same memory:
+//
+//   producer   push(value, current_lane()) into the ring of its core
+//   consumer   pop() does a k-way merge over the heads of all rings, by
+//              Before (the journal: timestamp, then staging sequence), ties
+//              going to the lower lane
+//
+// Within a lane values keep their reservation order, which is the sequence
+// the merge falls back to. A task preempted between current_lane() and
+// push() may land in the other core's ring: the rings are multi-producer,
+// so this only costs a shared slot, never correctness.
+//
+// current_lane() is xPortGetCoreID() on the target; on the host each thread
+// gets its own lane (round-robin) in thread-local storage.
+//
+// Consumer: exactly one task (the journal flush task) may call pop().
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "journal_ring.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#endif
+
+template <typename T, std::size_t N, std::size_t LANES, typename Before, std::size_t LOOKAHEAD = 4>
+class JournalStaging
+{
+    static_assert(LANES >= 1, "JournalStaging needs at least one lane");
+    static_assert(LOOKAHEAD >= 1, "JournalStaging lookahead must hold a value");
+
+public:
+    JournalStaging() noexcept = default;
+
+    JournalStaging(const JournalStaging&)            = delete;
+    JournalStaging& operator=(const JournalStaging&) = delete;
+
+    static constexpr std::size_t lanes() noexcept { return LANES; }
+    static constexpr std::size_t lane_capacity() noexcept { return N; }
+
+    // Lane of the calling context.
+    static std::size_t current_lane() noexcept
+    {
+#ifdef ESP_PLATFORM
+        return static_cast<std::size_t>(xPortGetCoreID()) % LANES;
+#else
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t lane = next.fetch_add(1, std::memory_order_relaxed) % LANES;
+        return lane;
+#endif
+    }
+
+    // Copies value into the lane's ring. Returns false (and counts a drop in
+    // that lane) when it is full.
+    bool push(const T& value, std::size_t lane) noexcept
+    {
+        return m_lanes[lane % LANES].ring.push(value);
+    }
+
+    // Approximate number of values staged in one lane.
+    [[nodiscard]] std::size_t size(std::size_t lane) const noexcept
+    {
+        return m_lanes[lane % LANES].ring.size();
+    }
+
+    // Moves up to max_count values into out, merged across lanes. Single
+    // consumer only. Values already taken from a ring but not yet returned
+    // wait in a small per-lane lookahead for the next call.
+    std::size_t pop(T* out, std::size_t max_count) noexcept
+    {
+        std::size_t count = 0;
+        while (count < max_count) {
+            Lane* best = nullptr;
+            for (Lane& lane : m_lanes) {
+                if (lane.pos == lane.count) {
+                    lane.count = lane.ring.pop(lane.ahead, LOOKAHEAD);
+                    lane.pos   = 0;
+                }
+                if (lane.pos < lane.count
+                    && (!best || m_before(lane.ahead[lane.pos], best->ahead[best->pos])))
+                    best = &lane;
+            }
+            if (!best)
+                break;
+            out[count++] = best->ahead[best->pos++];
+        }
+        return count;
+    }
+
+    // Number of values dropped because a lane was full.
+    [[nodiscard]] uint32_t dropped() const noexcept
+    {
+        uint32_t total = 0;
+        for (const Lane& lane : m_lanes)
+            total += lane.ring.dropped();
+        return total;
+    }
+
+    // Returns the drop counters and resets them to zero.
+    uint32_t take_dropped() noexcept
+    {
+        uint32_t total = 0;
+        for (Lane& lane : m_lanes)
+            total += lane.ring.take_dropped();
+        return total;
+    }
+
+private:
+    struct alignas(JOURNAL_RING_CACHE_LINE) Lane
+    {
+        JournalRing<T, N> ring;
+
+        // Consumer-side lookahead, ahead[pos .. count)
+        T           ahead[LOOKAHEAD];
+        std::size_t pos   = 0;
+        std::size_t count = 0;
+    };
+
+    Lane   m_lanes[LANES];
+    Before m_before{};
+
+}; // class JournalStaging
@@ -0,0 +1,188 @@
+#include "journal_storage.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char SEGMENT_EXT[] = ".ejs";
+
+// "<8 hex digits>.ejs" -> index
+static bool parse_segment_name(const char *name, uint32_t &index)
+{
+    if (std::strlen(name) != 8 + sizeof(SEGMENT_EXT) - 1 || std::strcmp(name + 8, SEGMENT_EXT) != 0)
+        return false;
+    char *end = nullptr;
+    const unsigned long v = std::strtoul(name, &end, 16);
+    if (end != name + 8)
+        return false;
+    index = static_cast<uint32_t>(v);
+    return true;
+}
+
+JournalFileStorage::JournalFileStorage(const char *dir) noexcept
+{
+    std::snprintf(m_dir, sizeof(m_dir), "%s", dir ? dir : "");
+}
+
+JournalFileStorage::~JournalFileStorage()
+{
+    if (m_append)
+        std::fclose(m_append);
+    if (m_read)
+        std::fclose(m_read);
+}
+
+void JournalFileStorage::Path(uint32_t segment, char *out, size_t cap) const
+{
+    std::snprintf(out, cap, "%s/%08" PRIx32 "%s", m_dir, segment, SEGMENT_EXT);
+}
+
+FILE *JournalFileStorage::OpenAppend(uint32_t segment)
+{
+    if (m_append && m_append_segment == segment)
+        return m_append;
+
+    if (m_append)
+        std::fclose(m_append);
+    if (m_read && m_read_segment == segment) {
+        std::fclose(m_read);
+        m_read = nullptr;
+    }
+
+    char path[DIR_MAX + 16];
+    Path(segment, path, sizeof(path));
+    m_append         = std::fopen(path, "a+b");
+    m_append_segment = segment;
+    return m_append;
+}
+
+FILE *JournalFileStorage::OpenRead(uint32_t segment)
+{
+    if (m_append && m_append_segment == segment)
+        return m_append;
+    if (m_read && m_read_segment == segment)
+        return m_read;
+
+    if (m_read)
+        std::fclose(m_read);
+
+    char path[DIR_MAX + 16];
+    Path(segment, path, sizeof(path));
+    m_read         = std::fopen(path, "rb");
+    m_read_segment = segment;
+    return m_read;
+}
+
+void JournalFileStorage::Close(uint32_t segment)
+{
+    if (m_append && m_append_segment == segment) {
+        std::fclose(m_append);
+        m_append = nullptr;
+    }
+    if (m_read && m_read_segment == segment) {
+        std::fclose(m_read);
+        m_read = nullptr;
+    }
+}
+
+esp_err_t JournalFileStorage::Prepare()
+{
+    struct stat st{};
+    if (stat(m_dir, &st) == 0)
+        return S_ISDIR(st.st_mode) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    return mkdir(m_dir, 0775) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t JournalFileStorage::List(uint32_t &first, uint32_t &last, size_t &count)
+{
+    DIR *dir = opendir(m_dir);
+    if (!dir)
+        return ESP_ERR_NOT_FOUND;
+
+    count = 0;
+    while (const struct dirent *entry = readdir(dir)) {
+        uint32_t index = 0;
+        if (!parse_segment_name(entry->d_name, index))
+            continue;
+        if (count == 0 || index < first)
+            first = index;
+        if (count == 0 || index > last)
+            last = index;
+        ++count;
+    }
+    closedir(dir);
+    return ESP_OK;
+}
+
+esp_err_t JournalFileStorage::Size(uint32_t segment, size_t &size)
+{
+    if (m_append && m_append_segment == segment) {
+        if (std::fseek(m_append, 0, SEEK_END) != 0)
+            return ESP_FAIL;
+        const long pos = std::ftell(m_append);
+        if (pos < 0)
+            return ESP_FAIL;
+        size = static_cast<size_t>(pos);
+        return ESP_OK;
+    }
+
+    char path[DIR_MAX + 16];
+    Path(segment, path, sizeof(path));
+    struct stat st{};
+    if (stat(path, &st) != 0)
+        return ESP_ERR_NOT_FOUND;
+    size = static_cast<size_t>(st.st_size);
+    return ESP_OK;
+}
+
+esp_err_t JournalFileStorage::Read(uint32_t segment, size_t offset, void *buf, size_t len)
+{
+    FILE *f = OpenRead(segment);
+    if (!f)
+        return ESP_ERR_NOT_FOUND;
+    if (std::fseek(f, static_cast<long>(offset), SEEK_SET) != 0)
+        return ESP_FAIL;
+    return std::fread(buf, 1, len, f) == len ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t JournalFileStorage::Append(uint32_t segment, const void *buf, size_t len)
+{
+    FILE *f = OpenAppend(segment);
+    if (!f)
+        return ESP_FAIL;
+    // Repositioning is required between a read and a write on the same stream
+    if (std::fseek(f, 0, SEEK_END) != 0)
+        return ESP_FAIL;
+    return std::fwrite(buf, 1, len, f) == len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t JournalFileStorage::Sync(uint32_t segment)
+{
+    if (!m_append || m_append_segment != segment)
+        return ESP_OK;
+    if (std::fflush(m_append) != 0 || fsync(fileno(m_append)) != 0)
+        return ESP_FAIL;
+    return ESP_OK;
+}
+
+esp_err_t JournalFileStorage::Truncate(uint32_t segment, size_t size)
+{
+    Close(segment);
+    char path[DIR_MAX + 16];
+    Path(segment, path, sizeof(path));
+    return truncate(path, static_cast<off_t>(size)) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t JournalFileStorage::Remove(uint32_t segment)
+{
+    Close(segment);
+    char path[DIR_MAX + 16];
+    Path(segment, path, sizeof(path));
+    if (std::remove(path) == 0)
+        return ESP_OK;
+    return errno == ENOENT ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+}
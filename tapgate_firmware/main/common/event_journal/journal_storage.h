@@ -0,0 +1,86 @@
+//
+// JournalStorage - segment file backend of the persistent event journal
+//
+// The journal is kept as numbered segment files in one directory. Segment
+// indices only grow; the oldest segment is removed on rotation, so existing
+// indices normally form a contiguous range [first, last].
+//
+// JournalStorage is the narrow I/O surface JournalStore needs. The production
+// backend, JournalFileStorage, uses stdio on the littlefs VFS mount; the same
+// class runs unchanged on the host against a temporary directory, where tests
+// wrap it to inject torn writes and power cuts.
+//
+
+#pragma once
+
+#include "esp_err.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+class JournalStorage
+{
+public:
+    virtual ~JournalStorage() = default;
+
+    // Enumerates segments. count == 0 means the journal is empty (first and
+    // last are then left unchanged).
+    virtual esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) = 0;
+
+    // Current size in bytes. ESP_ERR_NOT_FOUND if the segment does not exist.
+    virtual esp_err_t Size(uint32_t segment, size_t &size) = 0;
+
+    // Reads exactly len bytes at offset. ESP_ERR_INVALID_SIZE on a short read.
+    virtual esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) = 0;
+
+    // Appends len bytes, creating the segment if needed.
+    virtual esp_err_t Append(uint32_t segment, const void *buf, size_t len) = 0;
+
+    // Makes every byte appended so far durable.
+    virtual esp_err_t Sync(uint32_t segment) = 0;
+
+    // Cuts the segment to size bytes (used to discard a torn tail).
+    virtual esp_err_t Truncate(uint32_t segment, size_t size) = 0;
+
+    virtual esp_err_t Remove(uint32_t segment) = 0;
+};
+
+// Segment files "<dir>/<index as 8 hex digits>.ejs" accessed through stdio.
+// Keeps the segment being appended and the segment being read open between
+// calls; not thread-safe.
+class JournalFileStorage : public JournalStorage
+{
+public:
+    static constexpr size_t DIR_MAX = 48;
+
+    explicit JournalFileStorage(const char *dir) noexcept;
+    ~JournalFileStorage() override;
+
+    JournalFileStorage(const JournalFileStorage&) = delete;
+    JournalFileStorage& operator=(const JournalFileStorage&) = delete;
+
+    // Creates the directory if it does not exist.
+    esp_err_t Prepare();
+
+    esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) override;
+    esp_err_t Size(uint32_t segment, size_t &size) override;
+    esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) override;
+    esp_err_t Append(uint32_t segment, const void *buf, size_t len) override;
+    esp_err_t Sync(uint32_t segment) override;
+    esp_err_t Truncate(uint32_t segment, size_t size) override;
+    esp_err_t Remove(uint32_t segment) override;
+
+private:
+    void Path(uint32_t segment, char *out, size_t cap) const;
+    FILE *OpenAppend(uint32_t segment);
+    FILE *OpenRead(uint32_t segment);
+    void Close(uint32_t segment);
+
+    char     m_dir[DIR_MAX];
+    FILE    *m_append         = nullptr;    // "a+b": appends, also serves reads
+    uint32_t m_append_segment = 0;
+    FILE    *m_read           = nullptr;    // "rb": other (sealed) segments
+    uint32_t m_read_segment   = 0;
+
+}; // class JournalFileStorage
@@ -0,0 +1,1006 @@
+#include "journal_store.h"
+
+#include "crc32.h"
+
+#include <climits>
+#include <cstring>
+
+static constexpr uint32_t SEGMENT_MAGIC   = 0x47534A45;    // "EJSG"
+static constexpr uint32_t COMMIT_MAGIC    = 0x43534A45;    // "EJSC"
+static constexpr uint16_t FRAME_MAGIC     = 0xE51A;        // record frame
+static constexpr uint16_t INDEX_MAGIC     = 0xE51B;        // index frame of a sealed segment
+static constexpr uint16_t SEGMENT_VERSION = 2;
+
+// Chunk used to checksum frames during recovery without a payload-sized buffer
+static constexpr size_t RECOVERY_CHUNK = 64;
+
+// Records whose key cannot be extracted match every filter
+static constexpr JournalKey UNKNOWN_KEY = { INT64_MAX, 0xFF };
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+         | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return static_cast<uint64_t>(get_u32(p)) | (static_cast<uint64_t>(get_u32(p + 4)) << 32);
+}
+
+static bool frame_magic(uint16_t magic)
+{
+    return magic == FRAME_MAGIC || magic == INDEX_MAGIC;
+}
+
+// Frame checksum covers the length field and the payload
+static uint32_t frame_crc_begin(uint16_t len)
+{
+    uint8_t raw[2];
+    put_u16(raw, len);
+    return crc32_update(crc32_init(0xFFFFFFFF), raw, sizeof(raw));
+}
+
+static bool header_valid(const uint8_t *h, uint32_t segment)
+{
+    return get_u32(h) == SEGMENT_MAGIC
+        && get_u16(h + 6) == JournalStore::HEADER_SIZE
+        && get_u32(h + 8) == segment
+        && get_u32(h + 20) == crc32_calculate(h, 20);
+}
+
+struct Commit
+{
+    uint32_t data_end;
+    uint32_t records;
+    uint32_t index_offset;
+};
+
+static bool commit_valid(const uint8_t *c, size_t file_size, Commit &commit)
+{
+    if (get_u32(c) != COMMIT_MAGIC || get_u32(c + 16) != crc32_calculate(c, 16))
+        return false;
+    commit.data_end     = get_u32(c + 4);
+    commit.records      = get_u32(c + 8);
+    commit.index_offset = get_u32(c + 12);
+    return commit.data_end + JournalStore::COMMIT_SIZE == file_size;
+}
+
+// Key of the next record of a run of consecutive records. prev/prev_valid
+// carry the key of the preceding record; an unknown key breaks the run.
+static JournalKey chain_key(JournalKeyFn key_fn, const uint8_t *payload, size_t len,
+                            JournalKey &prev, bool &prev_valid)
+{
+    JournalKey key = UNKNOWN_KEY;
+    const size_t n = len < JournalStore::KEY_PREFIX_MAX ? len : JournalStore::KEY_PREFIX_MAX;
+    prev_valid = key_fn && key_fn(payload, n, prev_valid ? &prev : nullptr, key);
+    if (!prev_valid)
+        return UNKNOWN_KEY;
+    prev = key;
+    return key;
+}
+
+static uint8_t severity_bit(const JournalKey &key)
+{
+    return key.severity == UNKNOWN_KEY.severity ? 0xFF : static_cast<uint8_t>(1u << (key.severity & 7));
+}
+
+// Index frame entry: u32 offset, i64 first_ts, i64 max_ts, u8 severities
+static void encode_entry(uint8_t *p, const JournalStore::IndexBlock &b)
+{
+    put_u32(p, b.offset);
+    put_u64(p + 4, static_cast<uint64_t>(b.first_ts));
+    put_u64(p + 12, static_cast<uint64_t>(b.max_ts));
+    p[20] = b.severities;
+}
+
+JournalStore::JournalStore(JournalStorage &storage, const Config &config) noexcept
+    : m_storage(storage), m_config(config)
+{
+}
+
+void JournalStore::AttachIndex(JournalKeyFn key_fn, std::span<SegmentSummary> summaries,
+                               std::span<IndexBlock> blocks) noexcept
+{
+    m_key_fn    = key_fn;
+    m_summaries = summaries;
+    m_blocks    = blocks;
+}
+
+bool JournalStore::Indexed() const noexcept
+{
+    return m_config.index_interval != 0 && !m_summaries.empty() && !m_blocks.empty();
+}
+
+esp_err_t JournalStore::Fail(esp_err_t err) noexcept
+{
+    // In-memory tail no longer matches storage; force a recovery
+    m_mounted = false;
+    return err;
+}
+
+esp_err_t JournalStore::Mount()
+{
+    m_mounted      = false;
+    m_recovery     = {};
+    m_open         = false;
+    m_open_size    = 0;
+    m_count        = 0;
+    m_loaded       = false;
+    m_open_records = 0;
+    m_open_blocks  = 0;
+
+    m_append_key_valid = false;
+    if (m_config.max_segments == 0 || m_config.segment_size < HEADER_SIZE + FRAME_OVERHEAD + COMMIT_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = m_storage.List(m_first, m_last, m_count);
+    if (err != ESP_OK)
+        return err;
+    m_recovery.segments = m_count;
+
+    if (m_count != 0) {
+        err = RecoverTail();
+        if (err != ESP_OK)
+            return err;
+    }
+
+    err = EnforceQuota();
+    if (err != ESP_OK)
+        return err;
+
+    m_mounted = true;
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::RecoverTail()
+{
+    for (;;) {
+        size_t size = 0;
+        esp_err_t err = m_storage.Size(m_last, size);
+        if (err != ESP_OK)
+            return err;
+
+        uint8_t header[HEADER_SIZE];
+        const bool header_ok = size >= HEADER_SIZE
+            && m_storage.Read(m_last, 0, header, sizeof(header)) == ESP_OK
+            && header_valid(header, m_last);
+
+        if (!header_ok) {
+            // Power cut while the segment was being created: nothing in it
+            // was ever acknowledged, drop it and look at the previous one.
+            err = m_storage.Remove(m_last);
+            if (err != ESP_OK && err != ESP_ERR_NOT_FOUND)
+                return err;
+            m_recovery.dropped_tail = true;
+            err = m_storage.List(m_first, m_last, m_count);
+            if (err != ESP_OK || m_count == 0)
+                return err;
+            continue;
+        }
+
+        if (size >= HEADER_SIZE + COMMIT_SIZE) {
+            uint8_t raw[COMMIT_SIZE];
+            Commit commit{};
+            err = m_storage.Read(m_last, size - COMMIT_SIZE, raw, sizeof(raw));
+            if (err != ESP_OK)
+                return err;
+            if (commit_valid(raw, size, commit))
+                return ESP_OK; // sealed: next append starts a new segment
+        }
+
+        m_open = true;
+        if (size == HEADER_SIZE) {
+            m_open_size = size;
+            return ESP_OK;
+        }
+
+        // Fast path: the trailing length locates the last frame
+        if (size >= HEADER_SIZE + FRAME_OVERHEAD) {
+            uint8_t tail[FRAME_TAIL];
+            err = m_storage.Read(m_last, size - FRAME_TAIL, tail, sizeof(tail));
+            if (err != ESP_OK)
+                return err;
+            const size_t len = get_u16(tail);
+            if (frame_magic(get_u16(tail + 2)) && size >= HEADER_SIZE + FRAME_OVERHEAD + len) {
+                size_t frame_size = 0;
+                err = CheckFrame(m_last, size - FRAME_OVERHEAD - len, size, frame_size);
+                if (err == ESP_OK) {
+                    m_open_size = size;
+                    return ESP_OK;
+                }
+                if (err != ESP_ERR_INVALID_CRC)
+                    return err;
+            }
+        }
+
+        // Torn tail: find the last intact frame and cut everything after it
+        size_t valid_end = HEADER_SIZE;
+        m_recovery.scanned = true;
+        err = ScanFrames(m_last, size, valid_end);
+        if (err != ESP_OK)
+            return err;
+        err = m_storage.Truncate(m_last, valid_end);
+        if (err != ESP_OK)
+            return err;
+        m_recovery.truncated = size - valid_end;
+        m_open_size = valid_end;
+        return ESP_OK;
+    }
+}
+
+esp_err_t JournalStore::CheckFrame(uint32_t segment, size_t offset, size_t end, size_t &frame_size)
+{
+    uint8_t head[FRAME_HEAD];
+    esp_err_t err = m_storage.Read(segment, offset, head, sizeof(head));
+    if (err != ESP_OK)
+        return err;
+
+    const uint16_t len   = get_u16(head);
+    const uint16_t magic = get_u16(head + 2);
+    if (!frame_magic(magic) || offset + FRAME_OVERHEAD + len > end)
+        return ESP_ERR_INVALID_CRC;
+
+    uint32_t crc = frame_crc_begin(len);
+    uint8_t chunk[RECOVERY_CHUNK];
+    for (size_t done = 0; done < len;) {
+        const size_t n = (len - done) < sizeof(chunk) ? (len - done) : sizeof(chunk);
+        err = m_storage.Read(segment, offset + FRAME_HEAD + done, chunk, n);
+        if (err != ESP_OK)
+            return err;
+        crc = crc32_update(crc, chunk, n);
+        done += n;
+    }
+
+    uint8_t tail[FRAME_TAIL];
+    err = m_storage.Read(segment, offset + FRAME_HEAD + len, tail, sizeof(tail));
+    if (err != ESP_OK)
+        return err;
+
+    if (crc32_finalize(crc) != get_u32(head + 4) || get_u16(tail) != len || get_u16(tail + 2) != magic)
+        return ESP_ERR_INVALID_CRC;
+
+    frame_size = FRAME_OVERHEAD + len;
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::ScanFrames(uint32_t segment, size_t end, size_t &valid_end)
+{
+    size_t offset = HEADER_SIZE;
+    while (offset + FRAME_OVERHEAD <= end) {
+        size_t frame_size = 0;
+        const esp_err_t err = CheckFrame(segment, offset, end, frame_size);
+        if (err == ESP_ERR_INVALID_CRC)
+            break;
+        if (err != ESP_OK)
+            return err;
+        offset += frame_size;
+    }
+    valid_end = offset;
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::EnforceQuota()
+{
+    while (m_count > m_config.max_segments && m_first < m_last) {
+        const esp_err_t err = m_storage.Remove(m_first);
+        if (err != ESP_OK && err != ESP_ERR_NOT_FOUND)
+            return err;
+        if (err == ESP_OK)
+            --m_count;
+        ++m_first;
+        // Summaries are indexed from m_first
+        if (m_summaries.size() > 1)
+            std::memmove(m_summaries.data(), m_summaries.data() + 1, (m_summaries.size() - 1) * sizeof(SegmentSummary));
+    }
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Lazy state: sequence numbers and index
+// ---------------------------------------------------------------------------
+
+JournalStore::SegmentSummary *JournalStore::Summary(uint32_t segment) noexcept
+{
+    if (!Indexed() || !m_loaded || segment < m_first || segment - m_first >= m_summaries.size())
+        return nullptr;
+    return &m_summaries[segment - m_first];
+}
+
+JournalKey JournalStore::ExtractKey(uint32_t segment, uint32_t offset, size_t len)
+{
+    uint8_t prefix[KEY_PREFIX_MAX];
+    const size_t n = len < sizeof(prefix) ? len : sizeof(prefix);
+    if (!m_key_fn || m_storage.Read(segment, offset + FRAME_HEAD, prefix, n) != ESP_OK) {
+        m_append_key_valid = false;
+        return UNKNOWN_KEY;
+    }
+    return chain_key(m_key_fn, prefix, n, m_append_key, m_append_key_valid);
+}
+
+void JournalStore::IndexRecord(uint32_t offset, const JournalKey &key)
+{
+    SegmentSummary *summary = Summary(m_last);
+    if (!summary)
+        return;
+
+    const uint8_t bit = severity_bit(key);
+    const uint64_t seq = summary->first_seq + m_open_records;
+
+    if (m_open_records % m_config.index_interval == 0 && m_open_blocks < m_blocks.size()) {
+        m_blocks[m_open_blocks++] = { offset, seq, key.timestamp_ms, key.timestamp_ms, bit };
+    } else if (m_open_blocks != 0) {
+        IndexBlock &block = m_blocks[m_open_blocks - 1];
+        if (key.timestamp_ms > block.max_ts)
+            block.max_ts = key.timestamp_ms;
+        block.severities |= bit;
+    }
+
+    if (summary->records == 0)
+        summary->first_ts = key.timestamp_ms;
+    if (summary->records == 0 || key.timestamp_ms > summary->max_ts)
+        summary->max_ts = key.timestamp_ms;
+    summary->severities |= bit;
+    ++summary->records;
+}
+
+esp_err_t JournalStore::LoadOpenSegment(uint64_t first_seq)
+{
+    m_open_records     = 0;
+    m_open_blocks      = 0;
+    m_append_key_valid = false;
+    if (SegmentSummary *summary = Summary(m_last))
+        *summary = { first_seq, 0, 0, 0, 0, 0 };
+
+    // Mount() validated the tail, frames only need to be walked
+    size_t offset = HEADER_SIZE;
+    while (offset + FRAME_OVERHEAD <= m_open_size) {
+        uint8_t head[FRAME_HEAD];
+        const esp_err_t err = m_storage.Read(m_last, offset, head, sizeof(head));
+        if (err != ESP_OK)
+            return err;
+        const uint16_t len = get_u16(head);
+
+        if (get_u16(head + 2) == FRAME_MAGIC) {
+            const JournalKey key = Indexed() ? ExtractKey(m_last, static_cast<uint32_t>(offset), len) : UNKNOWN_KEY;
+            IndexRecord(static_cast<uint32_t>(offset), key);
+            ++m_open_records;
+        }
+        offset += FRAME_OVERHEAD + len;
+    }
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::LoadSummary(uint32_t segment, SegmentSummary &summary)
+{
+    // Missing segment: matches nothing. Unreadable index: matches everything.
+    summary = { 0, 0, 0, 0, INT64_MIN, 0 };
+
+    uint8_t header[HEADER_SIZE];
+    esp_err_t err = m_storage.Read(segment, 0, header, sizeof(header));
+    if (err == ESP_ERR_NOT_FOUND)
+        return ESP_OK;
+    if (err != ESP_OK)
+        return err;
+    if (!header_valid(header, segment))
+        return ESP_OK;
+    summary.first_seq = get_u64(header + 12);
+
+    size_t size = 0;
+    err = m_storage.Size(segment, size);
+    if (err != ESP_OK)
+        return err;
+
+    summary.first_ts   = INT64_MIN;
+    summary.max_ts     = INT64_MAX;
+    summary.severities = 0xFF;
+
+    uint8_t raw[COMMIT_SIZE];
+    Commit commit{};
+    if (size < HEADER_SIZE + COMMIT_SIZE)
+        return ESP_OK;
+    err = m_storage.Read(segment, size - COMMIT_SIZE, raw, sizeof(raw));
+    if (err != ESP_OK)
+        return err;
+    if (!commit_valid(raw, size, commit))
+        return ESP_OK;
+    summary.records = commit.records;
+
+    uint8_t index[FRAME_HEAD + INDEX_HEAD];
+    if (commit.index_offset < HEADER_SIZE || commit.index_offset + sizeof(index) > commit.data_end)
+        return ESP_OK;
+    err = m_storage.Read(segment, commit.index_offset, index, sizeof(index));
+    if (err != ESP_OK)
+        return err;
+    if (get_u16(index + 2) != INDEX_MAGIC)
+        return ESP_OK;
+
+    const uint8_t *p = index + FRAME_HEAD;
+    summary.index_offset = commit.index_offset;
+    summary.first_ts     = static_cast<int64_t>(get_u64(p + 8));
+    summary.max_ts       = static_cast<int64_t>(get_u64(p + 16));
+    summary.severities   = p[32];
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::EnsureLoaded()
+{
+    if (m_loaded)
+        return ESP_OK;
+
+    m_next_seq     = 0;
+    m_open_records = 0;
+    m_open_blocks  = 0;
+    if (m_count == 0) {
+        m_loaded = true;
+        return ESP_OK;
+    }
+
+    // Summaries first: LoadOpenSegment() fills the one of the open segment
+    m_loaded = true;
+    if (Indexed()) {
+        for (uint32_t segment = m_first; segment <= m_last && segment - m_first < m_summaries.size(); ++segment) {
+            const esp_err_t err = LoadSummary(segment, m_summaries[segment - m_first]);
+            if (err != ESP_OK) {
+                m_loaded = false;
+                return err;
+            }
+        }
+    }
+
+    uint8_t header[HEADER_SIZE];
+    esp_err_t err = m_storage.Read(m_last, 0, header, sizeof(header));
+    if (err == ESP_OK) {
+        const uint64_t first_seq = get_u64(header + 12);
+        if (m_open) {
+            err = LoadOpenSegment(first_seq);
+            m_next_seq = first_seq + m_open_records;
+        } else {
+            SegmentSummary summary{};
+            err = LoadSummary(m_last, summary);
+            m_next_seq = first_seq + summary.records;
+        }
+    }
+    if (err != ESP_OK)
+        m_loaded = false;
+    return err;
+}
+
+esp_err_t JournalStore::NextSeq(uint64_t &seq)
+{
+    if (!m_mounted)
+        return ESP_ERR_INVALID_STATE;
+    const esp_err_t err = EnsureLoaded();
+    if (err == ESP_OK)
+        seq = m_next_seq;
+    return err;
+}
+
+// ---------------------------------------------------------------------------
+// Writing
+// ---------------------------------------------------------------------------
+
+esp_err_t JournalStore::WriteFrame(uint16_t magic, const uint8_t *payload, size_t len)
+{
+    const uint16_t len16 = static_cast<uint16_t>(len);
+    uint8_t head[FRAME_HEAD];
+    uint8_t tail[FRAME_TAIL];
+    put_u16(head, len16);
+    put_u16(head + 2, magic);
+    put_u32(head + 4, crc32_finalize(crc32_update(frame_crc_begin(len16), payload, len)));
+    put_u16(tail, len16);
+    put_u16(tail + 2, magic);
+
+    esp_err_t err = m_storage.Append(m_last, head, sizeof(head));
+    if (err == ESP_OK && len != 0)
+        err = m_storage.Append(m_last, payload, len);
+    if (err == ESP_OK)
+        err = m_storage.Append(m_last, tail, sizeof(tail));
+    return err;
+}
+
+esp_err_t JournalStore::WriteIndexFrame(uint32_t &offset)
+{
+    const SegmentSummary *summary = Summary(m_last);
+    if (!summary) {
+        offset = 0;
+        return ESP_OK;
+    }
+
+    uint8_t head[INDEX_HEAD];
+    put_u64(head, summary->first_seq);
+    put_u64(head + 8, static_cast<uint64_t>(summary->first_ts));
+    put_u64(head + 16, static_cast<uint64_t>(summary->max_ts));
+    put_u32(head + 24, summary->records);
+    put_u16(head + 28, static_cast<uint16_t>(m_open_blocks));
+    put_u16(head + 30, m_config.index_interval);
+    head[32] = summary->severities;
+
+    // Entries are streamed twice (checksum, then write) to avoid a buffer
+    // the size of the whole index on the flush task stack.
+    const size_t len = INDEX_HEAD + m_open_blocks * INDEX_ENTRY;
+    uint8_t entry[INDEX_ENTRY];
+    uint32_t crc = crc32_update(frame_crc_begin(static_cast<uint16_t>(len)), head, sizeof(head));
+    for (size_t k = 0; k < m_open_blocks; ++k) {
+        encode_entry(entry, m_blocks[k]);
+        crc = crc32_update(crc, entry, sizeof(entry));
+    }
+
+    uint8_t frame_head[FRAME_HEAD];
+    uint8_t frame_tail[FRAME_TAIL];
+    put_u16(frame_head, static_cast<uint16_t>(len));
+    put_u16(frame_head + 2, INDEX_MAGIC);
+    put_u32(frame_head + 4, crc32_finalize(crc));
+    put_u16(frame_tail, static_cast<uint16_t>(len));
+    put_u16(frame_tail + 2, INDEX_MAGIC);
+
+    esp_err_t err = m_storage.Append(m_last, frame_head, sizeof(frame_head));
+    if (err == ESP_OK)
+        err = m_storage.Append(m_last, head, sizeof(head));
+    for (size_t k = 0; err == ESP_OK && k < m_open_blocks; ++k) {
+        encode_entry(entry, m_blocks[k]);
+        err = m_storage.Append(m_last, entry, sizeof(entry));
+    }
+    if (err == ESP_OK)
+        err = m_storage.Append(m_last, frame_tail, sizeof(frame_tail));
+    if (err != ESP_OK)
+        return err;
+
+    offset = static_cast<uint32_t>(m_open_size);
+    m_open_size += FRAME_OVERHEAD + len;
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::StartSegment()
+{
+    const uint32_t index = m_count == 0 ? 0 : m_last + 1;
+
+    uint8_t header[HEADER_SIZE];
+    put_u32(header, SEGMENT_MAGIC);
+    put_u16(header + 4, SEGMENT_VERSION);
+    put_u16(header + 6, HEADER_SIZE);
+    put_u32(header + 8, index);
+    put_u64(header + 12, m_next_seq);
+    put_u32(header + 20, crc32_calculate(header, 20));
+
+    const esp_err_t err = m_storage.Append(index, header, sizeof(header));
+    if (err != ESP_OK)
+        return err;
+
+    if (m_count == 0)
+        m_first = index;
+    m_last             = index;
+    m_open             = true;
+    m_open_size        = HEADER_SIZE;
+    m_open_records     = 0;
+    m_open_blocks      = 0;
+    m_append_key_valid = false;
+    ++m_count;
+
+    // Quota first so the new summary slot exists
+    const esp_err_t quota_err = EnforceQuota();
+    if (SegmentSummary *summary = Summary(m_last))
+        *summary = { m_next_seq, 0, 0, 0, 0, 0 };
+    return quota_err;
+}
+
+esp_err_t JournalStore::Seal()
+{
+    uint32_t index_offset = 0;
+    esp_err_t err = WriteIndexFrame(index_offset);
+    if (err != ESP_OK)
+        return err;
+
+    uint8_t commit[COMMIT_SIZE];
+    put_u32(commit, COMMIT_MAGIC);
+    put_u32(commit + 4, static_cast<uint32_t>(m_open_size));
+    put_u32(commit + 8, m_open_records);
+    put_u32(commit + 12, index_offset);
+    put_u32(commit + 16, crc32_calculate(commit, 16));
+
+    err = m_storage.Append(m_last, commit, sizeof(commit));
+    if (err == ESP_OK)
+        err = m_storage.Sync(m_last);
+    if (err != ESP_OK)
+        return err;
+
+    if (SegmentSummary *summary = Summary(m_last))
+        summary->index_offset = index_offset;
+    m_open = false;
+    return ESP_OK;
+}
+
+bool JournalStore::NewBlock() const noexcept
+{
+    return Indexed() && m_open_records % m_config.index_interval == 0;
+}
+
+bool JournalStore::Fits(size_t len, size_t used, size_t blocks) const noexcept
+{
+    // Room kept free for the index frame written when the segment is sealed
+    const size_t index = Indexed() ? FRAME_OVERHEAD + INDEX_HEAD + blocks * INDEX_ENTRY : 0;
+    return used + FRAME_OVERHEAD + len + index + COMMIT_SIZE <= m_config.segment_size;
+}
+
+bool JournalStore::StartsBlock(size_t len)
+{
+    if (!m_mounted || EnsureLoaded() != ESP_OK)
+        return true;
+    return !m_open || NewBlock() || !Fits(len, m_open_size, m_open_blocks);
+}
+
+esp_err_t JournalStore::Append(const uint8_t *payload, size_t len)
+{
+    if (!m_mounted)
+        return ESP_ERR_INVALID_STATE;
+    if (!payload && len != 0)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = EnsureLoaded();
+    if (err != ESP_OK)
+        return Fail(err);
+
+    const bool indexed = Indexed();
+    const size_t frame_size = FRAME_OVERHEAD + len;
+    if (len > PAYLOAD_MAX || !Fits(len, HEADER_SIZE, 1))
+        return ESP_ERR_INVALID_SIZE;
+
+    if (m_open && !Fits(len, m_open_size, m_open_blocks + (NewBlock() ? 1 : 0))) {
+        err = Seal();
+        if (err != ESP_OK)
+            return Fail(err);
+    }
+    if (!m_open) {
+        err = StartSegment();
+        if (err != ESP_OK)
+            return Fail(err);
+    }
+
+    err = WriteFrame(FRAME_MAGIC, payload, len);
+    if (err != ESP_OK)
+        return Fail(err);
+
+    if (indexed) {
+        const JournalKey key = chain_key(m_key_fn, payload, len, m_append_key, m_append_key_valid);
+        IndexRecord(static_cast<uint32_t>(m_open_size), key);
+    }
+
+    m_open_size += frame_size;
+    ++m_open_records;
+    ++m_next_seq;
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::Sync()
+{
+    if (!m_mounted)
+        return ESP_ERR_INVALID_STATE;
+    if (!m_open)
+        return ESP_OK;
+
+    const esp_err_t err = m_storage.Sync(m_last);
+    return err == ESP_OK ? ESP_OK : Fail(err);
+}
+
+esp_err_t JournalStore::DataEnd(uint32_t segment, uint32_t &end)
+{
+    if (m_open && segment == m_last) {
+        end = static_cast<uint32_t>(m_open_size);
+        return ESP_OK;
+    }
+
+    size_t size = 0;
+    esp_err_t err = m_storage.Size(segment, size);
+    if (err != ESP_OK)
+        return err;
+
+    uint8_t raw[COMMIT_SIZE];
+    Commit commit{};
+    if (size >= HEADER_SIZE + COMMIT_SIZE) {
+        err = m_storage.Read(segment, size - COMMIT_SIZE, raw, sizeof(raw));
+        if (err != ESP_OK)
+            return err;
+        if (commit_valid(raw, size, commit)) {
+            end = commit.data_end;
+            return ESP_OK;
+        }
+    }
+    // Not sealed (should not happen below the tail): frames are still CRC-checked
+    end = static_cast<uint32_t>(size);
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::Block(uint32_t segment, size_t k, IndexBlock &block, uint32_t &end,
+                              uint64_t &end_seq, bool &found)
+{
+    found = false;
+
+    if (m_open && segment == m_last && Summary(segment)) {
+        if (k >= m_open_blocks)
+            return ESP_OK;
+        block   = m_blocks[k];
+        end     = k + 1 < m_open_blocks ? m_blocks[k + 1].offset : static_cast<uint32_t>(m_open_size);
+        end_seq = k + 1 < m_open_blocks ? m_blocks[k + 1].first_seq : Summary(segment)->first_seq + m_open_records;
+        found   = true;
+        return ESP_OK;
+    }
+
+    const SegmentSummary *summary = Summary(segment);
+    if (!summary || summary->index_offset == 0) {
+        // No index: the whole segment is one block that may match anything
+        if (k != 0)
+            return ESP_OK;
+        const esp_err_t err = DataEnd(segment, end);
+        if (err != ESP_OK)
+            return err;
+        block   = { static_cast<uint32_t>(HEADER_SIZE), summary ? summary->first_seq : 0, INT64_MIN, INT64_MAX, 0xFF };
+        end_seq = UINT64_MAX;
+        found   = true;
+        return ESP_OK;
+    }
+
+    const uint32_t base = summary->index_offset + FRAME_HEAD;
+    uint8_t head[INDEX_HEAD];
+    esp_err_t err = m_storage.Read(segment, base, head, sizeof(head));
+    if (err != ESP_OK)
+        return err;
+    const size_t   count    = get_u16(head + 28);
+    const uint16_t interval = get_u16(head + 30);
+    if (k >= count)
+        return ESP_OK;
+
+    // Entry k and, if present, the offset of entry k + 1 (end of block k)
+    uint8_t raw[INDEX_ENTRY + 4];
+    const size_t n = k + 1 < count ? sizeof(raw) : INDEX_ENTRY;
+    err = m_storage.Read(segment, base + INDEX_HEAD + k * INDEX_ENTRY, raw, n);
+    if (err != ESP_OK)
+        return err;
+
+    block.offset     = get_u32(raw);
+    block.first_seq  = summary->first_seq + static_cast<uint64_t>(k) * interval;
+    block.first_ts   = static_cast<int64_t>(get_u64(raw + 4));
+    block.max_ts     = static_cast<int64_t>(get_u64(raw + 12));
+    block.severities = raw[20];
+    end     = k + 1 < count ? get_u32(raw + INDEX_ENTRY) : summary->index_offset;
+    end_seq = k + 1 < count ? block.first_seq + interval : summary->first_seq + summary->records;
+
+    // A damaged index must not send the reader outside the data area
+    if (block.offset < HEADER_SIZE || end > summary->index_offset || block.offset > end)
+        return ESP_ERR_INVALID_CRC;
+    found = true;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+JournalStore::Reader::Reader(JournalStore &store, const Filter *filter) noexcept
+    : m_store(store), m_segment(store.m_first)
+{
+    if (filter) {
+        m_filtered = true;
+        m_filter   = *filter;
+    }
+}
+
+void JournalStore::Reader::Seek(const Position &pos) noexcept
+{
+    m_segment   = pos.segment;
+    m_offset    = pos.offset;
+    m_seq       = pos.seq;
+    m_end       = 0;
+    m_block     = 0;
+    m_block_end = 0;
+    m_key_valid = false;
+}
+
+void JournalStore::Reader::NextSegment() noexcept
+{
+    Seek({ m_segment + 1, 0, 0 });
+}
+
+esp_err_t JournalStore::Reader::EnterSegment()
+{
+    uint8_t header[HEADER_SIZE];
+    esp_err_t err = m_store.m_storage.Read(m_segment, 0, header, sizeof(header));
+    if (err == ESP_OK && !header_valid(header, m_segment))
+        err = ESP_ERR_INVALID_CRC;
+    if (err == ESP_OK)
+        err = m_store.DataEnd(m_segment, m_end);
+    if (err != ESP_OK)
+        return err;
+
+    if (m_offset < HEADER_SIZE) {
+        m_offset = HEADER_SIZE;
+        m_seq    = get_u64(header + 12);
+    }
+    return ESP_OK;
+}
+
+esp_err_t JournalStore::Reader::SelectBlock(bool &found)
+{
+    // Starts at the current block: a block of the open segment may have grown
+    for (;; ++m_block) {
+        IndexBlock block{};
+        uint32_t end     = 0;
+        uint64_t end_seq = 0;
+        const esp_err_t err = m_store.Block(m_segment, m_block, block, end, end_seq, found);
+        if (err != ESP_OK)
+            return err;
+        if (!found) {
+            // Stay on the last block: it may still grow
+            if (m_block != 0)
+                --m_block;
+            return ESP_OK;
+        }
+
+        const bool match = block.max_ts >= m_filter.since_ms && (block.severities & m_filter.severities)
+                        && end_seq > m_filter.since_seq;
+        if (!match || end <= m_offset)
+            continue;
+
+        if (block.offset > m_offset) {
+            m_offset    = block.offset;
+            m_seq       = block.first_seq;
+            m_key_valid = false;
+        }
+        m_block_end = end;
+        return ESP_OK;
+    }
+}
+
+esp_err_t JournalStore::Reader::Next(uint8_t *buf, size_t cap, size_t &len)
+{
+    if (!m_store.m_mounted)
+        return ESP_ERR_INVALID_STATE;
+
+    if (m_filtered) {
+        const esp_err_t err = m_store.EnsureLoaded();
+        if (err != ESP_OK)
+            return err;
+    }
+
+    for (;;) {
+        if (m_store.m_count == 0 || m_segment > m_store.m_last)
+            return ESP_ERR_NOT_FOUND;
+        if (m_segment < m_store.m_first)
+            Seek({ m_store.m_first, 0, 0 });
+
+        const bool open_segment = m_store.m_open && m_segment == m_store.m_last;
+
+        if (m_end == 0) {
+            // Whole segments are skipped from the RAM summaries
+            if (m_filtered && !open_segment) {
+                const SegmentSummary *summary = m_store.Summary(m_segment);
+                if (summary && (summary->max_ts < m_filter.since_ms || !(summary->severities & m_filter.severities)
+                                || (summary->records != 0 && summary->first_seq + summary->records <= m_filter.since_seq))) {
+                    NextSegment();
+                    continue;
+                }
+            }
+
+            const esp_err_t err = EnterSegment();
+            if (err == ESP_ERR_INVALID_CRC)
+                ++m_corrupted;
+            if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_CRC) {
+                NextSegment();
+                continue;
+            }
+            if (err != ESP_OK)
+                return err;
+        }
+        // The open segment keeps growing while being read
+        if (open_segment)
+            m_end = static_cast<uint32_t>(m_store.m_open_size);
+
+        if (m_filtered && m_offset >= m_block_end) {
+            bool found = false;
+            const esp_err_t err = SelectBlock(found);
+            if (err == ESP_ERR_INVALID_CRC) {
+                ++m_corrupted;
+                NextSegment();
+                continue;
+            }
+            if (err != ESP_OK)
+                return err;
+            if (!found) {
+                if (m_segment == m_store.m_last)
+                    return ESP_ERR_NOT_FOUND;
+                NextSegment();
+                continue;
+            }
+        }
+
+        if (m_offset + FRAME_OVERHEAD > m_end) {
+            if (m_segment == m_store.m_last)
+                return ESP_ERR_NOT_FOUND;
+            // The segment may have been sealed after more records were read into it
+            uint32_t end = 0;
+            const esp_err_t err = m_store.DataEnd(m_segment, end);
+            if (err == ESP_OK && end > m_end) {
+                m_end = end;
+                continue;
+            }
+            NextSegment();
+            continue;
+        }
+
+        uint8_t head[FRAME_HEAD];
+        esp_err_t err = m_store.m_storage.Read(m_segment, m_offset, head, sizeof(head));
+        if (err != ESP_OK)
+            return err;
+
+        const uint16_t frame_len = get_u16(head);
+        const uint16_t magic     = get_u16(head + 2);
+        if (!frame_magic(magic) || m_offset + FRAME_OVERHEAD + frame_len > m_end) {
+            ++m_corrupted;
+            NextSegment();
+            continue;
+        }
+        if (magic == INDEX_MAGIC) {
+            m_offset += FRAME_OVERHEAD + frame_len;
+            continue;
+        }
+
+        ++m_visited;
+        len = frame_len;
+        if (frame_len > cap || (!buf && frame_len != 0)) {
+            m_offset += FRAME_OVERHEAD + frame_len;
+            m_last_seq = m_seq++;
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint8_t tail[FRAME_TAIL];
+        err = m_store.m_storage.Read(m_segment, m_offset + FRAME_HEAD, buf, frame_len);
+        if (err == ESP_OK)
+            err = m_store.m_storage.Read(m_segment, m_offset + FRAME_HEAD + frame_len, tail, sizeof(tail));
+        if (err != ESP_OK)
+            return err;
+
+        const uint32_t crc = crc32_finalize(crc32_update(frame_crc_begin(frame_len), buf, frame_len));
+        if (crc != get_u32(head + 4) || get_u16(tail) != frame_len || get_u16(tail + 2) != FRAME_MAGIC) {
+            ++m_corrupted;
+            NextSegment();
+            continue;
+        }
+
+        m_offset += FRAME_OVERHEAD + frame_len;
+        const uint64_t seq = m_seq++;
+
+        if (m_filtered) {
+            const JournalKey key = chain_key(m_store.m_key_fn, buf, frame_len, m_key, m_key_valid);
+            if (!m_filter.whole_blocks && seq < m_filter.since_seq)
+                continue;
+            if (!m_filter.whole_blocks && m_key_valid
+                && (key.timestamp_ms < m_filter.since_ms || !(severity_bit(key) & m_filter.severities)))
+                continue;
+        }
+
+        m_last_seq = seq;
+        return ESP_OK;
+    }
+}
@@ -0,0 +1,278 @@
+//
+// JournalStore - append-only, CRC-protected segmented journal
+//
+// Segment layout (all integers little-endian):
+//
+//   [header 24 B]  magic "EJSG", version, header size, segment index,
+//                  sequence number of the first record, crc32
+//   [frame]*       u16 length, u16 magic, u32 crc32(length, payload),
+//                  payload[length], u16 length, u16 magic
+//   [commit 20 B]  magic "EJSC", data end offset, record count,
+//                  index frame offset, crc32        (sealed segments only)
+//
+// Frames are either records (FRAME_MAGIC) or, written once when a segment
+// is sealed, its sparse index (INDEX_MAGIC).
+//
+// A segment holds at most segment_size bytes. When the next frame does not
+// fit, the segment is sealed with the commit marker and a new one is started;
+// once more than max_segments exist the oldest is removed.
+//
+// Recovery (Mount) lists the segments and inspects only the newest one, so
+// boot cost is O(segments): a sealed tail needs one read, an open tail is
+// verified through the trailing copy of the last frame length. Only when that
+// last frame is torn is the open segment scanned forward, and the torn bytes
+// are truncated away. Sequence numbers and the index are loaded lazily, on
+// the first append or query after boot.
+//
+// Sparse index: every index_interval records of a segment form a block
+// described by { offset, first sequence, first timestamp, latest timestamp,
+// severity bitmap }. Each segment also has a summary of the same fields. A
+// filtered Query() skips segments and blocks that cannot match, so "errors
+// since T" or "records since sequence S" reads only the blocks that can
+// contain them. Blocks of
+// the open segment live in RAM; a sealed segment keeps its blocks in its
+// index frame; summaries of all segments are kept in RAM.
+//
+// Not thread-safe: the caller serializes access.
+//
+
+#pragma once
+
+#include "journal_storage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Index key of a record, extracted from the leading payload bytes
+struct JournalKey
+{
+    int64_t timestamp_ms;
+    uint8_t severity;       // 0..7, bit in the severity bitmap
+};
+
+// prev is the key of the preceding record of the same segment, nullptr at
+// the start of a segment or index block or after an unknown key (records may
+// store their timestamp as a delta). Returns false if the payload carries no
+// usable key (the record is then indexed as matching every filter).
+using JournalKeyFn = bool (*)(const uint8_t *payload, size_t len, const JournalKey *prev, JournalKey &key);
+
+class JournalStore
+{
+public:
+    static constexpr size_t HEADER_SIZE    = 24;
+    static constexpr size_t COMMIT_SIZE    = 20;
+    static constexpr size_t FRAME_HEAD     = 8;
+    static constexpr size_t FRAME_TAIL     = 4;
+    static constexpr size_t FRAME_OVERHEAD = FRAME_HEAD + FRAME_TAIL;
+    static constexpr size_t PAYLOAD_MAX    = 0xFFFF;
+
+    // Index frame payload: summary header followed by one entry per block
+    static constexpr size_t INDEX_HEAD     = 33;
+    static constexpr size_t INDEX_ENTRY    = 21;
+
+    // Leading payload bytes passed to JournalKeyFn
+    static constexpr size_t KEY_PREFIX_MAX = 16;
+
+    struct Config
+    {
+        size_t   segment_size;          // Bytes per segment file, including header and commit marker
+        size_t   max_segments;          // Quota: segments kept before the oldest is removed
+        uint16_t index_interval = 0;    // Records per index block (used once an index is attached), 0: none
+    };
+
+    // What the last Mount() had to do
+    struct RecoveryInfo
+    {
+        size_t segments;        // Segments found
+        size_t truncated;       // Torn bytes discarded from the open segment
+        bool   scanned;         // Open segment needed a forward scan
+        bool   dropped_tail;    // Newest segment had a torn header and was removed
+    };
+
+    // Position of a frame: segment index + byte offset of its head, and the
+    // sequence number of the next record at or after it
+    struct Position
+    {
+        uint32_t segment;
+        uint32_t offset;
+        uint64_t seq;
+    };
+
+    struct IndexBlock
+    {
+        uint32_t offset;        // First frame of the block
+        uint64_t first_seq;
+        int64_t  first_ts;
+        int64_t  max_ts;
+        uint8_t  severities;    // Bitmap of JournalKey::severity
+    };
+
+    struct SegmentSummary
+    {
+        uint64_t first_seq;
+        uint32_t records;
+        uint32_t index_offset;  // Index frame of a sealed segment, 0 if none
+        int64_t  first_ts;
+        int64_t  max_ts;
+        uint8_t  severities;
+    };
+
+    // Records newer than or at since_ms with a severity in the bitmap and a
+    // sequence number of at least since_seq. whole_blocks returns every
+    // record of a matching block, for callers that decode records relative
+    // to the start of their block.
+    struct Filter
+    {
+        int64_t  since_ms;
+        uint8_t  severities;
+        bool     whole_blocks = false;
+        uint64_t since_seq    = 0;
+    };
+
+    // Size of the block table AttachIndex() needs for a configuration whose
+    // records carry at least min_payload bytes. A smaller table only makes the
+    // last block of a segment coarser.
+    static constexpr size_t MaxBlocks(const Config &config, size_t min_payload = 0)
+    {
+        const size_t records = (config.segment_size - HEADER_SIZE - COMMIT_SIZE) / (FRAME_OVERHEAD + min_payload);
+        return config.index_interval == 0 ? 0 : (records + config.index_interval - 1) / config.index_interval;
+    }
+
+    JournalStore(JournalStorage &storage, const Config &config) noexcept;
+
+    JournalStore(const JournalStore&) = delete;
+    JournalStore& operator=(const JournalStore&) = delete;
+
+    // Enables the sparse index. Tables are caller-owned: summaries needs
+    // max_segments + 1 entries, blocks is sized with MaxBlocks(). Call before
+    // Mount().
+    void AttachIndex(JournalKeyFn key_fn, std::span<SegmentSummary> summaries,
+                     std::span<IndexBlock> blocks) noexcept;
+
+    // Recovers the tail. Must succeed before Append()/Read().
+    esp_err_t Mount();
+
+    // Appends one record. ESP_ERR_INVALID_SIZE if it can never fit a segment.
+    // After any storage error the store must be mounted again.
+    esp_err_t Append(const uint8_t *payload, size_t len);
+
+    // Makes appended records durable.
+    esp_err_t Sync();
+
+    // Sequence number the next appended record will get
+    esp_err_t NextSeq(uint64_t &seq);
+
+    // True if a payload of len bytes appended now would be the first record
+    // of a segment or an index block, i.e. a point readers can start from.
+    // Also true when unsure.
+    bool StartsBlock(size_t len);
+
+    // Sequential reader over records, oldest first
+    class Reader
+    {
+    public:
+        // Copies the next payload into buf. ESP_ERR_NOT_FOUND at the end,
+        // ESP_ERR_INVALID_SIZE if cap is too small (the record is skipped).
+        // Frames failing their CRC skip the rest of their segment.
+        esp_err_t Next(uint8_t *buf, size_t cap, size_t &len);
+
+        // Sequence number of the record last returned by Next()
+        [[nodiscard]] uint64_t Seq() const noexcept { return m_last_seq; }
+
+        // Position of the frame Next() will look at
+        [[nodiscard]] Position Tell() const noexcept { return { m_segment, m_offset, m_seq }; }
+        // Continue from a position returned by Tell()
+        void Seek(const Position &pos) noexcept;
+
+        [[nodiscard]] size_t Corrupted() const noexcept { return m_corrupted; }
+        // Frames read, including those rejected by the filter
+        [[nodiscard]] size_t Visited() const noexcept { return m_visited; }
+
+    private:
+        friend class JournalStore;
+        Reader(JournalStore &store, const Filter *filter) noexcept;
+
+        esp_err_t EnterSegment();
+        esp_err_t SelectBlock(bool &found);
+        void NextSegment() noexcept;
+
+        JournalStore &m_store;
+        uint32_t      m_segment;
+        uint32_t      m_offset    = 0;  // 0: segment not entered yet
+        uint32_t      m_end       = 0;  // end of frames in m_segment
+        uint64_t      m_seq       = 0;  // sequence number of the frame at m_offset
+        uint64_t      m_last_seq  = 0;
+        size_t        m_corrupted = 0;
+        size_t        m_visited   = 0;
+
+        bool          m_filtered  = false;
+        JournalKey    m_key{};          // key of the previous record
+        bool          m_key_valid = false;
+        Filter        m_filter{};
+        size_t        m_block     = 0;  // next block to consider
+        uint32_t      m_block_end = 0;  // end of the block being read
+    };
+
+    [[nodiscard]] Reader Read() noexcept { return Reader(*this, nullptr); }
+    [[nodiscard]] Reader Query(const Filter &filter) noexcept { return Reader(*this, &filter); }
+
+    [[nodiscard]] bool     Mounted() const noexcept      { return m_mounted; }
+    [[nodiscard]] bool     Indexed() const noexcept;
+    [[nodiscard]] size_t   SegmentCount() const noexcept { return m_count; }
+    [[nodiscard]] uint32_t FirstSegment() const noexcept { return m_first; }
+    [[nodiscard]] uint32_t LastSegment() const noexcept  { return m_last; }
+    [[nodiscard]] const RecoveryInfo& Recovery() const noexcept { return m_recovery; }
+
+private:
+    esp_err_t RecoverTail();
+    esp_err_t ScanFrames(uint32_t segment, size_t end, size_t &valid_end);
+    esp_err_t CheckFrame(uint32_t segment, size_t offset, size_t end, size_t &frame_size);
+    esp_err_t StartSegment();
+    esp_err_t Seal();
+    esp_err_t WriteIndexFrame(uint32_t &offset);
+    esp_err_t WriteFrame(uint16_t magic, const uint8_t *payload, size_t len);
+    esp_err_t EnforceQuota();
+    esp_err_t Fail(esp_err_t err) noexcept;
+    bool NewBlock() const noexcept;
+    bool Fits(size_t len, size_t used, size_t blocks) const noexcept;
+
+    // Lazy state: sequence numbers, open-segment blocks, segment summaries
+    esp_err_t EnsureLoaded();
+    esp_err_t LoadOpenSegment(uint64_t first_seq);
+    esp_err_t LoadSummary(uint32_t segment, SegmentSummary &summary);
+    void IndexRecord(uint32_t offset, const JournalKey &key);
+    JournalKey ExtractKey(uint32_t segment, uint32_t offset, size_t len);
+    SegmentSummary *Summary(uint32_t segment) noexcept;
+    // Block k of a segment; end and end_seq are the offset and sequence number
+    // just past it (end_seq UINT64_MAX if unknown)
+    esp_err_t Block(uint32_t segment, size_t k, IndexBlock &block, uint32_t &end,
+                    uint64_t &end_seq, bool &found);
+
+    // End of frames in a sealed segment (from its commit marker), or of the open segment
+    esp_err_t DataEnd(uint32_t segment, uint32_t &end);
+
+    JournalStorage &m_storage;
+    Config          m_config;
+    RecoveryInfo    m_recovery{};
+
+    bool     m_mounted     = false;
+    size_t   m_count       = 0;     // existing segments
+    uint32_t m_first       = 0;
+    uint32_t m_last        = 0;
+    bool     m_open        = false; // m_last accepts appends
+    size_t   m_open_size   = 0;     // bytes in m_last when m_open
+
+    bool     m_loaded       = false;
+    uint64_t m_next_seq     = 0;
+    uint32_t m_open_records = 0;
+
+    // Sparse index (optional)
+    JournalKeyFn               m_key_fn = nullptr;
+    std::span<SegmentSummary>  m_summaries;     // [i] describes segment m_first + i
+    std::span<IndexBlock>      m_blocks;        // blocks of the open segment
+    size_t                     m_open_blocks = 0;
+    JournalKey                 m_append_key{};  // key of the last record of the open segment
+    bool                       m_append_key_valid = false;
+
+}; // class JournalStore
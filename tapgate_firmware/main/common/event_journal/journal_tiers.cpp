@@ -0,0 +1,141 @@
+#include "journal_tiers.h"
+
+static JournalStore::Filter tier_filter(const JournalStore::Filter &filter, const uint64_t *since_seq, size_t tier)
+{
+    JournalStore::Filter result = filter;
+    result.whole_blocks = true;
+    if (since_seq)
+        result.since_seq = since_seq[tier];
+    return result;
+}
+
+JournalTiers::JournalTiers(JournalStore &rolling, JournalStore &retained) noexcept
+    : m_stores{ &rolling, &retained }
+{
+}
+
+esp_err_t JournalTiers::Mount()
+{
+    for (size_t tier = 0; tier < COUNT; ++tier) {
+        if (m_stores[tier]->Mounted())
+            continue;
+        // The encoder state may no longer match the tail
+        m_codec[tier].valid = false;
+        const esp_err_t err = m_stores[tier]->Mount();
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_OK;
+}
+
+bool JournalTiers::Mounted() const noexcept
+{
+    for (const JournalStore *store : m_stores) {
+        if (!store->Mounted())
+            return false;
+    }
+    return true;
+}
+
+esp_err_t JournalTiers::Append(const journal_record_t &record, uint8_t *buf, size_t cap)
+{
+    const size_t tier = TierOf(record.type);
+    JournalStore &store = *m_stores[tier];
+
+    // Delta-encoded unless the record starts a segment or an index block,
+    // where readers need a restart record
+    JournalCodecState state = m_codec[tier];
+    size_t len = journal_codec_encode(record, false, state, buf, cap);
+    if (len != 0 && store.StartsBlock(len)) {
+        state = m_codec[tier];
+        len   = journal_codec_encode(record, true, state, buf, cap);
+    }
+    if (len == 0)
+        return ESP_OK;
+
+    const esp_err_t err = store.Append(buf, len);
+    if (err != ESP_OK)
+        return err;
+    m_codec[tier] = state;
+    m_dirty[tier] = true;
+    return ESP_OK;
+}
+
+esp_err_t JournalTiers::Sync()
+{
+    for (size_t tier = 0; tier < COUNT; ++tier) {
+        if (!m_dirty[tier])
+            continue;
+        const esp_err_t err = m_stores[tier]->Sync();
+        if (err != ESP_OK)
+            return err;
+        m_dirty[tier] = false;
+    }
+    return ESP_OK;
+}
+
+JournalTiers::Reader::Reader(JournalTiers &tiers, const JournalStore::Filter &filter, const uint64_t *since_seq,
+                             uint8_t *scratch, size_t cap) noexcept
+    : m_cap(cap)
+    , m_lanes{
+        { tiers.m_stores[ROLLING]->Query(tier_filter(filter, since_seq, ROLLING)), scratch, {}, {}, false, false },
+        { tiers.m_stores[RETAINED]->Query(tier_filter(filter, since_seq, RETAINED)), scratch + cap, {}, {}, false, false },
+    }
+{
+}
+
+esp_err_t JournalTiers::Reader::Fill(Lane &lane, size_t tier)
+{
+    while (!lane.ready && !lane.done) {
+        size_t len = 0;
+        const esp_err_t err = lane.reader.Next(lane.buf, m_cap, len);
+        if (err == ESP_ERR_NOT_FOUND) {
+            lane.done = true;
+            break;
+        }
+        if (err == ESP_ERR_INVALID_SIZE)
+            continue;
+        if (err != ESP_OK)
+            return err;
+
+        Entry &entry  = lane.entry;
+        entry.tier    = tier;
+        entry.seq     = lane.reader.Seq();
+        entry.decoded = journal_codec_decode(lane.buf, len, lane.state, entry.record, entry.event_id);
+        lane.ready    = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t JournalTiers::Reader::Next(const Entry *&entry)
+{
+    Lane *best = nullptr;
+    for (size_t tier = 0; tier < COUNT; ++tier) {
+        Lane &lane = m_lanes[tier];
+        const esp_err_t err = Fill(lane, tier);
+        if (err != ESP_OK)
+            return err;
+        if (!lane.ready)
+            continue;
+        // Undecodable records have no timestamp: hand them out at once
+        if (!best || !lane.entry.decoded
+            || (best->entry.decoded && lane.entry.record.timestamp_ms < best->entry.record.timestamp_ms))
+            best = &lane;
+        if (!best->entry.decoded)
+            break;
+    }
+    if (!best)
+        return ESP_ERR_NOT_FOUND;
+
+    best->ready = false;
+    entry = &best->entry;
+    return ESP_OK;
+}
+
+size_t JournalTiers::Reader::Corrupted() const noexcept
+{
+    size_t total = 0;
+    for (const Lane &lane : m_lanes)
+        total += lane.reader.Corrupted();
+    return total;
+}
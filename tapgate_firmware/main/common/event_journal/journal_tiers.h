@@ -0,0 +1,122 @@
+//
+// JournalTiers - severity-tiered retention over two journal stores
+//
+// INFO and WARNING records (boot banners, routine operations) are frequent
+// and lose their value quickly; ERROR and ALERT records are rare and are the
+// ones a post-mortem needs months later. In a single store the former rotate
+// the latter out. Records are therefore routed by severity into two stores:
+//
+//   rolling    INFO, WARNING   high churn, rotates quickly
+//   retained   ERROR, ALERT    own quota, long retention
+//
+// Each tier is a complete JournalStore with its own directory, segments,
+// index, sequence numbers and encoder state, so rotating one tier never
+// reads or rewrites the other and each can be given its own flash budget.
+// Reader merges both back into one view ordered by timestamp.
+//
+// Not thread-safe: the caller serializes access. Pure C++, no ESP-IDF
+// dependency.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "journal_codec.h"
+#include "journal_record.h"
+#include "journal_store.h"
+
+class JournalTiers
+{
+public:
+    static constexpr size_t COUNT    = 2;
+    static constexpr size_t ROLLING  = 0;
+    static constexpr size_t RETAINED = 1;
+
+    // Lowest record type kept in the retained tier (EVENT_JOURNAL_ERROR)
+    static constexpr uint8_t RETAINED_MIN_TYPE = 2;
+
+    static constexpr size_t TierOf(uint8_t type) noexcept
+    {
+        return type >= RETAINED_MIN_TYPE ? RETAINED : ROLLING;
+    }
+
+    // A record read back, with the tier and sequence number it is stored at
+    struct Entry
+    {
+        size_t           tier;
+        uint64_t         seq;
+        bool             decoded;   // false: record and event_id are not valid
+        uint16_t         event_id;
+        journal_record_t record;
+    };
+
+    JournalTiers(JournalStore &rolling, JournalStore &retained) noexcept;
+
+    JournalTiers(const JournalTiers&) = delete;
+    JournalTiers& operator=(const JournalTiers&) = delete;
+
+    [[nodiscard]] JournalStore &Store(size_t tier) noexcept { return *m_stores[tier]; }
+
+    // Mounts every tier that is not mounted (at boot or after a storage
+    // error). A remounted tier restarts encoding.
+    esp_err_t Mount();
+    [[nodiscard]] bool Mounted() const noexcept;
+
+    // Encodes record into buf (cap bytes, JOURNAL_CODEC_RECORD_MAX) and
+    // appends it to its tier. A record that cannot be encoded is skipped.
+    esp_err_t Append(const journal_record_t &record, uint8_t *buf, size_t cap);
+
+    // Makes the tiers appended to since the last Sync() durable
+    esp_err_t Sync();
+
+    // Merged reader over both tiers, oldest first
+    class Reader
+    {
+    public:
+        // Next record read from either tier; ties go to the rolling tier.
+        // Every record of a matching block is returned (the caller filters
+        // after decoding). ESP_ERR_NOT_FOUND at the end. entry stays valid
+        // until the next call.
+        esp_err_t Next(const Entry *&entry);
+
+        [[nodiscard]] size_t Corrupted() const noexcept;
+
+    private:
+        friend class JournalTiers;
+
+        struct Lane
+        {
+            JournalStore::Reader reader;
+            uint8_t             *buf;
+            JournalCodecState    state;
+            Entry                entry;
+            bool                 ready;
+            bool                 done;
+        };
+
+        Reader(JournalTiers &tiers, const JournalStore::Filter &filter, const uint64_t *since_seq,
+               uint8_t *scratch, size_t cap) noexcept;
+
+        esp_err_t Fill(Lane &lane, size_t tier);
+
+        size_t m_cap;
+        Lane   m_lanes[COUNT];
+    };
+
+    // Records matching filter (whole blocks) in both tiers. since_seq, if
+    // given, holds the first sequence number to read per tier and overrides
+    // filter.since_seq. scratch holds COUNT buffers of cap bytes each.
+    [[nodiscard]] Reader Query(const JournalStore::Filter &filter, const uint64_t *since_seq,
+                               uint8_t *scratch, size_t cap) noexcept
+    {
+        return Reader(*this, filter, since_seq, scratch, cap);
+    }
+
+private:
+    JournalStore     *m_stores[COUNT];
+    JournalCodecState m_codec[COUNT]{};     // encoder state of each open segment
+    bool              m_dirty[COUNT]{};
+
+}; // class JournalTiers
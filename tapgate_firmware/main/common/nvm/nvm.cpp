@@ -1,17 +1,16 @@
 #include "nvm.h"
+#include "nvm_snapshot.h"
 
 #include "esp_log.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
-#include <cstring>
+#include "crc32.h"
 
-// Maximum size for read-before-write comparison buffers (stack-allocated).
-// Calls with data exceeding these caps skip the comparison and write unconditionally.
-static constexpr size_t NVM_STR_COMPARE_CAP  = 256;
-static constexpr size_t NVM_BLOB_COMPARE_CAP = 256;
+#include <cstdio>
+#include <cstring>
 
-static const char* TAG = "NVM";
+[[maybe_unused]] static const char* TAG = "NVM";
 
 NVMWrapper& NVMWrapper::getInstance() noexcept
 {
@@ -24,6 +23,9 @@ NVMWrapper& NVM = NVMWrapper::getInstance();
 
 esp_err_t NVMWrapper::Init() noexcept
 {
+    InvalidateHandles();
+    m_stats.Reset();
+
     ESP_LOGI(TAG, "Initializing %d partition(s)", sizeof(NVM_PARTITION_LABELS) / sizeof(NVM_PARTITION_LABELS[0]));
     for (size_t idx = 0; idx < sizeof(NVM_PARTITION_LABELS) / sizeof(NVM_PARTITION_LABELS[0]); ++idx)
     {
@@ -47,6 +49,9 @@ esp_err_t NVMWrapper::EnsurePartitionReady(const char *partition_label)
         ESP_LOGW(TAG, "Erasing Partition \"%s\" due to previous error: " ERR_FORMAT, partition_label,
                  esp_err_to_str(err), err);
 
+        // Erasing deinitializes the partition and with it every open handle
+        InvalidateHandles(partition_label);
+
         err = nvs_flash_erase_partition(partition_label);
         if (err != ESP_OK)
         {
@@ -83,15 +88,16 @@ esp_err_t NVMWrapper::ReadString(const char *partition,
     if (!partition || !namespace_name || !key)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READONLY, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
     if (err != ESP_OK)
         return err;
 
     size_t length = size;
     err = nvs_get_str(handle, key, buffer, &length);
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::WriteString(const char *partition,
@@ -102,36 +108,52 @@ esp_err_t NVMWrapper::WriteString(const char *partition,
     if (!partition || !namespace_name || !key || !value)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READWRITE, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READWRITE, handle);
     if (err != ESP_OK)
         return err;
 
     // To reduce memory cell degradation, data is rewritten only when changes have occurred.
-    // Strings longer than NVM_STR_COMPARE_CAP are written unconditionally (safe, no heap).
+    // Strings longer than NVM_STR_COMPARE_CAP are compared through their digest key.
+    const size_t size = std::strlen(value) + 1;
     size_t existing_len = 0;
     err = nvs_get_str(handle, key, nullptr, &existing_len);
+    if (size > NVM_STR_COMPARE_CAP && (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND)) {
+        bool written = false;
+        err = WriteDigested(partition, handle, key, true, value, size, err == ESP_OK && existing_len == size, written);
+        if (written) {
+            m_stats.RecordWrite(partition, namespace_name, key, NVMStats::VariableEntries(size) + 1);
+        } else if (err == ESP_OK) {
+            m_stats.RecordSkip(partition, namespace_name, key);
+        }
+        if (err == ESP_OK && written) {
+            ESP_LOGD(TAG, "%s Store string (%zu bytes) to part: %s space: %s key %s", __FUNCTION__, size, partition, namespace_name, key);
+        }
+        return Release(part, handle, err);
+    }
     if (err == ESP_OK && existing_len > 0 && existing_len <= NVM_STR_COMPARE_CAP) {
         char buffer[NVM_STR_COMPARE_CAP];
         err = nvs_get_str(handle, key, buffer, &existing_len);
         if (err == ESP_OK && std::strcmp(buffer, value) == 0) {
-            nvs_close(handle);
             ESP_LOGD(TAG, "%s the value \"%s\" already set for part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
+            m_stats.RecordSkip(partition, namespace_name, key);
             return ESP_OK; // No change needed
         }
     } else if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        // NOT_FOUND and strings too large for the cache both fall through to write
-        nvs_close(handle);
-        return err;
+        return Release(part, handle, err);
     }
 
+    const uint64_t start_us = NVMStats::NowUs();
     err = nvs_set_str(handle, key, value);
     if (err == ESP_OK) {
+        m_stats.RecordWrite(partition, namespace_name, key, NVMStats::VariableEntries(size));
         ESP_LOGD(TAG, "%s Store: \"%s\" to part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
         err = nvs_commit(handle);
+        m_stats.RecordCommit(partition, NVMStats::SinceUs(start_us));
     }
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::StringSize(const char *partition,
@@ -142,15 +164,15 @@ esp_err_t NVMWrapper::StringSize(const char *partition,
     if (!partition || !namespace_name || !key)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
+    if (err != ESP_OK)
         return err;
-    }
     size = 0;
     err = nvs_get_str(handle, key, nullptr, &size);
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::ReadU32(const char *partition,
@@ -161,14 +183,15 @@ esp_err_t NVMWrapper::ReadU32(const char *partition,
     if (!partition || !namespace_name || !key || !value)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READONLY, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
     if (err != ESP_OK)
         return err;
 
     err = nvs_get_u32(handle, key, value);
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::WriteU32(const char *partition,
@@ -179,8 +202,10 @@ esp_err_t NVMWrapper::WriteU32(const char *partition,
     if (!partition || !namespace_name || !key)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READWRITE, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READWRITE, handle);
     if (err != ESP_OK)
         return err;
 
@@ -188,22 +213,23 @@ esp_err_t NVMWrapper::WriteU32(const char *partition,
     uint32_t existing_value;
     err = nvs_get_u32(handle, key, &existing_value);
     if (err == ESP_OK && existing_value == value) {
-        nvs_close(handle);
         ESP_LOGD(TAG, "%s the value \"%d\" already set for part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
+        m_stats.RecordSkip(partition, namespace_name, key);
         return ESP_OK; // No change needed
     }
     if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        nvs_close(handle);
-        return err;
+        return Release(part, handle, err);
     }
 
+    const uint64_t start_us = NVMStats::NowUs();
     err = nvs_set_u32(handle, key, value);
     if (err == ESP_OK) {
+        m_stats.RecordWrite(partition, namespace_name, key, 1);
         ESP_LOGD(TAG, "%s Store: \"%d\" to part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
         err = nvs_commit(handle);
+        m_stats.RecordCommit(partition, NVMStats::SinceUs(start_us));
     }
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::ReadU8(const char *partition,
@@ -214,14 +240,15 @@ esp_err_t NVMWrapper::ReadU8(const char *partition,
     if (!partition || !namespace_name || !key || !value)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READONLY, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
     if (err != ESP_OK)
         return err;
 
     err = nvs_get_u8(handle, key, value);
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::WriteU8(const char *partition,
@@ -232,8 +259,10 @@ esp_err_t NVMWrapper::WriteU8(const char *partition,
     if (!partition || !namespace_name || !key)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READWRITE, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READWRITE, handle);
     if (err != ESP_OK)
         return err;
 
@@ -241,22 +270,23 @@ esp_err_t NVMWrapper::WriteU8(const char *partition,
     uint8_t existing_value;
     err = nvs_get_u8(handle, key, &existing_value);
     if (err == ESP_OK && existing_value == value) {
-        nvs_close(handle);
         ESP_LOGD(TAG, "%s the value \"%d\" already set for part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
+        m_stats.RecordSkip(partition, namespace_name, key);
         return ESP_OK; // No change needed
     }
     if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        nvs_close(handle);
-        return err;
+        return Release(part, handle, err);
     }
 
+    const uint64_t start_us = NVMStats::NowUs();
     err = nvs_set_u8(handle, key, value);
     if (err == ESP_OK) {
+        m_stats.RecordWrite(partition, namespace_name, key, 1);
         ESP_LOGD(TAG, "%s Store: \"%d\" to part: %s space: %s key %s", __FUNCTION__, value, partition, namespace_name, key);
         err = nvs_commit(handle);
+        m_stats.RecordCommit(partition, NVMStats::SinceUs(start_us));
     }
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::ReadBlob(const char *partition,
@@ -271,15 +301,16 @@ esp_err_t NVMWrapper::ReadBlob(const char *partition,
     if (!partition || !namespace_name || !key)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READONLY, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
     if (err != ESP_OK)
         return err;
 
     size_t length = size;
     err = nvs_get_blob(handle, key, buffer, &length);
-    nvs_close(handle);
-    return err;
+    return Release(part, handle, err);
 }
 
 esp_err_t NVMWrapper::WriteBlob(const char *partition,
@@ -291,34 +322,327 @@ esp_err_t NVMWrapper::WriteBlob(const char *partition,
     if (!partition || !namespace_name || !key || !value || size == 0)
         return ESP_ERR_INVALID_ARG;
 
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
     nvs_handle_t handle;
-    esp_err_t err = nvs_open_from_partition(partition, namespace_name, NVS_READWRITE, &handle);
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READWRITE, handle);
     if (err != ESP_OK)
         return err;
 
     // To reduce memory cell degradation, data is rewritten only when changes have occurred.
-    // Blobs larger than NVM_BLOB_COMPARE_CAP are written unconditionally (safe, no heap).
+    // Blobs larger than NVM_BLOB_COMPARE_CAP are compared through their digest key.
     size_t existing_len = 0;
     err = nvs_get_blob(handle, key, nullptr, &existing_len);
+    if (size > NVM_BLOB_COMPARE_CAP && (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND)) {
+        bool written = false;
+        err = WriteDigested(partition, handle, key, false, value, size, err == ESP_OK && existing_len == size, written);
+        if (written) {
+            m_stats.RecordWrite(partition, namespace_name, key, NVMStats::VariableEntries(size) + 1);
+        } else if (err == ESP_OK) {
+            m_stats.RecordSkip(partition, namespace_name, key);
+        }
+        if (err == ESP_OK && written) {
+            ESP_LOGD(TAG, "%s Store blob (%zu bytes) to part: %s space: %s key %s", __FUNCTION__, size, partition, namespace_name, key);
+        }
+        return Release(part, handle, err);
+    }
     if (err == ESP_OK && existing_len == size && size <= NVM_BLOB_COMPARE_CAP) {
         uint8_t existing[NVM_BLOB_COMPARE_CAP];
         err = nvs_get_blob(handle, key, existing, &existing_len);
         if (err == ESP_OK && std::memcmp(existing, value, size) == 0) {
-            nvs_close(handle);
             ESP_LOGD(TAG, "%s blob already set for part: %s space: %s key %s", __FUNCTION__, partition, namespace_name, key);
+            m_stats.RecordSkip(partition, namespace_name, key);
             return ESP_OK; // No change needed
         }
     } else if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        // NOT_FOUND and blobs too large for the cache both fall through to write
-        nvs_close(handle);
-        return err;
+        return Release(part, handle, err);
     }
 
+    const uint64_t start_us = NVMStats::NowUs();
     err = nvs_set_blob(handle, key, value, size);
     if (err == ESP_OK) {
+        m_stats.RecordWrite(partition, namespace_name, key, NVMStats::VariableEntries(size));
         ESP_LOGD(TAG, "%s Store blob (%zu bytes) to part: %s space: %s key %s", __FUNCTION__, size, partition, namespace_name, key);
         err = nvs_commit(handle);
+        m_stats.RecordCommit(partition, NVMStats::SinceUs(start_us));
+    }
+    return Release(part, handle, err);
+}
+
+esp_err_t NVMWrapper::EraseKey(const char *partition,
+                               const char *namespace_name,
+                               const char *key)
+{
+    if (!partition || !namespace_name || !key)
+        return ESP_ERR_INVALID_ARG;
+
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
+    nvs_handle_t handle;
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READWRITE, handle);
+    if (err != ESP_OK)
+        return err;
+
+    err = DropDigest(handle, key);
+    if (err == ESP_OK) {
+        err = nvs_erase_key(handle, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND)
+            return ESP_OK;  // nothing to commit unless the digest went
+    }
+    if (err == ESP_OK) {
+        ESP_LOGD(TAG, "%s Erase key %s from part: %s space: %s", __FUNCTION__, key, partition, namespace_name);
+        err = nvs_commit(handle);
+    }
+    return Release(part, handle, err);
+}
+
+// ---------------------------------------------------------------------------
+// Namespace preload
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMWrapper::LoadNamespace(const char *partition,
+                                    const char *namespace_name,
+                                    NVMSnapshot &snapshot)
+{
+    snapshot.Clear();
+    if (!partition || !namespace_name)
+        return ESP_ERR_INVALID_ARG;
+
+    PartitionState &part = Partition(partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
+    nvs_handle_t handle;
+    esp_err_t err = OpenHandle(part, partition, namespace_name, NVS_READONLY, handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK;  // never written: nothing to load
+    if (err != ESP_OK)
+        return err;
+
+    // Values are read through the cached handle while the iterator lists the keys
+    nvs_iterator_t it = nullptr;
+    err = nvs_entry_find(partition, namespace_name, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK)
+    {
+        nvs_entry_info_t info;
+        err = nvs_entry_info(it, &info);
+        if (err == ESP_OK && info.key[0] != NVM_DIGEST_KEY_PREFIX)
+            err = snapshot.Append(handle, info);
+        if (err == ESP_OK)
+            err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+
+    if (err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        snapshot.Clear();
+        ESP_LOGE(TAG, "Failed to load part: %s space: %s: " ERR_FORMAT, partition, namespace_name,
+                 esp_err_to_str(err), err);
+        return Release(part, handle, err);
+    }
+
+    snapshot.Seal();
+    ESP_LOGD(TAG, "%s %zu key(s), %zu bytes from part: %s space: %s", __FUNCTION__,
+             snapshot.Count(), snapshot.Used(), partition, namespace_name);
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Telemetry
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMWrapper::GetStats(const char *partition, NVMPartitionStats &stats)
+{
+    if (!m_stats.Counters(partition, stats))
+        return ESP_ERR_NOT_FOUND;
+    return nvs_get_stats(partition, &stats.nvs);
+}
+
+size_t NVMWrapper::GetKeyStats(const char *partition, NVMKeyStats *keys, size_t max)
+{
+    return m_stats.Keys(partition, keys, max);
+}
+
+// ---------------------------------------------------------------------------
+// Digest keys — read-before-write for values above the compare caps
+// ---------------------------------------------------------------------------
+
+void NVMWrapper::DigestKey(const char *key, char (&out)[NVS_KEY_NAME_MAX_SIZE]) noexcept
+{
+    std::snprintf(out, sizeof(out), "%c%08lx", NVM_DIGEST_KEY_PREFIX,
+                  static_cast<unsigned long>(crc32_calculate(reinterpret_cast<const uint8_t*>(key), std::strlen(key))));
+}
+
+uint64_t NVMWrapper::ValueDigest(const char *key, const void *value, size_t size) noexcept
+{
+    // CRC-32 and FNV-1a over (key, '\0', value): two independent 32-bit hashes.
+    // The key is included so a digest never matches another key's value.
+    const auto *k = reinterpret_cast<const uint8_t*>(key);
+    const auto *v = static_cast<const uint8_t*>(value);
+    const size_t key_len = std::strlen(key) + 1;
+
+    uint32_t crc = crc32_init(0xFFFFFFFFu);
+    crc = crc32_update(crc, k, key_len);
+    crc = crc32_finalize(crc32_update(crc, v, size));
+
+    uint32_t fnv = 2166136261u;
+    for (size_t i = 0; i < key_len; ++i)
+        fnv = (fnv ^ k[i]) * 16777619u;
+    for (size_t i = 0; i < size; ++i)
+        fnv = (fnv ^ v[i]) * 16777619u;
+
+    return (static_cast<uint64_t>(crc) << 32) | fnv;
+}
+
+esp_err_t NVMWrapper::DropDigest(nvs_handle_t handle, const char *key) noexcept
+{
+    char digest_key[NVS_KEY_NAME_MAX_SIZE];
+    DigestKey(key, digest_key);
+    const esp_err_t err = nvs_erase_key(handle, digest_key);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
+
+esp_err_t NVMWrapper::WriteDigested(const char *partition,
+                                    nvs_handle_t handle,
+                                    const char *key,
+                                    bool is_string,
+                                    const void *value,
+                                    size_t size,
+                                    bool same_size,
+                                    bool &written)
+{
+    written = false;
+    char digest_key[NVS_KEY_NAME_MAX_SIZE];
+    DigestKey(key, digest_key);
+    const uint64_t digest = ValueDigest(key, value, size);
+
+    uint64_t stored = 0;
+    esp_err_t err = nvs_get_u64(handle, digest_key, &stored);
+    if (err == ESP_OK && same_size && stored == digest)
+        return ESP_OK; // No change needed
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+        return err;
+
+    // The digest goes before the value changes: a reset in between must not
+    // leave a digest describing a value that is no longer stored
+    if (err == ESP_OK) {
+        err = nvs_erase_key(handle, digest_key);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    const uint64_t start_us = NVMStats::NowUs();
+    err = is_string ? nvs_set_str(handle, key, static_cast<const char*>(value))
+                    : nvs_set_blob(handle, key, value, size);
+    if (err != ESP_OK)
+        return err;
+    written = true;
+
+    // Without a digest the next identical write is not skipped, nothing worse
+    const esp_err_t digest_err = nvs_set_u64(handle, digest_key, digest);
+    if (digest_err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store digest of key %s: " ERR_FORMAT, key, esp_err_to_str(digest_err), digest_err);
     }
-    nvs_close(handle);
+    err = nvs_commit(handle);
+    m_stats.RecordCommit(partition, NVMStats::SinceUs(start_us));
     return err;
 }
+
+// ---------------------------------------------------------------------------
+// Handle cache
+// ---------------------------------------------------------------------------
+
+NVMWrapper::PartitionState &NVMWrapper::Partition(const char *partition) noexcept
+{
+    for (size_t i = 0; i < NVMStats::PARTITIONS; ++i)
+    {
+        if (std::strcmp(NVM_PARTITION_LABELS[i], partition) == 0)
+            return m_partitions[i];
+    }
+    return m_partitions[NVMStats::PARTITIONS];
+}
+
+esp_err_t NVMWrapper::OpenHandle(PartitionState &part,
+                                 const char *partition,
+                                 const char *namespace_name,
+                                 nvs_open_mode_t mode,
+                                 nvs_handle_t &handle)
+{
+    // Longer names can never be opened; report what NVS would
+    if (std::strlen(partition) >= NVS_PART_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+    if (std::strlen(namespace_name) >= NVS_NS_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    // A read-only slot of the same namespace is replaced by the read-write
+    // handle, otherwise the least recently used (or a free) slot is reused
+    HandleSlot *victim = &part.handles[0];
+    bool upgrade = false;
+    for (HandleSlot &slot : part.handles)
+    {
+        const bool same = slot.last_use != 0
+                       && std::strcmp(slot.partition, partition) == 0
+                       && std::strcmp(slot.namespace_name, namespace_name) == 0;
+        if (same && (slot.mode == mode || slot.mode == NVS_READWRITE))
+        {
+            slot.last_use = ++part.use_clock;
+            handle = slot.handle;
+            return ESP_OK;
+        }
+        if (same)
+        {
+            victim  = &slot;
+            upgrade = true;
+        }
+        else if (!upgrade && slot.last_use < victim->last_use)
+        {
+            victim = &slot;
+        }
+    }
+
+    nvs_handle_t opened;
+    const esp_err_t err = nvs_open_from_partition(partition, namespace_name, mode, &opened);
+    if (err != ESP_OK)
+        return err;
+
+    CloseSlot(*victim);
+    std::strcpy(victim->partition, partition);
+    std::strcpy(victim->namespace_name, namespace_name);
+    victim->mode     = mode;
+    victim->handle   = opened;
+    victim->last_use = ++part.use_clock;
+    handle = opened;
+    return ESP_OK;
+}
+
+esp_err_t NVMWrapper::Release(PartitionState &part, nvs_handle_t handle, esp_err_t err) noexcept
+{
+    if (err != ESP_ERR_NVS_INVALID_HANDLE)
+        return err;
+
+    for (HandleSlot &slot : part.handles)
+    {
+        if (slot.last_use != 0 && slot.handle == handle)
+            slot.last_use = 0;
+    }
+    return err;
+}
+
+void NVMWrapper::CloseSlot(HandleSlot &slot) noexcept
+{
+    if (slot.last_use == 0)
+        return;
+    nvs_close(slot.handle);
+    slot.last_use = 0;
+}
+
+void NVMWrapper::InvalidateHandles(const char *partition) noexcept
+{
+    for (PartitionState &part : m_partitions)
+    {
+        std::lock_guard<std::mutex> lock(part.mutex);
+        for (HandleSlot &slot : part.handles)
+        {
+            if (!partition || std::strcmp(slot.partition, partition) == 0)
+                CloseSlot(slot);
+        }
+    }
+}
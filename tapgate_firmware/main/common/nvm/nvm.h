@@ -1,11 +1,53 @@
 //
 // NVMWrapper (Non-Volatile Memory) wrapper
-// 
+//
+// Handles opened with nvs_open_from_partition() stay open in a small LRU
+// cache per partition keyed by (namespace, mode), so repeated reads and
+// writes of the same namespace (the nonce on every DoAction) skip the
+// namespace lookup and handle allocation. A read-write handle also serves
+// reads of its namespace. Every call holds the mutex of its partition while it
+// uses a handle, up to and including nvs_commit(), so an eviction never closes
+// a handle in use. Operations on different partitions do not wait for each
+// other: a nonce lease refill is not held up by an entity or blob commit.
+// Cached handles of a partition are closed before it is erased or
+// initialized again (InvalidateHandles()).
+//
+// Writes are skipped when the key already holds the value. Strings and blobs
+// up to the compare caps are compared in a stack buffer. Larger values are
+// compared through a digest key in the same namespace: "~" followed by the
+// CRC-32 of the key name in hex, holding a 64-bit digest of (key, value) as
+// u64. The digest key is erased before such a value is rewritten, so it never
+// outlives the value it describes. Key names starting with '~' are reserved.
+//
+// LoadNamespace() reads a whole namespace into an NVMSnapshot (nvm_snapshot.h)
+// in one pass, for contexts that initialise from many keys at boot.
+//
+// Every stored value, skipped write and commit is counted per partition and
+// key (nvm_stats.h); GetStats() and GetKeyStats() read the counters back.
+//
 
 #pragma once
+#include <cstdint>
+#include <mutex>
+
 #include "nvs.h"
 #include "device_err.h"
 #include "nvm_partition.h"
+#include "nvm_stats.h"
+
+class NVMSnapshot;
+
+// Read-before-write compare buffers (stack). Larger values use digest keys.
+constexpr size_t NVM_STR_COMPARE_CAP  = 256;
+constexpr size_t NVM_BLOB_COMPARE_CAP = 256;
+
+constexpr char NVM_DIGEST_KEY_PREFIX = '~';
+
+#ifdef CONFIG_NVM_HANDLE_CACHE_SIZE
+constexpr size_t NVM_HANDLE_CACHE_SIZE = CONFIG_NVM_HANDLE_CACHE_SIZE;
+#else
+constexpr size_t NVM_HANDLE_CACHE_SIZE = 4;
+#endif
 
 class NVMWrapper
 {
@@ -65,13 +107,79 @@ public:
                         const void *value,
                         size_t size);
 
+    // Erases a key (and its digest key). ESP_OK if it does not exist.
+    esp_err_t EraseKey(const char *partition,
+                       const char *namespace_name,
+                       const char *key);
+
+    // Replaces the contents of snapshot with every key of the namespace.
+    // An absent namespace gives an empty snapshot. ESP_ERR_NO_MEM if the
+    // namespace does not fit the snapshot arena (snapshot left empty).
+    esp_err_t LoadNamespace(const char *partition,
+                            const char *namespace_name,
+                            NVMSnapshot &snapshot);
+
+    // Write telemetry of a partition since Init(), with nvs_get_stats().
+    // ESP_ERR_NOT_FOUND if the partition is not in NVM_PARTITION_LABELS.
+    esp_err_t GetStats(const char *partition, NVMPartitionStats &stats);
+    // Per-key counters of a partition, most stored first; returns the
+    // number of keys copied
+    size_t GetKeyStats(const char *partition, NVMKeyStats *keys, size_t max);
+
+    // Closes the cached handles of a partition, or of all partitions if
+    // partition is nullptr. Handles are reopened on the next access.
+    void InvalidateHandles(const char *partition = nullptr) noexcept;
+
 protected:
     esp_err_t EnsurePartitionReady(const char *partition_label);
 
 private:
+    friend class NVMTransaction;    // commits batches through the handle cache
+
     NVMWrapper() = default;
     ~NVMWrapper() = default;
 
+    struct HandleSlot
+    {
+        char            partition[NVS_PART_NAME_MAX_SIZE];
+        char            namespace_name[NVS_NS_NAME_MAX_SIZE];
+        nvs_open_mode_t mode;
+        nvs_handle_t    handle;
+        uint32_t        last_use;   // 0: slot free
+    };
+
+    // Lock and handle cache of one partition
+    struct PartitionState
+    {
+        std::mutex mutex;
+        HandleSlot handles[NVM_HANDLE_CACHE_SIZE]{};
+        uint32_t   use_clock = 0;
+    };
+
+    // State of a partition of NVM_PARTITION_LABELS; any other name shares
+    // the last one
+    PartitionState &Partition(const char *partition) noexcept;
+    // Cached handle for (partition, namespace, mode), opened on a miss by
+    // evicting the least recently used slot. part.mutex must be held.
+    esp_err_t OpenHandle(PartitionState &part, const char *partition, const char *namespace_name,
+                         nvs_open_mode_t mode, nvs_handle_t &handle);
+    // Passes err through; drops the cached handle if NVS no longer knows it
+    esp_err_t Release(PartitionState &part, nvs_handle_t handle, esp_err_t err) noexcept;
+    void CloseSlot(HandleSlot &slot) noexcept;
+
+    // Digest key of a string or blob above the compare caps
+    static void DigestKey(const char *key, char (&out)[NVS_KEY_NAME_MAX_SIZE]) noexcept;
+    static uint64_t ValueDigest(const char *key, const void *value, size_t size) noexcept;
+    // Erases the digest key of key, if any (before writing key some other way)
+    static esp_err_t DropDigest(nvs_handle_t handle, const char *key) noexcept;
+    // Writes and commits value unless its digest says it is stored already.
+    // same_size: key exists with a value of this size.
+    esp_err_t WriteDigested(const char *partition, nvs_handle_t handle, const char *key, bool is_string,
+                            const void *value, size_t size, bool same_size, bool &written);
+
+    PartitionState m_partitions[NVMStats::PARTITIONS + 1];
+    NVMStats       m_stats;
+
 }; // class NVMWrapper
 
 // Global instance of NVMWrapper
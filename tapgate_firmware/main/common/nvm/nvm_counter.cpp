@@ -0,0 +1,257 @@
+#include "nvm_counter.h"
+
+#include "esp_log.h"
+
+#include "crc32.h"
+
+#include <bit>
+#include <cstring>
+
+[[maybe_unused]] static const char* TAG = "NVMCounter";
+
+// Bitmap bytes read or written per flash access (stack)
+static constexpr size_t CHUNK_SIZE = 256;
+
+esp_err_t NVMCounter::Init(const char *partition_label) noexcept
+{
+    if (!partition_label)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_partition = nullptr;
+    m_created   = false;
+    m_uncertain = 0;
+
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (!partition)
+    {
+        ESP_LOGE(TAG, "Partition \"%s\" not found", partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (partition->erase_size != SECTOR_SIZE || partition->size / SECTOR_SIZE < 2)
+    {
+        ESP_LOGE(TAG, "Partition \"%s\" needs at least 2 sectors of %zu bytes", partition_label, SECTOR_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    m_partition = partition;
+    m_sectors   = partition->size / SECTOR_SIZE;
+
+    // Current sector: the valid header with the highest sequence
+    bool found = false;
+    for (size_t sector = 0; sector < m_sectors; ++sector)
+    {
+        Header header;
+        if (!ReadHeader(sector, header))
+            continue;
+        if (!found || header.sequence > m_sequence)
+        {
+            found      = true;
+            m_sector   = sector;
+            m_sequence = header.sequence;
+            m_base     = header.base;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (!found)
+    {
+        ESP_LOGW(TAG, "No counter in \"%s\", starting at 0", partition_label);
+        m_sector   = m_sectors - 1;     // Checkpoint() moves on to sector 0
+        m_sequence = 0;
+        m_cleared  = 0;
+        err = Checkpoint(0);
+        m_created = err == ESP_OK;
+    }
+    else
+    {
+        bool in_order = true;
+        err = ScanBitmap(m_cleared, in_order);
+        if (err == ESP_OK && !in_order)
+        {
+            ESP_LOGW(TAG, "Interrupted write in \"%s\" sector %zu, moving on", partition_label, m_sector);
+            err = Checkpoint(m_base + m_cleared);
+        }
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to mount \"%s\": " ERR_FORMAT, partition_label, esp_err_to_str(err), err);
+        m_partition = nullptr;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "\"%s\": value %llu (sector %zu, sequence %lu)", partition_label,
+             static_cast<unsigned long long>(m_base + m_cleared), m_sector,
+             static_cast<unsigned long>(m_sequence));
+    return ESP_OK;
+}
+
+esp_err_t NVMCounter::Add(uint32_t n, uint64_t *value) noexcept
+{
+    if (n == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_partition)
+        return ESP_ERR_INVALID_STATE;
+
+    // A failed write may have cleared bits past m_cleared, out of order:
+    // continue in a fresh sector above them
+    if (m_uncertain != 0)
+    {
+        const esp_err_t err = Checkpoint(m_base + m_cleared + m_uncertain);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    esp_err_t err;
+    if (n <= BITS_PER_SECTOR - m_cleared)
+    {
+        err = ClearBits(n);
+        if (err != ESP_OK)
+        {
+            m_uncertain = n;
+            return err;
+        }
+        m_cleared += n;
+    }
+    else
+    {
+        err = Checkpoint(m_base + m_cleared + n);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    if (value)
+        *value = m_base + m_cleared;
+    return ESP_OK;
+}
+
+uint64_t NVMCounter::Value() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_base + m_cleared;
+}
+
+// ---------------------------------------------------------------------------
+// Flash layout
+// ---------------------------------------------------------------------------
+
+uint32_t NVMCounter::HeaderCrc(const Header &header) noexcept
+{
+    return crc32_calculate(reinterpret_cast<const uint8_t*>(&header), offsetof(Header, crc));
+}
+
+bool NVMCounter::ReadHeader(size_t sector, Header &header) const noexcept
+{
+    if (esp_partition_read(m_partition, sector * SECTOR_SIZE, &header, sizeof(header)) != ESP_OK)
+        return false;
+    return header.magic == MAGIC && header.crc == HeaderCrc(header);
+}
+
+esp_err_t NVMCounter::ScanBitmap(uint32_t &cleared, bool &in_order) const noexcept
+{
+    // Add() clears bits from the start: 0x00 bytes, at most one partly
+    // cleared byte 0xFF << k, then 0xFF bytes
+    cleared  = 0;
+    in_order = true;
+    bool past_cleared = false;
+
+    const size_t begin = m_sector * SECTOR_SIZE + HEADER_SIZE;
+    const size_t end   = (m_sector + 1) * SECTOR_SIZE;
+    uint32_t chunk[CHUNK_SIZE / sizeof(uint32_t)];
+    for (size_t offset = begin; offset < end; offset += CHUNK_SIZE)
+    {
+        const size_t size = end - offset < CHUNK_SIZE ? end - offset : CHUNK_SIZE;
+        const esp_err_t err = esp_partition_read(m_partition, offset, chunk, size);
+        if (err != ESP_OK)
+            return err;
+
+        // Erased chunk past the cleared bits: nothing to count
+        const size_t words = size / sizeof(uint32_t);
+        size_t i = 0;
+        if (past_cleared)
+        {
+            while (i < words && chunk[i] == 0xFFFFFFFFu)
+                ++i;
+            if (i == words)
+                continue;
+        }
+
+        for (; i < words; ++i)
+        {
+            const uint32_t zeros = 32 - std::popcount(chunk[i]);
+            cleared += zeros;
+            if (zeros == 32)
+            {
+                in_order = in_order && !past_cleared;
+                continue;
+            }
+            if (past_cleared && zeros != 0)
+                in_order = false;
+            if (!past_cleared)
+            {
+                // The partly cleared word: its cleared bits must be the low ones
+                const uint32_t expected = zeros == 0 ? 0xFFFFFFFFu : 0xFFFFFFFFu << zeros;
+                in_order = in_order && chunk[i] == expected;
+                past_cleared = true;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t NVMCounter::ClearBits(uint32_t n) noexcept
+{
+    // Byte b of the bitmap holds bits [8b, 8b + 8); after the write the first
+    // `total` bits are cleared
+    const uint32_t total = m_cleared + n;
+    const size_t   first = m_cleared / 8;
+    const size_t   last  = (total - 1) / 8;
+
+    uint8_t chunk[CHUNK_SIZE];
+    for (size_t b = first; b <= last; b += CHUNK_SIZE)
+    {
+        const size_t size = last + 1 - b < CHUNK_SIZE ? last + 1 - b : CHUNK_SIZE;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const uint32_t bit = static_cast<uint32_t>((b + i) * 8);
+            const uint32_t clear = total - bit >= 8 ? 8 : total - bit;
+            chunk[i] = static_cast<uint8_t>(0xFFu << clear);
+        }
+        const esp_err_t err = esp_partition_write(m_partition,
+                                                  m_sector * SECTOR_SIZE + HEADER_SIZE + b,
+                                                  chunk, size);
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_OK;
+}
+
+esp_err_t NVMCounter::Checkpoint(uint64_t base) noexcept
+{
+    const size_t next = (m_sector + 1) % m_sectors;
+    esp_err_t err = esp_partition_erase_range(m_partition, next * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK)
+        return err;
+
+    Header header{};
+    header.magic    = MAGIC;
+    header.sequence = m_sequence + 1;
+    header.base     = base;
+    header.crc      = HeaderCrc(header);
+    header.reserved = 0xFFFFFFFFu;
+    err = esp_partition_write(m_partition, next * SECTOR_SIZE, &header, sizeof(header));
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGD(TAG, "%s sector %zu, sequence %lu, base %llu", __FUNCTION__, next,
+             static_cast<unsigned long>(header.sequence), static_cast<unsigned long long>(base));
+    m_sector    = next;
+    m_sequence  = header.sequence;
+    m_base      = base;
+    m_cleared   = 0;
+    m_uncertain = 0;
+    return ESP_OK;
+}
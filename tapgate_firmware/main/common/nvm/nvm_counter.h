@@ -0,0 +1,97 @@
+//
+// NVMCounter - monotonic counter on a raw flash partition
+//
+// NOR flash clears bits without an erase; only setting them back to 1 takes a
+// sector erase. The counter is kept in unary: an increment clears the next
+// bit of a bitmap, so a 4 KiB sector takes BITS_PER_SECTOR (32512) increments
+// between erases, where NVS spends a 32-byte entry on every u32 update.
+//
+// Sector layout (erase_size bytes):
+//   [0, 24)            header: magic, sequence, base, crc32
+//   [HEADER_SIZE, end) bitmap, bits cleared in order, LSB first
+//
+//   value = base + cleared bits of the current sector
+//
+// The current sector is the valid header with the highest sequence. When its
+// bitmap is full, or an Add() would overflow it, the value is checkpointed
+// into the next sector (round robin over the partition: A/B with two
+// sectors): that sector is erased and gets a header with sequence + 1 and
+// base = the new value. The previous sector stays current until the new
+// header is complete, so a reset at any point leaves the counter at least at
+// the last value Add() returned. Values may be skipped, never repeated.
+//
+// Init() reads the headers and popcounts the current bitmap. Bits left out
+// of order by an interrupted write are counted as well, and the counter moves
+// to a fresh sector straight away so later writes only ever clear bits.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "esp_partition.h"
+#include "device_err.h"
+
+class NVMCounter
+{
+public:
+    static constexpr uint32_t MAGIC           = 0x31434754;    // "TGC1"
+    static constexpr size_t   HEADER_SIZE     = 32;
+    static constexpr size_t   SECTOR_SIZE     = 4096;
+    static constexpr uint32_t BITS_PER_SECTOR = (SECTOR_SIZE - HEADER_SIZE) * 8;
+
+    NVMCounter() = default;
+    ~NVMCounter() = default;
+
+    NVMCounter(const NVMCounter&) = delete;
+    NVMCounter& operator=(const NVMCounter&) = delete;
+
+    // Mounts the counter of a data partition: at least two SECTOR_SIZE
+    // sectors. A partition without a counter gets one at 0 (Created()).
+    // ESP_ERR_NOT_FOUND: no such partition; ESP_ERR_INVALID_SIZE: too small.
+    esp_err_t Init(const char *partition_label) noexcept;
+
+    // Adds n (> 0) and returns the new value. On a flash error the value is
+    // unchanged; the bits the write may have cleared are skipped by the
+    // next Add().
+    esp_err_t Add(uint32_t n, uint64_t *value = nullptr) noexcept;
+    esp_err_t Increment(uint64_t *value = nullptr) noexcept { return Add(1, value); }
+
+    [[nodiscard]] uint64_t Value() const noexcept;
+    // Init() found no counter and created one
+    [[nodiscard]] bool Created() const noexcept { return m_created; }
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint64_t base;
+        uint32_t crc;
+        uint32_t reserved;      // 0xFFFFFFFF
+    };
+    static_assert(sizeof(Header) <= HEADER_SIZE);
+
+    static uint32_t HeaderCrc(const Header &header) noexcept;
+    bool ReadHeader(size_t sector, Header &header) const noexcept;
+
+    // Counts the cleared bits of the current sector; in_order: as Add() left them
+    esp_err_t ScanBitmap(uint32_t &cleared, bool &in_order) const noexcept;
+    // Clears bits [m_cleared, m_cleared + n) of the current sector
+    esp_err_t ClearBits(uint32_t n) noexcept;
+    // Erases the next sector and makes it current with the given base
+    esp_err_t Checkpoint(uint64_t base) noexcept;
+
+    mutable std::mutex     m_mutex;
+    const esp_partition_t *m_partition = nullptr;
+    size_t                 m_sectors   = 0;
+    size_t                 m_sector    = 0;     // current sector
+    uint32_t               m_sequence  = 0;
+    uint64_t               m_base      = 0;
+    uint32_t               m_cleared   = 0;     // bits cleared in the current sector
+    uint32_t               m_uncertain = 0;     // bits a failed write may have cleared
+    bool                   m_created   = false;
+
+}; // class NVMCounter
@@ -10,6 +10,9 @@ constexpr const char* NVM_PARTITION_NONCE   = "nvs_nonce";
 // Aliases
 constexpr const char* NVM_PARTITION_CTXDEVICE = NVM_PARTITION_ENTITY;
 
+// Raw data partition of the unary counter (NVMCounter, nvm_counter.h); not NVS
+constexpr const char* NVM_PARTITION_COUNTER = "nonce_ctr";
+
 // Table of all NVM partition labels
 constexpr const char* NVM_PARTITION_LABELS[] = {
     NVM_PARTITION_DEFAULT,
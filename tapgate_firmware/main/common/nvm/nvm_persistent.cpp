@@ -0,0 +1,81 @@
+#include "nvm_persistent.h"
+#include "nvm.h"
+#include "nvm_writer.h"
+
+#include "esp_log.h"
+
+[[maybe_unused]] static const char* TAG = "Persistent";
+
+static_assert(std::is_same_v<NVMWriter::Token, uint32_t>, "Persistent keeps NVMWriter tokens as uint32_t");
+
+esp_err_t nvm_persistent_read(const char *partition, const char *namespace_name, const char *key,
+                              NVMStorage storage, void *value, size_t size) noexcept
+{
+    if (storage == NVMStorage::SLOT_RECORD)
+    {
+        NVMSlotRecord record(partition, namespace_name, key);
+        return record.Load(value, size);
+    }
+    return NVM.ReadBlob(partition, namespace_name, key, value, size);
+}
+
+esp_err_t nvm_persistent_write(const char *partition, const char *namespace_name, const char *key,
+                               NVMStorage storage, const void *value, size_t size) noexcept
+{
+    esp_err_t err;
+    if (storage == NVMStorage::SLOT_RECORD)
+    {
+        NVMSlotRecord record(partition, namespace_name, key);
+        err = record.Store(value, size);
+    }
+    else
+    {
+        err = NVM.WriteBlob(partition, namespace_name, key, value, size);
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to store %s/%s: " ERR_FORMAT, namespace_name, key, esp_err_to_str(err), err);
+    }
+    return err;
+}
+
+esp_err_t nvm_persistent_queue(const char *partition, const char *namespace_name, const char *key,
+                               NVMStorage storage, const void *value, size_t size,
+                               uint32_t *token) noexcept
+{
+    *token = 0;
+    esp_err_t err;
+    if (storage == NVMStorage::SLOT_RECORD)
+    {
+        NVMSlotRecord record(partition, namespace_name, key);
+        err = record.Queue(value, size, token);
+    }
+    else
+    {
+        err = NVMAsync.WriteBlob(partition, namespace_name, key, value, size, token);
+    }
+
+    // Queue full, or a value above NVMWriter::VALUE_CAP: stored here instead
+    if (err == ESP_ERR_NO_MEM || err == ESP_ERR_INVALID_SIZE)
+    {
+        ESP_LOGW(TAG, "Cannot queue %s/%s (" ERR_FORMAT "), storing it now", namespace_name, key,
+                 esp_err_to_str(err), err);
+        *token = 0;
+        return nvm_persistent_write(partition, namespace_name, key, storage, value, size);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to queue %s/%s: " ERR_FORMAT, namespace_name, key, esp_err_to_str(err), err);
+    }
+    return err;
+}
+
+esp_err_t nvm_persistent_settle(uint32_t token, bool wait) noexcept
+{
+    const esp_err_t err = NVMAsync.Status(token);
+    if (err != ESP_ERR_NOT_FINISHED || !wait)
+        return err;
+    (void)NVMAsync.Flush();
+    return NVMAsync.Status(token);
+}
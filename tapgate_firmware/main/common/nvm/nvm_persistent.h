@@ -0,0 +1,337 @@
+//
+// Persistent<T, Key> - a RAM copy of one NVS value with deferred write-back
+//
+// Holds a trivially copyable T in RAM and stores it as one value described by
+// Key. Reads never touch NVS. A change marks the copy dirty; when it is
+// stored depends on the change:
+//
+//   NVMPersist::DEFERRED   stored by Poll() once no further change came for
+//                          Key::write_delay_ms, so a burst of changes (an
+//                          admin panel tweaking settings) costs one write
+//   NVMPersist::NOW        stored before Set()/Update() returns, together
+//                          with any deferred change still pending. Also when
+//                          nothing changed: the value is then in NVS either way
+//
+// Key describes where and how T is stored:
+//
+//   struct SettingsKey
+//   {
+//       static constexpr const char *partition      = NVM_PARTITION_DEFAULT;
+//       static constexpr char        namespace_name[] = "Settings";
+//       static constexpr char        key[]            = "Panel";
+//       static constexpr NVMStorage  storage          = NVMStorage::BLOB;
+//       static constexpr uint32_t    write_delay_ms   = 2000;
+//       static constexpr bool        queued           = true;    // optional
+//   };
+//   Persistent<settings_t, SettingsKey> settings;
+//
+//   err = settings.Load();
+//   err = settings.Update([&](settings_t &s) { s.volume = v; return NVMPersist::DEFERRED; });
+//   ...
+//   err = settings.Poll();             // periodically, e.g. from the main loop
+//   err = settings.Flush();            // before a restart
+//
+// NVMStorage::BLOB stores T as a plain blob through NVMWrapper;
+// NVMStorage::SLOT_RECORD as an NVMSlotRecord (nvm_slot_record.h), which
+// survives a damaged write and needs room for a slot suffix in the key
+// (NVMSlotRecord::KEY_MAX_LEN).
+// T must be trivially copyable and without padding: it is stored and compared
+// as raw bytes. Key names and sizes are checked at compile time.
+//
+// A change that leaves the value as it was does not make it dirty. A failed
+// store keeps the value dirty; Poll() retries it write_delay_ms later. A
+// change made while a store is in progress stays dirty for the next one.
+//
+// Key::queued (default false) hands the stores of Poll() to NVMAsync
+// (nvm_writer.h), so a deferred change never waits for NVS in the polling
+// task. The value counts as stored once queued; if the queued write fails it
+// is dirty again. Poll() queues nothing while the previous write is still
+// queued, since NVS still holds the value before it; NOW changes, Flush() and
+// Load() store that write first with NVMAsync.Flush(). A value the queue
+// cannot take (full, above NVMWriter::VALUE_CAP) is stored at once.
+//
+// Reads take no lock: the RAM copy is a DoubleBuffer (double_buffer.h).
+// Pin() returns a View, an immutable snapshot read in place; Get(), Read()
+// and ReadBytes() pin for the duration of the call. Changes are serialized by
+// a mutex, and so are stores; a change waits for Views of the snapshot it is
+// about to overwrite, so do not hold a View across a change. That wait lasts
+// as long as the oldest View and holds up other changes only: the dirty state
+// has a mutex of its own that is never held across it, so Dirty() and Poll()
+// do not wait for Views, nor do stores unless a Load() is publishing. No heap.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+#include "nvs.h"
+#include "device_err.h"
+#include "nvm_slot_record.h"
+#include "double_buffer.h"
+
+// When a change is stored
+enum class NVMPersist : uint8_t
+{
+    DEFERRED,
+    NOW,
+};
+
+// How a Persistent value is kept in NVS
+enum class NVMStorage : uint8_t
+{
+    BLOB,
+    SLOT_RECORD,
+};
+
+// Reads / stores size bytes as one value (nvm_persistent.cpp); shared by all
+// Persistent instantiations
+esp_err_t nvm_persistent_read(const char *partition, const char *namespace_name, const char *key,
+                              NVMStorage storage, void *value, size_t size) noexcept;
+esp_err_t nvm_persistent_write(const char *partition, const char *namespace_name, const char *key,
+                               NVMStorage storage, const void *value, size_t size) noexcept;
+// Queues the write through NVMAsync; token (an NVMWriter::Token) is 0 if
+// nothing was queued: value already stored, or stored at once because the
+// queue cannot take it
+esp_err_t nvm_persistent_queue(const char *partition, const char *namespace_name, const char *key,
+                               NVMStorage storage, const void *value, size_t size,
+                               uint32_t *token) noexcept;
+// NVMAsync.Status() of a queued write; wait: NVMAsync.Flush() first if it is
+// still queued
+esp_err_t nvm_persistent_settle(uint32_t token, bool wait) noexcept;
+
+template <typename T, typename Key>
+class Persistent
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Persistent<T>: T is stored as raw bytes and must be trivially copyable");
+    static_assert(std::has_unique_object_representations_v<T>,
+                  "Persistent<T>: T has padding (or floating point) bytes; they would be stored and compared");
+
+    static constexpr bool SLOT_RECORD = Key::storage == NVMStorage::SLOT_RECORD;
+    static constexpr bool QUEUED      = [] {
+        if constexpr (requires { Key::queued; })
+            return static_cast<bool>(Key::queued);
+        else
+            return false;
+    }();
+    static constexpr size_t KEY_LEN   = std::char_traits<char>::length(Key::key);
+    static constexpr size_t NS_LEN    = std::char_traits<char>::length(Key::namespace_name);
+
+    static_assert(KEY_LEN > 0 && KEY_LEN <= NVS_KEY_NAME_MAX_SIZE - 1,
+                  "Persistent: NVS key names are 1 to 15 characters");
+    static_assert(!SLOT_RECORD || KEY_LEN <= NVMSlotRecord::KEY_MAX_LEN,
+                  "Persistent: slot record keys are at most NVMSlotRecord::KEY_MAX_LEN characters (room for the \".a\" / \".b\" suffix)");
+    static_assert(NS_LEN > 0 && NS_LEN <= NVS_NS_NAME_MAX_SIZE - 1,
+                  "Persistent: NVS namespace names are 1 to 15 characters");
+    static_assert(!SLOT_RECORD || sizeof(T) <= NVMSlotRecord::MAX_PAYLOAD,
+                  "Persistent: T does not fit an NVMSlotRecord");
+
+public:
+    static constexpr uint32_t WRITE_DELAY_MS = Key::write_delay_ms;
+
+    using View = typename DoubleBuffer<T>::View;
+
+    Persistent() = default;
+    ~Persistent() = default;
+
+    Persistent(const Persistent&) = delete;
+    Persistent& operator=(const Persistent&) = delete;
+
+    // Replaces the RAM copy with the stored value and drops a pending change.
+    // On error (ESP_ERR_NVS_NOT_FOUND if nothing is stored) the copy is kept.
+    [[nodiscard]] esp_err_t Load() noexcept
+    {
+        std::lock_guard<std::mutex> store_lock(m_store_mutex);
+        (void)Settle(NowMs(), true);
+        T value{};
+        const esp_err_t err = nvm_persistent_read(Key::partition, Key::namespace_name, Key::key,
+                                                  Key::storage, &value, sizeof(T));
+        if (err != ESP_OK)
+            return err;
+
+        std::lock_guard<std::mutex> change_lock(m_change_mutex);
+        m_value.Store(value);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dirty = false;
+        ++m_generation;
+        return ESP_OK;
+    }
+
+    [[nodiscard]] T Get() const noexcept
+    {
+        return m_value.Load();
+    }
+
+    // Snapshot of the value, valid and unchanged while the View lives
+    [[nodiscard]] View Pin() const noexcept
+    {
+        return m_value.Pin();
+    }
+
+    // Calls fn(const T&) on a snapshot, without copying; returns its result
+    template <typename F>
+    decltype(auto) Read(F &&fn) const noexcept
+    {
+        const View view = m_value.Pin();
+        return fn(*view);
+    }
+
+    // Copies size bytes at offset (offsetof(T, field)) of the value, without
+    // copying the rest
+    void ReadBytes(size_t offset, void *out, size_t size) const noexcept
+    {
+        m_value.LoadBytes(offset, out, size);
+    }
+
+    esp_err_t Set(const T &value, NVMPersist when, int64_t now_ms = NowMs()) noexcept
+    {
+        return Update([&](T &v) { v = value; return when; }, now_ms);
+    }
+
+    // Calls fn(T&) under the change lock; fn changes the value and returns
+    // when the change is to be stored
+    template <typename F>
+    esp_err_t Update(F &&fn, int64_t now_ms = NowMs()) noexcept
+    {
+        NVMPersist when;
+        {
+            std::lock_guard<std::mutex> change_lock(m_change_mutex);
+            const T before = m_value.Load();
+            T value = before;
+            when = fn(value);
+            if (std::memcmp(&before, &value, sizeof(T)) != 0)
+            {
+                // May wait for Views; published before it is marked dirty, so
+                // a store copying it meanwhile leaves it dirty
+                m_value.Store(value);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_dirty      = true;
+                m_changed_ms = now_ms;
+                ++m_generation;
+            }
+        }
+        return when == NVMPersist::NOW ? Store(now_ms, true) : ESP_OK;
+    }
+
+    // Stores a pending change once it is write_delay_ms old
+    esp_err_t Poll(int64_t now_ms = NowMs()) noexcept
+    {
+        {
+            // A queued write is settled even if nothing changed since
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_token == 0 && (!m_dirty || now_ms - m_changed_ms < static_cast<int64_t>(WRITE_DELAY_MS)))
+                return ESP_OK;
+        }
+        return Store(now_ms, false, QUEUED);
+    }
+
+    // Stores a pending change now
+    esp_err_t Flush() noexcept
+    {
+        return Store(NowMs(), false);
+    }
+
+    [[nodiscard]] bool Dirty() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dirty;
+    }
+
+    static int64_t NowMs() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    // force: store a clean value as well. NVMWrapper and NVMSlotRecord skip
+    // the write if NVS holds it already. queue: through NVMAsync.
+    esp_err_t Store(int64_t now_ms, bool force, bool queue = false) noexcept
+    {
+        std::lock_guard<std::mutex> store_lock(m_store_mutex);
+        // Queued: retried write_delay_ms after a failed write, like a store
+        const esp_err_t settle_err = Settle(now_ms, !queue);
+        if (queue && settle_err == ESP_ERR_NOT_FINISHED)
+            return ESP_OK;
+        if (queue && settle_err != ESP_OK)
+            return settle_err;
+
+        T        value;
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_dirty && !force)
+                return ESP_OK;
+            if (queue && now_ms - m_changed_ms < static_cast<int64_t>(WRITE_DELAY_MS))
+                return ESP_OK;
+            value      = m_value.Load();
+            generation = m_generation;
+        }
+
+        uint32_t token = 0;
+        const esp_err_t err = queue ? nvm_persistent_queue(Key::partition, Key::namespace_name, Key::key,
+                                                           Key::storage, &value, sizeof(T), &token)
+                                    : nvm_persistent_write(Key::partition, Key::namespace_name, Key::key,
+                                                           Key::storage, &value, sizeof(T));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_token = token;
+        if (err != ESP_OK)
+        {
+            // Poll() retries after another delay
+            m_changed_ms = now_ms;
+            return err;
+        }
+        if (generation == m_generation)
+            m_dirty = false;
+        return ESP_OK;
+    }
+
+    // Outcome of the write queued last; m_store_mutex must be held. wait:
+    // store it now if still queued, else ESP_ERR_NOT_FINISHED. A failed write
+    // makes the value dirty again and is returned.
+    esp_err_t Settle(int64_t now_ms, bool wait) noexcept
+    {
+        uint32_t token;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            token = m_token;
+        }
+        if (token == 0)
+            return ESP_OK;
+
+        const esp_err_t err = nvm_persistent_settle(token, wait);
+        if (err == ESP_ERR_NOT_FINISHED)
+            return err;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_token = 0;
+        if (err != ESP_OK)
+        {
+            // ESP_ERR_NOT_FOUND: failed, and the error is no longer known
+            m_dirty      = true;
+            m_changed_ms = now_ms;
+        }
+        return err;
+    }
+
+    // Serializes changes and Load(): publishing to m_value
+    std::mutex         m_change_mutex;
+    // Guards the dirty state; never held while publishing
+    mutable std::mutex m_mutex;
+    // Serializes Load() and stores: the value copied last is stored last
+    std::mutex         m_store_mutex;
+
+    DoubleBuffer<T> m_value;
+    bool            m_dirty      = false;
+    int64_t         m_changed_ms = 0;   // last change, or last failed store
+    uint32_t        m_generation = 0;   // counts changes; a store clears m_dirty only if unchanged
+    uint32_t        m_token      = 0;   // QUEUED: NVMWriter::Token of the write queued last
+
+}; // class Persistent
@@ -0,0 +1,218 @@
+#include "nvm_slot_record.h"
+#include "nvm.h"
+#include "nvm_writer.h"
+
+#include "esp_log.h"
+
+#include "crc32.h"
+
+#include <cstdio>
+#include <cstring>
+
+[[maybe_unused]] static const char* TAG = "NVMSlotRecord";
+
+NVMSlotRecord::NVMSlotRecord(const char *partition, const char *namespace_name, const char *key) noexcept
+    : m_partition(partition)
+    , m_namespace(namespace_name)
+    , m_key(key)
+{
+}
+
+esp_err_t NVMSlotRecord::CheckArgs(const void *payload, size_t size) const noexcept
+{
+    if (!m_partition || !m_namespace || !m_key || m_key[0] == '\0' || !payload || size == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (std::strlen(m_key) > KEY_MAX_LEN)
+        return ESP_ERR_INVALID_ARG;
+    if (size > MAX_PAYLOAD)
+        return ESP_ERR_INVALID_SIZE;
+    return ESP_OK;
+}
+
+void NVMSlotRecord::SlotKey(size_t slot, char (&out)[NVS_KEY_NAME_MAX_SIZE]) const noexcept
+{
+    std::snprintf(out, sizeof(out), "%s.%c", m_key, static_cast<char>('a' + slot));
+}
+
+bool NVMSlotRecord::Valid(const uint8_t *image, size_t size) noexcept
+{
+    Header header;
+    std::memcpy(&header, image, sizeof(header));
+    if (header.size != size || header.format != FORMAT)
+        return false;
+
+    uint32_t crc = 0;
+    std::memcpy(&crc, image + sizeof(Header) + size, sizeof(crc));
+    return crc == crc32_calculate(image, sizeof(Header) + size);
+}
+
+bool NVMSlotRecord::Newer(uint32_t a, uint32_t b) noexcept
+{
+    return static_cast<int32_t>(a - b) > 0;
+}
+
+esp_err_t NVMSlotRecord::Scan(size_t size, Image &image, size_t &newest, bool &found) noexcept
+{
+    const size_t image_size = sizeof(Header) + size + CRC_SIZE;
+    newest = SLOTS;
+    found  = false;
+
+    // One image buffer: the newest slot is read again if a later one was not
+    uint32_t newest_version = 0;
+    bool     in_image       = false;
+    for (size_t slot = 0; slot < SLOTS; ++slot)
+    {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        SlotKey(slot, key);
+        std::memset(image, 0xFF, image_size);
+        const esp_err_t err = NVM.ReadBlob(m_partition, m_namespace, key, image, image_size);
+        in_image = false;
+        if (err == ESP_ERR_NVS_NOT_FOUND)
+            continue;
+        found = true;
+        // Another size or type: a slot of no use to this record
+        if (err == ESP_ERR_INVALID_SIZE || err == ESP_ERR_NVS_INVALID_LENGTH || err == ESP_ERR_NVS_TYPE_MISMATCH)
+        {
+            ESP_LOGW(TAG, "Slot %s/%s does not fit the record: " ERR_FORMAT, m_namespace, key,
+                     esp_err_to_str(err), err);
+            continue;
+        }
+        if (err != ESP_OK)
+            return err;
+        if (!Valid(image, size))
+        {
+            ESP_LOGW(TAG, "Slot %s/%s is damaged, passed over", m_namespace, key);
+            continue;
+        }
+
+        Header header;
+        std::memcpy(&header, image, sizeof(header));
+        if (newest == SLOTS || Newer(header.version, newest_version))
+        {
+            newest         = slot;
+            newest_version = header.version;
+            in_image       = true;
+        }
+    }
+
+    if (newest != SLOTS && !in_image)
+    {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        SlotKey(newest, key);
+        const esp_err_t err = NVM.ReadBlob(m_partition, m_namespace, key, image, image_size);
+        if (err != ESP_OK)
+            return err;
+        // Changed in between: the caller sees it as damaged
+        if (!Valid(image, size))
+            newest = SLOTS;
+    }
+    return ESP_OK;
+}
+
+esp_err_t NVMSlotRecord::Load(void *payload, size_t size) noexcept
+{
+    esp_err_t err = CheckArgs(payload, size);
+    if (err != ESP_OK)
+        return err;
+
+    Image image;
+    size_t newest = SLOTS;
+    bool found = false;
+    err = Scan(size, image, newest, found);
+    if (err != ESP_OK)
+        return err;
+    if (newest == SLOTS)
+        return found ? ESP_ERR_INVALID_CRC : ESP_ERR_NVS_NOT_FOUND;
+
+    Header header;
+    std::memcpy(&header, image, sizeof(header));
+    std::memcpy(payload, image + sizeof(Header), size);
+    m_version = header.version;
+    return ESP_OK;
+}
+
+esp_err_t NVMSlotRecord::Store(const void *payload, size_t size) noexcept
+{
+    return Write(payload, size, nullptr);
+}
+
+esp_err_t NVMSlotRecord::Queue(const void *payload, size_t size, uint32_t *token) noexcept
+{
+    if (!token)
+        return ESP_ERR_INVALID_ARG;
+    *token = 0;
+    return Write(payload, size, token);
+}
+
+esp_err_t NVMSlotRecord::Write(const void *payload, size_t size, uint32_t *token) noexcept
+{
+    esp_err_t err = CheckArgs(payload, size);
+    if (err != ESP_OK)
+        return err;
+
+    Image image;
+    size_t newest = SLOTS;
+    bool found = false;
+    err = Scan(size, image, newest, found);
+    if (err != ESP_OK)
+        return err;
+
+    Header header{};
+    if (newest != SLOTS)
+    {
+        std::memcpy(&header, image, sizeof(header));
+        if (std::memcmp(image + sizeof(Header), payload, size) == 0)
+        {
+            ESP_LOGD(TAG, "%s %s/%s version %lu already stored", __FUNCTION__, m_namespace, m_key,
+                     static_cast<unsigned long>(header.version));
+            m_version = header.version;
+            return ESP_OK;
+        }
+    }
+
+    // The other slot keeps the newest valid version until this one is stored
+    const size_t slot = newest == SLOTS ? 0 : 1 - newest;
+    header.version = newest == SLOTS ? 1 : header.version + 1;
+    if (header.version == 0)
+        header.version = 1;
+    header.size   = static_cast<uint16_t>(size);
+    header.format = FORMAT;
+
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + sizeof(Header), payload, size);
+    const uint32_t crc = crc32_calculate(image, sizeof(Header) + size);
+    std::memcpy(image + sizeof(Header) + size, &crc, sizeof(crc));
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    SlotKey(slot, key);
+    const size_t image_size = sizeof(Header) + size + CRC_SIZE;
+    err = token ? NVMAsync.WriteBlob(m_partition, m_namespace, key, image, image_size, token)
+                : NVM.WriteBlob(m_partition, m_namespace, key, image, image_size);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to %s %s/%s: " ERR_FORMAT, token ? "queue" : "store", m_namespace, key,
+                 esp_err_to_str(err), err);
+        return err;
+    }
+    m_version = header.version;
+    ESP_LOGD(TAG, "%s %s/%s version %lu%s", __FUNCTION__, m_namespace, key,
+             static_cast<unsigned long>(header.version), token ? " queued" : "");
+    return ESP_OK;
+}
+
+esp_err_t NVMSlotRecord::Erase() noexcept
+{
+    if (!m_partition || !m_namespace || !m_key || std::strlen(m_key) > KEY_MAX_LEN)
+        return ESP_ERR_INVALID_ARG;
+
+    for (size_t slot = 0; slot < SLOTS; ++slot)
+    {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        SlotKey(slot, key);
+        const esp_err_t err = NVM.EraseKey(m_partition, m_namespace, key);
+        if (err != ESP_OK)
+            return err;
+    }
+    m_version = 0;
+    return ESP_OK;
+}
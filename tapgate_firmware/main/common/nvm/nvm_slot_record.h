@@ -0,0 +1,111 @@
+//
+// NVMSlotRecord - a fixed-size record in two alternating NVS slots
+//
+// A record is kept in two blob keys of its namespace, "<key>.a" and
+// "<key>.b". Each holds one version of the record:
+//
+//   version (u32) | size (u16) | format (u16) | payload (size bytes) | CRC-32
+//
+// The CRC-32 covers everything before it. Store() writes the slot that does
+// not hold the newest valid version, with the next version number, so the
+// previous version stays intact until the new one is stored. Load() reads
+// both slots and returns the payload of the newest one whose CRC, size and
+// format check out. A slot that is damaged, was cut short or holds a payload
+// of another size is passed over and the previous version is returned.
+//
+//   device_entity_t entity;
+//   NVMSlotRecord record(NVM_PARTITION_ENTITY, "CtxDevice", "Entity");
+//   err = record.Load(&entity, sizeof(entity));
+//   ...
+//   err = record.Store(&entity, sizeof(entity));
+//
+// DeviceContext keeps its entity this way; client records (client_entity_t)
+// fit the same format, one record per client key.
+//
+// Store() of the payload already held by the newest slot writes nothing.
+// Version numbers wrap around; slots are compared by serial number
+// arithmetic, so the newer of two slots is always the one written last.
+// Through NVMWrapper, so values are compared before they are written and
+// the writes are counted in its telemetry. An object holds no state beyond
+// the version last loaded or stored: construct one per call, from any task.
+// Concurrent Store() calls on the same record must be serialized by the
+// caller, like any NVS write of one key. No heap.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "nvs.h"
+#include "device_err.h"
+
+class NVMSlotRecord
+{
+public:
+    static constexpr size_t   MAX_PAYLOAD = 240;
+    // Key names leave room for the ".a" / ".b" slot suffix
+    static constexpr size_t   KEY_MAX_LEN = NVS_KEY_NAME_MAX_SIZE - 3;
+    static constexpr uint16_t FORMAT      = 1;
+
+    NVMSlotRecord(const char *partition, const char *namespace_name, const char *key) noexcept;
+    ~NVMSlotRecord() = default;
+
+    NVMSlotRecord(const NVMSlotRecord&) = delete;
+    NVMSlotRecord& operator=(const NVMSlotRecord&) = delete;
+
+    // Copies the newest valid payload of size bytes. ESP_ERR_NVS_NOT_FOUND if
+    // neither slot exists, ESP_ERR_INVALID_CRC if slots exist but none is
+    // valid; payload is left untouched on any error.
+    [[nodiscard]] esp_err_t Load(void *payload, size_t size) noexcept;
+
+    // Stores payload as the next version. On error the newest valid version
+    // is still the previous one.
+    [[nodiscard]] esp_err_t Store(const void *payload, size_t size) noexcept;
+
+    // Store() through NVMAsync: the slot is chosen and its image built here,
+    // the blob write is queued. token receives its NVMWriter::Token, 0 if the
+    // newest slot holds payload already. Until the token completes the record
+    // reads back as the previous version: wait for it before the next Store()
+    // or Queue() of the record, or both would pick the same slot.
+    [[nodiscard]] esp_err_t Queue(const void *payload, size_t size, uint32_t *token) noexcept;
+
+    // Erases both slots
+    [[nodiscard]] esp_err_t Erase() noexcept;
+
+    // Version of the last Load(), Store() or Queue(); 0 before one succeeded
+    [[nodiscard]] uint32_t Version() const noexcept { return m_version; }
+
+private:
+    struct Header
+    {
+        uint32_t version;
+        uint16_t size;
+        uint16_t format;
+    };
+    static_assert(sizeof(Header) == 8, "slot header layout");
+
+    static constexpr size_t SLOTS          = 2;
+    static constexpr size_t CRC_SIZE       = sizeof(uint32_t);
+    static constexpr size_t MAX_IMAGE_SIZE = sizeof(Header) + MAX_PAYLOAD + CRC_SIZE;
+
+    // Image of a slot: header, payload, CRC
+    using Image = uint8_t[MAX_IMAGE_SIZE];
+
+    // Reads both slots. newest: index of the newest valid slot, or SLOTS if
+    // none; its image is left in image. ESP_OK also when no slot is valid;
+    // found tells whether any slot exists.
+    esp_err_t Scan(size_t size, Image &image, size_t &newest, bool &found) noexcept;
+    void SlotKey(size_t slot, char (&out)[NVS_KEY_NAME_MAX_SIZE]) const noexcept;
+    static bool Valid(const uint8_t *image, size_t size) noexcept;
+    static bool Newer(uint32_t a, uint32_t b) noexcept;
+    esp_err_t CheckArgs(const void *payload, size_t size) const noexcept;
+    // Store() and Queue(); token: queue the write
+    esp_err_t Write(const void *payload, size_t size, uint32_t *token) noexcept;
+
+    const char *m_partition;
+    const char *m_namespace;
+    const char *m_key;
+    uint32_t    m_version = 0;
+
+}; // class NVMSlotRecord
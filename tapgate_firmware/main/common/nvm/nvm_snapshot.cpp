@@ -0,0 +1,174 @@
+#include "nvm_snapshot.h"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+[[maybe_unused]] static const char* TAG = "NVM";
+
+NVMSnapshot::NVMSnapshot(void *arena, size_t size) noexcept
+    : m_arena(static_cast<uint8_t*>(arena))
+    , m_size(arena ? size : 0)
+{
+    // The key table sits at the aligned end of the arena
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(m_arena);
+    uintptr_t end = (begin + m_size) & ~static_cast<uintptr_t>(alignof(Entry) - 1);
+    if (end < begin)
+        end = begin;
+    m_table_end = reinterpret_cast<Entry*>(end);
+}
+
+// ---------------------------------------------------------------------------
+// Lookup
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMSnapshot::GetU8(const char *key, uint8_t *value) const noexcept
+{
+    return Get(key, NVS_TYPE_U8, value, sizeof(*value));
+}
+
+esp_err_t NVMSnapshot::GetU32(const char *key, uint32_t *value) const noexcept
+{
+    return Get(key, NVS_TYPE_U32, value, sizeof(*value));
+}
+
+esp_err_t NVMSnapshot::GetU64(const char *key, uint64_t *value) const noexcept
+{
+    return Get(key, NVS_TYPE_U64, value, sizeof(*value));
+}
+
+esp_err_t NVMSnapshot::GetString(const char *key, char *buffer, size_t size) const noexcept
+{
+    if (!buffer || size == 0)
+        return ESP_ERR_INVALID_ARG;
+    buffer[0] = '\0';
+    return Get(key, NVS_TYPE_STR, buffer, size);
+}
+
+esp_err_t NVMSnapshot::GetBlob(const char *key, void *buffer, size_t size) const noexcept
+{
+    if (!buffer || size == 0)
+        return ESP_ERR_INVALID_ARG;
+    return Get(key, NVS_TYPE_BLOB, buffer, size);
+}
+
+const char* NVMSnapshot::Key(size_t index) const noexcept
+{
+    if (index >= m_count)
+        return nullptr;
+    return (m_table_end - m_count)[index].key;
+}
+
+size_t NVMSnapshot::Used() const noexcept
+{
+    return m_used + m_count * sizeof(Entry);
+}
+
+const NVMSnapshot::Entry* NVMSnapshot::Find(const char *key, nvs_type_t type) const noexcept
+{
+    const Entry *const first = m_table_end - m_count;
+    const Entry *const last  = m_table_end;
+    const Entry *const it = std::lower_bound(first, last, key,
+        [](const Entry &e, const char *k) { return std::strcmp(e.key, k) < 0; });
+    if (it == last || std::strcmp(it->key, key) != 0 || it->type != type)
+        return nullptr;
+    return it;
+}
+
+esp_err_t NVMSnapshot::Get(const char *key, nvs_type_t type, void *out, size_t size) const noexcept
+{
+    if (!key || !out)
+        return ESP_ERR_INVALID_ARG;
+
+    const Entry *const e = Find(key, type);
+    if (!e)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (size < e->size)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    std::memcpy(out, m_arena + e->offset, e->size);
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Loading (NVMWrapper::LoadNamespace)
+// ---------------------------------------------------------------------------
+
+void NVMSnapshot::Clear() noexcept
+{
+    m_used  = 0;
+    m_count = 0;
+}
+
+esp_err_t NVMSnapshot::Append(nvs_handle_t handle, const nvs_entry_info_t &info) noexcept
+{
+    // Room left between the values and the table grown by one entry
+    const uintptr_t values_end = reinterpret_cast<uintptr_t>(m_arena) + m_used;
+    const uintptr_t table      = reinterpret_cast<uintptr_t>(m_table_end - m_count);
+    if (table < values_end + sizeof(Entry))
+        return ESP_ERR_NO_MEM;
+    const size_t free = table - sizeof(Entry) - values_end;
+
+    uint8_t *const dst = m_arena + m_used;
+    size_t size = 0;
+    esp_err_t err = ESP_OK;
+    switch (info.type)
+    {
+        case NVS_TYPE_U8:
+            size = sizeof(uint8_t);
+            if (free < size)
+                return ESP_ERR_NO_MEM;
+            err = nvs_get_u8(handle, info.key, dst);
+            break;
+        case NVS_TYPE_U32:
+        {
+            uint32_t value = 0;
+            size = sizeof(value);
+            if (free < size)
+                return ESP_ERR_NO_MEM;
+            err = nvs_get_u32(handle, info.key, &value);
+            std::memcpy(dst, &value, size);
+            break;
+        }
+        case NVS_TYPE_U64:
+        {
+            uint64_t value = 0;
+            size = sizeof(value);
+            if (free < size)
+                return ESP_ERR_NO_MEM;
+            err = nvs_get_u64(handle, info.key, &value);
+            std::memcpy(dst, &value, size);
+            break;
+        }
+        case NVS_TYPE_STR:
+        case NVS_TYPE_BLOB:
+            // Read straight into the free space: one NVS call, no size query
+            size = free;
+            err = info.type == NVS_TYPE_STR ? nvs_get_str(handle, info.key, reinterpret_cast<char*>(dst), &size)
+                                            : nvs_get_blob(handle, info.key, dst, &size);
+            if (err == ESP_ERR_NVS_INVALID_LENGTH)
+                return ESP_ERR_NO_MEM;
+            break;
+        default:
+            ESP_LOGD(TAG, "%s key %s: type 0x%02x not loaded", __FUNCTION__, info.key, info.type);
+            return ESP_OK;
+    }
+    if (err != ESP_OK)
+        return err;
+
+    Entry &e = *(m_table_end - m_count - 1);
+    std::memcpy(e.key, info.key, sizeof(e.key));
+    e.key[sizeof(e.key) - 1] = '\0';
+    e.type   = info.type;
+    e.offset = static_cast<uint32_t>(m_used);
+    e.size   = static_cast<uint32_t>(size);
+    m_used += size;
+    ++m_count;
+    return ESP_OK;
+}
+
+void NVMSnapshot::Seal() noexcept
+{
+    std::sort(m_table_end - m_count, m_table_end,
+              [](const Entry &a, const Entry &b) { return std::strcmp(a.key, b.key) < 0; });
+}
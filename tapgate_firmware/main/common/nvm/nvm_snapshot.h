@@ -0,0 +1,87 @@
+//
+// NVMSnapshot - an NVS namespace read into RAM in one pass
+//
+// NVMWrapper::LoadNamespace() walks a namespace once with nvs_entry_find() /
+// nvs_entry_next() and copies every key and value into an arena supplied by
+// the caller. The keys are sorted, so lookups afterwards are a binary search
+// in RAM instead of an NVS call each:
+//
+//   static uint8_t arena[4096];
+//   NVMSnapshot snapshot(arena, sizeof(arena));
+//   err = NVM.LoadNamespace(NVM_PARTITION_DEFAULT, "Client", snapshot);
+//   for (size_t i = 0; i < snapshot.Count(); ++i)
+//       err = snapshot.GetBlob(snapshot.Key(i), &record, sizeof(record));
+//
+// Getters return what the NVS getters would: ESP_ERR_NVS_NOT_FOUND for a
+// missing key or a key of another type, ESP_ERR_NVS_INVALID_LENGTH if the
+// buffer is too small. The snapshot does not see later writes; it is meant
+// for initialisation at boot.
+//
+// Values are packed from the front of the arena, the sorted key table from
+// its back. Each key costs sizeof(Entry) bytes plus its value. No heap.
+// Supported types: u8, u32, u64, string, blob; NVMWrapper digest keys and
+// other types are left out.
+//
+// Not used by the firmware yet; it is there for the client registry, which
+// will initialise from a namespace of 50 to 100 clients.
+// DeviceContext::Init() reads only its two entity slot keys and the nonce,
+// and the nonce is in another partition: a snapshot would not make it faster.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "nvs.h"
+#include "device_err.h"
+
+class NVMSnapshot
+{
+public:
+    NVMSnapshot(void *arena, size_t size) noexcept;
+    ~NVMSnapshot() = default;
+
+    NVMSnapshot(const NVMSnapshot&) = delete;
+    NVMSnapshot& operator=(const NVMSnapshot&) = delete;
+
+    esp_err_t GetU8(const char *key, uint8_t *value) const noexcept;
+    esp_err_t GetU32(const char *key, uint32_t *value) const noexcept;
+    esp_err_t GetU64(const char *key, uint64_t *value) const noexcept;
+    esp_err_t GetString(const char *key, char *buffer, size_t size) const noexcept;
+    esp_err_t GetBlob(const char *key, void *buffer, size_t size) const noexcept;
+
+    // Keys loaded, and the index-th of them in ascending strcmp() order
+    [[nodiscard]] size_t Count() const noexcept { return m_count; }
+    [[nodiscard]] const char* Key(size_t index) const noexcept;
+
+    // Arena bytes in use
+    [[nodiscard]] size_t Used() const noexcept;
+
+private:
+    friend class NVMWrapper;    // fills the snapshot in LoadNamespace()
+
+    struct Entry
+    {
+        char       key[NVS_KEY_NAME_MAX_SIZE];
+        nvs_type_t type;
+        uint32_t   offset;      // value in the arena
+        uint32_t   size;        // strings include their '\0'
+    };
+
+    void Clear() noexcept;
+    // Reads the value of info.key into the arena. ESP_ERR_NO_MEM if full.
+    esp_err_t Append(nvs_handle_t handle, const nvs_entry_info_t &info) noexcept;
+    // Sorts the key table
+    void Seal() noexcept;
+
+    const Entry* Find(const char *key, nvs_type_t type) const noexcept;
+    esp_err_t Get(const char *key, nvs_type_t type, void *out, size_t size) const noexcept;
+
+    uint8_t *m_arena;
+    size_t   m_size;
+    Entry   *m_table_end;       // the table grows down from here
+    size_t   m_used  = 0;       // value bytes
+    size_t   m_count = 0;
+
+}; // class NVMSnapshot
@@ -0,0 +1,155 @@
+#include "nvm_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+uint64_t NVMStats::NowUs() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t NVMStats::SinceUs(uint64_t start_us) noexcept
+{
+    return static_cast<uint32_t>(std::min<uint64_t>(NowUs() - start_us, UINT32_MAX));
+}
+
+int NVMStats::PartitionIndex(const char *partition) noexcept
+{
+    if (!partition)
+        return -1;
+    for (size_t i = 0; i < PARTITIONS; ++i)
+    {
+        if (std::strcmp(NVM_PARTITION_LABELS[i], partition) == 0)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+NVMStats::KeySlot *NVMStats::Slot(int partition, const char *namespace_name, const char *key) noexcept
+{
+    if (std::strlen(namespace_name) >= NVS_NS_NAME_MAX_SIZE || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return nullptr;
+
+    for (KeySlot &slot : m_keys)
+    {
+        if (slot.stats.key[0] == '\0')
+        {
+            slot.partition = static_cast<uint8_t>(partition);
+            std::strcpy(slot.stats.namespace_name, namespace_name);
+            std::strcpy(slot.stats.key, key);
+            return &slot;
+        }
+        if (slot.partition == partition && std::strcmp(slot.stats.key, key) == 0 &&
+            std::strcmp(slot.stats.namespace_name, namespace_name) == 0)
+            return &slot;
+    }
+    return nullptr;
+}
+
+void NVMStats::RecordWrite(const char *partition, const char *namespace_name, const char *key,
+                           size_t entries) noexcept
+{
+    const int index = PartitionIndex(partition);
+    if (index < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PartitionCounters &p = m_partitions[index];
+    ++p.writes;
+    p.entries_written += static_cast<uint32_t>(entries);
+    if (KeySlot *slot = Slot(index, namespace_name, key))
+        ++slot->stats.writes;
+    else
+        ++p.keys_untracked;
+}
+
+void NVMStats::RecordSkip(const char *partition, const char *namespace_name, const char *key) noexcept
+{
+    const int index = PartitionIndex(partition);
+    if (index < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PartitionCounters &p = m_partitions[index];
+    ++p.skipped;
+    if (KeySlot *slot = Slot(index, namespace_name, key))
+        ++slot->stats.skipped;
+    else
+        ++p.keys_untracked;
+}
+
+void NVMStats::RecordCommit(const char *partition, uint32_t duration_us) noexcept
+{
+    const int index = PartitionIndex(partition);
+    if (index < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PartitionCounters &p = m_partitions[index];
+    ++p.commits;
+    p.commit_max_us = std::max(p.commit_max_us, duration_us);
+
+    // Bucket b holds durations below 2^b ms, the last one everything above
+    size_t bucket = 0;
+    for (uint32_t ms = duration_us / 1000; ms != 0 && bucket + 1 < NVM_STATS_LATENCY_BUCKETS; ms >>= 1)
+        ++bucket;
+    ++p.commit_latency[bucket];
+}
+
+bool NVMStats::Counters(const char *partition, NVMPartitionStats &stats) const noexcept
+{
+    stats = {};
+    const int index = PartitionIndex(partition);
+    if (index < 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const PartitionCounters &p = m_partitions[index];
+    stats.writes           = p.writes;
+    stats.skipped          = p.skipped;
+    stats.entries_written  = p.entries_written;
+    stats.estimated_erases = static_cast<uint32_t>(p.entries_written / ENTRIES_PER_PAGE);
+    stats.commits          = p.commits;
+    std::memcpy(stats.commit_latency, p.commit_latency, sizeof(stats.commit_latency));
+    stats.commit_max_us    = p.commit_max_us;
+    stats.keys_untracked   = p.keys_untracked;
+    return true;
+}
+
+size_t NVMStats::Keys(const char *partition, NVMKeyStats *keys, size_t max) const noexcept
+{
+    const int index = PartitionIndex(partition);
+    if (index < 0 || !keys)
+        return 0;
+
+    // Insertion into the caller's array, kept sorted by stores
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const KeySlot &slot : m_keys)
+    {
+        if (slot.stats.key[0] == '\0')
+            break;
+        if (slot.partition != index)
+            continue;
+
+        size_t pos = count;
+        while (pos > 0 && keys[pos - 1].writes < slot.stats.writes)
+            --pos;
+        if (pos >= max)
+            continue;
+        const size_t last = std::min(count, max - 1);
+        std::memmove(&keys[pos + 1], &keys[pos], (last - pos) * sizeof(NVMKeyStats));
+        keys[pos] = slot.stats;
+        count = std::min(count + 1, max);
+    }
+    return count;
+}
+
+void NVMStats::Reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::memset(m_partitions, 0, sizeof(m_partitions));
+    std::memset(m_keys, 0, sizeof(m_keys));
+}
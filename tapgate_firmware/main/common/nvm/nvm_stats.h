@@ -0,0 +1,141 @@
+//
+// NVMStats - NVS write telemetry per partition
+//
+// NVMWrapper and NVMTransaction report every value they store, every write
+// they skip because the key already holds the value (read-before-write) and
+// how long every commit took. Per partition of NVM_PARTITION_LABELS:
+//
+//   writes, skipped     values stored / writes that cost no flash
+//   entries_written     32-byte NVS entries those values took: one item entry,
+//                       plus ceil(size / 32) data entries for strings and
+//                       blobs, plus the digest key of a large value
+//   estimated_erases    entries_written / 126: in steady state NVS erases one
+//                       page per page of entries written. Entries copied by
+//                       garbage collection are not seen; test_nvs_emu.cpp
+//                       compares the estimate with the emulated flash
+//   commit latency      first nvs_set_*() to the end of nvs_commit(), per
+//                       write or batch, in power-of-two millisecond buckets:
+//                       < 1 ms, < 2 ms, ... < 64 ms, >= 64 ms. NVS writes
+//                       the flash (and garbage collects) in nvs_set_*();
+//                       nvs_commit() alone would measure nothing
+//
+// and per key, for the first KEY_SLOTS keys written or skipped since Init():
+// stores and skips. Writes to further keys still count for their partition and
+// in keys_untracked. NVMWrapper::GetStats() adds nvs_get_stats() (used and free
+// entries, namespaces) to the partition counters.
+//
+// Every call takes the stats mutex, for the few microseconds of a counter
+// update: NVMWrapper calls it under the lock of one partition at a time. No
+// heap. nvm_stats_journal() (nvm_stats_journal.cpp) writes a snapshot of all
+// partitions to the event journal.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "nvs.h"
+#include "nvm_partition.h"
+
+#ifdef CONFIG_NVM_STATS_KEY_SLOTS
+constexpr size_t NVM_STATS_KEY_SLOTS = CONFIG_NVM_STATS_KEY_SLOTS;
+#else
+constexpr size_t NVM_STATS_KEY_SLOTS = 24;
+#endif
+
+// Period of nvm_stats_journal() in the main loop; 0: never
+#ifdef CONFIG_NVM_STATS_JOURNAL_PERIOD_S
+constexpr uint32_t NVM_STATS_JOURNAL_PERIOD_S = CONFIG_NVM_STATS_JOURNAL_PERIOD_S;
+#else
+constexpr uint32_t NVM_STATS_JOURNAL_PERIOD_S = 3600;
+#endif
+
+constexpr size_t NVM_STATS_LATENCY_BUCKETS = 8;
+
+struct NVMPartitionStats
+{
+    nvs_stats_t nvs;                // from nvs_get_stats()
+    uint32_t    writes;
+    uint32_t    skipped;
+    uint32_t    entries_written;
+    uint32_t    estimated_erases;
+    uint32_t    commits;
+    uint32_t    commit_latency[NVM_STATS_LATENCY_BUCKETS];
+    uint32_t    commit_max_us;
+    uint32_t    keys_untracked;     // writes and skips of keys without a slot
+};
+
+struct NVMKeyStats
+{
+    char     namespace_name[NVS_NS_NAME_MAX_SIZE];
+    char     key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t writes;
+    uint32_t skipped;
+};
+
+class NVMStats
+{
+public:
+    static constexpr size_t PARTITIONS = sizeof(NVM_PARTITION_LABELS) / sizeof(NVM_PARTITION_LABELS[0]);
+    static constexpr size_t KEY_SLOTS  = NVM_STATS_KEY_SLOTS;
+
+    static constexpr size_t ENTRY_SIZE       = 32;
+    static constexpr size_t ENTRIES_PER_PAGE = 126;
+
+    // Entries an item of a string or blob of size bytes takes
+    static constexpr size_t VariableEntries(size_t size) noexcept
+    {
+        return 1 + (size + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    }
+
+    // Monotonic time for RecordCommit()
+    static uint64_t NowUs() noexcept;
+    static uint32_t SinceUs(uint64_t start_us) noexcept;
+
+    // Calls for partitions outside NVM_PARTITION_LABELS are ignored
+    void RecordWrite(const char *partition, const char *namespace_name, const char *key,
+                     size_t entries) noexcept;
+    void RecordSkip(const char *partition, const char *namespace_name, const char *key) noexcept;
+    void RecordCommit(const char *partition, uint32_t duration_us) noexcept;
+
+    // Counters of a partition (nvs left zero); false if it is not tracked
+    bool Counters(const char *partition, NVMPartitionStats &stats) const noexcept;
+
+    // Keys of a partition, most stored first; returns the number copied
+    size_t Keys(const char *partition, NVMKeyStats *keys, size_t max) const noexcept;
+
+    void Reset() noexcept;
+
+private:
+    struct PartitionCounters
+    {
+        uint32_t writes;
+        uint32_t skipped;
+        uint32_t entries_written;
+        uint32_t commits;
+        uint32_t commit_latency[NVM_STATS_LATENCY_BUCKETS];
+        uint32_t commit_max_us;
+        uint32_t keys_untracked;
+    };
+
+    struct KeySlot
+    {
+        uint8_t     partition;      // index in NVM_PARTITION_LABELS
+        NVMKeyStats stats;          // key[0] == '\0': slot free
+    };
+
+    static int PartitionIndex(const char *partition) noexcept;
+    // Slot of the key, claimed if free; nullptr if the table is full
+    KeySlot *Slot(int partition, const char *namespace_name, const char *key) noexcept;
+
+    mutable std::mutex m_mutex;
+    PartitionCounters  m_partitions[PARTITIONS]{};
+    KeySlot            m_keys[KEY_SLOTS]{};
+};
+
+// Writes the stats of every partition to the event journal (INFO, tag
+// "NVMStats"): entry usage and write counters, commit latency histogram and
+// the most written key
+void nvm_stats_journal() noexcept;
@@ -0,0 +1,53 @@
+#include "nvm.h"
+#include "nvm_stats.h"
+
+#include "event_journal.h"
+
+// Own tag: the snapshot has its own rate limit bucket, apart from NVM errors
+static const char* TAG = "NVMStats";
+
+void nvm_stats_journal() noexcept
+{
+    for (const char *partition : NVM_PARTITION_LABELS)
+    {
+        NVMPartitionStats s;
+        const esp_err_t err = NVM.GetStats(partition, s);
+        if (err != ESP_OK)
+        {
+            EVENT_JOURNAL_ADD(EVENT_JOURNAL_WARNING, TAG, "%s: no stats: " ERR_FORMAT,
+                              partition, esp_err_to_str(err), err);
+            continue;
+        }
+
+        EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, TAG,
+                          "%s: %u/%u entries used, %u available, %u ns; %lu writes, %lu skipped, ~%lu erases",
+                          partition,
+                          static_cast<unsigned>(s.nvs.used_entries),
+                          static_cast<unsigned>(s.nvs.total_entries),
+                          static_cast<unsigned>(s.nvs.available_entries),
+                          static_cast<unsigned>(s.nvs.namespace_count),
+                          static_cast<unsigned long>(s.writes),
+                          static_cast<unsigned long>(s.skipped),
+                          static_cast<unsigned long>(s.estimated_erases));
+
+        static_assert(NVM_STATS_LATENCY_BUCKETS == 8, "update the commit latency format");
+        const uint32_t *h = s.commit_latency;
+        EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, TAG,
+                          "%s: %lu commits, ms <1:%lu <2:%lu <4:%lu <8:%lu <16:%lu <32:%lu <64:%lu more:%lu, max %lu us",
+                          partition, static_cast<unsigned long>(s.commits),
+                          static_cast<unsigned long>(h[0]), static_cast<unsigned long>(h[1]),
+                          static_cast<unsigned long>(h[2]), static_cast<unsigned long>(h[3]),
+                          static_cast<unsigned long>(h[4]), static_cast<unsigned long>(h[5]),
+                          static_cast<unsigned long>(h[6]), static_cast<unsigned long>(h[7]),
+                          static_cast<unsigned long>(s.commit_max_us));
+
+        NVMKeyStats top;
+        if (NVM.GetKeyStats(partition, &top, 1) == 1)
+        {
+            EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, TAG, "%s: most written %s/%s: %lu writes, %lu skipped",
+                              partition, top.namespace_name, top.key,
+                              static_cast<unsigned long>(top.writes),
+                              static_cast<unsigned long>(top.skipped));
+        }
+    }
+}
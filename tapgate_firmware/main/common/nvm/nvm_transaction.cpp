@@ -0,0 +1,263 @@
+#include "nvm_transaction.h"
+#include "nvm.h"
+
+#include "esp_log.h"
+
+#include <cstring>
+
+[[maybe_unused]] static const char* TAG = "NVM";
+
+NVMTransaction::NVMTransaction(const char *partition, const char *namespace_name) noexcept
+    : m_partition(partition)
+    , m_namespace(namespace_name)
+{
+    if (!partition || !namespace_name)
+        m_error = ESP_ERR_INVALID_ARG;
+}
+
+// ---------------------------------------------------------------------------
+// Staging
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMTransaction::SetU8(const char *key, uint8_t value) noexcept
+{
+    return Stage(key, Type::U8, value, nullptr, 0);
+}
+
+esp_err_t NVMTransaction::SetU32(const char *key, uint32_t value) noexcept
+{
+    return Stage(key, Type::U32, value, nullptr, 0);
+}
+
+esp_err_t NVMTransaction::SetString(const char *key, const char *value) noexcept
+{
+    if (!value)
+        return Stage(key, Type::STR, 0, nullptr, 0);
+    return Stage(key, Type::STR, 0, value, std::strlen(value) + 1);
+}
+
+esp_err_t NVMTransaction::SetBlob(const char *key, const void *value, size_t size) noexcept
+{
+    return Stage(key, Type::BLOB, 0, value, size);
+}
+
+esp_err_t NVMTransaction::Stage(const char *key, Type type, uint32_t value, const void *data, size_t size) noexcept
+{
+    esp_err_t err = ESP_OK;
+    if (!key || ((type == Type::STR || type == Type::BLOB) && (!data || size == 0)))
+        err = ESP_ERR_INVALID_ARG;
+
+    Write *slot = nullptr;
+    if (err == ESP_OK)
+    {
+        for (size_t i = 0; i < m_count && !slot; ++i)
+        {
+            if (std::strcmp(m_writes[i].key, key) == 0)
+                slot = &m_writes[i];
+        }
+        if (!slot && m_count == MAX_WRITES)
+            err = ESP_ERR_NO_MEM;
+    }
+
+    if (err != ESP_OK)
+    {
+        if (m_error == ESP_OK)
+            m_error = err;
+        return err;
+    }
+
+    if (!slot)
+        slot = &m_writes[m_count++];
+    *slot = Write{};
+    slot->key   = key;
+    slot->type  = type;
+    slot->value = value;
+    slot->data  = data;
+    slot->size  = size;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Commit
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMTransaction::Commit() noexcept
+{
+    m_written = 0;
+    if (m_error != ESP_OK)
+        return m_error;
+    if (m_count == 0)
+        return ESP_OK;
+
+    NVMWrapper &nvm = NVMWrapper::getInstance();
+    NVMWrapper::PartitionState &part = nvm.Partition(m_partition);
+    std::lock_guard<std::mutex> lock(part.mutex);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvm.OpenHandle(part, m_partition, m_namespace, NVS_READWRITE, handle);
+    if (err != ESP_OK)
+        return err;
+
+    // Read phase: nothing is written if any stored value cannot be read
+    size_t undo_used = 0;
+    size_t changed   = 0;
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        err = Prepare(handle, m_writes[i], undo_used);
+        if (err != ESP_OK)
+            return nvm.Release(part, handle, err);
+        if (m_writes[i].changed)
+            ++changed;
+        else
+            nvm.m_stats.RecordSkip(m_partition, m_namespace, m_writes[i].key);
+    }
+    if (changed == 0)
+    {
+        ESP_LOGD(TAG, "%s %zu key(s) already set in part: %s space: %s", __FUNCTION__, m_count, m_partition, m_namespace);
+        return ESP_OK;
+    }
+
+    // Write phase
+    const uint64_t start_us = NVMStats::NowUs();
+    size_t applied = 0;
+    for (; applied < m_count && err == ESP_OK; ++applied)
+    {
+        const Write &w = m_writes[applied];
+        if (!w.changed)
+            continue;
+        err = Apply(handle, w);
+        if (err == ESP_OK)
+        {
+            const bool variable = w.type == Type::STR || w.type == Type::BLOB;
+            nvm.m_stats.RecordWrite(m_partition, m_namespace, w.key,
+                                    variable ? NVMStats::VariableEntries(w.size) : 1);
+        }
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+        nvm.m_stats.RecordCommit(m_partition, NVMStats::SinceUs(start_us));
+    }
+    if (err == ESP_OK)
+    {
+        m_written = changed;
+        ESP_LOGD(TAG, "%s Store %zu key(s) to part: %s space: %s", __FUNCTION__, changed, m_partition, m_namespace);
+        return ESP_OK;
+    }
+
+    // Roll back, newest first. The failed write itself is restored too: NVS
+    // may have stored it before reporting the error.
+    ESP_LOGW(TAG, "Batch write to part: %s space: %s failed: " ERR_FORMAT ", rolling back",
+             m_partition, m_namespace, esp_err_to_str(err), err);
+    bool restored = true;
+    while (applied-- > 0)
+    {
+        if (m_writes[applied].changed && Restore(handle, m_writes[applied]) != ESP_OK)
+            restored = false;
+    }
+    if (nvs_commit(handle) != ESP_OK)
+        restored = false;
+    if (!restored)
+    {
+        ESP_LOGE(TAG, "Rollback of part: %s space: %s incomplete", m_partition, m_namespace);
+    }
+    return nvm.Release(part, handle, err);
+}
+
+esp_err_t NVMTransaction::Prepare(nvs_handle_t handle, Write &w, size_t &undo_used) noexcept
+{
+    esp_err_t err = ESP_OK;
+    switch (w.type)
+    {
+        case Type::U8:
+        {
+            uint8_t old = 0;
+            err = nvs_get_u8(handle, w.key, &old);
+            w.old_value = old;
+            break;
+        }
+        case Type::U32:
+            err = nvs_get_u32(handle, w.key, &w.old_value);
+            break;
+        case Type::STR:
+        case Type::BLOB:
+        {
+            size_t length = 0;
+            err = w.type == Type::STR ? nvs_get_str(handle, w.key, nullptr, &length)
+                                      : nvs_get_blob(handle, w.key, nullptr, &length);
+            if (err != ESP_OK)
+                break;
+            if (length > UNDO_CAP - undo_used)
+                return ESP_ERR_INVALID_SIZE;
+
+            uint8_t *const old = m_undo + undo_used;
+            err = w.type == Type::STR ? nvs_get_str(handle, w.key, reinterpret_cast<char*>(old), &length)
+                                      : nvs_get_blob(handle, w.key, old, &length);
+            if (err != ESP_OK)
+                return err;
+
+            w.existed = true;
+            w.changed = length != w.size || std::memcmp(old, w.data, length) != 0;
+            if (w.changed)
+            {
+                w.undo_offset = static_cast<uint16_t>(undo_used);
+                w.undo_size   = static_cast<uint16_t>(length);
+                undo_used += length;
+            }
+            return ESP_OK;
+        }
+    }
+
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        w.existed = false;
+        w.changed = true;
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        return err;
+
+    w.existed = true;
+    w.changed = w.old_value != w.value;
+    return ESP_OK;
+}
+
+esp_err_t NVMTransaction::Apply(nvs_handle_t handle, const Write &w) noexcept
+{
+    // A value above the compare caps must not be described by a stale digest
+    const size_t cap = w.type == Type::STR ? NVM_STR_COMPARE_CAP : NVM_BLOB_COMPARE_CAP;
+    if ((w.type == Type::STR || w.type == Type::BLOB) && w.size > cap)
+    {
+        const esp_err_t err = NVMWrapper::DropDigest(handle, w.key);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    switch (w.type)
+    {
+        case Type::U8:   return nvs_set_u8(handle, w.key, static_cast<uint8_t>(w.value));
+        case Type::U32:  return nvs_set_u32(handle, w.key, w.value);
+        case Type::STR:  return nvs_set_str(handle, w.key, static_cast<const char*>(w.data));
+        case Type::BLOB: return nvs_set_blob(handle, w.key, w.data, w.size);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t NVMTransaction::Restore(nvs_handle_t handle, const Write &w) noexcept
+{
+    if (!w.existed)
+    {
+        const esp_err_t err = nvs_erase_key(handle, w.key);
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+
+    const uint8_t *const old = m_undo + w.undo_offset;
+    switch (w.type)
+    {
+        case Type::U8:   return nvs_set_u8(handle, w.key, static_cast<uint8_t>(w.old_value));
+        case Type::U32:  return nvs_set_u32(handle, w.key, w.old_value);
+        case Type::STR:  return nvs_set_str(handle, w.key, reinterpret_cast<const char*>(old));
+        case Type::BLOB: return nvs_set_blob(handle, w.key, old, w.undo_size);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,111 @@
+//
+// NVMTransaction - batched writes to one NVS namespace, rolled back on error
+//
+// Stages writes to several keys of a namespace and applies them in Commit()
+// with a single nvs_commit():
+//
+//   NVMTransaction txn(NVM_PARTITION_DEFAULT, "Client");
+//   txn.SetBlob("Rec3", &record, sizeof(record));
+//   txn.SetU32("Nonce3", nonce);
+//   err = txn.Commit();
+//
+// Commit() first reads the stored value of every staged key. Keys whose value
+// is already stored are not written; a batch of no-ops costs no write and no
+// commit. The previous values of the keys that do change are kept in an undo
+// buffer inside the transaction. If a write fails part way, the keys written
+// so far are restored (or erased if they did not exist) before the error is
+// returned. NVMWrapper calls on the partition are held off for the duration,
+// so no other task sees a partial batch.
+//
+// All or nothing only while the device stays powered. Every key is written
+// to flash as it is applied and the undo buffer is in RAM: a reset part way
+// through a Commit() leaves the keys written so far, and a restore that fails
+// too (logged) leaves them as well. Values that must change together across
+// a reset belong in one blob, e.g. an NVMSlotRecord.
+//
+// Nothing is written until Commit(); a transaction destroyed without it is
+// discarded. Staged keys, strings and blobs are referenced, not copied: they
+// must stay valid until Commit(). Staging the same key again replaces the
+// earlier value. No heap: capacity and undo space are fixed (MAX_WRITES,
+// UNDO_CAP); the previous strings and blobs of a batch must fit UNDO_CAP.
+//
+// NVMWriter applies its batches through it. No other code writes several keys
+// of one namespace together yet: the device entity is a single slot record
+// and the nonce lives in its own partition. Client enrolment (record, nonce
+// and stats in one commit) is the intended direct caller, once the client
+// registry exists.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "nvs.h"
+#include "device_err.h"
+
+class NVMTransaction
+{
+public:
+    static constexpr size_t MAX_WRITES = 8;
+    static constexpr size_t UNDO_CAP   = 256;
+
+    NVMTransaction(const char *partition, const char *namespace_name) noexcept;
+    ~NVMTransaction() = default;
+
+    NVMTransaction(const NVMTransaction&) = delete;
+    NVMTransaction& operator=(const NVMTransaction&) = delete;
+
+    // Staging. A failure (invalid argument, more than MAX_WRITES keys) is
+    // also returned by Commit(), so a batch can be staged unchecked.
+    esp_err_t SetU8(const char *key, uint8_t value) noexcept;
+    esp_err_t SetU32(const char *key, uint32_t value) noexcept;
+    esp_err_t SetString(const char *key, const char *value) noexcept;
+    esp_err_t SetBlob(const char *key, const void *value, size_t size) noexcept;
+
+    // Applies the batch. ESP_ERR_INVALID_SIZE if the previous values do not
+    // fit UNDO_CAP (nothing written). After a write error the previous
+    // values are restored, as far as NVS allows, and the write error is
+    // returned.
+    [[nodiscard]] esp_err_t Commit() noexcept;
+
+    // Keys written by the last Commit(), no-ops excluded
+    [[nodiscard]] size_t Written() const noexcept { return m_written; }
+    // Keys staged
+    [[nodiscard]] size_t Size() const noexcept { return m_count; }
+
+private:
+    enum class Type : uint8_t { U8, U32, STR, BLOB };
+
+    struct Write
+    {
+        const char *key;
+        Type        type;
+        uint32_t    value;          // U8, U32
+        const void *data;           // STR (with '\0'), BLOB
+        size_t      size;
+
+        // Commit state
+        bool        changed;
+        bool        existed;
+        uint32_t    old_value;      // U8, U32
+        uint16_t    undo_offset;    // STR, BLOB: previous value in m_undo
+        uint16_t    undo_size;
+    };
+
+    esp_err_t Stage(const char *key, Type type, uint32_t value, const void *data, size_t size) noexcept;
+
+    // Reads the stored value of w, decides whether it changes and keeps its undo copy
+    esp_err_t Prepare(nvs_handle_t handle, Write &w, size_t &undo_used) noexcept;
+    static esp_err_t Apply(nvs_handle_t handle, const Write &w) noexcept;
+    esp_err_t Restore(nvs_handle_t handle, const Write &w) noexcept;
+
+    const char *m_partition;
+    const char *m_namespace;
+    Write       m_writes[MAX_WRITES];
+    size_t      m_count   = 0;
+    size_t      m_written = 0;
+    esp_err_t   m_error   = ESP_OK;     // first staging error
+    uint8_t     m_undo[UNDO_CAP];
+
+}; // class NVMTransaction
@@ -0,0 +1,342 @@
+#include "nvm_writer.h"
+#include "nvm.h"
+#include "nvm_transaction.h"
+
+#include "esp_log.h"
+
+#include <chrono>
+#include <cstring>
+
+[[maybe_unused]] static const char* TAG = "NVMWriter";
+
+static NVMWriter s_writer;
+
+// Global instance of NVMWriter
+NVMWriter& NVMAsync = s_writer;
+
+static bool name_fits(const char *name, size_t max_size) noexcept
+{
+    return name && name[0] != '\0' && std::strlen(name) < max_size;
+}
+
+// ---------------------------------------------------------------------------
+// Queue
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMWriter::WriteU8(const char *partition, const char *namespace_name, const char *key,
+                             uint8_t value, Token *token) noexcept
+{
+    return Enqueue(partition, namespace_name, key, Type::U8, &value, sizeof(value), token);
+}
+
+esp_err_t NVMWriter::WriteU32(const char *partition, const char *namespace_name, const char *key,
+                              uint32_t value, Token *token) noexcept
+{
+    return Enqueue(partition, namespace_name, key, Type::U32, &value, sizeof(value), token);
+}
+
+esp_err_t NVMWriter::WriteString(const char *partition, const char *namespace_name, const char *key,
+                                 const char *value, Token *token) noexcept
+{
+    if (!value)
+        return ESP_ERR_INVALID_ARG;
+    return Enqueue(partition, namespace_name, key, Type::STR, value, std::strlen(value) + 1, token);
+}
+
+esp_err_t NVMWriter::WriteBlob(const char *partition, const char *namespace_name, const char *key,
+                               const void *value, size_t size, Token *token) noexcept
+{
+    if (!value || size == 0)
+        return ESP_ERR_INVALID_ARG;
+    return Enqueue(partition, namespace_name, key, Type::BLOB, value, size, token);
+}
+
+esp_err_t NVMWriter::Enqueue(const char *partition, const char *namespace_name, const char *key,
+                             Type type, const void *value, size_t size, Token *token) noexcept
+{
+    if (!name_fits(partition, NVS_PART_NAME_MAX_SIZE) ||
+        !name_fits(namespace_name, NVS_NS_NAME_MAX_SIZE) ||
+        !name_fits(key, NVS_KEY_NAME_MAX_SIZE) || key[0] == NVM_DIGEST_KEY_PREFIX)
+        return ESP_ERR_INVALID_ARG;
+    if (size > VALUE_CAP)
+        return ESP_ERR_INVALID_SIZE;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // A queued write of the same key takes the new value; one being
+        // written already is left alone and the new value queued behind it
+        Slot *slot = nullptr;
+        Slot *free_slot = nullptr;
+        for (Slot &s : m_slots)
+        {
+            if (s.state == State::QUEUED && std::strcmp(s.key, key) == 0 &&
+                std::strcmp(s.namespace_name, namespace_name) == 0 &&
+                std::strcmp(s.partition, partition) == 0)
+            {
+                slot = &s;
+                break;
+            }
+            if (s.state == State::FREE && !free_slot)
+                free_slot = &s;
+        }
+
+        if (slot)
+        {
+            ++m_stats.coalesced;
+        }
+        else
+        {
+            if (!free_slot)
+            {
+                ++m_stats.rejected;
+                ESP_LOGW(TAG, "Queue full, write of %s/%s rejected", namespace_name, key);
+                return ESP_ERR_NO_MEM;
+            }
+            slot = free_slot;
+            std::strcpy(slot->partition, partition);
+            std::strcpy(slot->namespace_name, namespace_name);
+            std::strcpy(slot->key, key);
+            slot->token = m_next_token++;
+            if (m_next_token == 0)
+                m_next_token = 1;
+            slot->state = State::QUEUED;
+            ++m_queued;
+        }
+
+        slot->type = type;
+        slot->size = static_cast<uint16_t>(size);
+        std::memcpy(slot->value, value, size);
+        ++m_stats.queued;
+        if (token)
+            *token = slot->token;
+    }
+    m_wake.notify_one();
+    return ESP_OK;
+}
+
+size_t NVMWriter::Pending() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queued;
+}
+
+NVMWriter::Stats NVMWriter::GetStats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// ---------------------------------------------------------------------------
+// Completion
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMWriter::Status(Token token) const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return StatusLocked(token);
+}
+
+esp_err_t NVMWriter::Wait(Token token, uint32_t timeout_ms) const noexcept
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (token == 0 || token >= m_next_token)
+        return ESP_ERR_INVALID_ARG;
+    if (!m_done.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                         [this, token] { return token <= m_completed; }))
+        return ESP_ERR_TIMEOUT;
+    return StatusLocked(token);
+}
+
+esp_err_t NVMWriter::StatusLocked(Token token) const noexcept
+{
+    if (token == 0 || token >= m_next_token)
+        return ESP_ERR_INVALID_ARG;
+    if (token > m_completed)
+        return ESP_ERR_NOT_FINISHED;
+    for (const Failure &f : m_failures)
+    {
+        if (f.token == token)
+            return f.err;
+    }
+    return token <= m_forgotten ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+void NVMWriter::RecordFailure(Token token, esp_err_t err) noexcept
+{
+    Failure &f = m_failures[m_failure_next];
+    if (f.token > m_forgotten)
+        m_forgotten = f.token;
+    f.token = token;
+    f.err   = err;
+    m_failure_next = (m_failure_next + 1) % FAILURE_HISTORY;
+
+    ++m_stats.failed;
+    if (m_error == ESP_OK)
+        m_error = err;
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+void NVMWriter::Run() noexcept
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_stop || m_queued != 0; });
+        // Let the rest of a burst join the batch
+        if (!m_stop && GROUP_DELAY_MS != 0)
+        {
+            m_wake.wait_for(lock, std::chrono::milliseconds(GROUP_DELAY_MS),
+                            [this] { return m_stop || m_queued == QUEUE_SIZE; });
+        }
+        if (m_stop)
+        {
+            m_stop = false;
+            return;
+        }
+
+        lock.unlock();
+        Drain();
+        lock.lock();
+    }
+}
+
+void NVMWriter::Stop() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+}
+
+esp_err_t NVMWriter::Flush() noexcept
+{
+    Drain();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const esp_err_t err = m_error;
+    m_error = ESP_OK;
+    return err;
+}
+
+void NVMWriter::Drain() noexcept
+{
+    std::lock_guard<std::mutex> batch(m_batch_mutex);
+
+    // Every token issued so far is either queued now or already done
+    Token last = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queued == 0)
+            return;
+        for (Slot &s : m_slots)
+        {
+            if (s.state == State::QUEUED)
+            {
+                s.state = State::IN_FLIGHT;
+                s.err   = ESP_OK;
+            }
+        }
+        m_queued = 0;
+        last = m_next_token - 1;
+        ++m_stats.batches;
+    }
+
+    // In-flight slots are not touched by Enqueue(): no lock while writing
+    bool stored[QUEUE_SIZE] = {};
+    for (size_t i = 0; i < QUEUE_SIZE; ++i)
+    {
+        if (m_slots[i].state == State::IN_FLIGHT && !stored[i])
+            StoreGroup(i, stored);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Slot &s : m_slots)
+        {
+            if (s.state != State::IN_FLIGHT)
+                continue;
+            if (s.err != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Failed to store %s/%s: " ERR_FORMAT, s.namespace_name, s.key,
+                         esp_err_to_str(s.err), s.err);
+                RecordFailure(s.token, s.err);
+            }
+            s.state = State::FREE;
+        }
+        m_completed = last;
+    }
+    m_done.notify_all();
+}
+
+void NVMWriter::StoreGroup(size_t first, bool (&stored)[QUEUE_SIZE]) noexcept
+{
+    const Slot &head = m_slots[first];
+
+    // The group, in chunks of what one transaction takes
+    size_t next = first;
+    while (next < QUEUE_SIZE)
+    {
+        size_t members[NVMTransaction::MAX_WRITES];
+        size_t count = 0;
+        NVMTransaction txn(head.partition, head.namespace_name);
+        for (size_t i = next; i < QUEUE_SIZE && count < NVMTransaction::MAX_WRITES; ++i)
+        {
+            const Slot &s = m_slots[i];
+            next = i + 1;
+            if (s.state != State::IN_FLIGHT || stored[i] ||
+                std::strcmp(s.namespace_name, head.namespace_name) != 0 ||
+                std::strcmp(s.partition, head.partition) != 0)
+                continue;
+
+            uint32_t u32 = 0;
+            switch (s.type)
+            {
+            case Type::U8:   (void)txn.SetU8(s.key, s.value[0]); break;
+            case Type::U32:  std::memcpy(&u32, s.value, sizeof(u32));
+                             (void)txn.SetU32(s.key, u32); break;
+            case Type::STR:  (void)txn.SetString(s.key, reinterpret_cast<const char*>(s.value)); break;
+            case Type::BLOB: (void)txn.SetBlob(s.key, s.value, s.size); break;
+            }
+            members[count++] = i;
+            stored[i] = true;
+        }
+        if (count == 0)
+            break;
+
+        esp_err_t err = txn.Commit();
+        if (err == ESP_ERR_INVALID_SIZE)
+        {
+            // Previous values too large to undo: one write and commit per key
+            ESP_LOGD(TAG, "%s %zu key(s) of %s written one by one", __FUNCTION__, count, head.namespace_name);
+            for (size_t i = 0; i < count; ++i)
+                m_slots[members[i]].err = StoreOne(m_slots[members[i]]);
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i)
+            m_slots[members[i]].err = err;
+    }
+}
+
+esp_err_t NVMWriter::StoreOne(const Slot &slot) noexcept
+{
+    uint32_t u32 = 0;
+    switch (slot.type)
+    {
+    case Type::U8:
+        return NVM.WriteU8(slot.partition, slot.namespace_name, slot.key, slot.value[0]);
+    case Type::U32:
+        std::memcpy(&u32, slot.value, sizeof(u32));
+        return NVM.WriteU32(slot.partition, slot.namespace_name, slot.key, u32);
+    case Type::STR:
+        return NVM.WriteString(slot.partition, slot.namespace_name, slot.key,
+                               reinterpret_cast<const char*>(slot.value));
+    case Type::BLOB:
+        return NVM.WriteBlob(slot.partition, slot.namespace_name, slot.key, slot.value, slot.size);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,189 @@
+//
+// NVMWriter - asynchronous, coalescing NVS writes
+//
+// A flash write can stall for tens of milliseconds while NVS garbage collects
+// a page. NVMWriter takes such writes off the calling task: Write*() copies
+// the value into a fixed queue and returns at once with a completion token;
+// a writer task (Start()) stores the queue in the background.
+//
+//   NVMWriter::Token token;
+//   err = NVMAsync.WriteBlob(NVM_PARTITION_DEFAULT, "Client", "Rec3", &rec, sizeof(rec), &token);
+//   ...
+//   err = NVMAsync.Wait(token, 100);      // optional: ESP_OK once stored
+//
+// Writes to a key that is still queued replace the queued value (the latest
+// value wins, the earlier one is never written) and share its token. The
+// writer takes the whole queue as one batch: writes to the same namespace are
+// applied through NVMTransaction (nvm_transaction.h) with one nvs_commit()
+// per namespace, and values already stored cost nothing. A group whose
+// previous values do not fit the transaction undo buffer is written key by
+// key through NVMWrapper instead. On a burst the writer waits up to
+// GROUP_DELAY_MS after the first write so the rest of the burst joins the
+// batch.
+//
+// Flush() stores everything queued so far in the calling task, after the
+// batch the writer may have in progress, and works without the writer task:
+// the shutdown and brownout paths call it. Start() also registers it as a
+// shutdown handler.
+//
+// app_main() starts the task. Producers: the deferred stores of Persistent
+// values whose Key sets queued (nvm_persistent.h), i.e. device name changes.
+//
+// Reads still go to NVS: a value still queued reads back as its previous
+// value, so callers keep their own RAM copy until the token completes. No
+// heap: QUEUE_SIZE keys of up to VALUE_CAP bytes. A full queue is reported
+// (ESP_ERR_NO_MEM), never waited on; the caller may write synchronously
+// through NVMWrapper instead.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "nvs.h"
+#include "device_err.h"
+
+#ifdef CONFIG_NVM_WRITER_QUEUE_SIZE
+constexpr size_t NVM_WRITER_QUEUE_SIZE = CONFIG_NVM_WRITER_QUEUE_SIZE;
+#else
+constexpr size_t NVM_WRITER_QUEUE_SIZE = 8;
+#endif
+
+#ifdef CONFIG_NVM_WRITER_VALUE_CAP
+constexpr size_t NVM_WRITER_VALUE_CAP = CONFIG_NVM_WRITER_VALUE_CAP;
+#else
+constexpr size_t NVM_WRITER_VALUE_CAP = 128;
+#endif
+
+#ifdef CONFIG_NVM_WRITER_GROUP_DELAY_MS
+constexpr uint32_t NVM_WRITER_GROUP_DELAY_MS = CONFIG_NVM_WRITER_GROUP_DELAY_MS;
+#else
+constexpr uint32_t NVM_WRITER_GROUP_DELAY_MS = 20;
+#endif
+
+class NVMWriter
+{
+public:
+    static constexpr size_t   QUEUE_SIZE      = NVM_WRITER_QUEUE_SIZE;
+    static constexpr size_t   VALUE_CAP       = NVM_WRITER_VALUE_CAP;
+    static constexpr uint32_t GROUP_DELAY_MS  = NVM_WRITER_GROUP_DELAY_MS;
+    // Failed tokens remembered for Status()
+    static constexpr size_t   FAILURE_HISTORY = 8;
+
+    // Completion token of a queued write; 0 is never issued
+    using Token = uint32_t;
+
+    struct Stats
+    {
+        uint32_t queued;        // writes accepted
+        uint32_t coalesced;     // of those, replaced a queued value
+        uint32_t rejected;      // queue full
+        uint32_t batches;
+        uint32_t failed;        // keys whose write failed
+    };
+
+    NVMWriter() = default;
+    ~NVMWriter() = default;
+
+    NVMWriter(const NVMWriter&) = delete;
+    NVMWriter& operator=(const NVMWriter&) = delete;
+
+    // Creates the writer task and registers Flush() as a shutdown handler.
+    // Writes queued before are stored by its first batch.
+    esp_err_t Start() noexcept;
+
+    // Writer loop: waits for writes and stores them in batches until Stop().
+    // Start() runs it in the writer task.
+    void Run() noexcept;
+    // Makes Run() return after its current batch; queued writes stay queued
+    void Stop() noexcept;
+
+    // Queue a write. ESP_ERR_INVALID_ARG: bad or reserved name ('~' prefix),
+    // ESP_ERR_INVALID_SIZE: value above VALUE_CAP, ESP_ERR_NO_MEM: queue full.
+    // token (optional) receives the completion token.
+    esp_err_t WriteU8(const char *partition, const char *namespace_name, const char *key,
+                      uint8_t value, Token *token = nullptr) noexcept;
+    esp_err_t WriteU32(const char *partition, const char *namespace_name, const char *key,
+                       uint32_t value, Token *token = nullptr) noexcept;
+    esp_err_t WriteString(const char *partition, const char *namespace_name, const char *key,
+                          const char *value, Token *token = nullptr) noexcept;
+    esp_err_t WriteBlob(const char *partition, const char *namespace_name, const char *key,
+                        const void *value, size_t size, Token *token = nullptr) noexcept;
+
+    // Result of a write: ESP_ERR_NOT_FINISHED while queued or in progress,
+    // then ESP_OK or the write error. ESP_ERR_NOT_FOUND: the outcome of an
+    // old token is no longer known (FAILURE_HISTORY later failures).
+    [[nodiscard]] esp_err_t Status(Token token) const noexcept;
+    // Status() once the write completed; ESP_ERR_TIMEOUT if it did not in time
+    esp_err_t Wait(Token token, uint32_t timeout_ms) const noexcept;
+
+    // Stores every write queued so far (see above). Returns the first write
+    // error since the previous Flush(), ESP_OK if there was none.
+    esp_err_t Flush() noexcept;
+
+    // Writes queued and not yet taken by a batch
+    [[nodiscard]] size_t Pending() const noexcept;
+    [[nodiscard]] Stats GetStats() const noexcept;
+
+private:
+    enum class Type : uint8_t { U8, U32, STR, BLOB };
+    enum class State : uint8_t { FREE, QUEUED, IN_FLIGHT };
+
+    struct Slot
+    {
+        State     state;
+        Type      type;
+        char      partition[NVS_PART_NAME_MAX_SIZE];
+        char      namespace_name[NVS_NS_NAME_MAX_SIZE];
+        char      key[NVS_KEY_NAME_MAX_SIZE];
+        Token     token;
+        esp_err_t err;              // IN_FLIGHT: result
+        uint16_t  size;
+        alignas(uint32_t) uint8_t value[VALUE_CAP];     // STR with its '\0'
+    };
+
+    struct Failure
+    {
+        Token     token;
+        esp_err_t err;
+    };
+
+    esp_err_t Enqueue(const char *partition, const char *namespace_name, const char *key,
+                      Type type, const void *value, size_t size, Token *token) noexcept;
+
+    // Takes every queued write and stores it; serialized by m_batch_mutex
+    void Drain() noexcept;
+    // Writes the in-flight slots of one (partition, namespace) starting at first
+    void StoreGroup(size_t first, bool (&stored)[QUEUE_SIZE]) noexcept;
+    // Writes one slot through NVMWrapper (own commit)
+    static esp_err_t StoreOne(const Slot &slot) noexcept;
+
+    // m_mutex must be held
+    esp_err_t StatusLocked(Token token) const noexcept;
+    void RecordFailure(Token token, esp_err_t err) noexcept;
+
+    mutable std::mutex              m_mutex;
+    mutable std::condition_variable m_wake;     // Run(): writes queued or Stop()
+    mutable std::condition_variable m_done;     // Wait(): a batch completed
+    std::mutex                      m_batch_mutex;
+
+    Slot      m_slots[QUEUE_SIZE]{};
+    size_t    m_queued     = 0;
+    Token     m_next_token = 1;
+    Token     m_completed  = 0;     // every token up to this one is done
+    bool      m_stop       = false;
+    bool      m_started    = false;
+    esp_err_t m_error      = ESP_OK;   // first failure since Flush()
+
+    Failure   m_failures[FAILURE_HISTORY]{};
+    size_t    m_failure_next = 0;
+    Token     m_forgotten    = 0;   // newest failure dropped from m_failures
+    Stats     m_stats{};
+
+}; // class NVMWriter
+
+// Global instance of NVMWriter
+extern NVMWriter& NVMAsync;
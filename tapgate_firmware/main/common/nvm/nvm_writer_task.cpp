@@ -0,0 +1,66 @@
+// Writer task of NVMWriter. Kept apart from nvm_writer.cpp so the queue and
+// batch logic build for the host tests without FreeRTOS.
+
+#include "nvm_writer.h"
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char* TAG = "NVMWriter";
+
+// NVS writes and the transaction undo copies run on this stack
+static constexpr uint32_t    NVM_WRITER_TASK_STACK    = 4096;
+// Below the tasks that queue writes, above the journal flush task
+static constexpr UBaseType_t NVM_WRITER_TASK_PRIORITY = tskIDLE_PRIORITY + 2;
+
+static NVMWriter* s_shutdown_writer = nullptr;
+
+static void nvm_writer_task(void *arg)
+{
+    static_cast<NVMWriter*>(arg)->Run();
+    vTaskDelete(nullptr);
+}
+
+// esp_restart(): store what is still queued
+static void nvm_writer_shutdown(void)
+{
+    if (s_shutdown_writer)
+        (void)s_shutdown_writer->Flush();
+}
+
+esp_err_t NVMWriter::Start() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_started)
+            return ESP_OK;
+        m_started = true;
+    }
+
+    const BaseType_t res = xTaskCreate(nvm_writer_task, "nvm_writer",
+                                       NVM_WRITER_TASK_STACK, this,
+                                       NVM_WRITER_TASK_PRIORITY, nullptr);
+    if (res != pdPASS)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_started = false;
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (!s_shutdown_writer)
+    {
+        s_shutdown_writer = this;
+        const esp_err_t err = esp_register_shutdown_handler(nvm_writer_shutdown);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Failed to register shutdown flush: " ERR_FORMAT, esp_err_to_str(err), err);
+        }
+    }
+
+    ESP_LOGI(TAG, "Started (%u slots of %u bytes)",
+             static_cast<unsigned>(QUEUE_SIZE), static_cast<unsigned>(VALUE_CAP));
+    return ESP_OK;
+}
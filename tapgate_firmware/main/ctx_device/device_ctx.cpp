@@ -1,4 +1,6 @@
+#include <cstddef>
 #include <cstring>
+#include <limits>
 
 #include "esp_log.h"
 
@@ -10,14 +12,20 @@
 
 static constexpr char TAG[] = "DeviceCtx";
 
-// Entity: stored as a single blob in NVM_PARTITION_ENTITY
-static constexpr char NVS_CTXDEVICE_NS[]          = "CtxDevice";
-static constexpr char NVS_CTXDEVICE_KEY_ENTITY[]  = "Entity";
-
-// Nonce: stored separately in NVM_PARTITION_NONCE for independent update cycles
+// Nonce: the high-water mark of the current lease is the value of an
+// NVMCounter in NVM_PARTITION_COUNTER. Firmware before the counter kept it
+// under this key of NVM_PARTITION_NONCE (firmware before leases kept the
+// current nonce there, which reads back as a valid mark); load_nonce()
+// moves it into the counter.
 static constexpr char NVS_DEVICENONCE_NS[]        = "CtxDevice";
 static constexpr char NVS_DEVICENONCE_KEY_NONCE[] = "Nonce";
 
+#ifdef CONFIG_TAPGATE_NONCE_LEASE_SIZE
+static constexpr tg_nonce_t NONCE_LEASE_SIZE = CONFIG_TAPGATE_NONCE_LEASE_SIZE;
+#else
+static constexpr tg_nonce_t NONCE_LEASE_SIZE = 64;
+#endif
+
 static constexpr char DEVICE_NAME_DEFAULT[] =
 #ifdef CONFIG_TAPGATE_DEVICE_DEFAULT_NAME
     CONFIG_TAPGATE_DEVICE_DEFAULT_NAME;
@@ -54,19 +62,16 @@ esp_err_t DeviceContext::Init() noexcept
                 init_err = uid_err;
             }
 
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                std::memset(&m_entity, 0, sizeof(m_entity));
-                std::memcpy(m_entity.name, DEVICE_NAME_DEFAULT, sizeof(DEVICE_NAME_DEFAULT));
-                if (uid_err == ESP_OK) {
-                    std::memcpy(m_entity.device_id, device_id, UID_CAP);
-                }
+            device_entity_t entity{};
+            std::memcpy(entity.name, DEVICE_NAME_DEFAULT, sizeof(DEVICE_NAME_DEFAULT));
+            if (uid_err == ESP_OK) {
+                std::memcpy(entity.device_id, device_id, UID_CAP);
             }
             ESP_LOGW(TAG, "Entity not in NVS, applying defaults");
 
             // Store Device Ctx to NVM
-            store_entity();
-            
+            (void)m_entity.Set(entity, NVMPersist::NOW);
+
         } else if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to load entity: %s", esp_err_to_name(err));
             init_err = err;
@@ -75,10 +80,7 @@ esp_err_t DeviceContext::Init() noexcept
 
     {
         const esp_err_t err = load_nonce();
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            m_nonce.store(0, std::memory_order_relaxed);
-            ESP_LOGW(TAG, "Nonce not in NVS, starting at 0");
-        } else if (err != ESP_OK) {
+        if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to load nonce: %s", esp_err_to_name(err));
             init_err = err;
         }
@@ -129,8 +131,7 @@ esp_err_t DeviceContext::get_device_entity(device_entity_t* entity) const noexce
     if (!entity)
         return ESP_ERR_INVALID_ARG;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    std::memcpy(entity, &m_entity, sizeof(m_entity));
+    *entity = m_entity.Get();
     return ESP_OK;
 }
 
@@ -139,11 +140,25 @@ esp_err_t DeviceContext::update_device_entity(const device_entity_t* entity) noe
     if (!entity)
         return ESP_ERR_INVALID_ARG;
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::memcpy(&m_entity, entity, sizeof(m_entity));
-    }
-    return store_entity();
+    return m_entity.Update([entity](device_entity_t& e) {
+        // Identity and keys must not be lost to a reset; the name may wait
+        const bool critical =
+            std::memcmp(e.device_id,   entity->device_id,   UID_CAP)    != 0 ||
+            std::memcmp(e.pub_key,     entity->pub_key,     PUBKEY_CAP) != 0 ||
+            std::memcmp(e.private_key, entity->private_key, PRVKEY_CAP) != 0;
+        e = *entity;
+        return critical ? NVMPersist::NOW : NVMPersist::DEFERRED;
+    });
+}
+
+esp_err_t DeviceContext::sync_entity() noexcept
+{
+    return m_entity.Poll();
+}
+
+esp_err_t DeviceContext::flush_entity() noexcept
+{
+    return m_entity.Flush();
 }
 
 // ---------------------------------------------------------------------------
@@ -155,13 +170,14 @@ esp_err_t DeviceContext::get_device_name(std::span<char> out) const noexcept
     if (out.empty())
         return ESP_ERR_INVALID_ARG;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    const auto* name = reinterpret_cast<const char*>(m_entity.name);
-    const std::size_t name_len = std::strlen(name);
+    tg_name_t name;
+    m_entity.ReadBytes(offsetof(device_entity_t, name), name, NAME_MAX_SIZE);
+    const std::size_t name_len = strnlen(reinterpret_cast<const char*>(name), NAME_MAX_SIZE - 1);
     if (out.size() <= name_len)
         return ESP_ERR_INVALID_SIZE;
 
-    std::memcpy(out.data(), name, name_len + 1);
+    std::memcpy(out.data(), name, name_len);
+    out[name_len] = '\0';
     return ESP_OK;
 }
 
@@ -173,12 +189,11 @@ esp_err_t DeviceContext::set_device_name(std::string_view name) noexcept
     if (name.find('\0') != std::string_view::npos)
         return ESP_ERR_INVALID_ARG;
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::memcpy(m_entity.name, name.data(), name.size());
-        m_entity.name[name.size()] = '\0';
-    }
-    return store_entity();
+    return m_entity.Update([name](device_entity_t& e) {
+        std::memcpy(e.name, name.data(), name.size());
+        std::memset(e.name + name.size(), 0, NAME_MAX_SIZE - name.size());
+        return NVMPersist::DEFERRED;
+    });
 }
 
 // ---------------------------------------------------------------------------
@@ -199,8 +214,44 @@ esp_err_t DeviceContext::set_nonce(tg_nonce_t nonce) noexcept
     if (m_nonce.load(std::memory_order_relaxed) == nonce)
         return ESP_OK;
 
+    std::lock_guard<std::mutex> lock(m_lease_mutex);
+    if (nonce > m_nonce_limit.load(std::memory_order_relaxed))
+    {
+        const esp_err_t err = reserve_nonces(nonce);
+        if (err != ESP_OK)
+            return err;
+    }
     m_nonce.store(nonce, std::memory_order_relaxed);
-    return store_nonce();
+    return ESP_OK;
+}
+
+esp_err_t DeviceContext::consume_nonce(tg_nonce_t nonce) noexcept
+{
+    if (nonce == std::numeric_limits<tg_nonce_t>::max())
+    {
+        ESP_LOGE(TAG, "Nonce range exhausted");
+        return ESP_ERR_INVALID_STATE;
+    }
+    const tg_nonce_t next = nonce + 1;
+
+    // Lease used up: the next lease is stored before next is handed out
+    if (next > m_nonce_limit.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(m_lease_mutex);
+        if (m_nonce.load(std::memory_order_relaxed) != nonce)
+            return ESP_ERR_INVALID_STATE;
+        if (next > m_nonce_limit.load(std::memory_order_relaxed))
+        {
+            const esp_err_t err = reserve_nonces(next);
+            if (err != ESP_OK)
+                return err;
+        }
+    }
+
+    tg_nonce_t expected = nonce;
+    if (!m_nonce.compare_exchange_strong(expected, next, std::memory_order_acq_rel))
+        return ESP_ERR_INVALID_STATE;
+    return ESP_OK;
 }
 
 // ---------------------------------------------------------------------------
@@ -212,8 +263,7 @@ esp_err_t DeviceContext::get_public_key(tg_public_key_t pubkey) const noexcept
     if (!pubkey)
         return ESP_ERR_INVALID_ARG;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    std::memcpy(pubkey, m_entity.pub_key, PUBKEY_CAP);
+    m_entity.ReadBytes(offsetof(device_entity_t, pub_key), pubkey, PUBKEY_CAP);
     return ESP_OK;
 }
 
@@ -222,8 +272,7 @@ esp_err_t DeviceContext::get_private_key(tg_private_key_t prvkey) const noexcept
     if (!prvkey)
         return ESP_ERR_INVALID_ARG;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    std::memcpy(prvkey, m_entity.private_key, PRVKEY_CAP);
+    m_entity.ReadBytes(offsetof(device_entity_t, private_key), prvkey, PRVKEY_CAP);
     return ESP_OK;
 }
 
@@ -232,72 +281,105 @@ esp_err_t DeviceContext::get_device_id(tg_uid_t device_id) const noexcept
     if (!device_id)
         return ESP_ERR_INVALID_ARG;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    std::memcpy(device_id, m_entity.device_id, UID_CAP);
+    m_entity.ReadBytes(offsetof(device_entity_t, device_id), device_id, UID_CAP);
     return ESP_OK;
 }
 
+DeviceContext::EntityView DeviceContext::view_entity() const noexcept
+{
+    return EntityView(m_entity.Pin());
+}
+
 // ---------------------------------------------------------------------------
 // NVM helpers
 // ---------------------------------------------------------------------------
 
 esp_err_t DeviceContext::load_entity() noexcept
 {
+    esp_err_t err = m_entity.Load();
+    if (err != ESP_ERR_NVS_NOT_FOUND)
+        return err;
+
+    // No slot yet: the plain blob of older firmware, stored under the record
+    // key itself, if any
     device_entity_t buf{};
-    const esp_err_t err = NVM.ReadBlob(NVM_PARTITION_ENTITY,
-                                       NVS_CTXDEVICE_NS,
-                                       NVS_CTXDEVICE_KEY_ENTITY,
-                                       &buf, sizeof(buf));
+    err = NVM.ReadBlob(EntityKey::partition,
+                       EntityKey::namespace_name,
+                       EntityKey::key,
+                       &buf, sizeof(buf));
     if (err != ESP_OK)
         return err;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_entity = buf;
-    return ESP_OK;
-}
-
-esp_err_t DeviceContext::store_entity() noexcept
-{
-    device_entity_t entity{};
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        entity = m_entity;
-    }
-    const esp_err_t err = NVM.WriteBlob(NVM_PARTITION_ENTITY,
-                                        NVS_CTXDEVICE_NS,
-                                        NVS_CTXDEVICE_KEY_ENTITY,
-                                        &entity, sizeof(entity));
-    if (err == ESP_OK){
-        ESP_LOGI(TAG, "Entity stored successfully");
+    // The blob goes only once the record holds the entity; until then
+    // the next boot migrates again
+    const esp_err_t migrate_err = m_entity.Set(buf, NVMPersist::NOW);
+    if (migrate_err == ESP_OK) {
+        CALLW(TAG, NVM.EraseKey(EntityKey::partition, EntityKey::namespace_name, EntityKey::key));
+        ESP_LOGI(TAG, "Entity migrated to slot record");
     } else {
-        ESP_LOGE(TAG, "Failed to store entity: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "Failed to migrate entity: %s", esp_err_to_name(migrate_err));
     }
-    return err;
+    return ESP_OK;
 }
 
 esp_err_t DeviceContext::load_nonce() noexcept
 {
-    tg_nonce_t val = 0;
-    const esp_err_t err = NVM.ReadU32(NVM_PARTITION_NONCE,
-                                      NVS_DEVICENONCE_NS,
-                                      NVS_DEVICENONCE_KEY_NONCE,
-                                      &val);
+    m_nonce.store(0, std::memory_order_relaxed);
+    m_nonce_limit.store(0, std::memory_order_relaxed);
+
+    esp_err_t err = m_nonce_counter.Init(NVM_PARTITION_COUNTER);
     if (err != ESP_OK)
         return err;
 
-    m_nonce.store(val, std::memory_order_relaxed);
+    // Mark of firmware before the counter, if any. The key goes only once
+    // the counter is past it; until then the next boot migrates again.
+    tg_nonce_t legacy = 0;
+    err = NVM.ReadU32(NVM_PARTITION_NONCE,
+                      NVS_DEVICENONCE_NS,
+                      NVS_DEVICENONCE_KEY_NONCE,
+                      &legacy);
+    if (err == ESP_OK) {
+        const uint64_t value = m_nonce_counter.Value();
+        const esp_err_t migrate_err =
+            legacy > value ? m_nonce_counter.Add(static_cast<uint32_t>(legacy - value)) : ESP_OK;
+        if (migrate_err == ESP_OK) {
+            CALLW(TAG, NVM.EraseKey(NVM_PARTITION_NONCE, NVS_DEVICENONCE_NS, NVS_DEVICENONCE_KEY_NONCE));
+            ESP_LOGI(TAG, "Nonce migrated to counter");
+        } else {
+            ESP_LOGE(TAG, "Failed to migrate nonce: %s", esp_err_to_name(migrate_err));
+            return migrate_err;
+        }
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+
+    // Resume at the high-water mark: every nonce accepted before the reset
+    // is below it. No write until the first nonce is consumed.
+    const uint64_t value = m_nonce_counter.Value();
+    const tg_nonce_t mark = value > std::numeric_limits<tg_nonce_t>::max()
+                                ? std::numeric_limits<tg_nonce_t>::max()
+                                : static_cast<tg_nonce_t>(value);
+    m_nonce.store(mark, std::memory_order_relaxed);
+    m_nonce_limit.store(mark, std::memory_order_relaxed);
     return ESP_OK;
 }
 
-esp_err_t DeviceContext::store_nonce() noexcept
+esp_err_t DeviceContext::reserve_nonces(tg_nonce_t nonce) noexcept
 {
-    const esp_err_t err = NVM.WriteU32(NVM_PARTITION_NONCE,
-                                       NVS_DEVICENONCE_NS,
-                                       NVS_DEVICENONCE_KEY_NONCE,
-                                       m_nonce.load(std::memory_order_relaxed));
+    const tg_nonce_t max = std::numeric_limits<tg_nonce_t>::max();
+    const tg_nonce_t limit = nonce > max - NONCE_LEASE_SIZE ? max : nonce + NONCE_LEASE_SIZE;
+
+    // The counter only moves forward and may have skipped values after a
+    // failed write: the new mark is its value, at least limit
+    uint64_t value = m_nonce_counter.Value();
+    esp_err_t err = ESP_OK;
+    if (value < limit)
+        err = m_nonce_counter.Add(static_cast<uint32_t>(limit - value), &value);
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Nonce stored successfully. Value: %lu",
-            static_cast<unsigned long>(m_nonce.load(std::memory_order_relaxed)));
+        const tg_nonce_t mark = value > max ? max : static_cast<tg_nonce_t>(value);
+        m_nonce_limit.store(mark, std::memory_order_release);
+        ESP_LOGI(TAG, "Nonce lease stored successfully. Limit: %lu",
+            static_cast<unsigned long>(mark));
     } else {
         ESP_LOGE(TAG, "Failed to store nonce: %s", esp_err_to_name(err));
     }
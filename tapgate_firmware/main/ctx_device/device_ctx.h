@@ -5,11 +5,21 @@
 #include <mutex>
 #include <span>
 #include <string_view>
+#include <utility>
 
 #include "device_err.h"
 #include "constants.h"
 #include "types.h"
 #include "device_entity.h"
+#include "nvm_counter.h"
+#include "nvm_partition.h"
+#include "nvm_persistent.h"
+
+#ifdef CONFIG_TAPGATE_ENTITY_WRITE_DELAY_MS
+constexpr uint32_t ENTITY_WRITE_DELAY_MS = CONFIG_TAPGATE_ENTITY_WRITE_DELAY_MS;
+#else
+constexpr uint32_t ENTITY_WRITE_DELAY_MS = 2000;
+#endif
 
 class DeviceContext
 {
@@ -25,36 +35,96 @@ public:
     // Initialize Device Context from NVM. Must be called before any other API.
     esp_err_t Init() noexcept;
 
-    // Set/Get Device Entity (all fields as a unit, stored as blob in NVM_PARTITION_ENTITY)
+    // Set/Get Device Entity (all fields as a unit, stored as a slot record in
+    // NVM_PARTITION_ENTITY). A change of the device ID or a key is stored
+    // before return; a change of the name alone is deferred like set_device_name().
     [[nodiscard]] esp_err_t get_device_entity(device_entity_t *entity) const noexcept;
     [[nodiscard]] esp_err_t update_device_entity(const device_entity_t *entity) noexcept;
 
-    // Get/Set Device Name (convenience accessor — name lives inside the entity blob)
+    // Get/Set Device Name (convenience accessor — name lives inside the entity blob).
+    // The name is stored once it has not changed for ENTITY_WRITE_DELAY_MS,
+    // by sync_entity(): a burst of renames costs one write.
     [[nodiscard]] esp_err_t get_device_name(std::span<char> out) const noexcept;
     [[nodiscard]] esp_err_t set_device_name(std::string_view name) noexcept;
 
-    // Get/Set Nonce (stored as u32 in NVM_PARTITION_NONCE, separate from entity)
+    // Get/Set Nonce. The counter in NVM_PARTITION_COUNTER holds a high-water
+    // mark up to NONCE_LEASE_SIZE values ahead, not the nonce itself: nonces
+    // below it are handed out from RAM, and after a reset numbering resumes
+    // at it.
     [[nodiscard]] esp_err_t get_nonce(tg_nonce_t *nonce) const noexcept;
     [[nodiscard]] esp_err_t set_nonce(tg_nonce_t nonce) noexcept;
 
-    // Read-only accessors for individual entity fields
+    // DoAction: accepts nonce if it is the current one and advances to the
+    // next. ESP_ERR_INVALID_STATE for any other value (duplicate or stale).
+    // Writes to NVM only when the lease is used up.
+    [[nodiscard]] esp_err_t consume_nonce(tg_nonce_t nonce) noexcept;
+
+    // Queues a deferred entity change to NVMAsync once it is
+    // ENTITY_WRITE_DELAY_MS old; called from the main loop
+    esp_err_t sync_entity() noexcept;
+    // Stores a deferred or queued entity change now (restart, shutdown)
+    esp_err_t flush_entity() noexcept;
+
+    // Read-only accessors for individual entity fields. They copy; on the
+    // message path prefer view_entity().
     [[nodiscard]] esp_err_t get_public_key(tg_public_key_t pubkey) const noexcept;
     [[nodiscard]] esp_err_t get_private_key(tg_private_key_t prvkey) const noexcept;
     [[nodiscard]] esp_err_t get_device_id(tg_uid_t device_id) const noexcept;
 
+    // Borrowed view of the entity: the spans point into the snapshot current
+    // when the view was taken, which stays valid and unchanged until the view
+    // is destroyed. No copy of the keys, so nothing to zero afterwards:
+    //
+    //   {
+    //       const auto view = DeviceCtx.view_entity();
+    //       ecies_decrypt(msg, len, view.private_key().data(), out, cap, &out_len);
+    //   }
+    //
+    // Keep a view for one operation. An entity change waits for views of the
+    // snapshot it overwrites: do not change the entity while holding one.
+    class EntityView
+    {
+    public:
+        [[nodiscard]] std::span<const uint8_t, UID_CAP> device_id() const noexcept
+        {
+            return std::span<const uint8_t, UID_CAP>(m_view->device_id);
+        }
+        [[nodiscard]] std::span<const uint8_t, PUBKEY_CAP> public_key() const noexcept
+        {
+            return std::span<const uint8_t, PUBKEY_CAP>(m_view->pub_key);
+        }
+        [[nodiscard]] std::span<const uint8_t, PRVKEY_CAP> private_key() const noexcept
+        {
+            return std::span<const uint8_t, PRVKEY_CAP>(m_view->private_key);
+        }
+        // Changes with every entity change; equal versions show equal entities
+        [[nodiscard]] uint32_t version() const noexcept { return m_view.Version(); }
+
+    private:
+        friend class DeviceContext;
+        explicit EntityView(DoubleBuffer<device_entity_t>::View &&view) noexcept
+            : m_view(std::move(view))
+        {
+        }
+
+        DoubleBuffer<device_entity_t>::View m_view;
+    };
+
+    [[nodiscard]] EntityView view_entity() const noexcept;
+
 private:
     DeviceContext() = default;
     ~DeviceContext() = default;
 
-    // Entity helpers — store_entity() must be called with m_mutex held
+    // Entity helper: loads the slot record, or migrates the plain blob of
+    // firmware before slot records
     esp_err_t load_entity() noexcept;
-    esp_err_t store_entity() noexcept;
 
-    // Nonce helpers — no mutex required; m_nonce is atomic
+    // Nonce helpers. load_nonce() mounts the counter and migrates the NVS
+    // mark of firmware before it. reserve_nonces() persists a lease covering
+    // nonce and must be called with m_lease_mutex held.
     esp_err_t load_nonce() noexcept;
-    esp_err_t store_nonce() noexcept;
-
-    mutable std::mutex m_mutex;
+    esp_err_t reserve_nonces(tg_nonce_t nonce) noexcept;
 
     // All uint8_t[] fields — no struct padding possible
     static_assert(sizeof(device_entity_t) == UID_CAP + NAME_MAX_SIZE + PUBKEY_CAP + PRVKEY_CAP,
@@ -65,8 +135,26 @@ private:
                   "CONFIG_TAPGATE_DEVICE_DEFAULT_NAME must be <= " STR(NAME_MAX_SIZE) " bytes including NUL");
 #endif
 
-    device_entity_t          m_entity{};
-    std::atomic<tg_nonce_t>     m_nonce{0};
+    // Entity: an NVMSlotRecord in NVM_PARTITION_ENTITY (keys "Entity.a" and
+    // "Entity.b"). Deferred changes are queued to NVMAsync by sync_entity().
+    struct EntityKey
+    {
+        static constexpr const char *partition        = NVM_PARTITION_ENTITY;
+        static constexpr char        namespace_name[] = "CtxDevice";
+        static constexpr char        key[]            = "Entity";
+        static constexpr NVMStorage  storage          = NVMStorage::SLOT_RECORD;
+        static constexpr uint32_t    write_delay_ms   = ENTITY_WRITE_DELAY_MS;
+        static constexpr bool        queued           = true;
+    };
+    Persistent<device_entity_t, EntityKey> m_entity;
+
+    // m_nonce <= m_nonce_limit, the high-water mark stored in m_nonce_counter.
+    // m_nonce advances lock-free below the limit; moving the limit takes
+    // m_lease_mutex.
+    NVMCounter               m_nonce_counter;
+    std::atomic<tg_nonce_t>  m_nonce{0};
+    std::atomic<tg_nonce_t>  m_nonce_limit{0};
+    std::mutex               m_lease_mutex;
 
 }; // class DeviceContext
 
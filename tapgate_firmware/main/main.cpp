@@ -4,11 +4,14 @@
 #include "esp_app_trace.h"
 #include "esp_app_desc.h"
 #include "esp_log.h"
+#include "esp_system.h"
 
 #include "constants.h"
 #include "event_journal.h"
 #include "fcall.h"
 #include "nvm.h"
+#include "nvm_stats.h"
+#include "nvm_writer.h"
 #include "datetime.h"
 #include "device_ctx.h"
 #include "uuid.h"
@@ -20,6 +23,12 @@
 #include "diag/wait_dbg.h"
 #endif
 
+// esp_restart(): store a deferred device name change
+static void device_ctx_shutdown(void)
+{
+    (void)DeviceCtx.flush_entity();
+}
+
 extern "C" void app_main(void)
 {
 #ifdef CONFIG_APP_WAIT_FOR_DEBUGGER
@@ -29,9 +38,19 @@ extern "C" void app_main(void)
     // Global Initialization section
     // Follow sequence of steps to ensure predictable startup behavior and proper error handling.
 
+    // Start Event Journal flush task.
+    // Events added before this point are staged in RAM and are not lost.
+    // Also merges the records a panic or watchdog reset left in the crash
+    // tail, so it must stay the first step: nothing else may log before it.
+    esp_err_t err = event_journal_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_MAIN, "Event Journal initialization failed: " ERR_FORMAT, esp_err_to_str(err), err);
+    }
+
     // Initialize NVS partitions.
     // Critical for application operation. Will be before any NVM access.
-    esp_err_t err = NVM.Init();
+    err = NVM.Init();
     if (err != ESP_OK)
     {
         // Critical error
@@ -41,6 +60,17 @@ extern "C" void app_main(void)
         esp_system_abort("Verify NVM partition label in 'nvm_partition.h' and 'partitions.csv'");
     }
 
+    // Start the asynchronous NVS writer task.
+    // Stores the deferred device entity changes queued by the main loop;
+    // without it they are only stored by NVMAsync.Flush() (restart).
+    err = NVMAsync.Start();
+    if (err != ESP_OK)
+    {
+        EVENT_JOURNAL_ADD(EVENT_JOURNAL_ERROR,
+                          TAG_MAIN,
+                          "NVM writer start failed: " ERR_FORMAT, esp_err_to_str(err), err);
+    }
+
     // Initialize DateTime subsystem.
     err = DateTime.Init();
     if (err != ESP_OK)
@@ -58,6 +88,7 @@ extern "C" void app_main(void)
                           TAG_MAIN,
                           "DeviceCtx initialization failed: " ERR_FORMAT, esp_err_to_str(err), err);
     }
+    CALLW(TAG_MAIN, esp_register_shutdown_handler(device_ctx_shutdown));
 
     // Almost all initialization steps are complete. 
     // Report startup complete before entering main loop.
@@ -84,6 +115,9 @@ extern "C" void app_main(void)
             build_chip_features_str(features_buf, sizeof(features_buf), chip);
         }
 
+        // One event: the console gets the whole text. A deferred record keeps
+        // the arguments that fit JOURNAL_DATA_MAX_SIZE, in this order; the
+        // rest render as "<?>" (a text record keeps the first characters).
         EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO,
             TAG_MAIN, "Boot Info [%s-%s]:"
             "\nFeatures:           %s"
@@ -97,7 +131,7 @@ extern "C" void app_main(void)
             get_current_chip_name(),
             get_chip_pkg_str(),
             features_buf,
-            CONFIG_XTAL_FREQ,            
+            CONFIG_XTAL_FREQ,
             device_name_buf,
             device_id_buf,
             app_desc->version,
@@ -116,9 +150,22 @@ extern "C" void app_main(void)
     
     // Main app loop
     ESP_LOGI(TAG_MAIN, "Entering main loop");
+    TickType_t nvm_stats_due = xTaskGetTickCount() + pdMS_TO_TICKS(NVM_STATS_JOURNAL_PERIOD_S * 1000);
     while (true)
     {
         // TODO:
-        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        // Deferred entity changes (device name) once they are quiet, queued
+        // to the NVM writer task
+        CALLW(TAG_MAIN, DeviceCtx.sync_entity());
+
+        // NVS usage and wear in the journal, to check the partition sizing
+        // (docs/partitions.md) against devices in the field
+        if (NVM_STATS_JOURNAL_PERIOD_S != 0 && static_cast<int32_t>(xTaskGetTickCount() - nvm_stats_due) >= 0)
+        {
+            nvm_stats_journal();
+            nvm_stats_due += pdMS_TO_TICKS(NVM_STATS_JOURNAL_PERIOD_S * 1000);
+        }
     }
 }
\ No newline at end of file
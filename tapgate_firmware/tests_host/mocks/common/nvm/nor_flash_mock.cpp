@@ -0,0 +1,199 @@
+#include "nor_flash_mock.h"
+#include "esp_partition.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Partition
+{
+    esp_partition_t      info;
+    std::vector<uint8_t> data;
+    std::vector<size_t>  erases;     // per sector
+};
+
+std::mutex                       s_mutex;
+std::map<std::string, Partition> s_partitions;     // nodes stay put: info is handed out
+NorMockCounters                  s_counters{};
+uint32_t                         s_next_address = 0x10000;
+
+// Injected power loss: cut the operation when s_fail_after reaches 0
+bool                             s_fail_armed = false;
+size_t                           s_fail_after = 0;
+size_t                           s_fail_keep  = 0;
+
+Partition* find(const esp_partition_t* partition)
+{
+    if (!partition)
+        return nullptr;
+    const auto it = s_partitions.find(partition->label);
+    return it != s_partitions.end() && &it->second.info == partition ? &it->second : nullptr;
+}
+
+bool in_range(const Partition& p, size_t offset, size_t size)
+{
+    return offset <= p.data.size() && size <= p.data.size() - offset;
+}
+
+bool cut_now()
+{
+    if (!s_fail_armed || s_fail_after-- != 0)
+        return false;
+    s_fail_armed = false;
+    return true;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Mock control
+// ---------------------------------------------------------------------------
+
+void nor_mock_reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_partitions.clear();
+    s_counters     = {};
+    s_next_address = 0x10000;
+    s_fail_armed   = false;
+}
+
+void nor_mock_add_partition(const char* label, uint32_t size) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition& p = s_partitions[label];
+    p.info = esp_partition_t{};
+    p.info.type       = ESP_PARTITION_TYPE_DATA;
+    p.info.subtype    = static_cast<esp_partition_subtype_t>(0x40);
+    p.info.address    = s_next_address;
+    p.info.size       = size;
+    p.info.erase_size = NOR_MOCK_SECTOR_SIZE;
+    std::strncpy(p.info.label, label, sizeof(p.info.label) - 1);
+    p.data.assign(size, 0xFF);
+    p.erases.assign(size / NOR_MOCK_SECTOR_SIZE, 0);
+    s_next_address += size;
+}
+
+NorMockCounters nor_mock_counters() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_counters;
+}
+
+size_t nor_mock_sector_erases(const char* label, size_t sector) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(label);
+    if (it == s_partitions.end() || sector >= it->second.erases.size())
+        return 0;
+    return it->second.erases[sector];
+}
+
+uint8_t* nor_mock_data(const char* label) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(label);
+    return it != s_partitions.end() ? it->second.data.data() : nullptr;
+}
+
+void nor_mock_fail_after(size_t after, size_t keep) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_fail_armed = true;
+    s_fail_after = after;
+    s_fail_keep  = keep;
+}
+
+// ---------------------------------------------------------------------------
+// esp_partition
+// ---------------------------------------------------------------------------
+
+extern "C" const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                           esp_partition_subtype_t subtype,
+                                                           const char* label)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (auto& [name, p] : s_partitions) {
+        if (label && name != label)
+            continue;
+        if (type != ESP_PARTITION_TYPE_ANY && p.info.type != type)
+            continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p.info.subtype != subtype)
+            continue;
+        return &p.info;
+    }
+    return nullptr;
+}
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset,
+                                        void* dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = find(partition);
+    if (!p || !dst)
+        return ESP_ERR_INVALID_ARG;
+    if (!in_range(*p, src_offset, size))
+        return ESP_ERR_INVALID_SIZE;
+    std::memcpy(dst, p->data.data() + src_offset, size);
+    ++s_counters.reads;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset,
+                                         const void* src, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = find(partition);
+    if (!p || !src)
+        return ESP_ERR_INVALID_ARG;
+    if (!in_range(*p, dst_offset, size))
+        return ESP_ERR_INVALID_SIZE;
+
+    // NOR programming only clears bits
+    const auto* bytes = static_cast<const uint8_t*>(src);
+    uint8_t* flash = p->data.data() + dst_offset;
+    for (size_t i = 0; i < size; ++i) {
+        if ((flash[i] & bytes[i]) != bytes[i]) {
+            ++s_counters.violations;
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    if (cut_now()) {
+        for (size_t i = 0; i < size && i < s_fail_keep; ++i)
+            flash[i] &= bytes[i];
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < size; ++i)
+        flash[i] &= bytes[i];
+    ++s_counters.writes;
+    s_counters.bytes_written += size;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset,
+                                               size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = find(partition);
+    if (!p)
+        return ESP_ERR_INVALID_ARG;
+    if (offset % NOR_MOCK_SECTOR_SIZE != 0 || size % NOR_MOCK_SECTOR_SIZE != 0)
+        return ESP_ERR_INVALID_ARG;
+    if (!in_range(*p, offset, size))
+        return ESP_ERR_INVALID_SIZE;
+
+    if (cut_now()) {
+        std::memset(p->data.data() + offset, 0xFF, size / 2);
+        return ESP_FAIL;
+    }
+    std::memset(p->data.data() + offset, 0xFF, size);
+    for (size_t s = offset / NOR_MOCK_SECTOR_SIZE; s < (offset + size) / NOR_MOCK_SECTOR_SIZE; ++s)
+        ++p->erases[s];
+    s_counters.erases += size / NOR_MOCK_SECTOR_SIZE;
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Host-side NOR flash behind the esp_partition API. Like the real chip, an
+// erase sets a whole sector to 0xFF and a write can only clear bits: a write
+// that would turn a 0 bit back into 1 is rejected and counted, so tests can
+// assert that code never relies on it.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+
+constexpr uint32_t NOR_MOCK_SECTOR_SIZE = 4096;
+
+struct NorMockCounters
+{
+    size_t reads;           // esp_partition_read()
+    size_t writes;          // esp_partition_write() that reached the flash
+    size_t bytes_written;
+    size_t erases;          // sectors erased
+    size_t violations;      // writes rejected for setting a bit 0 -> 1
+};
+
+// Drops all partitions and counters
+void nor_mock_reset() noexcept;
+
+// Adds an erased data partition of size bytes (a multiple of the sector size)
+void nor_mock_add_partition(const char *label, uint32_t size) noexcept;
+
+// Counters since the last reset
+NorMockCounters nor_mock_counters() noexcept;
+
+// Erase count of one sector of a partition
+size_t nor_mock_sector_erases(const char *label, size_t sector) noexcept;
+
+// Raw partition contents, for tests that inspect or corrupt the layout
+uint8_t *nor_mock_data(const char *label) noexcept;
+
+// Power loss: the write or erase after `after` more successful ones is cut
+// short and fails with ESP_FAIL, once. A cut write stores only its first
+// `keep` bytes; a cut erase erases only the first half of the range.
+void nor_mock_fail_after(size_t after, size_t keep = 0) noexcept;
@@ -51,6 +51,11 @@ public:
                        const char* key,
                        uint32_t value);
 
+    // ESP_OK also when the key does not exist; fails with the injected write error
+    esp_err_t EraseKey(const char* partition,
+                       const char* namespace_name,
+                       const char* key);
+
     // Reset all stored values and injected errors — call between tests to ensure isolation
     void reset() noexcept
     {
@@ -58,6 +63,8 @@ public:
         storage_.clear();
         not_found_err_ = ESP_OK;
         read_err_      = ESP_OK;
+        write_err_     = ESP_OK;
+        writes_        = 0;
     }
 
     // Set error returned for missing keys (default: ESP_OK for strings, NOT_FOUND for blobs/u32).
@@ -68,6 +75,16 @@ public:
     // Use to test NVM failure propagation paths (e.g. ESP_ERR_NO_MEM).
     void set_read_err(esp_err_t err) noexcept { read_err_ = err; }
 
+    // Inject an error returned by all Write* calls; nothing is stored
+    void set_write_err(esp_err_t err) noexcept { write_err_ = err; }
+
+    // Successful Write* calls since the last reset
+    size_t write_count() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return writes_;
+    }
+
 private:
     NVMWrapper() = default;
     ~NVMWrapper() = default;
@@ -77,6 +94,8 @@ private:
     std::unordered_map<std::string, std::string> storage_;
     esp_err_t not_found_err_ = ESP_OK;
     esp_err_t read_err_      = ESP_OK;
+    esp_err_t write_err_     = ESP_OK;
+    size_t    writes_        = 0;
 };
 
 // Global instance of NVMWrapper
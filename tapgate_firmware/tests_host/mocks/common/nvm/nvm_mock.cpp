@@ -54,7 +54,9 @@ esp_err_t NVMWrapper::WriteString(const char* partition,
                                   const char* value)
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    if (write_err_ != ESP_OK) return write_err_;
     storage_[make_key(partition, namespace_name, key)] = value ? value : std::string();
+    ++writes_;
     return ESP_OK;
 }
 
@@ -94,8 +96,10 @@ esp_err_t NVMWrapper::WriteBlob(const char* partition,
         return ESP_ERR_INVALID_ARG;
 
     std::lock_guard<std::mutex> lock(mutex_);
+    if (write_err_ != ESP_OK) return write_err_;
     storage_[make_key(partition, namespace_name, key)] =
         std::string(static_cast<const char*>(value), size);
+    ++writes_;
     return ESP_OK;
 }
 
@@ -133,6 +137,22 @@ esp_err_t NVMWrapper::WriteU32(const char* partition,
     std::memcpy(bytes.data(), &value, sizeof(uint32_t));
 
     std::lock_guard<std::mutex> lock(mutex_);
+    if (write_err_ != ESP_OK) return write_err_;
     storage_[make_key(partition, namespace_name, key)] = std::move(bytes);
+    ++writes_;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Erase
+// ---------------------------------------------------------------------------
+
+esp_err_t NVMWrapper::EraseKey(const char* partition,
+                               const char* namespace_name,
+                               const char* key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (write_err_ != ESP_OK) return write_err_;
+    storage_.erase(make_key(partition, namespace_name, key));
     return ESP_OK;
 }
@@ -0,0 +1,67 @@
+#pragma once
+
+// NVMWriter mock over the NVMWrapper mock: a write is stored at once, or held
+// in the queue until Flush() while hold(true) is set. Only the API the
+// code under test uses.
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "device_err.h"
+
+class NVMWriter
+{
+public:
+    using Token = uint32_t;
+
+    static constexpr size_t VALUE_CAP = 128;
+
+    static NVMWriter& getInstance() noexcept;
+
+    NVMWriter(const NVMWriter&)            = delete;
+    NVMWriter& operator=(const NVMWriter&) = delete;
+
+    esp_err_t Start() noexcept { return ESP_OK; }
+
+    esp_err_t WriteBlob(const char *partition, const char *namespace_name, const char *key,
+                        const void *value, size_t size, Token *token = nullptr) noexcept;
+
+    // ESP_ERR_NOT_FINISHED while held, then the result of the NVM mock write
+    [[nodiscard]] esp_err_t Status(Token token) const noexcept;
+    esp_err_t Flush() noexcept;
+
+    // Drop queued writes (they fail) and the hold — call between tests
+    void reset() noexcept;
+    // Keep writes queued until Flush()
+    void hold(bool on) noexcept;
+    // Writes queued and not yet stored
+    [[nodiscard]] size_t Pending() const noexcept;
+
+private:
+    NVMWriter() = default;
+    ~NVMWriter() = default;
+
+    struct Write
+    {
+        Token       token;
+        std::string partition;
+        std::string namespace_name;
+        std::string key;
+        std::string value;
+    };
+
+    // mutex_ must be held
+    void StoreLocked(const Write &w) noexcept;
+
+    mutable std::mutex                   mutex_;
+    std::vector<Write>                   queue_;
+    std::unordered_map<Token, esp_err_t> results_;
+    Token                                next_token_ = 1;
+    bool                                 hold_       = false;
+};
+
+// Global instance of NVMWriter
+extern NVMWriter& NVMAsync;
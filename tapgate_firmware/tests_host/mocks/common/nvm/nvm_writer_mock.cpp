@@ -0,0 +1,79 @@
+#include "nvm_writer.h"
+#include "nvm.h"
+
+NVMWriter& NVMWriter::getInstance() noexcept
+{
+    static NVMWriter inst;
+    return inst;
+}
+
+NVMWriter& NVMAsync = NVMWriter::getInstance();
+
+esp_err_t NVMWriter::WriteBlob(const char *partition, const char *namespace_name, const char *key,
+                               const void *value, size_t size, Token *token) noexcept
+{
+    if (!partition || !namespace_name || !key || !value)
+        return ESP_ERR_INVALID_ARG;
+    if (size > VALUE_CAP)
+        return ESP_ERR_INVALID_SIZE;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Write w{next_token_++, partition, namespace_name, key,
+            std::string(static_cast<const char*>(value), size)};
+    if (token)
+        *token = w.token;
+    if (hold_)
+        queue_.push_back(std::move(w));
+    else
+        StoreLocked(w);
+    return ESP_OK;
+}
+
+esp_err_t NVMWriter::Status(Token token) const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = results_.find(token);
+    return it == results_.end() ? ESP_ERR_NOT_FINISHED : it->second;
+}
+
+esp_err_t NVMWriter::Flush() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_err_t first = ESP_OK;
+    for (const Write &w : queue_)
+    {
+        StoreLocked(w);
+        if (first == ESP_OK)
+            first = results_[w.token];
+    }
+    queue_.clear();
+    return first;
+}
+
+void NVMWriter::reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Dropped writes fail, so a caller still waiting for one stores again
+    for (const Write &w : queue_)
+        results_[w.token] = ESP_FAIL;
+    queue_.clear();
+    hold_ = false;
+}
+
+void NVMWriter::hold(bool on) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    hold_ = on;
+}
+
+size_t NVMWriter::Pending() const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void NVMWriter::StoreLocked(const Write &w) noexcept
+{
+    results_[w.token] = NVM.WriteBlob(w.partition.c_str(), w.namespace_name.c_str(), w.key.c_str(),
+                                      w.value.data(), w.value.size());
+}
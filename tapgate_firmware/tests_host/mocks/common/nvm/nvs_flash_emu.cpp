@@ -0,0 +1,1055 @@
+#include "nvs_flash_emu.h"
+#include "nor_flash_mock.h"
+
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "crc32.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t   PAGE_SIZE     = NVS_EMU_PAGE_SIZE;
+constexpr size_t   ENTRY_COUNT   = NVS_EMU_ENTRIES_PER_PAGE;
+constexpr size_t   ENTRY_SIZE    = 32;
+constexpr size_t   BITMAP_OFFSET = 32;
+constexpr size_t   ENTRY_OFFSET  = 64;
+constexpr uint8_t  PAGE_VERSION  = 0xFE;
+constexpr uint8_t  NS_INDEX_NONE = 0xFF;      // namespace 0: namespace items
+constexpr size_t   NONE          = SIZE_MAX;
+
+static_assert(ENTRY_OFFSET + ENTRY_COUNT * ENTRY_SIZE == PAGE_SIZE);
+
+// Page and entry states only ever clear bits
+enum : uint32_t
+{
+    PAGE_UNINITIALIZED = 0xFFFFFFFF,
+    PAGE_ACTIVE        = 0xFFFFFFFE,
+    PAGE_FULL          = 0xFFFFFFFC,
+    PAGE_FREEING       = 0xFFFFFFF8,
+};
+
+enum : uint8_t
+{
+    ENTRY_EMPTY   = 0x3,
+    ENTRY_WRITTEN = 0x2,
+    ENTRY_ERASED  = 0x0,
+};
+
+// NVS item types (the nvs_type_t codes)
+enum : uint8_t
+{
+    TYPE_U8   = NVS_TYPE_U8,
+    TYPE_U32  = NVS_TYPE_U32,
+    TYPE_U64  = NVS_TYPE_U64,
+    TYPE_STR  = NVS_TYPE_STR,
+    TYPE_BLOB = NVS_TYPE_BLOB,
+};
+
+struct PageHeader
+{
+    uint32_t state;
+    uint32_t seq;
+    uint8_t  version;
+    uint8_t  unused[19];
+    uint32_t crc;               // of seq .. unused
+};
+static_assert(sizeof(PageHeader) == 32);
+
+struct Item
+{
+    uint8_t  ns;
+    uint8_t  type;
+    uint8_t  span;              // entries, data entries included
+    uint8_t  chunk;             // 0xFF
+    uint32_t crc;               // of the item without this field
+    char     key[NVS_KEY_NAME_MAX_SIZE];
+    union
+    {
+        uint8_t raw[8];         // U8, U32, U64: little endian, padded with 0xFF
+        struct
+        {
+            uint16_t size;
+            uint16_t reserved;  // 0xFFFF
+            uint32_t data_crc;
+        } var;
+    } data;
+};
+static_assert(sizeof(Item) == ENTRY_SIZE);
+
+struct Page
+{
+    uint32_t state = PAGE_UNINITIALIZED;
+    uint32_t seq   = 0;
+    uint8_t  entries[ENTRY_COUNT];
+    size_t   next_free = 0;     // entries are written in order
+    size_t   used      = 0;     // WRITTEN
+    size_t   erased    = 0;     // ERASED
+};
+
+struct Key
+{
+    uint8_t     ns;
+    uint8_t     type;
+    std::string key;
+
+    bool operator<(const Key& o) const
+    {
+        if (ns != o.ns)
+            return ns < o.ns;
+        if (type != o.type)
+            return type < o.type;
+        return key < o.key;
+    }
+};
+
+struct Location
+{
+    size_t page;
+    size_t entry;
+    uint8_t span;
+};
+
+struct Partition
+{
+    const esp_partition_t*         flash = nullptr;
+    bool                           mounted = false;
+    std::vector<Page>              pages;
+    size_t                         active = NONE;
+    uint32_t                       next_seq = 0;
+    std::map<std::string, uint8_t> namespaces;
+    std::map<Key, Location>        index;
+    NvsEmuStats                    stats{};
+};
+
+struct Handle
+{
+    std::string     partition;
+    std::string     namespace_name;
+    uint8_t         ns;
+    nvs_open_mode_t mode;
+};
+
+std::mutex                     s_mutex;
+std::map<std::string, Partition> s_partitions;
+std::map<nvs_handle_t, Handle> s_handles;
+nvs_handle_t                   s_next_handle = 1;
+
+bool valid_name(const char* name, size_t max_size)
+{
+    return name && name[0] != '\0' && std::strlen(name) < max_size;
+}
+
+bool is_variable(uint8_t type)
+{
+    return type == TYPE_STR || type == TYPE_BLOB;
+}
+
+size_t data_entries(size_t size)
+{
+    return (size + ENTRY_SIZE - 1) / ENTRY_SIZE;
+}
+
+uint32_t item_crc(const Item& item)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&item);
+    uint32_t crc = crc32_init(0);
+    crc = crc32_update(crc, bytes, offsetof(Item, crc));
+    crc = crc32_update(crc, bytes + offsetof(Item, key), sizeof(Item) - offsetof(Item, key));
+    return crc32_finalize(crc);
+}
+
+uint32_t header_crc(const PageHeader& header)
+{
+    return crc32_calculate(reinterpret_cast<const uint8_t*>(&header) + offsetof(PageHeader, seq),
+                           offsetof(PageHeader, crc) - offsetof(PageHeader, seq));
+}
+
+size_t entry_offset(size_t page, size_t entry)
+{
+    return page * PAGE_SIZE + ENTRY_OFFSET + entry * ENTRY_SIZE;
+}
+
+// ---------------------------------------------------------------------------
+// Flash access
+// ---------------------------------------------------------------------------
+
+esp_err_t write_page_state(Partition& p, size_t page, uint32_t state)
+{
+    const esp_err_t err = esp_partition_write(p.flash, page * PAGE_SIZE, &state, sizeof(state));
+    if (err == ESP_OK)
+        p.pages[page].state = state;
+    return err;
+}
+
+esp_err_t erase_page(Partition& p, size_t page)
+{
+    const esp_err_t err = esp_partition_erase_range(p.flash, page * PAGE_SIZE, PAGE_SIZE);
+    if (err != ESP_OK)
+        return err;
+    p.pages[page] = Page{};
+    std::memset(p.pages[page].entries, ENTRY_EMPTY, ENTRY_COUNT);
+    ++p.stats.page_erases;
+    p.stats.max_page_erases = std::max(p.stats.max_page_erases,
+                                       nor_mock_sector_erases(p.flash->label, page));
+    return ESP_OK;
+}
+
+esp_err_t init_page(Partition& p, size_t page)
+{
+    PageHeader header;
+    std::memset(&header, 0xFF, sizeof(header));
+    header.state   = PAGE_ACTIVE;
+    header.seq     = p.next_seq++;
+    header.version = PAGE_VERSION;
+    header.crc     = header_crc(header);
+    const esp_err_t err = esp_partition_write(p.flash, page * PAGE_SIZE, &header, sizeof(header));
+    if (err != ESP_OK)
+        return err;
+    Page& pg = p.pages[page];
+    pg.state = PAGE_ACTIVE;
+    pg.seq   = header.seq;
+    return ESP_OK;
+}
+
+// Sets the state of entries [first, first + count) and writes the bitmap
+// words they are in
+esp_err_t set_entry_states(Partition& p, size_t page, size_t first, size_t count, uint8_t state)
+{
+    Page& pg = p.pages[page];
+    for (size_t i = first; i < first + count; ++i) {
+        if (pg.entries[i] == ENTRY_WRITTEN)
+            --pg.used;
+        else if (pg.entries[i] == ENTRY_ERASED)
+            --pg.erased;
+        pg.entries[i] = state;
+        if (state == ENTRY_WRITTEN)
+            ++pg.used;
+        else if (state == ENTRY_ERASED)
+            ++pg.erased;
+    }
+
+    // 16 entries per 32-bit word
+    for (size_t word = first / 16; word <= (first + count - 1) / 16; ++word) {
+        uint32_t bits = 0xFFFFFFFF;
+        for (size_t i = 0; i < 16 && word * 16 + i < ENTRY_COUNT; ++i) {
+            const uint32_t s = pg.entries[word * 16 + i];
+            bits &= ~(static_cast<uint32_t>(0x3 & ~s) << (2 * i));
+        }
+        const esp_err_t err = esp_partition_write(p.flash, page * PAGE_SIZE + BITMAP_OFFSET + word * 4,
+                                                  &bits, sizeof(bits));
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_OK;
+}
+
+esp_err_t read_item(const Partition& p, const Location& loc, Item& item)
+{
+    return esp_partition_read(p.flash, entry_offset(loc.page, loc.entry), &item, sizeof(item));
+}
+
+esp_err_t read_data(const Partition& p, const Location& loc, const Item& item, void* out)
+{
+    return esp_partition_read(p.flash, entry_offset(loc.page, loc.entry + 1), out, item.data.var.size);
+}
+
+// Writes item and its data entries at the next free entries of a page that
+// has room for them, then marks them WRITTEN
+esp_err_t put_entries(Partition& p, size_t page, const Item& item, const void* data, size_t& entry)
+{
+    Page& pg = p.pages[page];
+    entry = pg.next_free;
+    esp_err_t err = esp_partition_write(p.flash, entry_offset(page, entry), &item, sizeof(item));
+    if (err == ESP_OK && item.span > 1) {
+        // The data entries, the tail padded with 0xFF
+        const size_t size = item.data.var.size;
+        const size_t whole = size / ENTRY_SIZE * ENTRY_SIZE;
+        if (whole != 0)
+            err = esp_partition_write(p.flash, entry_offset(page, entry + 1), data, whole);
+        if (err == ESP_OK && whole != size) {
+            uint8_t tail[ENTRY_SIZE];
+            std::memset(tail, 0xFF, sizeof(tail));
+            std::memcpy(tail, static_cast<const uint8_t*>(data) + whole, size - whole);
+            err = esp_partition_write(p.flash, entry_offset(page, entry + 1) + whole, tail, sizeof(tail));
+        }
+    }
+    // Entries are used even if the write failed part way
+    pg.next_free += item.span;
+    if (err != ESP_OK) {
+        (void)set_entry_states(p, page, entry, item.span, ENTRY_ERASED);
+        return err;
+    }
+    return set_entry_states(p, page, entry, item.span, ENTRY_WRITTEN);
+}
+
+// ---------------------------------------------------------------------------
+// Page management
+// ---------------------------------------------------------------------------
+
+size_t free_pages(const Partition& p)
+{
+    return static_cast<size_t>(std::count_if(p.pages.begin(), p.pages.end(),
+        [](const Page& pg) { return pg.state == PAGE_UNINITIALIZED; }));
+}
+
+// Copies the live items of page src to page dst and updates the index
+esp_err_t copy_items(Partition& p, size_t src, size_t dst)
+{
+    std::vector<std::pair<Key, Location>> live;
+    for (const auto& [key, loc] : p.index) {
+        if (loc.page == src)
+            live.emplace_back(key, loc);
+    }
+    std::sort(live.begin(), live.end(),
+              [](const auto& a, const auto& b) { return a.second.entry < b.second.entry; });
+
+    uint8_t data[(ENTRY_COUNT - 1) * ENTRY_SIZE];
+    for (const auto& [key, loc] : live) {
+        Item item;
+        esp_err_t err = read_item(p, loc, item);
+        if (err == ESP_OK && item.span > 1)
+            err = read_data(p, loc, item, data);
+        size_t entry = 0;
+        if (err == ESP_OK)
+            err = put_entries(p, dst, item, data, entry);
+        if (err != ESP_OK)
+            return err;
+        p.index[key] = Location{dst, entry, item.span};
+        p.stats.entries_copied += item.span;
+    }
+    return ESP_OK;
+}
+
+// Makes a page with room ACTIVE: a free page while two or more are free,
+// otherwise the reserve, after garbage collecting into it
+esp_err_t request_page(Partition& p)
+{
+    const size_t free = free_pages(p);
+    if (free == 0)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+    auto first_free = [&p]() {
+        for (size_t i = 0; i < p.pages.size(); ++i) {
+            if (p.pages[i].state == PAGE_UNINITIALIZED)
+                return i;
+        }
+        return NONE;
+    };
+
+    if (free >= 2) {
+        const size_t page = first_free();
+        const esp_err_t err = init_page(p, page);
+        if (err == ESP_OK)
+            p.active = page;
+        return err;
+    }
+
+    // The FULL page with the most erased entries
+    size_t victim = NONE;
+    for (size_t i = 0; i < p.pages.size(); ++i) {
+        const Page& pg = p.pages[i];
+        if (pg.state == PAGE_FULL && pg.erased != 0 &&
+            (victim == NONE || pg.erased > p.pages[victim].erased))
+            victim = i;
+    }
+    if (victim == NONE)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+    const size_t reserve = first_free();
+    esp_err_t err = write_page_state(p, victim, PAGE_FREEING);
+    if (err == ESP_OK)
+        err = init_page(p, reserve);
+    if (err == ESP_OK)
+        err = copy_items(p, victim, reserve);
+    if (err == ESP_OK)
+        err = erase_page(p, victim);
+    if (err != ESP_OK)
+        return err;
+    p.active = reserve;
+    ++p.stats.gc_runs;
+    return ESP_OK;
+}
+
+// An active page with span free entries
+esp_err_t reserve_entries(Partition& p, size_t span)
+{
+    for (size_t attempts = 0; attempts <= p.pages.size(); ++attempts) {
+        if (p.active != NONE && ENTRY_COUNT - p.pages[p.active].next_free >= span)
+            return ESP_OK;
+        if (p.active != NONE) {
+            const esp_err_t err = write_page_state(p, p.active, PAGE_FULL);
+            if (err != ESP_OK)
+                return err;
+            p.active = NONE;
+        }
+        const esp_err_t err = request_page(p);
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+esp_err_t erase_item(Partition& p, std::map<Key, Location>::iterator it)
+{
+    const Location loc = it->second;
+    p.index.erase(it);
+    return set_entry_states(p, loc.page, loc.entry, loc.span, ENTRY_ERASED);
+}
+
+// Writes a new item for key, then erases the previous one
+esp_err_t write_item(Partition& p, uint8_t ns, uint8_t type, const char* key,
+                     const void* data, size_t size)
+{
+    Item item;
+    std::memset(&item, 0xFF, sizeof(item));
+    item.ns    = ns;
+    item.type  = type;
+    item.chunk = 0xFF;
+    std::memset(item.key, 0, sizeof(item.key));
+    std::strncpy(item.key, key, sizeof(item.key) - 1);
+    if (is_variable(type)) {
+        if (1 + data_entries(size) > ENTRY_COUNT)
+            return ESP_ERR_NVS_VALUE_TOO_LONG;
+        item.span               = static_cast<uint8_t>(1 + data_entries(size));
+        item.data.var.size      = static_cast<uint16_t>(size);
+        item.data.var.reserved  = 0xFFFF;
+        item.data.var.data_crc  = crc32_calculate(static_cast<const uint8_t*>(data), size);
+    } else {
+        item.span = 1;
+        std::memcpy(item.data.raw, data, size);
+    }
+    item.crc = item_crc(item);
+
+    esp_err_t err = reserve_entries(p, item.span);
+    if (err != ESP_OK)
+        return err;
+
+    // GC may have moved the previous item: look it up afterwards
+    const Key k{ns, type, key};
+    size_t entry = 0;
+    const size_t page = p.active;
+    err = put_entries(p, page, item, data, entry);
+    if (err != ESP_OK)
+        return err;
+    ++p.stats.items_written;
+    p.stats.entries_written += item.span;
+
+    const auto old = p.index.find(k);
+    if (old != p.index.end())
+        err = erase_item(p, old);
+    p.index[k] = Location{page, entry, item.span};
+    return err;
+}
+
+// ---------------------------------------------------------------------------
+// Mount
+// ---------------------------------------------------------------------------
+
+// Reads every page: headers, bitmaps and items. Items with a bad CRC, entries
+// written but not marked and older duplicates of a key are erased; a page
+// left FREEING by a reset during GC is collected again.
+esp_err_t mount(Partition& p)
+{
+    p.pages.assign(p.flash->size / PAGE_SIZE, Page{});
+    p.index.clear();
+    p.namespaces.clear();
+    p.active   = NONE;
+    p.next_seq = 0;
+
+    struct Found { Key key; Location loc; uint32_t seq; };
+    std::vector<Found> found;
+
+    for (size_t page = 0; page < p.pages.size(); ++page) {
+        Page& pg = p.pages[page];
+        std::memset(pg.entries, ENTRY_EMPTY, ENTRY_COUNT);
+
+        uint8_t raw[PAGE_SIZE];
+        esp_err_t err = esp_partition_read(p.flash, page * PAGE_SIZE, raw, sizeof(raw));
+        if (err != ESP_OK)
+            return err;
+        PageHeader header;
+        std::memcpy(&header, raw, sizeof(header));
+
+        const bool known = header.state == PAGE_ACTIVE || header.state == PAGE_FULL ||
+                           header.state == PAGE_FREEING;
+        if (!known || header.crc != header_crc(header)) {
+            // Erased, torn or foreign: erase unless already blank
+            const bool blank = std::all_of(raw, raw + PAGE_SIZE, [](uint8_t b) { return b == 0xFF; });
+            if (!blank && (err = erase_page(p, page)) != ESP_OK)
+                return err;
+            continue;
+        }
+
+        pg.state = header.state;
+        pg.seq   = header.seq;
+        p.next_seq = std::max(p.next_seq, header.seq + 1);
+        for (size_t i = 0; i < ENTRY_COUNT; ++i) {
+            const uint8_t s = (raw[BITMAP_OFFSET + i / 4] >> (2 * (i % 4))) & 0x3;
+            pg.entries[i] = s == ENTRY_EMPTY || s == ENTRY_WRITTEN ? s : static_cast<uint8_t>(ENTRY_ERASED);
+            if (pg.entries[i] == ENTRY_WRITTEN)
+                ++pg.used;
+            else if (pg.entries[i] == ENTRY_ERASED)
+                ++pg.erased;
+            if (pg.entries[i] != ENTRY_EMPTY)
+                pg.next_free = i + 1;
+        }
+        // A write cut before its entries were marked: not EMPTY on flash
+        for (size_t i = 0; i < ENTRY_COUNT; ++i) {
+            if (pg.entries[i] != ENTRY_EMPTY)
+                continue;
+            const uint8_t* e = raw + ENTRY_OFFSET + i * ENTRY_SIZE;
+            if (std::any_of(e, e + ENTRY_SIZE, [](uint8_t b) { return b != 0xFF; })) {
+                pg.next_free = std::max(pg.next_free, i + 1);
+                if ((err = set_entry_states(p, page, i, 1, ENTRY_ERASED)) != ESP_OK)
+                    return err;
+            }
+        }
+
+        for (size_t i = 0; i < ENTRY_COUNT;) {
+            if (pg.entries[i] != ENTRY_WRITTEN) {
+                ++i;
+                continue;
+            }
+            Item item;
+            std::memcpy(&item, raw + ENTRY_OFFSET + i * ENTRY_SIZE, sizeof(item));
+            bool valid = item.crc == item_crc(item) && item.span >= 1 && i + item.span <= ENTRY_COUNT;
+            if (valid && is_variable(item.type)) {
+                valid = item.span == 1 + data_entries(item.data.var.size) &&
+                        item.data.var.data_crc == crc32_calculate(raw + ENTRY_OFFSET + (i + 1) * ENTRY_SIZE,
+                                                                   item.data.var.size);
+            }
+            if (!valid) {
+                if ((err = set_entry_states(p, page, i, 1, ENTRY_ERASED)) != ESP_OK)
+                    return err;
+                ++i;
+                continue;
+            }
+            item.key[sizeof(item.key) - 1] = '\0';
+            found.push_back(Found{Key{item.ns, item.type, item.key}, Location{page, i, item.span}, pg.seq});
+            i += item.span;
+        }
+    }
+
+    // Older duplicates (an update cut before the old item was erased)
+    std::stable_sort(found.begin(), found.end(),
+                     [](const Found& a, const Found& b) { return a.seq < b.seq; });
+    for (const Found& f : found) {
+        const auto old = p.index.find(f.key);
+        if (old != p.index.end()) {
+            const esp_err_t err = erase_item(p, old);
+            if (err != ESP_OK)
+                return err;
+        }
+        p.index[f.key] = f.loc;
+    }
+    for (const auto& [key, loc] : p.index) {
+        if (key.ns == 0 && key.type == TYPE_U8) {
+            Item item;
+            const esp_err_t err = read_item(p, loc, item);
+            if (err != ESP_OK)
+                return err;
+            p.namespaces[key.key] = item.data.raw[0];
+        }
+    }
+
+    // One ACTIVE page: the newest; older ones are FULL
+    for (size_t i = 0; i < p.pages.size(); ++i) {
+        if (p.pages[i].state != PAGE_ACTIVE)
+            continue;
+        if (p.active == NONE || p.pages[i].seq > p.pages[p.active].seq) {
+            if (p.active != NONE && write_page_state(p, p.active, PAGE_FULL) != ESP_OK)
+                return ESP_FAIL;
+            p.active = i;
+        } else if (write_page_state(p, i, PAGE_FULL) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
+    // Finish an interrupted GC
+    for (size_t i = 0; i < p.pages.size(); ++i) {
+        if (p.pages[i].state != PAGE_FREEING)
+            continue;
+        size_t live = 0;
+        for (const auto& [key, loc] : p.index)
+            live += loc.page == i ? loc.span : 0;
+        esp_err_t err = reserve_entries(p, live != 0 ? live : 1);
+        if (err == ESP_OK)
+            err = copy_items(p, i, p.active);
+        if (err == ESP_OK)
+            err = erase_page(p, i);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    if (free_pages(p) == 0)
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    if (p.active == NONE)
+        return request_page(p);
+    return ESP_OK;
+}
+
+Partition* mounted_partition(const std::string& label)
+{
+    const auto it = s_partitions.find(label);
+    return it != s_partitions.end() && it->second.mounted ? &it->second : nullptr;
+}
+
+void drop_handles(const std::string& partition)
+{
+    for (auto it = s_handles.begin(); it != s_handles.end();) {
+        if (it->second.partition == partition)
+            it = s_handles.erase(it);
+        else
+            ++it;
+    }
+}
+
+// Partition and namespace of an open handle
+Partition* handle_partition(nvs_handle_t handle, const Handle** out)
+{
+    const auto it = s_handles.find(handle);
+    if (it == s_handles.end())
+        return nullptr;
+    *out = &it->second;
+    return mounted_partition(it->second.partition);
+}
+
+esp_err_t set_value(nvs_handle_t handle, const char* key, uint8_t type, const void* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Partition* p = handle_partition(handle, &h);
+    if (!p)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+    if (!key || key[0] == '\0')
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    for (const uint8_t other : {TYPE_U8, TYPE_U32, TYPE_U64, TYPE_STR, TYPE_BLOB}) {
+        if (other != type && p->index.count(Key{h->ns, other, key}) != 0)
+            return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    return write_item(*p, h->ns, type, key, data, size);
+}
+
+esp_err_t get_fixed(nvs_handle_t handle, const char* key, uint8_t type, void* out, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Partition* p = handle_partition(handle, &h);
+    if (!p)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    const auto it = p->index.find(Key{h->ns, type, key});
+    if (it == p->index.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    Item item;
+    const esp_err_t err = read_item(*p, it->second, item);
+    if (err != ESP_OK)
+        return err;
+    std::memcpy(out, item.data.raw, size);
+    return ESP_OK;
+}
+
+esp_err_t get_variable(nvs_handle_t handle, const char* key, uint8_t type, void* out, size_t* length)
+{
+    if (!length)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Partition* p = handle_partition(handle, &h);
+    if (!p)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    const auto it = p->index.find(Key{h->ns, type, key});
+    if (it == p->index.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    Item item;
+    esp_err_t err = read_item(*p, it->second, item);
+    if (err != ESP_OK)
+        return err;
+
+    const size_t size = item.data.var.size;
+    if (!out) {
+        *length = size;
+        return ESP_OK;
+    }
+    if (*length < size) {
+        *length = size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    err = read_data(*p, it->second, item, out);
+    if (err == ESP_OK)
+        *length = size;
+    return err;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Emulator control
+// ---------------------------------------------------------------------------
+
+void nvs_emu_reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_partitions.clear();
+    s_handles.clear();
+    s_next_handle = 1;
+    nor_mock_reset();
+}
+
+void nvs_emu_add_partition(const char* label, size_t pages) noexcept
+{
+    nor_mock_add_partition(label, static_cast<uint32_t>(pages * PAGE_SIZE));
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition& p = s_partitions[label];
+    p = Partition{};
+    p.flash = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+}
+
+void nvs_emu_add_default_partitions() noexcept
+{
+    // partitions.csv: 12K, 24K, 52K
+    nvs_emu_add_partition("nvs", 3);
+    nvs_emu_add_partition("nvs_entity", 6);
+    nvs_emu_add_partition("nvs_nonce", 13);
+}
+
+NvsEmuStats nvs_emu_stats(const char* label) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(label ? label : "");
+    return it != s_partitions.end() ? it->second.stats : NvsEmuStats{};
+}
+
+// ---------------------------------------------------------------------------
+// nvs_flash
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_flash_init_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(partition_label);
+    if (it == s_partitions.end() || !it->second.flash)
+        return ESP_ERR_NOT_FOUND;
+    Partition& p = it->second;
+    if (p.mounted)
+        return ESP_OK;
+
+    const esp_err_t err = mount(p);
+    p.mounted = err == ESP_OK;
+    return err;
+}
+
+extern "C" esp_err_t nvs_flash_deinit_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = mounted_partition(partition_label);
+    if (!p)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    drop_handles(partition_label);
+    p->mounted = false;
+    p->index.clear();
+    p->namespaces.clear();
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_flash_erase_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(partition_label);
+    if (it == s_partitions.end() || !it->second.flash)
+        return ESP_ERR_NOT_FOUND;
+    Partition& p = it->second;
+    drop_handles(partition_label);
+    p.mounted = false;
+    p.index.clear();
+    p.namespaces.clear();
+    p.pages.assign(p.flash->size / PAGE_SIZE, Page{});
+    for (size_t page = 0; page < p.pages.size(); ++page) {
+        const esp_err_t err = erase_page(p, page);
+        if (err != ESP_OK)
+            return err;
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats)
+{
+    if (!nvs_stats)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = mounted_partition(part_name ? part_name : "nvs");
+    if (!p)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+
+    *nvs_stats = nvs_stats_t{};
+    for (const Page& pg : p->pages) {
+        nvs_stats->total_entries += ENTRY_COUNT;
+        nvs_stats->used_entries  += pg.used;
+        nvs_stats->free_entries  += pg.state == PAGE_UNINITIALIZED ? ENTRY_COUNT : ENTRY_COUNT - pg.next_free;
+    }
+    // The reserve page is not available for data
+    nvs_stats->available_entries = nvs_stats->free_entries > ENTRY_COUNT ? nvs_stats->free_entries - ENTRY_COUNT : 0;
+    nvs_stats->namespace_count   = p->namespaces.size();
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Handles
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_open_from_partition(const char* part_name, const char* namespace_name,
+                                             nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    if (!out_handle)
+        return ESP_ERR_INVALID_ARG;
+    if (!namespace_name || namespace_name[0] == '\0')
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (std::strlen(namespace_name) >= NVS_NS_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = part_name ? mounted_partition(part_name) : nullptr;
+    if (!p)
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    auto ns = p->namespaces.find(namespace_name);
+    if (ns == p->namespaces.end()) {
+        if (open_mode == NVS_READONLY)
+            return ESP_ERR_NVS_NOT_FOUND;
+        // Namespace indexes 1..254
+        uint8_t index = 1;
+        std::vector<bool> taken(256, false);
+        for (const auto& [name, i] : p->namespaces)
+            taken[i] = true;
+        while (index < NS_INDEX_NONE && taken[index])
+            ++index;
+        if (index == NS_INDEX_NONE)
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        const esp_err_t err = write_item(*p, 0, TYPE_U8, namespace_name, &index, sizeof(index));
+        if (err != ESP_OK)
+            return err;
+        ns = p->namespaces.emplace(namespace_name, index).first;
+    }
+
+    *out_handle = s_next_handle++;
+    s_handles[*out_handle] = Handle{ part_name, namespace_name, ns->second, open_mode };
+    return ESP_OK;
+}
+
+extern "C" void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_handles.erase(handle);
+}
+
+// NVS writes straight through; nothing is buffered
+extern "C" esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_handles.count(handle) != 0 ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+// ---------------------------------------------------------------------------
+// Values
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value)
+{
+    return set_value(handle, key, TYPE_U8, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return set_value(handle, key, TYPE_U32, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_u64(nvs_handle_t handle, const char* key, uint64_t value)
+{
+    return set_value(handle, key, TYPE_U64, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value)
+{
+    if (!value)
+        return ESP_ERR_INVALID_ARG;
+    return set_value(handle, key, TYPE_STR, value, std::strlen(value) + 1);
+}
+
+extern "C" esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    if (!value && length != 0)
+        return ESP_ERR_INVALID_ARG;
+    return set_value(handle, key, TYPE_BLOB, value, length);
+}
+
+extern "C" esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value)
+{
+    return get_fixed(handle, key, TYPE_U8, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)
+{
+    return get_fixed(handle, key, TYPE_U32, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_u64(nvs_handle_t handle, const char* key, uint64_t* out_value)
+{
+    return get_fixed(handle, key, TYPE_U64, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length)
+{
+    return get_variable(handle, key, TYPE_STR, out_value, length);
+}
+
+extern "C" esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    return get_variable(handle, key, TYPE_BLOB, out_value, length);
+}
+
+extern "C" esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Partition* p = handle_partition(handle, &h);
+    if (!p)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+    if (!key)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    for (const uint8_t type : {TYPE_U8, TYPE_U32, TYPE_U64, TYPE_STR, TYPE_BLOB}) {
+        const auto it = p->index.find(Key{h->ns, type, key});
+        if (it != p->index.end())
+            return erase_item(*p, it);
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+extern "C" esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Partition* p = handle_partition(handle, &h);
+    if (!p)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+
+    for (auto it = p->index.begin(); it != p->index.end();) {
+        const auto next = std::next(it);
+        if (it->first.ns == h->ns) {
+            const esp_err_t err = erase_item(*p, it);
+            if (err != ESP_OK)
+                return err;
+        }
+        it = next;
+    }
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Iteration
+// ---------------------------------------------------------------------------
+
+// Entries of a namespace as listed when the iteration started, in flash order
+struct nvs_opaque_iterator_t
+{
+    std::vector<nvs_entry_info_t> entries;
+    size_t                        pos = 0;
+};
+
+extern "C" esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name,
+                                    nvs_type_t type, nvs_iterator_t* output_iterator)
+{
+    if (!part_name || !namespace_name || !output_iterator)
+        return ESP_ERR_INVALID_ARG;
+    *output_iterator = nullptr;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Partition* p = mounted_partition(part_name);
+    if (!p)
+        return ESP_ERR_NVS_NOT_FOUND;
+    const auto ns = p->namespaces.find(namespace_name);
+    if (ns == p->namespaces.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    // Page sequence, then entry: the order NVS walks the flash in
+    std::vector<std::pair<std::pair<uint32_t, size_t>, nvs_entry_info_t>> found;
+    for (const auto& [key, loc] : p->index) {
+        if (key.ns != ns->second || (type != NVS_TYPE_ANY && key.type != type))
+            continue;
+        nvs_entry_info_t info{};
+        std::strncpy(info.namespace_name, namespace_name, sizeof(info.namespace_name) - 1);
+        std::strncpy(info.key, key.key.c_str(), sizeof(info.key) - 1);
+        info.type = static_cast<nvs_type_t>(key.type);
+        found.emplace_back(std::make_pair(p->pages[loc.page].seq, loc.entry), info);
+    }
+    if (found.empty())
+        return ESP_ERR_NVS_NOT_FOUND;
+    std::sort(found.begin(), found.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    auto* it = new nvs_opaque_iterator_t{};
+    for (const auto& entry : found)
+        it->entries.push_back(entry.second);
+    *output_iterator = it;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_entry_next(nvs_iterator_t* iterator)
+{
+    if (!iterator || !*iterator)
+        return ESP_ERR_INVALID_ARG;
+
+    // Like ESP-IDF: past the last entry the iterator is released
+    if (++(*iterator)->pos >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t* out_info)
+{
+    if (!iterator || !out_info)
+        return ESP_ERR_INVALID_ARG;
+    *out_info = iterator->entries[iterator->pos];
+    return ESP_OK;
+}
+
+extern "C" void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    delete iterator;
+}
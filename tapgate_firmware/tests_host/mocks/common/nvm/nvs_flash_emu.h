@@ -0,0 +1,59 @@
+#pragma once
+
+// Host-side NVS emulator: the nvs / nvs_flash C API over NVS pages stored on
+// the NOR flash mock (nor_flash_mock.h), for tests and wear benchmarks that
+// need flash behaviour rather than the key/value map of nvs_mock.cpp. Link
+// one of the two.
+//
+// Modelled on the ESP-IDF NVS layout:
+//   - 4096-byte pages: 32-byte header (state, sequence number, CRC-32), a
+//     32-byte entry state bitmap (2 bits per entry) and 126 entries of 32
+//     bytes
+//   - page states ACTIVE -> FULL -> FREEING -> erased; entry states
+//     EMPTY -> WRITTEN -> ERASED, each a NOR write that only clears bits
+//   - an item is one entry (nsIndex, type, span, key, 8 data bytes, CRC-32);
+//     strings and blobs add ceil(size / 32) data entries after it, in the
+//     same page
+//   - an update writes the new item before it erases the old one
+//   - one free page is kept in reserve: when a new page is needed and only
+//     the reserve is left, the FULL page with the most erased entries is
+//     garbage collected: its live items are copied to the reserve and the
+//     page is erased
+//   - namespaces are items of namespace 0 holding their index
+// Mounting reads every page back from the flash, so data survives a
+// deinit/init as it survives a reset.
+//
+// Differences from ESP-IDF: blobs are stored like strings (one item with data
+// entries, at most a page) rather than as v2 chunks and index; writes of the
+// same type only (a different type is rejected as by nvs_mock.cpp); no
+// encryption. Power loss is recovered only for the cases of Mount() below.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+
+constexpr size_t NVS_EMU_PAGE_SIZE         = 4096;
+constexpr size_t NVS_EMU_ENTRIES_PER_PAGE  = 126;
+
+struct NvsEmuStats
+{
+    size_t items_written;       // items written by nvs_set_*, GC copies excluded
+    size_t entries_written;     // entries of those items (item + data entries)
+    size_t entries_copied;      // entries moved by garbage collection
+    size_t gc_runs;
+    size_t page_erases;         // GC and mount, nvs_flash_erase_partition() included
+    size_t max_page_erases;     // erases of the most erased page
+};
+
+// Drops every partition, handle and counter (also resets the NOR flash mock)
+void nvs_emu_reset() noexcept;
+
+// Adds an erased NVS partition of `pages` pages to the NOR flash mock
+void nvs_emu_add_partition(const char *label, size_t pages) noexcept;
+
+// Adds the partitions of partitions.csv: nvs, nvs_entity, nvs_nonce
+void nvs_emu_add_default_partitions() noexcept;
+
+// Counters of a partition since it was added
+NvsEmuStats nvs_emu_stats(const char *label) noexcept;
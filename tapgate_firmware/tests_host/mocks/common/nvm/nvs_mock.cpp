@@ -0,0 +1,507 @@
+#include "nvs_mock.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class ItemType { U8, U32, U64, STR, BLOB };
+
+struct Item
+{
+    ItemType    type;
+    std::string bytes;      // strings include their '\0'
+    uint64_t    seq;        // write order: entries are iterated in it, like NVS
+};
+
+using Namespace = std::map<std::string, Item>;
+
+struct Partition
+{
+    bool                             initialized = false;
+    std::map<std::string, Namespace> namespaces;
+};
+
+struct Handle
+{
+    std::string     partition;
+    std::string     namespace_name;
+    nvs_open_mode_t mode;
+};
+
+std::mutex                            s_mutex;
+std::map<std::string, Partition>      s_partitions;
+std::map<nvs_handle_t, Handle>        s_handles;
+nvs_handle_t                          s_next_handle = 1;
+uint64_t                              s_next_seq    = 1;
+NvsMockCounters                       s_counters{};
+
+// Injected write failure: fail when s_fail_after reaches 0
+bool                                  s_fail_armed = false;
+size_t                                s_fail_after = 0;
+esp_err_t                             s_fail_err   = ESP_OK;
+
+uint32_t                              s_commit_delay_ms = 0;
+
+bool valid_name(const char* name, size_t max_size)
+{
+    return name && std::strlen(name) < max_size;
+}
+
+// Namespace of a handle, nullptr if the handle is not open
+Namespace* handle_namespace(nvs_handle_t handle, const Handle** out = nullptr)
+{
+    const auto it = s_handles.find(handle);
+    if (it == s_handles.end())
+        return nullptr;
+    if (out)
+        *out = &it->second;
+    return &s_partitions[it->second.partition].namespaces[it->second.namespace_name];
+}
+
+void drop_handles(const std::string& partition)
+{
+    for (auto it = s_handles.begin(); it != s_handles.end();) {
+        if (it->second.partition == partition) {
+            it = s_handles.erase(it);
+            --s_counters.open_handles;
+        } else {
+            ++it;
+        }
+    }
+}
+
+esp_err_t set_item(nvs_handle_t handle, const char* key, ItemType type, const void* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Namespace* ns = handle_namespace(handle, &h);
+    if (!ns)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+    if (!key || key[0] == '\0')
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    const auto it = ns->find(key);
+    if (it != ns->end() && it->second.type != type)
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+
+    if (s_fail_armed && s_fail_after-- == 0) {
+        s_fail_armed = false;
+        return s_fail_err;
+    }
+
+    (*ns)[key] = Item{ type, std::string(static_cast<const char*>(data), size), s_next_seq++ };
+    ++s_counters.writes;
+    return ESP_OK;
+}
+
+// Fixed-size items: size must match exactly
+esp_err_t get_item(nvs_handle_t handle, const char* key, ItemType type, void* out, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Namespace* ns = handle_namespace(handle);
+    if (!ns)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    ++s_counters.reads;
+
+    const auto it = ns->find(key);
+    if (it == ns->end() || it->second.type != type)
+        return ESP_ERR_NVS_NOT_FOUND;
+    std::memcpy(out, it->second.bytes.data(), size);
+    return ESP_OK;
+}
+
+// Variable-size items: out == nullptr queries the length
+esp_err_t get_variable(nvs_handle_t handle, const char* key, ItemType type, void* out, size_t* length)
+{
+    if (!length)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Namespace* ns = handle_namespace(handle);
+    if (!ns)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key || std::strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    ++s_counters.reads;
+
+    const auto it = ns->find(key);
+    if (it == ns->end() || it->second.type != type)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    const std::string& bytes = it->second.bytes;
+    if (!out) {
+        *length = bytes.size();
+        return ESP_OK;
+    }
+    if (*length < bytes.size()) {
+        *length = bytes.size();
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    std::memcpy(out, bytes.data(), bytes.size());
+    *length = bytes.size();
+    return ESP_OK;
+}
+
+nvs_type_t entry_type(ItemType type)
+{
+    switch (type) {
+        case ItemType::U8:   return NVS_TYPE_U8;
+        case ItemType::U32:  return NVS_TYPE_U32;
+        case ItemType::U64:  return NVS_TYPE_U64;
+        case ItemType::STR:  return NVS_TYPE_STR;
+        case ItemType::BLOB: return NVS_TYPE_BLOB;
+    }
+    return NVS_TYPE_ANY;
+}
+
+} // namespace
+
+// Entries of a namespace as listed when the iteration started
+struct nvs_opaque_iterator_t
+{
+    std::string                   namespace_name;
+    std::vector<nvs_entry_info_t> entries;
+    size_t                        pos = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Mock control
+// ---------------------------------------------------------------------------
+
+void nvs_mock_reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_partitions.clear();
+    s_handles.clear();
+    s_next_handle = 1;
+    s_next_seq    = 1;
+    s_counters    = {};
+    s_fail_armed  = false;
+    s_commit_delay_ms = 0;
+}
+
+NvsMockCounters nvs_mock_counters() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_counters;
+}
+
+void nvs_mock_clear_counters() noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const size_t open_handles = s_counters.open_handles;
+    s_counters = {};
+    s_counters.open_handles = open_handles;
+}
+
+void nvs_mock_set_commit_delay(uint32_t delay_ms) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_commit_delay_ms = delay_ms;
+}
+
+void nvs_mock_fail_write(size_t after, esp_err_t err) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_fail_armed = true;
+    s_fail_after = after;
+    s_fail_err   = err;
+}
+
+// ---------------------------------------------------------------------------
+// nvs_flash
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_flash_init_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_partitions[partition_label].initialized = true;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_flash_deinit_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto it = s_partitions.find(partition_label);
+    if (it == s_partitions.end() || !it->second.initialized)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    drop_handles(partition_label);
+    it->second.initialized = false;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_flash_erase_partition(const char* partition_label)
+{
+    if (!valid_name(partition_label, NVS_PART_NAME_MAX_SIZE))
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    // Like ESP-IDF: an initialized partition is deinitialized first, which
+    // invalidates its open handles
+    std::lock_guard<std::mutex> lock(s_mutex);
+    drop_handles(partition_label);
+    s_partitions[partition_label] = Partition{};
+    ++s_counters.erases;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Handles
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_open_from_partition(const char* part_name, const char* namespace_name,
+                                             nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    if (!out_handle)
+        return ESP_ERR_INVALID_ARG;
+    if (!namespace_name || namespace_name[0] == '\0')
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (std::strlen(namespace_name) >= NVS_NS_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto part = part_name ? s_partitions.find(part_name) : s_partitions.end();
+    if (part == s_partitions.end() || !part->second.initialized)
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    auto& namespaces = part->second.namespaces;
+    if (open_mode == NVS_READONLY && namespaces.find(namespace_name) == namespaces.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    namespaces[namespace_name];
+
+    *out_handle = s_next_handle++;
+    s_handles[*out_handle] = Handle{ part_name, namespace_name, open_mode };
+    ++s_counters.opens;
+    ++s_counters.open_handles;
+    return ESP_OK;
+}
+
+extern "C" void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_handles.erase(handle) != 0) {
+        ++s_counters.closes;
+        --s_counters.open_handles;
+    }
+}
+
+extern "C" esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    uint32_t delay_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_handles.find(handle) == s_handles.end())
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        ++s_counters.commits;
+        delay_ms = s_commit_delay_ms;
+    }
+    if (delay_ms != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Values
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value)
+{
+    return set_item(handle, key, ItemType::U8, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return set_item(handle, key, ItemType::U32, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_u64(nvs_handle_t handle, const char* key, uint64_t value)
+{
+    return set_item(handle, key, ItemType::U64, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value)
+{
+    if (!value)
+        return ESP_ERR_INVALID_ARG;
+    return set_item(handle, key, ItemType::STR, value, std::strlen(value) + 1);
+}
+
+extern "C" esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    if (!value && length != 0)
+        return ESP_ERR_INVALID_ARG;
+    return set_item(handle, key, ItemType::BLOB, value, length);
+}
+
+extern "C" esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value)
+{
+    return get_item(handle, key, ItemType::U8, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)
+{
+    return get_item(handle, key, ItemType::U32, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_u64(nvs_handle_t handle, const char* key, uint64_t* out_value)
+{
+    return get_item(handle, key, ItemType::U64, out_value, sizeof(*out_value));
+}
+
+extern "C" esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length)
+{
+    return get_variable(handle, key, ItemType::STR, out_value, length);
+}
+
+extern "C" esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    return get_variable(handle, key, ItemType::BLOB, out_value, length);
+}
+
+extern "C" esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Namespace* ns = handle_namespace(handle, &h);
+    if (!ns)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+    return ns->erase(key ? key : "") != 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+extern "C" esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const Handle* h = nullptr;
+    Namespace* ns = handle_namespace(handle, &h);
+    if (!ns)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (h->mode == NVS_READONLY)
+        return ESP_ERR_NVS_READ_ONLY;
+    ns->clear();
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Iteration
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name,
+                                    nvs_type_t type, nvs_iterator_t* output_iterator)
+{
+    if (!part_name || !namespace_name || !output_iterator)
+        return ESP_ERR_INVALID_ARG;
+    *output_iterator = nullptr;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto part = s_partitions.find(part_name);
+    if (part == s_partitions.end() || !part->second.initialized)
+        return ESP_ERR_NVS_NOT_FOUND;
+    const auto ns = part->second.namespaces.find(namespace_name);
+    if (ns == part->second.namespaces.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    std::vector<std::pair<uint64_t, nvs_entry_info_t>> found;
+    for (const auto& [key, item] : ns->second) {
+        if (type != NVS_TYPE_ANY && entry_type(item.type) != type)
+            continue;
+        nvs_entry_info_t info{};
+        std::strncpy(info.namespace_name, namespace_name, sizeof(info.namespace_name) - 1);
+        std::strncpy(info.key, key.c_str(), sizeof(info.key) - 1);
+        info.type = entry_type(item.type);
+        found.emplace_back(item.seq, info);
+    }
+    if (found.empty())
+        return ESP_ERR_NVS_NOT_FOUND;
+    std::sort(found.begin(), found.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    auto* it = new nvs_opaque_iterator_t{};
+    it->namespace_name = namespace_name;
+    for (const auto& entry : found)
+        it->entries.push_back(entry.second);
+    *output_iterator = it;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_entry_next(nvs_iterator_t* iterator)
+{
+    if (!iterator || !*iterator)
+        return ESP_ERR_INVALID_ARG;
+
+    // Like ESP-IDF: past the last entry the iterator is released
+    if (++(*iterator)->pos >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t* out_info)
+{
+    if (!iterator || !out_info)
+        return ESP_ERR_INVALID_ARG;
+    *out_info = iterator->entries[iterator->pos];
+    return ESP_OK;
+}
+
+extern "C" void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    delete iterator;
+}
+
+// ---------------------------------------------------------------------------
+// Statistics
+// ---------------------------------------------------------------------------
+
+extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats)
+{
+    if (!nvs_stats)
+        return ESP_ERR_INVALID_ARG;
+    *nvs_stats = {};
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const auto part = part_name ? s_partitions.find(part_name) : s_partitions.end();
+    if (part == s_partitions.end() || !part->second.initialized)
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+
+    // One entry per namespace and per item, plus the data entries of
+    // strings and blobs; garbage is never left behind
+    size_t used = 0;
+    for (const auto& [name, ns] : part->second.namespaces) {
+        ++used;
+        for (const auto& [key, item] : ns) {
+            ++used;
+            if (item.type == ItemType::STR || item.type == ItemType::BLOB)
+                used += (item.bytes.size() + 31) / 32;
+        }
+    }
+    nvs_stats->total_entries     = NVS_MOCK_PAGES * 126;
+    nvs_stats->used_entries      = std::min(used, nvs_stats->total_entries);
+    nvs_stats->free_entries      = nvs_stats->total_entries - nvs_stats->used_entries;
+    nvs_stats->available_entries = nvs_stats->free_entries > 126 ? nvs_stats->free_entries - 126 : 0;
+    nvs_stats->namespace_count   = part->second.namespaces.size();
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Host-side NVS (C API) mock: keeps partitions in memory and counts calls,
+// so tests of the real NVMWrapper (main/common/nvm/nvm.cpp) can assert how
+// often it opens handles, writes and commits.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+
+// Pages of 126 entries nvs_get_stats() reports for every partition. Used
+// entries are those the stored items would take in NVS, without garbage.
+constexpr size_t NVS_MOCK_PAGES = 4;
+
+struct NvsMockCounters
+{
+    size_t opens;           // successful nvs_open_from_partition()
+    size_t closes;          // nvs_close() of a valid handle
+    size_t open_handles;    // opens - closes - handles invalidated by deinit/erase
+    size_t reads;           // nvs_get_*
+    size_t writes;          // nvs_set_* that reached storage
+    size_t commits;
+    size_t erases;          // nvs_flash_erase_partition()
+};
+
+// Drops all partitions, handles and counters
+void nvs_mock_reset() noexcept;
+
+// Counters since the last reset
+NvsMockCounters nvs_mock_counters() noexcept;
+
+// Zeroes the counters, keeps the stored data and open handles
+void nvs_mock_clear_counters() noexcept;
+
+// Every nvs_commit() then blocks for delay_ms, like a write that triggers
+// page garbage collection; 0 turns it off
+void nvs_mock_set_commit_delay(uint32_t delay_ms) noexcept;
+
+// The nvs_set_* call after `after` more successful writes fails with err,
+// once, without storing anything
+void nvs_mock_fail_write(size_t after, esp_err_t err) noexcept;
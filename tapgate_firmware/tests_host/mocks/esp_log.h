@@ -10,3 +10,24 @@
     #define ESP_LOGW(tag, fmt, ...) std::printf("[W] " fmt "\n", ##__VA_ARGS__)
     #define ESP_LOGE(tag, fmt, ...) std::printf("[E] " fmt "\n", ##__VA_ARGS__)
 #endif
+#define ESP_LOGD(tag, fmt, ...) ((void)0)
+
+// Runtime-level API used by the journal emit path (journal_emit.cpp). Tests
+// linking it define these functions to capture the console output.
+#include <cstdarg>
+#include <cstdint>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern "C" void     esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...);
+extern "C" void     esp_log_writev(esp_log_level_t level, const char *tag, const char *format, va_list args);
+extern "C" uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...) esp_log_write(level, tag, format, ##__VA_ARGS__)
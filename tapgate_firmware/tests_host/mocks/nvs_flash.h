@@ -0,0 +1,11 @@
+#pragma once
+#include "nvs.h"
+
+// Minimal nvs_flash API for host unit tests (see mocks/common/nvm/nvs_mock.cpp)
+extern "C" {
+
+esp_err_t nvs_flash_init_partition(const char *partition_label);
+esp_err_t nvs_flash_deinit_partition(const char *partition_label);
+esp_err_t nvs_flash_erase_partition(const char *partition_label);
+
+} // extern "C"
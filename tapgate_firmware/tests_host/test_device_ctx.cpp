@@ -2,16 +2,30 @@
 #include "device_ctx.h"
 #include "device_entity.h"
 #include "nvm.h"
+#include "nvm_partition.h"
+#include "nor_flash_mock.h"
+#include "nvm_writer.h"
 
 #include <atomic>
+#include <chrono>
 #include <cstring>
 #include <cstdio>
 #include <thread>
 #include <vector>
 
-extern "C" void setUp(void) {}
+// Every test starts with an erased nonce counter partition, mounted
+extern "C" void setUp(void)
+{
+    NVMAsync.reset();
+    nor_mock_reset();
+    nor_mock_add_partition(NVM_PARTITION_COUNTER, 2 * NOR_MOCK_SECTOR_SIZE);
+    DeviceCtx.Init();
+}
 extern "C" void tearDown(void) {}
 
+// CONFIG_TAPGATE_NONCE_LEASE_SIZE of this target
+static constexpr tg_nonce_t NONCE_LEASE_SIZE = 16;
+
 // ---------------------------------------------------------------------------
 // Helpers
 // ---------------------------------------------------------------------------
@@ -168,6 +182,7 @@ void DeviceCtx_SetDeviceName_PersistsToNvm()
 {
     NVM.reset();
     TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.set_device_name("Persisted"));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.flush_entity());
 
     reset_ctx_from_nvm();
 
@@ -176,6 +191,88 @@ void DeviceCtx_SetDeviceName_PersistsToNvm()
     TEST_ASSERT_EQUAL_STRING("Persisted", buf);
 }
 
+// ---------------------------------------------------------------------------
+// set_device_name — a burst of renames is stored once, by sync_entity()
+// ---------------------------------------------------------------------------
+
+void DeviceCtx_SetDeviceName_Burst_OneWriteWhenQuiet()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+    const size_t writes = NVM.write_count();     // default entity
+
+    char name[NAME_MAX_SIZE];
+    for (int i = 0; i < 10; ++i)
+    {
+        std::snprintf(name, sizeof(name), "Gate %d", i);
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.set_device_name(name));
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.sync_entity());
+    }
+    // Read back from RAM at once, not yet in NVM
+    char buf[NAME_MAX_SIZE]{};
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_name({buf, sizeof(buf)}));
+    TEST_ASSERT_EQUAL_STRING("Gate 9", buf);
+    TEST_ASSERT_EQUAL(writes, NVM.write_count());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(ENTITY_WRITE_DELAY_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.sync_entity());
+    TEST_ASSERT_EQUAL(writes + 1, NVM.write_count());
+
+    reset_ctx_from_nvm();
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_name({buf, sizeof(buf)}));
+    TEST_ASSERT_EQUAL_STRING("Gate 9", buf);
+}
+
+// The writer task is busy: the rename is queued, the next one waits for it
+void DeviceCtx_SetDeviceName_Queued_NextWaitsForWrite()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+    const size_t writes = NVM.write_count();
+    NVMAsync.hold(true);
+
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.set_device_name("First"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(ENTITY_WRITE_DELAY_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.sync_entity());
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(writes, NVM.write_count());
+
+    // NVS still holds the entity before "First": no second slot image yet
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.set_device_name("Second"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(ENTITY_WRITE_DELAY_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.sync_entity());
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+
+    // First written, then Second queued into the other slot
+    TEST_ASSERT_EQUAL(ESP_OK, NVMAsync.Flush());
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.sync_entity());
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+
+    // flush_entity() stores the queued write
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.flush_entity());
+    TEST_ASSERT_EQUAL(0, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(writes + 2, NVM.write_count());
+
+    NVMAsync.hold(false);
+    reset_ctx_from_nvm();
+    char buf[NAME_MAX_SIZE]{};
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_name({buf, sizeof(buf)}));
+    TEST_ASSERT_EQUAL_STRING("Second", buf);
+}
+
+void DeviceCtx_UpdateEntity_KeyChanged_StoredAtOnce()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+    const size_t writes = NVM.write_count();
+
+    device_entity_t e{};
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_entity(&e));
+    std::memset(e.private_key, 0x5A, PRVKEY_CAP);
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&e));
+    TEST_ASSERT_EQUAL(writes + 1, NVM.write_count());
+}
+
 // ---------------------------------------------------------------------------
 // get/update entity — null pointer rejected
 // ---------------------------------------------------------------------------
@@ -224,6 +321,100 @@ void DeviceCtx_UpdateEntity_PersistsToNvm()
     TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(device_entity_t));
 }
 
+// ---------------------------------------------------------------------------
+// Entity slot record — migration and damaged slots
+// ---------------------------------------------------------------------------
+
+void DeviceCtx_Init_LegacyEntityBlob_MigratedToSlotRecord()
+{
+    NVM.reset();
+
+    const device_entity_t legacy = make_entity("Legacy", 0x01, 0x02, 0x03);
+    NVM.WriteBlob("nvs_entity", "CtxDevice", "Entity", &legacy, sizeof(legacy));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.Init());
+
+    // The plain blob is gone once the record holds the entity
+    device_entity_t raw{};
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND,
+                      NVM.ReadBlob("nvs_entity", "CtxDevice", "Entity", &raw, sizeof(raw)));
+
+    reset_ctx_from_nvm();
+    device_entity_t out{};
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_entity(&out));
+    TEST_ASSERT_EQUAL_MEMORY(&legacy, &out, sizeof(device_entity_t));
+}
+
+void DeviceCtx_UpdateEntity_NewestSlotDamaged_PreviousEntityLoaded()
+{
+    NVM.reset();
+
+    const device_entity_t first  = make_entity("First",  0x01, 0x02, 0x03);
+    const device_entity_t second = make_entity("Second", 0x04, 0x05, 0x06);
+    // Flushed: a change of the name alone is deferred
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&first));     // slot a
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.flush_entity());
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&second));    // slot b
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.flush_entity());
+
+    // Version, size and format, the entity, CRC-32
+    uint8_t image[8 + sizeof(device_entity_t) + 4];
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob("nvs_entity", "CtxDevice", "Entity.b", image, sizeof(image)));
+    image[8] ^= 0x80;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob("nvs_entity", "CtxDevice", "Entity.b", image, sizeof(image)));
+
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.Init());
+    device_entity_t out{};
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_device_entity(&out));
+    TEST_ASSERT_EQUAL_MEMORY(&first, &out, sizeof(device_entity_t));
+}
+
+// ---------------------------------------------------------------------------
+// view_entity — borrowed spans into an unchanging snapshot
+// ---------------------------------------------------------------------------
+
+void DeviceCtx_ViewEntity_SpansMatchEntity()
+{
+    NVM.reset();
+    const device_entity_t in = make_entity("View", 0x11, 0x22, 0x33);
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&in));
+
+    const auto view = DeviceCtx.view_entity();
+    TEST_ASSERT_EQUAL_MEMORY(in.device_id,   view.device_id().data(),   UID_CAP);
+    TEST_ASSERT_EQUAL_MEMORY(in.pub_key,     view.public_key().data(),  PUBKEY_CAP);
+    TEST_ASSERT_EQUAL_MEMORY(in.private_key, view.private_key().data(), PRVKEY_CAP);
+
+    // A second view of the same entity shows the same version and memory
+    const auto again = DeviceCtx.view_entity();
+    TEST_ASSERT_EQUAL(view.version(), again.version());
+    TEST_ASSERT_TRUE(view.private_key().data() == again.private_key().data());
+}
+
+void DeviceCtx_ViewEntity_UnchangedByUpdate()
+{
+    NVM.reset();
+    const device_entity_t first  = make_entity("First",  0x01, 0x02, 0x03);
+    const device_entity_t second = make_entity("Second", 0x04, 0x05, 0x06);
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&first));
+
+    uint32_t version = 0;
+    {
+        const auto view = DeviceCtx.view_entity();
+        version = view.version();
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.update_device_entity(&second));
+
+        TEST_ASSERT_EQUAL(version, view.version());
+        TEST_ASSERT_EQUAL_MEMORY(first.private_key, view.private_key().data(), PRVKEY_CAP);
+
+        tg_private_key_t prvkey{};
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_private_key(prvkey));
+        TEST_ASSERT_EQUAL_MEMORY(second.private_key, prvkey, PRVKEY_CAP);
+    }
+
+    const auto view = DeviceCtx.view_entity();
+    TEST_ASSERT_TRUE(view.version() != version);
+    TEST_ASSERT_EQUAL_MEMORY(second.private_key, view.private_key().data(), PRVKEY_CAP);
+}
+
 // ---------------------------------------------------------------------------
 // get_public_key / get_private_key / get_device_id — return entity field copies
 // ---------------------------------------------------------------------------
@@ -299,7 +490,7 @@ void DeviceCtx_SetNonce_GetNonce_Roundtrip()
 }
 
 // ---------------------------------------------------------------------------
-// Nonce — persists to NVM (re-init reads it back)
+// Nonce — persists to the counter (re-init resumes at the lease high-water mark)
 // ---------------------------------------------------------------------------
 
 void DeviceCtx_SetNonce_PersistsToNvm()
@@ -311,7 +502,117 @@ void DeviceCtx_SetNonce_PersistsToNvm()
 
     tg_nonce_t n = 0;
     TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
-    TEST_ASSERT_EQUAL(0xCAFEBABEu, n);
+    TEST_ASSERT_EQUAL(0xCAFEBABEu + NONCE_LEASE_SIZE, n);
+}
+
+// ---------------------------------------------------------------------------
+// Nonce — consume_nonce (DoAction): leased from RAM
+// ---------------------------------------------------------------------------
+
+void DeviceCtx_ConsumeNonce_WithinLease_NoNvmWrite()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+    const size_t writes = nor_mock_counters().writes;
+    const size_t nvs_writes = NVM.write_count();     // default entity
+
+    // First action stores the lease [1, 1 + NONCE_LEASE_SIZE]
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(0));
+    TEST_ASSERT_EQUAL(writes + 1, nor_mock_counters().writes);
+
+    for (tg_nonce_t n = 1; n <= NONCE_LEASE_SIZE; ++n)
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(n));
+    TEST_ASSERT_EQUAL(writes + 1, nor_mock_counters().writes);
+
+    // Lease used up: one write, then RAM again
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(NONCE_LEASE_SIZE + 1));
+    TEST_ASSERT_EQUAL(writes + 2, nor_mock_counters().writes);
+    TEST_ASSERT_EQUAL(1, nor_mock_counters().erases);     // counter created by setUp()
+    TEST_ASSERT_EQUAL(nvs_writes, NVM.write_count());
+
+    tg_nonce_t n = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(NONCE_LEASE_SIZE + 2, n);
+}
+
+void DeviceCtx_ConsumeNonce_NotCurrent_Rejected()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, DeviceCtx.consume_nonce(1));
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(0));
+    // Duplicate of an accepted action
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, DeviceCtx.consume_nonce(0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, DeviceCtx.consume_nonce(5));
+
+    tg_nonce_t n = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(1u, n);
+}
+
+void DeviceCtx_ConsumeNonce_AfterReset_NeverReused()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+
+    constexpr tg_nonce_t ACTIONS = 3 * NONCE_LEASE_SIZE / 2;
+    for (tg_nonce_t n = 0; n < ACTIONS; ++n)
+        TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(n));
+
+    reset_ctx_from_nvm();
+
+    // Resumes past every accepted nonce, skipping the rest of the lease
+    tg_nonce_t n = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_TRUE(n >= ACTIONS);
+    TEST_ASSERT_TRUE(n <= ACTIONS + NONCE_LEASE_SIZE);
+    for (tg_nonce_t old = 0; old < ACTIONS; ++old)
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, DeviceCtx.consume_nonce(old));
+
+    const size_t writes = nor_mock_counters().writes;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(n));
+    TEST_ASSERT_EQUAL(writes + 1, nor_mock_counters().writes);
+}
+
+void DeviceCtx_ConsumeNonce_LeaseWriteFails_NonceUnchanged()
+{
+    NVM.reset();
+    reset_ctx_from_nvm();
+
+    nor_mock_fail_after(0);
+    TEST_ASSERT_EQUAL(ESP_FAIL, DeviceCtx.consume_nonce(0));
+    tg_nonce_t n = 0xFFFF;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(0u, n);
+
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.consume_nonce(0));
+}
+
+// Firmware before the counter kept the mark in NVS: moved into the counter
+void DeviceCtx_LoadNonce_LegacyNvsMark_Migrated()
+{
+    NVM.reset();
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, "CtxDevice", "Nonce", 1000));
+    reset_ctx_from_nvm();
+
+    tg_nonce_t n = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(1000u, n);
+    uint32_t legacy = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_NONCE, "CtxDevice", "Nonce", &legacy));
+
+    // Resumes from the counter alone
+    reset_ctx_from_nvm();
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(1000u, n);
+}
+
+void DeviceCtx_ConsumeNonce_MaxValue_Rejected()
+{
+    NVM.reset();
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.set_nonce(UINT32_MAX));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, DeviceCtx.consume_nonce(UINT32_MAX));
 }
 
 // ---------------------------------------------------------------------------
@@ -467,6 +768,43 @@ void DeviceCtx_Multithreaded_ConcurrentSetGetNonce_NoDeadlock()
     // Pass = no deadlock or crash; nonce value is intentionally racy
 }
 
+// ---------------------------------------------------------------------------
+// Multithreaded — concurrent consume: each nonce accepted exactly once
+// ---------------------------------------------------------------------------
+
+void DeviceCtx_Multithreaded_ConcurrentConsumeNonce_EachAcceptedOnce()
+{
+    constexpr int NUM_THREADS = 8;
+    constexpr int ITERATIONS  = 500;
+
+    NVM.reset();
+    reset_ctx_from_nvm();
+    const size_t writes = NVM.write_count();
+
+    std::atomic<uint32_t> accepted{0};
+    std::vector<std::thread> threads;
+    threads.reserve(NUM_THREADS);
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back([&accepted]() {
+            for (int j = 0; j < ITERATIONS; ++j) {
+                tg_nonce_t n = 0;
+                (void)DeviceCtx.get_nonce(&n);
+                if (DeviceCtx.consume_nonce(n) == ESP_OK)
+                    accepted.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    tg_nonce_t n = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, DeviceCtx.get_nonce(&n));
+    TEST_ASSERT_EQUAL(accepted.load(), n);
+    TEST_ASSERT_TRUE(NVM.write_count() - writes <= n / NONCE_LEASE_SIZE + 1);
+}
+
 // ---------------------------------------------------------------------------
 // Multithreaded — concurrent get/set produces no corruption
 // ---------------------------------------------------------------------------
@@ -547,6 +885,14 @@ int main(void)
 
     UnityDefaultTestRun(DeviceCtx_SetDeviceName_PersistsToNvm,
                         "DeviceCtx_SetDeviceName_PersistsToNvm", __FILE__);
+    UnityDefaultTestRun(DeviceCtx_SetDeviceName_Burst_OneWriteWhenQuiet,
+                        "DeviceCtx_SetDeviceName_Burst_OneWriteWhenQuiet", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_SetDeviceName_Queued_NextWaitsForWrite,
+                        "DeviceCtx_SetDeviceName_Queued_NextWaitsForWrite", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_UpdateEntity_KeyChanged_StoredAtOnce,
+                        "DeviceCtx_UpdateEntity_KeyChanged_StoredAtOnce", __FILE__);
 
     UnityDefaultTestRun(DeviceCtx_GetEntity_NullPtr_ReturnsInvalidArg,
                         "DeviceCtx_GetEntity_NullPtr_ReturnsInvalidArg", __FILE__);
@@ -559,7 +905,15 @@ int main(void)
 
     UnityDefaultTestRun(DeviceCtx_UpdateEntity_PersistsToNvm,
                         "DeviceCtx_UpdateEntity_PersistsToNvm", __FILE__);
-
+    UnityDefaultTestRun(DeviceCtx_Init_LegacyEntityBlob_MigratedToSlotRecord,
+                        "DeviceCtx_Init_LegacyEntityBlob_MigratedToSlotRecord", __FILE__);
+    UnityDefaultTestRun(DeviceCtx_UpdateEntity_NewestSlotDamaged_PreviousEntityLoaded,
+                        "DeviceCtx_UpdateEntity_NewestSlotDamaged_PreviousEntityLoaded", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_ViewEntity_SpansMatchEntity,
+                        "DeviceCtx_ViewEntity_SpansMatchEntity", __FILE__);
+    UnityDefaultTestRun(DeviceCtx_ViewEntity_UnchangedByUpdate,
+                        "DeviceCtx_ViewEntity_UnchangedByUpdate", __FILE__);
     UnityDefaultTestRun(DeviceCtx_GetPublicKey_ReturnsEntityPubKey,
                         "DeviceCtx_GetPublicKey_ReturnsEntityPubKey", __FILE__);
 
@@ -590,12 +944,32 @@ int main(void)
     UnityDefaultTestRun(DeviceCtx_SetNonce_PersistsToNvm,
                         "DeviceCtx_SetNonce_PersistsToNvm", __FILE__);
 
+    UnityDefaultTestRun(DeviceCtx_ConsumeNonce_WithinLease_NoNvmWrite,
+                        "DeviceCtx_ConsumeNonce_WithinLease_NoNvmWrite", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_ConsumeNonce_NotCurrent_Rejected,
+                        "DeviceCtx_ConsumeNonce_NotCurrent_Rejected", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_ConsumeNonce_AfterReset_NeverReused,
+                        "DeviceCtx_ConsumeNonce_AfterReset_NeverReused", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_ConsumeNonce_LeaseWriteFails_NonceUnchanged,
+                        "DeviceCtx_ConsumeNonce_LeaseWriteFails_NonceUnchanged", __FILE__);
+
+    UnityDefaultTestRun(DeviceCtx_LoadNonce_LegacyNvsMark_Migrated,
+                        "DeviceCtx_LoadNonce_LegacyNvsMark_Migrated", __FILE__);
+    UnityDefaultTestRun(DeviceCtx_ConsumeNonce_MaxValue_Rejected,
+                        "DeviceCtx_ConsumeNonce_MaxValue_Rejected", __FILE__);
+
     UnityDefaultTestRun(DeviceCtx_SetNonce_MaxValue_Succeeds,
                         "DeviceCtx_SetNonce_MaxValue_Succeeds", __FILE__);
 
     UnityDefaultTestRun(DeviceCtx_Init_NvmReadError_PropagatesError,
                         "DeviceCtx_Init_NvmReadError_PropagatesError", __FILE__);
 
+    UnityDefaultTestRun(DeviceCtx_Multithreaded_ConcurrentConsumeNonce_EachAcceptedOnce,
+                        "DeviceCtx_Multithreaded_ConcurrentConsumeNonce_EachAcceptedOnce", __FILE__);
+
     UnityDefaultTestRun(DeviceCtx_Multithreaded_ConcurrentSetGet_NoCorruption,
                         "DeviceCtx_Multithreaded_ConcurrentSetGet_NoCorruption", __FILE__);
 
@@ -0,0 +1,309 @@
+#include "unity.h"
+
+#include "double_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+// Layout of device_entity_t: the key getters read one 32-byte field
+struct Entity
+{
+    uint8_t id[16];
+    uint8_t name[32];
+    uint8_t pub_key[32];
+    uint8_t private_key[32];
+};
+
+static Entity make_entity(uint8_t fill)
+{
+    Entity e;
+    std::memset(&e, fill, sizeof(e));
+    return e;
+}
+
+static bool uniform(const uint8_t *data, size_t size)
+{
+    for (size_t i = 1; i < size; ++i)
+        if (data[i] != data[0])
+            return false;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Single thread
+// ---------------------------------------------------------------------------
+
+void DoubleBuffer_Default_ZeroedVersionOne()
+{
+    DoubleBuffer<Entity> buffer;
+    const Entity e = buffer.Load();
+    const Entity zero{};
+    TEST_ASSERT_EQUAL_MEMORY(&zero, &e, sizeof(e));
+    TEST_ASSERT_EQUAL(1u, buffer.Version());
+}
+
+void DoubleBuffer_Store_LoadReturnsNewest()
+{
+    DoubleBuffer<Entity> buffer;
+    for (uint8_t v = 1; v <= 5; ++v)
+    {
+        buffer.Store(make_entity(v));
+        const Entity expected = make_entity(v);
+        const Entity e = buffer.Load();
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &e, sizeof(e));
+    }
+    TEST_ASSERT_EQUAL(6u, buffer.Version());
+    TEST_ASSERT_EQUAL(0u, buffer.Waits());
+}
+
+void DoubleBuffer_LoadBytes_UnalignedRange()
+{
+    // Size not a multiple of 4 and a range that starts and ends inside a word
+    struct Odd { uint8_t b[11]; };
+    Odd v;
+    for (uint8_t i = 0; i < sizeof(v.b); ++i)
+        v.b[i] = static_cast<uint8_t>(i + 1);
+
+    DoubleBuffer<Odd> buffer;
+    buffer.Store(v);
+    uint8_t out[6] = {};
+    buffer.LoadBytes(3, out, sizeof(out));
+    TEST_ASSERT_EQUAL_MEMORY(&v.b[3], out, sizeof(out));
+
+    uint8_t last = 0;
+    buffer.LoadBytes(10, &last, 1);
+    TEST_ASSERT_EQUAL(11, last);
+}
+
+// ---------------------------------------------------------------------------
+// Views
+// ---------------------------------------------------------------------------
+
+void DoubleBuffer_View_UnchangedByStore()
+{
+    DoubleBuffer<Entity> buffer;
+    buffer.Store(make_entity(1));
+
+    const DoubleBuffer<Entity>::View view = buffer.Pin();
+    const uint8_t *key = view->pub_key;
+    TEST_ASSERT_EQUAL(2u, view.Version());
+
+    // The store goes to the other slot: the view still shows version 2
+    buffer.Store(make_entity(2));
+    TEST_ASSERT_EQUAL(2, buffer.Load().pub_key[0]);
+    TEST_ASSERT_EQUAL(2u, view.Version());
+    TEST_ASSERT_TRUE(key == view->pub_key);
+    TEST_ASSERT_EQUAL(1, key[0]);
+    TEST_ASSERT_TRUE(uniform(key, sizeof(view->pub_key)));
+}
+
+void DoubleBuffer_Store_WaitsForViewOfItsSlot()
+{
+    DoubleBuffer<Entity> buffer;
+    buffer.Store(make_entity(1));
+    std::atomic<int> stored{0};
+
+    std::thread writer;
+    {
+        const DoubleBuffer<Entity>::View view = buffer.Pin();
+        writer = std::thread([&]() {
+            buffer.Store(make_entity(2));         // other slot
+            stored.fetch_add(1);
+            buffer.Store(make_entity(3));         // the pinned slot: waits
+            stored.fetch_add(1);
+        });
+        // Keep the view until the writer sleeps in the second Store(), however
+        // late it gets scheduled; a Store() that did not wait fails the test
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (buffer.Waits() == 0 && stored.load() < 2 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        TEST_ASSERT_EQUAL(1, stored.load());
+        TEST_ASSERT_TRUE(buffer.Waits() > 0);
+        TEST_ASSERT_EQUAL(1, view->pub_key[0]);
+    }
+    writer.join();
+    TEST_ASSERT_EQUAL(2, stored.load());
+    TEST_ASSERT_EQUAL(3, buffer.Load().pub_key[0]);
+}
+
+// ---------------------------------------------------------------------------
+// Concurrent readers
+// ---------------------------------------------------------------------------
+
+void DoubleBuffer_ConcurrentStores_ReadsNeverTorn()
+{
+    DoubleBuffer<Entity> buffer;
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> torn{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+    {
+        readers.emplace_back([&]() {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                const Entity e = buffer.Load();
+                uint8_t key[32];
+                buffer.LoadBytes(offsetof(Entity, pub_key), key, sizeof(key));
+                const DoubleBuffer<Entity>::View view = buffer.Pin();
+                if (!uniform(reinterpret_cast<const uint8_t*>(&e), sizeof(e)) || !uniform(key, sizeof(key)) ||
+                    !uniform(reinterpret_cast<const uint8_t*>(&*view), sizeof(Entity)))
+                    torn.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (uint32_t i = 0; i < 20000; ++i)
+        buffer.Store(make_entity(static_cast<uint8_t>(i)));
+    stop.store(true);
+    for (auto &t : readers)
+        t.join();
+
+    TEST_ASSERT_EQUAL(0u, torn.load());
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark — DoubleBuffer vs std::mutex, N readers and one writer
+// ---------------------------------------------------------------------------
+
+namespace {
+
+constexpr uint32_t BENCH_READS = 200000;
+
+// DeviceContext before the double buffer: lock, copy the field, unlock
+class MutexEntity
+{
+public:
+    void LoadBytes(size_t offset, void *out, size_t size) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::memcpy(out, reinterpret_cast<const uint8_t*>(&m_value) + offset, size);
+    }
+
+    void Store(const Entity &value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_value = value;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    Entity             m_value{};
+};
+
+struct BenchResult
+{
+    double   ns_per_read;
+    uint64_t stores;
+    uint32_t torn;
+};
+
+// Readers copy the public key BENCH_READS times each while one writer stores
+// as fast as it can until they are done
+template <typename Cell>
+BenchResult run_bench(Cell &cell, int readers)
+{
+    std::atomic<int>      ready{0};
+    std::atomic<bool>     go{false};
+    std::atomic<int>      done{0};
+    std::atomic<uint32_t> torn{0};
+    uint64_t stores = 0;
+
+    std::thread writer([&]() {
+        while (!go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        while (done.load(std::memory_order_acquire) != readers)
+            cell.Store(make_entity(static_cast<uint8_t>(++stores)));
+    });
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            uint8_t key[32];
+            for (uint32_t i = 0; i < BENCH_READS; ++i)
+            {
+                cell.LoadBytes(offsetof(Entity, pub_key), key, sizeof(key));
+                if (!uniform(key, sizeof(key)))
+                    torn.fetch_add(1, std::memory_order_relaxed);
+            }
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    while (ready.load() != readers)
+        std::this_thread::yield();
+
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &t : threads)
+        t.join();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    writer.join();
+
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    return { ns / BENCH_READS, stores, torn.load() };
+}
+
+} // namespace
+
+void DoubleBuffer_Benchmark_ReadersVsMutex()
+{
+    // Wall time per read of each reader, with the writer storing throughout.
+    // Contention only shows with more hardware threads than readers.
+    std::printf("\n  %u hardware thread(s)\n", std::thread::hardware_concurrency());
+    std::printf("  readers | mutex ns/read (stores) | double buffer ns/read (stores, waits)\n");
+    for (const int readers : { 1, 2, 4 })
+    {
+        static MutexEntity     mutex_cell;
+        static DoubleBuffer<Entity> buffer_cell;
+        const uint32_t waits = buffer_cell.Waits();
+
+        const BenchResult mutex  = run_bench(mutex_cell, readers);
+        const BenchResult buffer = run_bench(buffer_cell, readers);
+
+        std::printf("  %7d | %8.1f (%10llu)    | %8.1f (%10llu, %lu)\n", readers,
+                    mutex.ns_per_read, static_cast<unsigned long long>(mutex.stores),
+                    buffer.ns_per_read, static_cast<unsigned long long>(buffer.stores),
+                    static_cast<unsigned long>(buffer_cell.Waits() - waits));
+
+        TEST_ASSERT_EQUAL(0u, mutex.torn);
+        TEST_ASSERT_EQUAL(0u, buffer.torn);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(DoubleBuffer_Default_ZeroedVersionOne,
+                        "DoubleBuffer_Default_ZeroedVersionOne", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_Store_LoadReturnsNewest,
+                        "DoubleBuffer_Store_LoadReturnsNewest", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_LoadBytes_UnalignedRange,
+                        "DoubleBuffer_LoadBytes_UnalignedRange", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_View_UnchangedByStore,
+                        "DoubleBuffer_View_UnchangedByStore", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_Store_WaitsForViewOfItsSlot,
+                        "DoubleBuffer_Store_WaitsForViewOfItsSlot", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_ConcurrentStores_ReadsNeverTorn,
+                        "DoubleBuffer_ConcurrentStores_ReadsNeverTorn", __FILE__);
+    UnityDefaultTestRun(DoubleBuffer_Benchmark_ReadersVsMutex,
+                        "DoubleBuffer_Benchmark_ReadersVsMutex", __FILE__);
+    return UNITY_END();
+}
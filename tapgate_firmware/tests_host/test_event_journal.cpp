@@ -1,45 +1,60 @@
 #include "unity.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <string>
 
 // ---------------------------------------------------------------------------
 // Log capture
 // ---------------------------------------------------------------------------
 
+#include "esp_log.h"
+#include "event_journal.h"
+#include "journal_emit.h"
+#include "journal_record.h"
+
 struct LogCapture {
-    int  level;         // 0=INFO  1=WARN  2=ERROR
-    char tag[64];
-    char message[256];
-    bool called;
+    int         level;          // esp_log_level_t
+    char        tag[64];
+    char        message[512];   // every write since setUp(), concatenated
+    size_t      length;
+    const char* line;           // string passed to a "%s" write
+    int         calls;
 };
 
 static LogCapture g_log{};
 
-static void capture_log(int level, const char* tag, const char* fmt, ...) {
+static void capture_write(esp_log_level_t level, const char* tag, const char* fmt, va_list args) {
     g_log.level = level;
     snprintf(g_log.tag, sizeof(g_log.tag), "%s", tag);
+    if (std::strcmp(fmt, "%s") == 0) {
+        va_list copy;
+        va_copy(copy, args);
+        g_log.line = va_arg(copy, const char*);
+        va_end(copy);
+    }
+    const int len = vsnprintf(g_log.message + g_log.length, sizeof(g_log.message) - g_log.length, fmt, args);
+    if (len > 0)
+        g_log.length = std::min(sizeof(g_log.message) - 1, g_log.length + static_cast<size_t>(len));
+    ++g_log.calls;
+}
+
+extern "C" void esp_log_write(esp_log_level_t level, const char* tag, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    vsnprintf(g_log.message, sizeof(g_log.message), fmt, args);
+    capture_write(level, tag, fmt, args);
     va_end(args);
-    g_log.called = true;
 }
 
-// Include mock first to satisfy #pragma once, then override with captures.
-// EVENT_JOURNAL_ADD is a macro: its ESP_LOGx calls expand at the call site,
-// so whatever definitions are active here will be used in the tests below.
-#include "esp_log.h"
-#undef ESP_LOGI
-#undef ESP_LOGW
-#undef ESP_LOGE
-#define ESP_LOGI(tag, fmt, ...) capture_log(0, tag, fmt, ##__VA_ARGS__)
-#define ESP_LOGW(tag, fmt, ...) capture_log(1, tag, fmt, ##__VA_ARGS__)
-#define ESP_LOGE(tag, fmt, ...) capture_log(2, tag, fmt, ##__VA_ARGS__)
-
-// event_journal.h defines event_journal_type; must come before StoreCapture.
-#include "event_journal.h"
+extern "C" void esp_log_writev(esp_log_level_t level, const char* tag, const char* fmt, va_list args) {
+    capture_write(level, tag, fmt, args);
+}
+
+extern "C" uint32_t esp_log_timestamp(void) { return 0; }
 
 // ---------------------------------------------------------------------------
 // Store capture
@@ -47,21 +62,25 @@ static void capture_log(int level, const char* tag, const char* fmt, ...) {
 
 struct StoreCapture {
     int                call_count;
+    uint16_t           id;
     char               tag[64];
     char               message[256];
+    const char*        text;
     event_journal_type type;
 };
 
 static StoreCapture g_store{};
 
-extern "C" void _event_journal_store(enum event_journal_type type,
-                                     const char* tag, const char* fmt, ...) {
+void journal_emit_record(enum event_journal_type type, const journal_event_desc_t* event,
+                         const char* text, size_t length, va_list args) {
+    (void)args;
     g_store.type = type;
-    snprintf(g_store.tag, sizeof(g_store.tag), "%s", tag);
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(g_store.message, sizeof(g_store.message), fmt, args);
-    va_end(args);
+    g_store.id   = event->id;
+    g_store.text = text;
+    snprintf(g_store.tag, sizeof(g_store.tag), "%s", event->tag);
+    length = std::min(length, sizeof(g_store.message) - 1);
+    std::memcpy(g_store.message, text, length);
+    g_store.message[length] = '\0';
     ++g_store.call_count;
 }
 
@@ -119,31 +138,31 @@ void EventJournal_Add_MultipleFormatArgs_AllExpanded()
 }
 
 // ---------------------------------------------------------------------------
-// Log level routing — INFO→LOGI  WARNING→LOGW  ERROR→LOGE  ALERT→LOGW
+// Log level routing — INFO→I  WARNING→W  ERROR→E  ALERT→W
 // ---------------------------------------------------------------------------
 
 void EventJournal_Add_InfoType_UsesLogi()
 {
     EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, CALLER_TAG, "msg");
-    TEST_ASSERT_EQUAL(0, g_log.level);
+    TEST_ASSERT_EQUAL(ESP_LOG_INFO, g_log.level);
 }
 
 void EventJournal_Add_WarningType_UsesLogw()
 {
     EVENT_JOURNAL_ADD(EVENT_JOURNAL_WARNING, CALLER_TAG, "msg");
-    TEST_ASSERT_EQUAL(1, g_log.level);
+    TEST_ASSERT_EQUAL(ESP_LOG_WARN, g_log.level);
 }
 
 void EventJournal_Add_ErrorType_UsesLoge()
 {
     EVENT_JOURNAL_ADD(EVENT_JOURNAL_ERROR, CALLER_TAG, "msg");
-    TEST_ASSERT_EQUAL(2, g_log.level);
+    TEST_ASSERT_EQUAL(ESP_LOG_ERROR, g_log.level);
 }
 
 void EventJournal_Add_AlertType_UsesLogw()
 {
     EVENT_JOURNAL_ADD(EVENT_JOURNAL_ALERT, CALLER_TAG, "msg");
-    TEST_ASSERT_EQUAL(1, g_log.level);
+    TEST_ASSERT_EQUAL(ESP_LOG_WARN, g_log.level);
 }
 
 // ---------------------------------------------------------------------------
@@ -168,6 +187,102 @@ void EventJournal_Store_ReceivesCorrectType()
     TEST_ASSERT_EQUAL(EVENT_JOURNAL_WARNING, g_store.type);
 }
 
+void EventJournal_Store_ReceivesCompileTimeEventId()
+{
+    EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, CALLER_TAG, "val=%d", 1);
+    TEST_ASSERT_EQUAL(journal_event_id(CALLER_TAG, "val=%d"), g_store.id);
+}
+
+// ---------------------------------------------------------------------------
+// Single formatting pass — console and journal share the same bytes
+// ---------------------------------------------------------------------------
+
+void EventJournal_Emit_OneConsoleWrite_RecordSharesLine()
+{
+    EVENT_JOURNAL_ADD(EVENT_JOURNAL_WARNING, CALLER_TAG, "retry %d of %d", 2, 5);
+    TEST_ASSERT_EQUAL(1, g_log.calls);
+    TEST_ASSERT_TRUE(g_log.line != nullptr);
+    TEST_ASSERT_EQUAL_STRING("MYTAG: retry 2 of 5", g_log.line);
+    // The record gets the message part of the very same buffer
+    TEST_ASSERT_TRUE(g_store.text == g_log.line + std::strlen("MYTAG: "));
+    TEST_ASSERT_EQUAL_STRING("retry 2 of 5", g_store.message);
+}
+
+void EventJournal_Emit_LongLine_ConsoleComplete_RecordTruncated()
+{
+    const std::string long_text(400, 'x');
+    EVENT_JOURNAL_ADD(EVENT_JOURNAL_INFO, CALLER_TAG, "banner %s end", long_text.c_str());
+
+    const std::string expected = "MYTAG: banner " + long_text + " end\n";
+    TEST_ASSERT_TRUE(std::strstr(g_log.message, expected.c_str()) != nullptr);
+    TEST_ASSERT_EQUAL(ESP_LOG_INFO, g_log.level);
+    TEST_ASSERT_EQUAL(1, g_store.call_count);
+    TEST_ASSERT_EQUAL(JOURNAL_EMIT_LINE_MAX - 1 - std::strlen("MYTAG: "), std::strlen(g_store.message));
+}
+
+void EventJournal_Emit_DebugTag_FormatsCounter()
+{
+    char buf[24];
+    TEST_ASSERT_EQUAL_STRING(">> EVENT 0 <<", journal_emit_debug_tag(buf, sizeof(buf), 0));
+    TEST_ASSERT_EQUAL_STRING(">> EVENT 4294967295 <<", journal_emit_debug_tag(buf, sizeof(buf), 4294967295u));
+    TEST_ASSERT_EQUAL_STRING("", journal_emit_debug_tag(buf, 8, 1));
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark — formatting twice (previous macro) vs once
+// ---------------------------------------------------------------------------
+
+// The previous EVENT_JOURNAL_ADD: vsnprintf() into the record, then ESP_LOGx
+// formatting "<tag>: " fmt again for the console
+static char g_legacy_record[JOURNAL_MSG_MAX_SIZE];
+
+static void legacy_store(const journal_event_desc_t* event, ...) {
+    va_list args;
+    va_start(args, event);
+    vsnprintf(g_legacy_record, sizeof(g_legacy_record), event->fmt, args);
+    va_end(args);
+}
+
+#define LEGACY_EVENT_JOURNAL_ADD(level, tag, fmt, ...) \
+    do { \
+        _EJ_EVENT_DECL(tag, fmt) \
+        legacy_store(&_ej_event, ##__VA_ARGS__); \
+        esp_log_write(level, EVENT_JOURNAL_TAG, "%s: " fmt, tag, ##__VA_ARGS__); \
+    } while (0)
+
+void EventJournal_Benchmark_FormatOnceVsTwice()
+{
+    constexpr int ITERATIONS = 200000;
+    using Clock = std::chrono::steady_clock;
+
+    const auto legacy_start = Clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        g_log.length = 0;
+        LEGACY_EVENT_JOURNAL_ADD(ESP_LOG_WARN, "NVM", "Commit \"%s\" failed: %s (0x%x), attempt %d",
+                                 "device_ctx", "ESP_ERR_NVS_NOT_ENOUGH_SPACE", 0x1105, i);
+    }
+    const auto legacy = Clock::now() - legacy_start;
+    std::string legacy_line(g_log.message);
+
+    const auto emit_start = Clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        g_log.length = 0;
+        EVENT_JOURNAL_ADD(EVENT_JOURNAL_WARNING, "NVM", "Commit \"%s\" failed: %s (0x%x), attempt %d",
+                          "device_ctx", "ESP_ERR_NVS_NOT_ENOUGH_SPACE", 0x1105, i);
+    }
+    const auto emit = Clock::now() - emit_start;
+
+    // Same console text and record either way
+    TEST_ASSERT_EQUAL_STRING(legacy_line.c_str(), g_log.message);
+    TEST_ASSERT_EQUAL_STRING(g_legacy_record, g_store.message);
+
+    const auto per_second = [](Clock::duration d) {
+        return ITERATIONS / std::chrono::duration<double>(d).count();
+    };
+    std::printf("\n  format twice: %10.0f events/s\n  format once:  %10.0f events/s (x%.2f)\n",
+                per_second(legacy), per_second(emit), per_second(emit) / per_second(legacy));
+}
+
 // ---------------------------------------------------------------------------
 // Runner
 // ---------------------------------------------------------------------------
@@ -205,6 +320,17 @@ int main()
                         "EventJournal_Store_ReceivesOriginalTag", __FILE__);
     UnityDefaultTestRun(EventJournal_Store_ReceivesCorrectType,
                         "EventJournal_Store_ReceivesCorrectType", __FILE__);
+    UnityDefaultTestRun(EventJournal_Store_ReceivesCompileTimeEventId,
+                        "EventJournal_Store_ReceivesCompileTimeEventId", __FILE__);
+
+    UnityDefaultTestRun(EventJournal_Emit_OneConsoleWrite_RecordSharesLine,
+                        "EventJournal_Emit_OneConsoleWrite_RecordSharesLine", __FILE__);
+    UnityDefaultTestRun(EventJournal_Emit_LongLine_ConsoleComplete_RecordTruncated,
+                        "EventJournal_Emit_LongLine_ConsoleComplete_RecordTruncated", __FILE__);
+    UnityDefaultTestRun(EventJournal_Emit_DebugTag_FormatsCounter,
+                        "EventJournal_Emit_DebugTag_FormatsCounter", __FILE__);
+    UnityDefaultTestRun(EventJournal_Benchmark_FormatOnceVsTwice,
+                        "EventJournal_Benchmark_FormatOnceVsTwice", __FILE__);
 
     return UNITY_END();
 }
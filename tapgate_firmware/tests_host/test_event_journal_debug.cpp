@@ -1,8 +1,7 @@
-#define APP_DEBUG_MODE
-
 #include "unity.h"
 
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 
@@ -10,6 +9,10 @@
 // Log capture
 // ---------------------------------------------------------------------------
 
+#include "esp_log.h"
+#include "event_journal.h"
+#include "journal_emit.h"
+
 struct LogCapture {
     int  level;
     char tag[64];
@@ -19,7 +22,7 @@ struct LogCapture {
 
 static LogCapture g_log{};
 
-static void capture_log(int level, const char* tag, const char* fmt, ...) {
+extern "C" void esp_log_write(esp_log_level_t level, const char* tag, const char* fmt, ...) {
     g_log.level = level;
     snprintf(g_log.tag, sizeof(g_log.tag), "%s", tag);
     va_list args;
@@ -29,24 +32,15 @@ static void capture_log(int level, const char* tag, const char* fmt, ...) {
     g_log.called = true;
 }
 
-#include "esp_log.h"
-#undef ESP_LOGI
-#undef ESP_LOGW
-#undef ESP_LOGE
-#define ESP_LOGI(tag, fmt, ...) capture_log(0, tag, fmt, ##__VA_ARGS__)
-#define ESP_LOGW(tag, fmt, ...) capture_log(1, tag, fmt, ##__VA_ARGS__)
-#define ESP_LOGE(tag, fmt, ...) capture_log(2, tag, fmt, ##__VA_ARGS__)
+extern "C" void esp_log_writev(esp_log_level_t, const char*, const char*, va_list) {}
 
-#include "event_journal.h"
+extern "C" uint32_t esp_log_timestamp(void) { return 0; }
 
 // ---------------------------------------------------------------------------
 // Store stub
 // ---------------------------------------------------------------------------
 
-extern "C" void _event_journal_store(enum event_journal_type, const char*, const char*, ...) {}
-
-// Definition required because event_journal.c is not compiled in host tests.
-unsigned int global_events_counter_per_session = 0;
+void journal_emit_record(enum event_journal_type, const journal_event_desc_t*, const char*, size_t, va_list) {}
 
 // ---------------------------------------------------------------------------
 // Fixtures
@@ -0,0 +1,319 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_record.h"
+#include "elf_strings.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Packs args, renders them back and compares with what snprintf produces.
+template <typename... Args>
+static void check_roundtrip(const char* fmt, Args... args)
+{
+    char expected[256];
+    std::snprintf(expected, sizeof(expected), fmt, args...);
+
+    uint8_t packed[128];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), fmt, args...);
+
+    char actual[256];
+    const size_t n = journal_args_format(fmt, packed, len, actual, sizeof(actual));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    TEST_ASSERT_EQUAL(std::strlen(expected), n);
+}
+
+// ---------------------------------------------------------------------------
+// Round trip — output identical to snprintf
+// ---------------------------------------------------------------------------
+
+void JournalArgs_NoArgs_LiteralCopied()
+{
+    check_roundtrip("plain text, no conversions");
+}
+
+void JournalArgs_PercentEscape_Rendered()
+{
+    check_roundtrip("100%% done");
+}
+
+void JournalArgs_Integers_MatchSnprintf()
+{
+    check_roundtrip("%d %i %u", -42, 17, 4000000000u);
+    check_roundtrip("0x%x 0X%X %o %c", 0xbeef, 0xCAFE, 8, 'Z');
+    check_roundtrip("%hhu %hd", 255, -3);
+    // Values out of range of char/short are truncated, as by printf
+    check_roundtrip("%hhu %hhd %hx %hd", 300, 200, 0x12345, 70000);
+}
+
+void JournalArgs_WideIntegers_MatchSnprintf()
+{
+    check_roundtrip("%lld %llu", -1234567890123LL, 18446744073709551615ULL);
+    check_roundtrip("%ld %lu %zu", -7L, 7UL, static_cast<size_t>(12345));
+}
+
+void JournalArgs_FlagsWidthPrecision_MatchSnprintf()
+{
+    check_roundtrip("[%-6d] [%06d] [%+d] [%#x] [% d]", 12, 34, 5, 255, 9);
+    check_roundtrip("[%*d] [%-*d] [%.*f]", 5, 1, 4, 2, 3, 3.14159);
+}
+
+void JournalArgs_Floats_MatchSnprintf()
+{
+    check_roundtrip("%f %.2f %e %g", 1.5, 2.345, 12345.678, 0.0001);
+}
+
+void JournalArgs_Strings_MatchSnprintf()
+{
+    check_roundtrip("%s: \"%s\" (0x%x)", "NVM", "ESP_ERR_NVS_NOT_FOUND", 0x1102);
+    check_roundtrip("[%8s] [%-8s] [%.3s]", "ab", "cd", "truncate");
+}
+
+void JournalArgs_StringArgCopied_NotReferenced()
+{
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "volatile");
+
+    uint8_t packed[64];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), "value=%s", buf);
+    std::memset(buf, 'X', sizeof(buf) - 1); // caller reuses its buffer
+
+    char out[64];
+    journal_args_format("value=%s", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("value=volatile", out);
+}
+
+void JournalArgs_StringPrecision_OnlyThatManyBytesCopied()
+{
+    // Not NUL-terminated: only the precision bounds the argument
+    const char name[4] = {'N', 'V', 'M', 'X'};
+
+    uint8_t packed[64];
+    size_t len = journal_args_pack_v(packed, sizeof(packed), "[%.*s] [%.2s]", 3, name, name);
+    TEST_ASSERT_EQUAL((1 + 4) + (1 + 1 + 3) + (1 + 1 + 2), len);
+
+    char out[64];
+    journal_args_format("[%.*s] [%.2s]", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("[NVM] [NV]", out);
+
+    // A negative '*' precision is no precision
+    len = journal_args_pack_v(packed, sizeof(packed), "%.*s", -1, "abc");
+    journal_args_format("%.*s", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("abc", out);
+}
+
+// ---------------------------------------------------------------------------
+// Capacity limits
+// ---------------------------------------------------------------------------
+
+void JournalArgs_BufferFull_RemainingArgsMissing()
+{
+    uint8_t packed[10]; // room for exactly 2 x I32 entries
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), "%d %d %d", 1, 2, 3);
+    TEST_ASSERT_EQUAL(10, len);
+
+    char out[64];
+    journal_args_format("%d %d %d", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("1 2 " JOURNAL_ARG_MISSING, out);
+}
+
+void JournalArgs_LongString_TruncatedToFit()
+{
+    uint8_t packed[8];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), "%s", "abcdefghijkl");
+    TEST_ASSERT_EQUAL(8, len);
+
+    char out[64];
+    journal_args_format("%s", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("abcdef", out);
+}
+
+void JournalArgs_OutputBufferSmall_TruncatedAndTerminated()
+{
+    uint8_t packed[32];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), "value=%d", 123456);
+
+    char out[8];
+    const size_t n = journal_args_format("value=%d", packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("value=1", out);
+    TEST_ASSERT_EQUAL(7, n);
+}
+
+void JournalArgs_PackedSmallerThanText()
+{
+    // Typical journal event: caller tag prefix + error name + code
+    uint8_t packed[64];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed),
+                                           "Internal NVM access failed: \"%s\" (0x%x)",
+                                           "ESP_ERR_NVS_NO_FREE_PAGES", 0x110d);
+    char text[128];
+    const int text_len = std::snprintf(text, sizeof(text), "Internal NVM access failed: \"%s\" (0x%x)",
+                                       "ESP_ERR_NVS_NO_FREE_PAGES", 0x110d);
+    TEST_ASSERT_TRUE(len < static_cast<size_t>(text_len));
+}
+
+// ---------------------------------------------------------------------------
+// Record rendering
+// ---------------------------------------------------------------------------
+
+void JournalRecord_Render_DeferredAndText()
+{
+    static const char FMT[] = "count=%d name=%s";
+    static const journal_event_desc_t EVENT = { journal_event_id("T", FMT), "T", FMT };
+
+    journal_record_t deferred{};
+    deferred.event  = &EVENT;
+    deferred.flags  = JOURNAL_RECORD_DEFERRED;
+    deferred.length = static_cast<uint8_t>(journal_args_pack_v(deferred.data, sizeof(deferred.data),
+                                                               FMT, 7, "gate"));
+    char out[JOURNAL_MSG_MAX_SIZE];
+    journal_record_render(deferred, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("count=7 name=gate", out);
+
+    journal_record_t text{};
+    text.length = static_cast<uint8_t>(std::snprintf(reinterpret_cast<char*>(text.data),
+                                                     sizeof(text.data), "already formatted"));
+    journal_record_render(text, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("already formatted", out);
+}
+
+// ---------------------------------------------------------------------------
+// ELF string table — synthetic little-endian ELF32 image
+// ---------------------------------------------------------------------------
+
+static void put_le(std::vector<uint8_t>& v, size_t off, uint64_t val, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        v[off + i] = static_cast<uint8_t>(val >> (8 * i));
+}
+
+// Builds an ELF32 with one allocated PROGBITS section at vaddr 0x3F400000
+// holding two strings, plus one non-allocated section that must be ignored.
+static std::vector<uint8_t> make_elf32()
+{
+    static const char RODATA[] = "Boot %s\0Temp %d";
+    constexpr size_t RODATA_OFF = 0x40;
+    constexpr size_t SHOFF      = 0x60;
+    constexpr size_t SHENTSIZE  = 40;
+
+    std::vector<uint8_t> img(SHOFF + 3 * SHENTSIZE, 0);
+    std::memcpy(img.data(), "\x7f" "ELF", 4);
+    img[4] = 1; // ELFCLASS32
+    img[5] = 1; // little-endian
+    img[6] = 1;
+    put_le(img, 0x20, SHOFF, 4);
+    put_le(img, 0x2E, SHENTSIZE, 2);
+    put_le(img, 0x30, 3, 2);
+    std::memcpy(&img[RODATA_OFF], RODATA, sizeof(RODATA));
+
+    // [0] null section, [1] .flash.rodata (ALLOC), [2] .comment (not ALLOC)
+    const size_t sh1 = SHOFF + SHENTSIZE;
+    put_le(img, sh1 + 0x04, 1, 4);           // SHT_PROGBITS
+    put_le(img, sh1 + 0x08, 0x2, 4);         // SHF_ALLOC
+    put_le(img, sh1 + 0x0C, 0x3F400000, 4);  // addr
+    put_le(img, sh1 + 0x10, RODATA_OFF, 4);  // offset
+    put_le(img, sh1 + 0x14, sizeof(RODATA), 4);
+
+    const size_t sh2 = SHOFF + 2 * SHENTSIZE;
+    put_le(img, sh2 + 0x04, 1, 4);
+    put_le(img, sh2 + 0x0C, 0x1000, 4);
+    put_le(img, sh2 + 0x10, RODATA_OFF, 4);
+    put_le(img, sh2 + 0x14, sizeof(RODATA), 4);
+    return img;
+}
+
+void ElfStrings_Resolve_AddressInRodata_ReturnsString()
+{
+    ElfStringTable table;
+    TEST_ASSERT_TRUE(table.Load(make_elf32()));
+    TEST_ASSERT_EQUAL(1, table.SectionCount());
+    TEST_ASSERT_EQUAL_STRING("Boot %s", table.Resolve(0x3F400000));
+    TEST_ASSERT_EQUAL_STRING("Temp %d", table.Resolve(0x3F400008));
+}
+
+void ElfStrings_Resolve_UnknownAddress_ReturnsNull()
+{
+    ElfStringTable table;
+    TEST_ASSERT_TRUE(table.Load(make_elf32()));
+    TEST_ASSERT_TRUE(table.Resolve(0x1000) == nullptr);     // non-ALLOC section
+    TEST_ASSERT_TRUE(table.Resolve(0x3F500000) == nullptr); // outside any section
+}
+
+void ElfStrings_Load_NotElf_Fails()
+{
+    ElfStringTable table;
+    TEST_ASSERT_FALSE(table.Load(std::vector<uint8_t>(64, 0)));
+}
+
+void ElfStrings_DecodeDeferredRecord_AgainstElf()
+{
+    ElfStringTable table;
+    TEST_ASSERT_TRUE(table.Load(make_elf32()));
+
+    // Record captured on target: format address + packed args
+    uint8_t packed[32];
+    const size_t len = journal_args_pack_v(packed, sizeof(packed), "Temp %d", 21);
+
+    char out[64];
+    journal_args_format(table.Resolve(0x3F400008), packed, len, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("Temp 21", out);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    UnityDefaultTestRun(JournalArgs_NoArgs_LiteralCopied,
+                        "JournalArgs_NoArgs_LiteralCopied", __FILE__);
+    UnityDefaultTestRun(JournalArgs_PercentEscape_Rendered,
+                        "JournalArgs_PercentEscape_Rendered", __FILE__);
+    UnityDefaultTestRun(JournalArgs_Integers_MatchSnprintf,
+                        "JournalArgs_Integers_MatchSnprintf", __FILE__);
+    UnityDefaultTestRun(JournalArgs_WideIntegers_MatchSnprintf,
+                        "JournalArgs_WideIntegers_MatchSnprintf", __FILE__);
+    UnityDefaultTestRun(JournalArgs_FlagsWidthPrecision_MatchSnprintf,
+                        "JournalArgs_FlagsWidthPrecision_MatchSnprintf", __FILE__);
+    UnityDefaultTestRun(JournalArgs_Floats_MatchSnprintf,
+                        "JournalArgs_Floats_MatchSnprintf", __FILE__);
+    UnityDefaultTestRun(JournalArgs_Strings_MatchSnprintf,
+                        "JournalArgs_Strings_MatchSnprintf", __FILE__);
+    UnityDefaultTestRun(JournalArgs_StringArgCopied_NotReferenced,
+                        "JournalArgs_StringArgCopied_NotReferenced", __FILE__);
+    UnityDefaultTestRun(JournalArgs_StringPrecision_OnlyThatManyBytesCopied,
+                        "JournalArgs_StringPrecision_OnlyThatManyBytesCopied", __FILE__);
+
+    UnityDefaultTestRun(JournalArgs_BufferFull_RemainingArgsMissing,
+                        "JournalArgs_BufferFull_RemainingArgsMissing", __FILE__);
+    UnityDefaultTestRun(JournalArgs_LongString_TruncatedToFit,
+                        "JournalArgs_LongString_TruncatedToFit", __FILE__);
+    UnityDefaultTestRun(JournalArgs_OutputBufferSmall_TruncatedAndTerminated,
+                        "JournalArgs_OutputBufferSmall_TruncatedAndTerminated", __FILE__);
+    UnityDefaultTestRun(JournalArgs_PackedSmallerThanText,
+                        "JournalArgs_PackedSmallerThanText", __FILE__);
+
+    UnityDefaultTestRun(JournalRecord_Render_DeferredAndText,
+                        "JournalRecord_Render_DeferredAndText", __FILE__);
+
+    UnityDefaultTestRun(ElfStrings_Resolve_AddressInRodata_ReturnsString,
+                        "ElfStrings_Resolve_AddressInRodata_ReturnsString", __FILE__);
+    UnityDefaultTestRun(ElfStrings_Resolve_UnknownAddress_ReturnsNull,
+                        "ElfStrings_Resolve_UnknownAddress_ReturnsNull", __FILE__);
+    UnityDefaultTestRun(ElfStrings_Load_NotElf_Fails,
+                        "ElfStrings_Load_NotElf_Fails", __FILE__);
+    UnityDefaultTestRun(ElfStrings_DecodeDeferredRecord_AgainstElf,
+                        "ElfStrings_DecodeDeferredRecord_AgainstElf", __FILE__);
+
+    return UNITY_END();
+}
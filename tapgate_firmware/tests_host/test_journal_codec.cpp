@@ -0,0 +1,428 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_codec.h"
+#include "journal_store.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+static char g_dir[64];
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_codec_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+}
+
+extern "C" void tearDown(void)
+{
+    DIR *dir = opendir(g_dir);
+    if (dir) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const std::string path = std::string(g_dir) + "/" + entry->d_name;
+            std::remove(path.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(g_dir);
+}
+
+#define ERR_FORMAT "\"%s\" (0x%x)"
+
+static const char FMT_NVM[]    = "Internal NVM access failed: " ERR_FORMAT;
+static const char FMT_WRITE[]  = "Write \"%s\": %u byte(s)";
+static const char FMT_CLIENT[] = "Client %u enrolled, %d slot(s) left";
+static const char FMT_DEBUG[]  = "Debug Mode enabled";
+static const char FMT_MIXED[]  = "i32=%d u32=%u i64=%lld ptr=%p f=%f s=%s";
+
+static const journal_event_desc_t EV_NVM    = { journal_event_id("TAG_MAIN", FMT_NVM), "TAG_MAIN", FMT_NVM };
+static const journal_event_desc_t EV_WRITE  = { journal_event_id("NVM", FMT_WRITE), "NVM", FMT_WRITE };
+static const journal_event_desc_t EV_CLIENT = { journal_event_id("DeviceCtx", FMT_CLIENT), "DeviceCtx", FMT_CLIENT };
+static const journal_event_desc_t EV_DEBUG  = { journal_event_id("TAG_MAIN", FMT_DEBUG), "TAG_MAIN", FMT_DEBUG };
+static const journal_event_desc_t EV_MIXED  = { journal_event_id("T", FMT_MIXED), "T", FMT_MIXED };
+
+template <typename... Args>
+static journal_record_t deferred(const journal_event_desc_t &event, uint8_t type, int64_t ts, Args... args)
+{
+    journal_record_t record{};
+    record.timestamp_ms = ts;
+    record.event        = &event;
+    record.type         = type;
+    record.flags        = JOURNAL_RECORD_DEFERRED;
+    record.length       = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), event.fmt, args...));
+    return record;
+}
+
+static std::string render(const journal_record_t &record)
+{
+    char out[JOURNAL_MSG_MAX_SIZE];
+    journal_record_render(record, out, sizeof(out));
+    return out;
+}
+
+// Decodes and checks the record matches what was encoded
+static void check_round_trip(const journal_record_t &in, const uint8_t *buf, size_t len, JournalCodecState &state)
+{
+    journal_record_t out{};
+    uint16_t id = 0;
+    TEST_ASSERT_TRUE(journal_codec_decode(buf, len, state, out, id));
+    TEST_ASSERT_EQUAL(in.event->id, id);
+    TEST_ASSERT_EQUAL(in.timestamp_ms, out.timestamp_ms);
+    TEST_ASSERT_EQUAL(in.type, out.type);
+    TEST_ASSERT_EQUAL(in.flags, out.flags);
+    TEST_ASSERT_EQUAL(in.length, out.length);
+    TEST_ASSERT_EQUAL(in.repeat, out.repeat);
+    TEST_ASSERT_EQUAL(in.span_ms, out.span_ms);
+    TEST_ASSERT_EQUAL_MEMORY(in.data, out.data, in.length);
+    // Test descriptors are not in the registry: resolve the ID by hand
+    TEST_ASSERT_TRUE(out.event == nullptr);
+    out.event = in.event;
+    TEST_ASSERT_EQUAL_STRING(render(in).c_str(), render(out).c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Codec
+// ---------------------------------------------------------------------------
+
+void JournalCodec_RoundTrip_AllArgumentKinds()
+{
+    const journal_record_t records[] = {
+        deferred(EV_MIXED, 0, 1760000000123, -5, 0xFFFFFFF0u, -1234567890123LL, reinterpret_cast<void*>(0x3ffb1234), 2.5, "gate"),
+        deferred(EV_MIXED, 3, 1760000000124, INT32_MIN, 0u, INT64_MIN, nullptr, -0.0, ""),
+        deferred(EV_NVM, 2, 1760000009999, "ESP_ERR_NVS_NO_FREE_PAGES", 0x110d),
+        deferred(EV_DEBUG, 1, 1760000009999),
+    };
+
+    JournalCodecState enc{};
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+    for (const journal_record_t &record : records) {
+        const size_t len = journal_codec_encode(record, false, enc, buf, sizeof(buf));
+        TEST_ASSERT_TRUE(len >= JOURNAL_CODEC_RECORD_MIN);
+        check_round_trip(record, buf, len, dec);
+    }
+
+    // Text (non-deferred) records
+    journal_record_t text{};
+    text.timestamp_ms = 1760000010000;
+    text.event        = &EV_DEBUG;
+    text.length       = static_cast<uint8_t>(std::snprintf(reinterpret_cast<char*>(text.data), sizeof(text.data), "formatted"));
+    const size_t len = journal_codec_encode(text, false, enc, buf, sizeof(buf));
+    check_round_trip(text, buf, len, dec);
+}
+
+void JournalCodec_Dictionary_RepeatedEventsReferenced()
+{
+    JournalCodecState enc{};
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+
+    const journal_record_t first = deferred(EV_CLIENT, 0, 1000, 7u, 3);
+    const size_t defined = journal_codec_encode(first, false, enc, buf, sizeof(buf));
+    check_round_trip(first, buf, defined, dec);
+
+    const journal_record_t again = deferred(EV_CLIENT, 0, 1200, 7u, 3);
+    const size_t referenced = journal_codec_encode(again, false, enc, buf, sizeof(buf));
+    check_round_trip(again, buf, referenced, dec);
+    TEST_ASSERT_EQUAL(defined - 2, referenced);
+
+    // More distinct events than fit the header index and the dictionary
+    std::vector<journal_event_desc_t> events(JOURNAL_CODEC_DICT_MAX + 8);
+    for (size_t i = 0; i < events.size(); ++i)
+        events[i] = { static_cast<uint16_t>(0x100 + i), "T", FMT_DEBUG };
+    for (int pass = 0; pass < 3; ++pass) {
+        for (size_t i = 0; i < events.size(); ++i) {
+            const journal_record_t record = deferred(events[i], 0, 2000 + pass * 100 + static_cast<int64_t>(i));
+            const size_t len = journal_codec_encode(record, false, enc, buf, sizeof(buf));
+            check_round_trip(record, buf, len, dec);
+        }
+    }
+}
+
+void JournalCodec_Restart_DecodesWithoutHistory()
+{
+    JournalCodecState enc{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+
+    journal_codec_encode(deferred(EV_WRITE, 0, 5000, "uid", 16u), false, enc, buf, sizeof(buf));
+
+    // Delta record needs the previous ones
+    const journal_record_t delta = deferred(EV_WRITE, 0, 5100, "uid", 16u);
+    JournalCodecState probe = enc;
+    size_t len = journal_codec_encode(delta, false, probe, buf, sizeof(buf));
+    JournalCodecState fresh{};
+    journal_record_t out{};
+    uint16_t id = 0;
+    TEST_ASSERT_FALSE(journal_codec_decode(buf, len, fresh, out, id));
+
+    // Restart record decodes alone, and resets a stale decoder
+    len = journal_codec_encode(delta, true, enc, buf, sizeof(buf));
+    JournalCodecState stale{};
+    stale.valid        = true;
+    stale.timestamp_ms = 123;
+    stale.count        = 1;
+    stale.ids[0]       = 0xBEEF;
+    check_round_trip(delta, buf, len, fresh);
+    check_round_trip(delta, buf, len, stale);
+}
+
+void JournalCodec_RepeatSummary_KeptOutOfDictionary()
+{
+    JournalCodecState enc{};
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+
+    journal_record_t summary = deferred(EV_NVM, 2, 7000, "ESP_ERR_NVS_NO_FREE_PAGES", 0x110d);
+    summary.flags  |= JOURNAL_RECORD_REPEAT;
+    summary.repeat  = 41;
+    summary.span_ms = 123456;
+    size_t len = journal_codec_encode(summary, false, enc, buf, sizeof(buf));
+    check_round_trip(summary, buf, len, dec);
+    TEST_ASSERT_EQUAL(0, enc.count);
+    TEST_ASSERT_EQUAL(0, dec.count);
+    TEST_ASSERT_TRUE(render(summary).find("[repeated 41 times in 123456 ms]") != std::string::npos);
+
+    // A plain record of the same event defines it, the next one references it
+    const journal_record_t plain = deferred(EV_NVM, 2, 7100, "ESP_ERR_NVS_NO_FREE_PAGES", 0x110d);
+    const size_t defined = journal_codec_encode(plain, false, enc, buf, sizeof(buf));
+    check_round_trip(plain, buf, defined, dec);
+    journal_record_t again = plain;
+    again.timestamp_ms = 7200;
+    len = journal_codec_encode(again, false, enc, buf, sizeof(buf));
+    check_round_trip(again, buf, len, dec);
+    TEST_ASSERT_EQUAL(defined - 2, len);
+
+    // Summaries stay inline even when the event is in the dictionary
+    summary.timestamp_ms = 7300;
+    len = journal_codec_encode(summary, false, enc, buf, sizeof(buf));
+    check_round_trip(summary, buf, len, dec);
+    TEST_ASSERT_EQUAL(1, enc.count);
+}
+
+void JournalCodec_Timestamps_NegativeAndLargeDeltas()
+{
+    const int64_t times[] = { 0, 1760000000000, 1759999999000, 1760000000001, -5, INT64_MAX / 4, 3 };
+    JournalCodecState enc{};
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+    for (const int64_t ts : times) {
+        const journal_record_t record = deferred(EV_DEBUG, 1, ts);
+        const size_t len = journal_codec_encode(record, false, enc, buf, sizeof(buf));
+        check_round_trip(record, buf, len, dec);
+    }
+}
+
+void JournalCodec_Key_FollowsDeltaChain()
+{
+    JournalCodecState enc{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+
+    size_t len = journal_codec_encode(deferred(EV_NVM, 2, 90000, "E", 1), false, enc, buf, sizeof(buf));
+    JournalKey key{};
+    TEST_ASSERT_TRUE(journal_codec_key(buf, len, nullptr, key));
+    TEST_ASSERT_EQUAL(90000, key.timestamp_ms);
+    TEST_ASSERT_EQUAL(2, key.severity);
+
+    len = journal_codec_encode(deferred(EV_DEBUG, 1, 90250), false, enc, buf, sizeof(buf));
+    const JournalKey prev = key;
+    TEST_ASSERT_FALSE(journal_codec_key(buf, len, nullptr, key));
+    TEST_ASSERT_TRUE(journal_codec_key(buf, len, &prev, key));
+    TEST_ASSERT_EQUAL(90250, key.timestamp_ms);
+    TEST_ASSERT_EQUAL(1, key.severity);
+}
+
+void JournalCodec_Decode_TruncatedInputNeverOverruns()
+{
+    JournalCodecState enc{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+    const journal_record_t record = deferred(EV_MIXED, 0, 1760000000123, -5, 1u, 1LL << 40, nullptr, 1.0, "abcdef");
+    const size_t len = journal_codec_encode(record, true, enc, buf, sizeof(buf));
+
+    for (size_t cut = 0; cut < len; ++cut) {
+        // Exact-size heap copy so a read past the end is caught by sanitizers
+        std::vector<uint8_t> prefix(buf, buf + cut);
+        JournalCodecState dec{};
+        journal_record_t out{};
+        uint16_t id = 0;
+        const bool ok = journal_codec_decode(prefix.data(), prefix.size(), dec, out, id);
+        if (cut < 4)
+            TEST_ASSERT_FALSE(ok);
+        if (ok)
+            TEST_ASSERT_TRUE(out.length <= record.length);
+    }
+
+    // Encoding into a buffer that is too small fails without touching the state
+    JournalCodecState before = enc;
+    TEST_ASSERT_EQUAL(0, journal_codec_encode(record, false, enc, buf, 4));
+    TEST_ASSERT_EQUAL_MEMORY(&before, &enc, sizeof(enc));
+}
+
+// Typical traffic: repeated NVM/DeviceCtx events, small integers, esp_err_t
+// codes, timestamps a fraction of a second apart. Compared with the fixed
+// layout (i64 timestamp, u16 event ID, type, flags + packed arguments).
+void JournalCodec_CompressionRatio_TypicalEvents()
+{
+    static constexpr size_t FIXED_HEADER = 12;
+    static constexpr size_t SECTOR       = 4096;
+
+    JournalCodecState enc{};
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+    size_t fixed = 0;
+    size_t compact = 0;
+    size_t count = 0;
+    int64_t ts = 1760000000000;
+
+    for (uint32_t i = 0; i < 2000; ++i) {
+        ts += 40 + (i * 7919) % 900;
+        journal_record_t record;
+        switch (i % 8) {
+            case 0:  record = deferred(EV_NVM, 2, ts, "ESP_ERR_NVS_NOT_FOUND", 0x1102); break;
+            case 1:
+            case 2:
+            case 3:  record = deferred(EV_WRITE, 0, ts, "ctr", 4u); break;
+            case 4:
+            case 5:  record = deferred(EV_CLIENT, 0, ts, i % 50, static_cast<int>(50 - i % 50)); break;
+            default: record = deferred(EV_DEBUG, 1, ts); break;
+        }
+        // A restart every 16 records, like the store's index blocks
+        const size_t len = journal_codec_encode(record, i % 16 == 0, enc, buf, sizeof(buf));
+        check_round_trip(record, buf, len, dec);
+
+        fixed   += FIXED_HEADER + record.length;
+        compact += len;
+        ++count;
+    }
+
+    const double ratio = static_cast<double>(fixed) / static_cast<double>(compact);
+    const size_t frame = JournalStore::FRAME_OVERHEAD;
+    std::printf("%zu records: fixed %zu B, compact %zu B, payload ratio %.2fx; per 4 KiB sector %zu -> %zu records\n",
+                count, fixed, compact, ratio,
+                SECTOR / (fixed / count + frame), SECTOR / (compact / count + frame));
+    TEST_ASSERT_TRUE(ratio >= 2.0);
+}
+
+// ---------------------------------------------------------------------------
+// With the store: restarts at segment and index block starts
+// ---------------------------------------------------------------------------
+
+struct Journal
+{
+    JournalFileStorage                         storage;
+    JournalStore                               store;
+    std::vector<JournalStore::SegmentSummary>  summaries;
+    std::vector<JournalStore::IndexBlock>      blocks;
+    JournalCodecState                          codec{};
+
+    explicit Journal(const JournalStore::Config &config)
+        : storage(g_dir), store(storage, config),
+          summaries(config.max_segments + 1), blocks(JournalStore::MaxBlocks(config, JOURNAL_CODEC_RECORD_MIN))
+    {
+        store.AttachIndex(journal_codec_key, summaries, blocks);
+        TEST_ASSERT_EQUAL(ESP_OK, store.Mount());
+    }
+
+    // Same sequence as the flush task
+    void Append(const journal_record_t &record)
+    {
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        JournalCodecState next = codec;
+        size_t len = journal_codec_encode(record, false, next, buf, sizeof(buf));
+        if (store.StartsBlock(len)) {
+            next = codec;
+            len  = journal_codec_encode(record, true, next, buf, sizeof(buf));
+        }
+        TEST_ASSERT_EQUAL(ESP_OK, store.Append(buf, len));
+        codec = next;
+    }
+};
+
+static journal_record_t nth_event(uint32_t i)
+{
+    const int64_t ts = 1760000000000 + 100 * static_cast<int64_t>(i);
+    return i % 61 == 7 ? deferred(EV_NVM, 2, ts, "ESP_FAIL", 0x1 + i)
+                       : deferred(EV_CLIENT, 0, ts, i, static_cast<int>(i % 5));
+}
+
+void JournalCodec_Store_QueryDecodesFromBlockStarts()
+{
+    const JournalStore::Config config = { 2048, 32, 16 };
+    {
+        Journal journal(config);
+        for (uint32_t i = 0; i < 1500; ++i)
+            journal.Append(nth_event(i));
+    }
+
+    // After a reboot the encoder has no state: it restarts mid-block
+    Journal journal(config);
+    for (uint32_t i = 1500; i < 3000; ++i)
+        journal.Append(nth_event(i));
+
+    const int64_t since = nth_event(1000).timestamp_ms;
+    JournalStore::Reader reader = journal.store.Query({ since, 1u << 2, true });
+    JournalCodecState dec{};
+    uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+    size_t len = 0;
+    std::vector<uint32_t> found;
+    while (reader.Next(buf, sizeof(buf), len) == ESP_OK) {
+        journal_record_t record{};
+        uint16_t id = 0;
+        TEST_ASSERT_TRUE(journal_codec_decode(buf, len, dec, record, id));
+        const uint32_t i = static_cast<uint32_t>((record.timestamp_ms - 1760000000000) / 100);
+        TEST_ASSERT_EQUAL(i, reader.Seq());
+        if (record.timestamp_ms >= since && record.type == 2) {
+            TEST_ASSERT_EQUAL(EV_NVM.id, id);
+            record.event = &EV_NVM;
+            TEST_ASSERT_EQUAL_STRING(render(nth_event(i)).c_str(), render(record).c_str());
+            found.push_back(i);
+        }
+    }
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 1000; i < 3000; ++i) {
+        if (i % 61 == 7)
+            expected.push_back(i);
+    }
+    TEST_ASSERT_TRUE(found == expected);
+    TEST_ASSERT_TRUE(reader.Visited() < 3000 / 2);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalCodec_RoundTrip_AllArgumentKinds,
+                        "JournalCodec_RoundTrip_AllArgumentKinds", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Dictionary_RepeatedEventsReferenced,
+                        "JournalCodec_Dictionary_RepeatedEventsReferenced", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Restart_DecodesWithoutHistory,
+                        "JournalCodec_Restart_DecodesWithoutHistory", __FILE__);
+    UnityDefaultTestRun(JournalCodec_RepeatSummary_KeptOutOfDictionary,
+                        "JournalCodec_RepeatSummary_KeptOutOfDictionary", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Timestamps_NegativeAndLargeDeltas,
+                        "JournalCodec_Timestamps_NegativeAndLargeDeltas", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Key_FollowsDeltaChain,
+                        "JournalCodec_Key_FollowsDeltaChain", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Decode_TruncatedInputNeverOverruns,
+                        "JournalCodec_Decode_TruncatedInputNeverOverruns", __FILE__);
+    UnityDefaultTestRun(JournalCodec_CompressionRatio_TypicalEvents,
+                        "JournalCodec_CompressionRatio_TypicalEvents", __FILE__);
+    UnityDefaultTestRun(JournalCodec_Store_QueryDecodesFromBlockStarts,
+                        "JournalCodec_Store_QueryDecodesFromBlockStarts", __FILE__);
+    return UNITY_END();
+}
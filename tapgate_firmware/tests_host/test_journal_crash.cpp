@@ -0,0 +1,418 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_codec.h"
+#include "journal_crash.h"
+#include "journal_store.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+// The RTC no-init region is emulated by a file mapped MAP_SHARED: unmapping
+// and mapping it again is a reset that keeps the memory contents.
+
+static constexpr size_t SLOTS = 8;
+using Region = JournalCrashRegion<SLOTS>;
+
+static char g_dir[64];
+static std::string g_region_path;
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_crash_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+    g_region_path = std::string(g_dir) + "/rtc_noinit.bin";
+}
+
+extern "C" void tearDown(void)
+{
+    DIR *dir = opendir(g_dir);
+    if (dir) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const std::string path = std::string(g_dir) + "/" + entry->d_name;
+            std::remove(path.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(g_dir);
+}
+
+// One boot: the retained region mapped for the lifetime of the object
+class RetainedRegion
+{
+public:
+    RetainedRegion()
+    {
+        const int fd = open(g_region_path.c_str(), O_RDWR | O_CREAT, 0600);
+        TEST_ASSERT_TRUE(fd >= 0);
+        TEST_ASSERT_EQUAL(0, ftruncate(fd, sizeof(Region)));
+        void *p = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        TEST_ASSERT_TRUE(p != MAP_FAILED);
+        m_region = static_cast<Region *>(p);
+    }
+
+    ~RetainedRegion()
+    {
+        msync(m_region, sizeof(Region), MS_SYNC);
+        munmap(m_region, sizeof(Region));
+    }
+
+    RetainedRegion(const RetainedRegion&) = delete;
+    RetainedRegion& operator=(const RetainedRegion&) = delete;
+
+    Region &operator*() { return *m_region; }
+    uint8_t *bytes() { return reinterpret_cast<uint8_t *>(m_region); }
+
+private:
+    Region *m_region;
+};
+
+static const char FMT_WRITE[] = "Write \"%s\": %u byte(s)";
+static const char FMT_FAIL[]  = "Commit failed: %d";
+
+static const journal_event_desc_t EV_WRITE = { journal_event_id("NVM", FMT_WRITE), "NVM", FMT_WRITE };
+static const journal_event_desc_t EV_FAIL  = { journal_event_id("NVM", FMT_FAIL), "NVM", FMT_FAIL };
+
+static journal_record_t nth_event(uint32_t i)
+{
+    journal_record_t record{};
+    record.timestamp_ms = 1760000000000 + 250 * static_cast<int64_t>(i);
+    record.flags        = JOURNAL_RECORD_DEFERRED;
+    if (i % 3 == 2) {
+        record.event  = &EV_FAIL;
+        record.type   = 2;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_FAIL,
+                                                                 -static_cast<int>(i)));
+    } else {
+        record.event  = &EV_WRITE;
+        record.type   = 0;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_WRITE,
+                                                                 "device_ctx", i));
+    }
+    return record;
+}
+
+// Test descriptors are not in the registry: resolve IDs by hand
+static void resolve(journal_record_t &record, uint16_t id)
+{
+    TEST_ASSERT_TRUE(record.event == nullptr);
+    record.event = id == EV_FAIL.id ? &EV_FAIL : &EV_WRITE;
+}
+
+static void check_equal(const journal_record_t &expected, const journal_record_t &actual)
+{
+    TEST_ASSERT_EQUAL(expected.timestamp_ms, actual.timestamp_ms);
+    TEST_ASSERT_TRUE(expected.event == actual.event);
+    TEST_ASSERT_EQUAL(expected.type, actual.type);
+    TEST_ASSERT_EQUAL(expected.flags, actual.flags);
+    TEST_ASSERT_EQUAL(expected.length, actual.length);
+    TEST_ASSERT_EQUAL_MEMORY(expected.data, actual.data, expected.length);
+}
+
+// ---------------------------------------------------------------------------
+// Retained region
+// ---------------------------------------------------------------------------
+
+void JournalCrash_PowerOn_InvalidUntilReset()
+{
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+
+    TEST_ASSERT_FALSE(tail.Valid());
+    TEST_ASSERT_EQUAL(0, tail.Pending());
+    tail.Record(nth_event(0));
+    TEST_ASSERT_FALSE(tail.Valid());
+
+    // Power-on garbage is no better than zeros
+    std::memset(region.bytes(), 0xA5, sizeof(Region));
+    TEST_ASSERT_FALSE(tail.Valid());
+
+    tail.Reset();
+    TEST_ASSERT_TRUE(tail.Valid());
+    TEST_ASSERT_EQUAL(0, tail.Pending());
+    TEST_ASSERT_EQUAL(INT64_MAX, tail.OldestTimestamp());
+}
+
+void JournalCrash_Reset_RecordsSurviveOldestFirst()
+{
+    {
+        RetainedRegion region;
+        JournalCrashTail tail(*region);
+        tail.Reset();
+        for (uint32_t i = 0; i < 5; ++i)
+            tail.Record(nth_event(i));
+    }
+
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+    TEST_ASSERT_TRUE(tail.Valid());
+    TEST_ASSERT_EQUAL(5, tail.Pending());
+    TEST_ASSERT_EQUAL(nth_event(0).timestamp_ms, tail.OldestTimestamp());
+
+    journal_record_t record;
+    uint16_t id = 0;
+    for (uint32_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_TRUE(tail.Take(record, id));
+        resolve(record, id);
+        check_equal(nth_event(i), record);
+    }
+    TEST_ASSERT_FALSE(tail.Take(record, id));
+    TEST_ASSERT_EQUAL(0, tail.Pending());
+}
+
+void JournalCrash_Wraparound_KeepsNewest()
+{
+    {
+        RetainedRegion region;
+        JournalCrashTail tail(*region);
+        tail.Reset();
+        for (uint32_t i = 0; i < 3 * SLOTS + 5; ++i)
+            tail.Record(nth_event(i));
+    }
+
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+    TEST_ASSERT_EQUAL(SLOTS, tail.Pending());
+    TEST_ASSERT_EQUAL(nth_event(3 * SLOTS + 4).timestamp_ms, tail.NewestTimestamp());
+    journal_record_t record;
+    uint16_t id = 0;
+    for (uint32_t i = 2 * SLOTS + 5; i < 3 * SLOTS + 5; ++i) {
+        TEST_ASSERT_TRUE(tail.Take(record, id));
+        resolve(record, id);
+        check_equal(nth_event(i), record);
+    }
+    TEST_ASSERT_FALSE(tail.Take(record, id));
+}
+
+void JournalCrash_TornSlot_Skipped()
+{
+    {
+        RetainedRegion region;
+        JournalCrashTail tail(*region);
+        tail.Reset();
+        for (uint32_t i = 0; i < 6; ++i)
+            tail.Record(nth_event(i));
+
+        // Reset hit while slot 3 was being rewritten
+        (*region).slots[3].timestamp_ms += 1;
+    }
+
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+    TEST_ASSERT_EQUAL(5, tail.Pending());
+    journal_record_t record;
+    uint16_t id = 0;
+    for (const uint32_t i : { 0u, 1u, 2u, 4u, 5u }) {
+        TEST_ASSERT_TRUE(tail.Take(record, id));
+        resolve(record, id);
+        check_equal(nth_event(i), record);
+    }
+
+    // A damaged header invalidates everything
+    tail.Reset();
+    tail.Record(nth_event(0));
+    (*region).header.magic ^= 1;
+    TEST_ASSERT_FALSE(tail.Valid());
+    TEST_ASSERT_EQUAL(0, tail.Pending());
+}
+
+void JournalCrash_NewestTimestamp_SkipsSlotBeingWritten()
+{
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+    tail.Reset();
+    TEST_ASSERT_EQUAL(0, tail.NewestTimestamp());
+
+    for (uint32_t i = 0; i < SLOTS + 2; ++i)
+        tail.Record(nth_event(i));
+    TEST_ASSERT_EQUAL(nth_event(SLOTS + 1).timestamp_ms, tail.NewestTimestamp());
+
+    // Panic while another core was writing the newest slot
+    (*region).slots[(SLOTS + 1) % SLOTS].length ^= 1;
+    TEST_ASSERT_EQUAL(nth_event(SLOTS).timestamp_ms, tail.NewestTimestamp());
+}
+
+void JournalCrash_LayoutChange_Invalid()
+{
+    RetainedRegion region;
+    {
+        JournalCrashTail tail(*region);
+        tail.Reset();
+        tail.Record(nth_event(0));
+    }
+
+    // A build with another capacity must not read the old slots
+    JournalCrashTail smaller((*region).header, std::span<JournalCrashSlot>((*region).slots, SLOTS / 2));
+    TEST_ASSERT_FALSE(smaller.Valid());
+    smaller.Record(nth_event(1));
+
+    JournalCrashTail same(*region);
+    TEST_ASSERT_TRUE(same.Valid());
+    TEST_ASSERT_EQUAL(1, same.Pending());
+}
+
+void JournalCrash_Discard_SkipsPersisted()
+{
+    RetainedRegion region;
+    JournalCrashTail tail(*region);
+    tail.Reset();
+    for (uint32_t i = 0; i < 6; ++i)
+        tail.Record(nth_event(i));
+
+    for (uint32_t i = 0; i < 4; ++i)
+        TEST_ASSERT_TRUE(tail.Discard(nth_event(i)));
+    TEST_ASSERT_FALSE(tail.Discard(nth_event(0)));
+    TEST_ASSERT_FALSE(tail.Discard(nth_event(7)));
+
+    // Same event, other arguments
+    journal_record_t other = nth_event(4);
+    other.data[other.length - 1] ^= 1;
+    TEST_ASSERT_FALSE(tail.Discard(other));
+
+    TEST_ASSERT_EQUAL(2, tail.Pending());
+    TEST_ASSERT_EQUAL(nth_event(4).timestamp_ms, tail.OldestTimestamp());
+}
+
+// ---------------------------------------------------------------------------
+// Recovery into the journal
+// ---------------------------------------------------------------------------
+
+struct Journal
+{
+    JournalFileStorage                         storage;
+    JournalStore                               store;
+    std::vector<JournalStore::SegmentSummary>  summaries;
+    std::vector<JournalStore::IndexBlock>      blocks;
+    JournalCodecState                          codec{};
+
+    explicit Journal(const JournalStore::Config &config)
+        : storage(g_dir), store(storage, config),
+          summaries(config.max_segments + 1), blocks(JournalStore::MaxBlocks(config, JOURNAL_CODEC_RECORD_MIN))
+    {
+        store.AttachIndex(journal_codec_key, summaries, blocks);
+        TEST_ASSERT_EQUAL(ESP_OK, store.Mount());
+    }
+
+    void Append(const journal_record_t &record)
+    {
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        JournalCodecState next = codec;
+        size_t len = journal_codec_encode(record, false, next, buf, sizeof(buf));
+        if (store.StartsBlock(len)) {
+            next = codec;
+            len  = journal_codec_encode(record, true, next, buf, sizeof(buf));
+        }
+        TEST_ASSERT_EQUAL(ESP_OK, store.Append(buf, len));
+        TEST_ASSERT_EQUAL(ESP_OK, store.Sync());
+        codec = next;
+    }
+
+    template <typename Visit>
+    void Query(int64_t since_ms, Visit visit)
+    {
+        JournalStore::Reader reader = store.Query({ since_ms, 0xFF, true });
+        JournalCodecState state{};
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        size_t len = 0;
+        while (reader.Next(buf, sizeof(buf), len) == ESP_OK) {
+            journal_record_t record{};
+            uint16_t id = 0;
+            TEST_ASSERT_TRUE(journal_codec_decode(buf, len, state, record, id));
+            if (record.timestamp_ms < since_ms)
+                continue;
+            resolve(record, id);
+            visit(record);
+        }
+    }
+};
+
+void JournalCrash_Recovery_MergesOnlyUnpersisted()
+{
+    const JournalStore::Config config = { 1024, 8, 4 };
+    static constexpr uint32_t TOTAL     = 40;
+    static constexpr uint32_t PERSISTED = 35;
+
+    // Boot 1: every record is mirrored; the flush task got through 35 of
+    // them before the watchdog fired
+    {
+        RetainedRegion region;
+        JournalCrashTail tail(*region);
+        tail.Reset();
+        Journal journal(config);
+        for (uint32_t i = 0; i < TOTAL; ++i) {
+            tail.Record(nth_event(i));
+            if (i < PERSISTED)
+                journal.Append(nth_event(i));
+        }
+    }
+
+    // Boot 2: same sequence as event_journal_init()
+    {
+        RetainedRegion region;
+        JournalCrashTail tail(*region);
+        Journal journal(config);
+        TEST_ASSERT_TRUE(tail.Valid());
+        TEST_ASSERT_EQUAL(SLOTS, tail.Pending());
+
+        journal.Query(tail.OldestTimestamp(), [&](const journal_record_t &record) { tail.Discard(record); });
+        TEST_ASSERT_EQUAL(TOTAL - PERSISTED, tail.Pending());
+
+        journal_record_t record;
+        uint16_t id = 0;
+        while (tail.Take(record, id)) {
+            resolve(record, id);
+            journal.Append(record);
+        }
+        tail.Reset();
+        TEST_ASSERT_EQUAL(0, tail.Pending());
+    }
+
+    // Every record exactly once, in order
+    Journal journal(config);
+    std::vector<int64_t> seen;
+    journal.Query(INT64_MIN, [&](const journal_record_t &record) { seen.push_back(record.timestamp_ms); });
+    TEST_ASSERT_EQUAL(TOTAL, seen.size());
+    for (uint32_t i = 0; i < TOTAL; ++i)
+        TEST_ASSERT_EQUAL(nth_event(i).timestamp_ms, seen[i]);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalCrash_PowerOn_InvalidUntilReset,
+                        "JournalCrash_PowerOn_InvalidUntilReset", __FILE__);
+    UnityDefaultTestRun(JournalCrash_Reset_RecordsSurviveOldestFirst,
+                        "JournalCrash_Reset_RecordsSurviveOldestFirst", __FILE__);
+    UnityDefaultTestRun(JournalCrash_Wraparound_KeepsNewest,
+                        "JournalCrash_Wraparound_KeepsNewest", __FILE__);
+    UnityDefaultTestRun(JournalCrash_TornSlot_Skipped,
+                        "JournalCrash_TornSlot_Skipped", __FILE__);
+    UnityDefaultTestRun(JournalCrash_NewestTimestamp_SkipsSlotBeingWritten,
+                        "JournalCrash_NewestTimestamp_SkipsSlotBeingWritten", __FILE__);
+    UnityDefaultTestRun(JournalCrash_LayoutChange_Invalid,
+                        "JournalCrash_LayoutChange_Invalid", __FILE__);
+    UnityDefaultTestRun(JournalCrash_Discard_SkipsPersisted,
+                        "JournalCrash_Discard_SkipsPersisted", __FILE__);
+    UnityDefaultTestRun(JournalCrash_Recovery_MergesOnlyUnpersisted,
+                        "JournalCrash_Recovery_MergesOnlyUnpersisted", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,383 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_codec.h"
+#include "journal_cursor.h"
+#include "journal_store.h"
+#include "journal_tiers.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+// One directory per tier
+static char g_dir[64];
+static char g_retained_dir[64];
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_cursor_XXXXXX");
+    std::snprintf(g_retained_dir, sizeof(g_retained_dir), "/tmp/ej_cursor_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+    TEST_ASSERT_TRUE(mkdtemp(g_retained_dir) != nullptr);
+}
+
+static void remove_dir(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (dir) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const std::string file = std::string(path) + "/" + entry->d_name;
+            std::remove(file.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+extern "C" void tearDown(void)
+{
+    remove_dir(g_dir);
+    remove_dir(g_retained_dir);
+}
+
+class CountingStorage : public JournalStorage
+{
+public:
+    explicit CountingStorage(const char *dir) : m_inner(dir) {}
+
+    size_t read_bytes = 0;
+
+    esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) override { return m_inner.List(first, last, count); }
+    esp_err_t Size(uint32_t segment, size_t &size) override { return m_inner.Size(segment, size); }
+    esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) override
+    {
+        read_bytes += len;
+        return m_inner.Read(segment, offset, buf, len);
+    }
+    esp_err_t Append(uint32_t segment, const void *buf, size_t len) override { return m_inner.Append(segment, buf, len); }
+    esp_err_t Sync(uint32_t segment) override { return m_inner.Sync(segment); }
+    esp_err_t Truncate(uint32_t segment, size_t size) override { return m_inner.Truncate(segment, size); }
+    esp_err_t Remove(uint32_t segment) override { return m_inner.Remove(segment); }
+
+private:
+    JournalFileStorage m_inner;
+};
+
+static const char FMT_WRITE[] = "Write \"%s\": %u byte(s)";
+static const char FMT_FAIL[]  = "Commit failed: %d";
+
+static const journal_event_desc_t EV_WRITE = { journal_event_id("NVM", FMT_WRITE), "NVM", FMT_WRITE };
+static const journal_event_desc_t EV_FAIL  = { journal_event_id("NVM", FMT_FAIL), "NVM", FMT_FAIL };
+
+// Every third record is an ERROR carrying -i (retained tier)
+static journal_record_t nth_event(uint32_t i)
+{
+    journal_record_t record{};
+    record.timestamp_ms = 1760000000000 + 250 * static_cast<int64_t>(i);
+    record.flags        = JOURNAL_RECORD_DEFERRED;
+    if (i % 3 == 2) {
+        record.event  = &EV_FAIL;
+        record.type   = 2;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_FAIL,
+                                                                 -static_cast<int>(i)));
+    } else {
+        record.event  = &EV_WRITE;
+        record.type   = 0;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_WRITE,
+                                                                 "device_ctx", i));
+    }
+    return record;
+}
+
+struct Tier
+{
+    CountingStorage                            storage;
+    JournalStore                               store;
+    std::vector<JournalStore::SegmentSummary>  summaries;
+    std::vector<JournalStore::IndexBlock>      blocks;
+
+    Tier(const char *dir, const JournalStore::Config &config)
+        : storage(dir), store(storage, config),
+          summaries(config.max_segments + 1), blocks(JournalStore::MaxBlocks(config, JOURNAL_CODEC_RECORD_MIN))
+    {
+        store.AttachIndex(journal_codec_key, summaries, blocks);
+    }
+};
+
+struct Journal
+{
+    Tier         rolling;
+    Tier         retained;
+    JournalTiers tiers;
+
+    explicit Journal(const JournalStore::Config &config)
+        : Journal(config, config)
+    {
+    }
+
+    Journal(const JournalStore::Config &rolling_config, const JournalStore::Config &retained_config)
+        : rolling(g_dir, rolling_config), retained(g_retained_dir, retained_config),
+          tiers(rolling.store, retained.store)
+    {
+        TEST_ASSERT_EQUAL(ESP_OK, tiers.Mount());
+    }
+
+    void AppendRange(uint32_t from, uint32_t to)
+    {
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        for (uint32_t i = from; i < to; ++i)
+            TEST_ASSERT_EQUAL(ESP_OK, tiers.Append(nth_event(i), buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL(ESP_OK, tiers.Sync());
+    }
+
+    size_t ReadBytes() const { return rolling.storage.read_bytes + retained.storage.read_bytes; }
+    void ResetReadBytes() { rolling.storage.read_bytes = retained.storage.read_bytes = 0; }
+};
+
+// Records 0..n split into the tiers: sequence numbers of the last ones
+static JournalCursor cursor_at(uint32_t n)
+{
+    return { { n - n / 3, n / 3 }, false };
+}
+
+// What a client received: tier, sequence number and the event number i
+// decoded from the arguments (nth_event(i) was appended as record i)
+struct Received
+{
+    std::vector<size_t>   tiers;
+    std::vector<uint64_t> seqs;
+    std::vector<uint32_t> events;
+    size_t                stop_after = SIZE_MAX;
+};
+
+static bool collect(size_t tier, uint64_t seq, const journal_record_t &record, uint16_t event_id, void *ctx)
+{
+    Received &received = *static_cast<Received *>(ctx);
+    const bool fail = event_id == EV_FAIL.id;
+    char text[64];
+    journal_args_format(fail ? FMT_FAIL : FMT_WRITE, record.data, record.length, text, sizeof(text));
+    int n = -1;
+    if (fail)
+        std::sscanf(text, "Commit failed: %d", &n);
+    else
+        std::sscanf(text, "Write \"device_ctx\": %d", &n);
+    const uint32_t i = static_cast<uint32_t>(fail ? -n : n);
+    received.tiers.push_back(tier);
+    received.seqs.push_back(seq);
+    received.events.push_back(i);
+    return received.seqs.size() < received.stop_after;
+}
+
+static JournalCursor read_since(Journal &journal, const JournalCursor &since, size_t max_records,
+                                Received &received, uint8_t severities = 0xFF)
+{
+    uint8_t buf[JournalTiers::COUNT * JOURNAL_CODEC_RECORD_MAX];
+    JournalCursor cursor{};
+    TEST_ASSERT_EQUAL(ESP_OK, journal_cursor_read(journal.tiers, since, severities, max_records, buf,
+                                                  JOURNAL_CODEC_RECORD_MAX, collect, &received, cursor));
+    return cursor;
+}
+
+static bool same_position(const JournalCursor &a, const JournalCursor &b)
+{
+    return a.next_seq[0] == b.next_seq[0] && a.next_seq[1] == b.next_seq[1];
+}
+
+static const JournalStore::Config CONFIG = { 1024, 16, 8 };
+
+// ---------------------------------------------------------------------------
+// Delta reads
+// ---------------------------------------------------------------------------
+
+void JournalCursor_ReadAll_ThenOnlyNewRecords()
+{
+    Journal journal(CONFIG);
+    journal.AppendRange(0, 30);
+
+    // Both tiers, merged back into append order
+    Received all;
+    JournalCursor cursor = read_since(journal, {}, SIZE_MAX, all);
+    TEST_ASSERT_EQUAL(30, all.seqs.size());
+    TEST_ASSERT_TRUE(same_position(cursor_at(30), cursor));
+    TEST_ASSERT_FALSE(cursor.gap);
+    for (uint32_t i = 0; i < 30; ++i) {
+        TEST_ASSERT_EQUAL(i, all.events[i]);
+        TEST_ASSERT_EQUAL(i % 3 == 2 ? JournalTiers::RETAINED : JournalTiers::ROLLING, all.tiers[i]);
+    }
+    TEST_ASSERT_EQUAL(0, all.seqs[2]);
+    TEST_ASSERT_EQUAL(2, all.seqs[3]);
+
+    // Up to date: nothing, same cursor
+    Received none;
+    const JournalCursor same = read_since(journal, cursor, SIZE_MAX, none);
+    TEST_ASSERT_EQUAL(0, none.seqs.size());
+    TEST_ASSERT_TRUE(same_position(cursor, same));
+    TEST_ASSERT_FALSE(same.gap);
+
+    journal.AppendRange(30, 35);
+    Received delta;
+    cursor = read_since(journal, cursor, SIZE_MAX, delta);
+    TEST_ASSERT_EQUAL(5, delta.seqs.size());
+    TEST_ASSERT_EQUAL(30, delta.events[0]);
+    TEST_ASSERT_EQUAL(34, delta.events[4]);
+    TEST_ASSERT_TRUE(same_position(cursor_at(35), cursor));
+    TEST_ASSERT_FALSE(cursor.gap);
+}
+
+void JournalCursor_Limit_PagesWithoutLossAcrossReboot()
+{
+    {
+        Journal journal(CONFIG);
+        journal.AppendRange(0, 25);
+    }
+
+    // Sequence numbers continue after a remount
+    Journal journal(CONFIG);
+    journal.AppendRange(25, 50);
+
+    std::vector<uint32_t> events;
+    JournalCursor cursor{};
+    for (;;) {
+        Received page;
+        cursor = read_since(journal, cursor, 7, page);
+        TEST_ASSERT_FALSE(cursor.gap);
+        TEST_ASSERT_TRUE(page.seqs.size() <= 7);
+        if (page.seqs.empty())
+            break;
+        TEST_ASSERT_EQUAL(page.seqs.back() + 1, cursor.next_seq[page.tiers.back()]);
+        events.insert(events.end(), page.events.begin(), page.events.end());
+    }
+    TEST_ASSERT_EQUAL(50, events.size());
+    for (uint32_t i = 0; i < 50; ++i)
+        TEST_ASSERT_EQUAL(i, events[i]);
+
+    // A visitor that stops early resumes right after its last record
+    Received first;
+    first.stop_after = 3;
+    cursor = read_since(journal, cursor_at(10), SIZE_MAX, first);
+    TEST_ASSERT_EQUAL(3, first.seqs.size());
+    TEST_ASSERT_EQUAL(12, first.events[2]);
+    TEST_ASSERT_TRUE(same_position(cursor_at(13), cursor));
+}
+
+void JournalCursor_SeverityFilter_AdvancesCursor()
+{
+    Journal journal(CONFIG);
+    journal.AppendRange(0, 20);
+
+    Received errors;
+    const JournalCursor cursor = read_since(journal, cursor_at(3), SIZE_MAX, errors, 1u << 2);
+    TEST_ASSERT_EQUAL(5, errors.seqs.size());
+    TEST_ASSERT_EQUAL(5, errors.events[0]);
+    TEST_ASSERT_TRUE(same_position(cursor_at(20), cursor));
+    TEST_ASSERT_FALSE(cursor.gap);
+}
+
+void JournalCursor_RecentCursor_ReadsOnlyTailBlocks()
+{
+    static constexpr uint32_t TOTAL = 600;
+    Journal journal(CONFIG);
+    journal.AppendRange(0, TOTAL);
+
+    journal.ResetReadBytes();
+    Received all;
+    (void)read_since(journal, {}, SIZE_MAX, all);
+    const size_t full = journal.ReadBytes();
+
+    journal.ResetReadBytes();
+    Received tail;
+    const JournalCursor cursor = read_since(journal, cursor_at(TOTAL - 3), SIZE_MAX, tail);
+    const size_t delta = journal.ReadBytes();
+
+    TEST_ASSERT_EQUAL(3, tail.seqs.size());
+    TEST_ASSERT_EQUAL(TOTAL - 3, tail.events[0]);
+    TEST_ASSERT_TRUE(same_position(cursor_at(TOTAL), cursor));
+    std::printf("\n  %u records: full read %zu bytes, 3-record delta %zu bytes\n", TOTAL, full, delta);
+    TEST_ASSERT_TRUE(delta * 20 < full);
+}
+
+// ---------------------------------------------------------------------------
+// Gaps
+// ---------------------------------------------------------------------------
+
+void JournalCursor_StaleCursorAfterRotation_ReportsGap()
+{
+    // Retained tier: same segments, longer quota
+    Journal journal({ 512, 3, 8 }, { 512, 16, 8 });
+    journal.AppendRange(0, 10);
+
+    Received before;
+    const JournalCursor stale = read_since(journal, {}, 4, before);
+    TEST_ASSERT_TRUE(same_position(cursor_at(4), stale));
+
+    // The client goes away while older rolling segments are rotated out
+    journal.AppendRange(10, 300);
+
+    Received after;
+    const JournalCursor cursor = read_since(journal, stale, SIZE_MAX, after);
+    TEST_ASSERT_TRUE(cursor.gap);
+    TEST_ASSERT_TRUE(after.seqs.size() > 0);
+    TEST_ASSERT_EQUAL(299, after.events.back());
+    TEST_ASSERT_TRUE(same_position(cursor_at(300), cursor));
+
+    // Errors are retained: the first one the client had not seen is still there
+    size_t first_error = 0;
+    while (after.tiers[first_error] != JournalTiers::RETAINED)
+        ++first_error;
+    TEST_ASSERT_EQUAL(5, after.events[first_error]);
+    TEST_ASSERT_EQUAL(1, after.seqs[first_error]);
+
+    // Caught up: no gap any more
+    Received none;
+    const JournalCursor next = read_since(journal, cursor, SIZE_MAX, none);
+    TEST_ASSERT_FALSE(next.gap);
+    TEST_ASSERT_EQUAL(0, none.seqs.size());
+}
+
+void JournalCursor_CursorBeyondJournal_RestartsWithGap()
+{
+    Journal journal(CONFIG);
+    journal.AppendRange(0, 5);
+
+    // Cursor kept by a client from before the journal was erased
+    Received received;
+    const JournalCursor cursor = read_since(journal, { { 1000, 1000 }, false }, SIZE_MAX, received);
+    TEST_ASSERT_TRUE(cursor.gap);
+    TEST_ASSERT_EQUAL(5, received.seqs.size());
+    TEST_ASSERT_EQUAL(0, received.events[0]);
+    TEST_ASSERT_TRUE(same_position(cursor_at(5), cursor));
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalCursor_ReadAll_ThenOnlyNewRecords,
+                        "JournalCursor_ReadAll_ThenOnlyNewRecords", __FILE__);
+    UnityDefaultTestRun(JournalCursor_Limit_PagesWithoutLossAcrossReboot,
+                        "JournalCursor_Limit_PagesWithoutLossAcrossReboot", __FILE__);
+    UnityDefaultTestRun(JournalCursor_SeverityFilter_AdvancesCursor,
+                        "JournalCursor_SeverityFilter_AdvancesCursor", __FILE__);
+    UnityDefaultTestRun(JournalCursor_RecentCursor_ReadsOnlyTailBlocks,
+                        "JournalCursor_RecentCursor_ReadsOnlyTailBlocks", __FILE__);
+    UnityDefaultTestRun(JournalCursor_StaleCursorAfterRotation_ReportsGap,
+                        "JournalCursor_StaleCursorAfterRotation_ReportsGap", __FILE__);
+    UnityDefaultTestRun(JournalCursor_CursorBeyondJournal_RestartsWithGap,
+                        "JournalCursor_CursorBeyondJournal_RestartsWithGap", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+#include "unity.h"
+#include "journal_event.h"
+#include "event_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+// IDs are computed at compile time and depend only on tag + format text
+static_assert(journal_event_id("NVM", "Open failed") == journal_event_id("NVM", "Open failed"));
+static_assert(journal_event_id("NVM", "Open failed") != journal_event_id("NVM", "Open failed: %d"));
+static_assert(journal_event_id("NVM", "Open failed") != journal_event_id("NV", "MOpen failed"));
+static_assert(journal_event_id("", "") != JOURNAL_EVENT_ID_NONE);
+
+// ---------------------------------------------------------------------------
+// Call sites — each function body owns one descriptor, as EVENT_JOURNAL_ADD does
+// ---------------------------------------------------------------------------
+
+static constexpr char TAG[] = "EventTest";
+
+static const journal_event_desc_t* site_boot()      { _EJ_EVENT_DECL(TAG, "Boot %s")     return &_ej_event; }
+static const journal_event_desc_t* site_temp()      { _EJ_EVENT_DECL(TAG, "Temp %d")     return &_ej_event; }
+static const journal_event_desc_t* site_temp_copy() { _EJ_EVENT_DECL(TAG, "Temp %d")     return &_ej_event; }
+static const journal_event_desc_t* site_other_tag() { _EJ_EVENT_DECL("Other", "Temp %d") return &_ej_event; }
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+void JournalEvent_Descriptor_HoldsTagFormatAndId()
+{
+    const journal_event_desc_t* e = site_boot();
+    TEST_ASSERT_EQUAL_STRING("EventTest", e->tag);
+    TEST_ASSERT_EQUAL_STRING("Boot %s", e->fmt);
+    TEST_ASSERT_EQUAL(journal_event_id("EventTest", "Boot %s"), e->id);
+}
+
+void JournalEvent_Registry_EnumeratesAllCallSites()
+{
+    TEST_ASSERT_EQUAL(4, journal_event_count());
+
+    const journal_event_desc_t* sites[] = { site_boot(), site_temp(), site_temp_copy(), site_other_tag() };
+    for (const journal_event_desc_t* site : sites) {
+        bool listed = false;
+        for (size_t i = 0; i < journal_event_count(); ++i)
+            listed |= journal_event_at(i) == site;
+        TEST_ASSERT_TRUE(listed);
+    }
+    TEST_ASSERT_TRUE(journal_event_at(journal_event_count()) == nullptr);
+}
+
+void JournalEvent_Find_ById()
+{
+    const journal_event_desc_t* found = journal_event_find(site_other_tag()->id);
+    TEST_ASSERT_TRUE(found != nullptr);
+    TEST_ASSERT_EQUAL_STRING("Other", found->tag);
+    TEST_ASSERT_TRUE(journal_event_find(JOURNAL_EVENT_ID_NONE) == nullptr);
+}
+
+void JournalEvent_IdenticalSites_ShareIdWithoutCollision()
+{
+    TEST_ASSERT_TRUE(site_temp() != site_temp_copy());
+    TEST_ASSERT_EQUAL(site_temp()->id, site_temp_copy()->id);
+    TEST_ASSERT_TRUE(site_temp()->id != site_other_tag()->id);
+    TEST_ASSERT_EQUAL(0, journal_event_collisions());
+}
+
+// ---------------------------------------------------------------------------
+// Offline table — synthetic little-endian ELF32 with .symtab
+// ---------------------------------------------------------------------------
+
+static void put_le(std::vector<uint8_t>& v, size_t off, uint64_t val, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        v[off + i] = static_cast<uint8_t>(val >> (8 * i));
+}
+
+static void put_section(std::vector<uint8_t>& img, size_t sh, uint32_t type, uint32_t flags,
+                        uint32_t addr, uint32_t offset, uint32_t size, uint32_t link, uint32_t entsize)
+{
+    put_le(img, sh + 0x04, type, 4);
+    put_le(img, sh + 0x08, flags, 4);
+    put_le(img, sh + 0x0C, addr, 4);
+    put_le(img, sh + 0x10, offset, 4);
+    put_le(img, sh + 0x14, size, 4);
+    put_le(img, sh + 0x18, link, 4);
+    put_le(img, sh + 0x24, entsize, 4);
+}
+
+// Rodata at 0x3F400000: [table: 2 pointers][2 descriptors of 12 bytes][strings]
+static std::vector<uint8_t> make_elf32_with_events()
+{
+    constexpr uint32_t BASE       = 0x3F400000;
+    constexpr size_t   RODATA_OFF = 0x40;
+    constexpr size_t   RODATA_LEN = 0x60;
+    constexpr size_t   SYMTAB_OFF = RODATA_OFF + RODATA_LEN;
+    constexpr size_t   STRTAB_OFF = SYMTAB_OFF + 3 * 16;
+    static const char  STRTAB[]   = "\0_ej_events_start\0_ej_events_end";
+    constexpr size_t   SHOFF      = 0x100;
+    constexpr size_t   SHENTSIZE  = 40;
+
+    std::vector<uint8_t> img(SHOFF + 4 * SHENTSIZE, 0);
+    std::memcpy(img.data(), "\x7f" "ELF", 4);
+    img[4] = 1; // ELFCLASS32
+    img[5] = 1; // little-endian
+    img[6] = 1;
+    put_le(img, 0x20, SHOFF, 4);
+    put_le(img, 0x2E, SHENTSIZE, 2);
+    put_le(img, 0x30, 4, 2);
+
+    // Strings
+    const size_t str = RODATA_OFF + 0x20;
+    std::memcpy(&img[str], "NVM\0Open %d\0Boot", 17);
+    const uint32_t tag_nvm  = BASE + 0x20;
+    const uint32_t fmt_open = BASE + 0x24;
+    const uint32_t fmt_boot = BASE + 0x2C;
+
+    // Table of descriptor pointers, then descriptors { u16 id, pad, tag, fmt }
+    put_le(img, RODATA_OFF + 0x00, BASE + 0x08, 4);
+    put_le(img, RODATA_OFF + 0x04, BASE + 0x14, 4);
+    put_le(img, RODATA_OFF + 0x08, 0x1234, 2);
+    put_le(img, RODATA_OFF + 0x0C, tag_nvm, 4);
+    put_le(img, RODATA_OFF + 0x10, fmt_open, 4);
+    put_le(img, RODATA_OFF + 0x14, 0xBEEF, 2);
+    put_le(img, RODATA_OFF + 0x18, tag_nvm, 4);
+    put_le(img, RODATA_OFF + 0x1C, fmt_boot, 4);
+
+    // Symbols: [0] null, [1] _ej_events_start, [2] _ej_events_end (shndx 1)
+    put_le(img, SYMTAB_OFF + 16 + 0x00, 1, 4);
+    put_le(img, SYMTAB_OFF + 16 + 0x04, BASE, 4);
+    put_le(img, SYMTAB_OFF + 16 + 0x0E, 1, 2);
+    put_le(img, SYMTAB_OFF + 32 + 0x00, 18, 4);
+    put_le(img, SYMTAB_OFF + 32 + 0x04, BASE + 0x08, 4);
+    put_le(img, SYMTAB_OFF + 32 + 0x0E, 1, 2);
+    std::memcpy(&img[STRTAB_OFF], STRTAB, sizeof(STRTAB));
+
+    // [1] .flash.rodata  [2] .symtab  [3] .strtab
+    put_section(img, SHOFF + 1 * SHENTSIZE, 1, 0x2, BASE, RODATA_OFF, RODATA_LEN, 0, 0);
+    put_section(img, SHOFF + 2 * SHENTSIZE, 2, 0, 0, SYMTAB_OFF, 3 * 16, 3, 16);
+    put_section(img, SHOFF + 3 * SHENTSIZE, 3, 0, 0, STRTAB_OFF, sizeof(STRTAB), 0, 0);
+    return img;
+}
+
+void EventTable_Elf32_ListsDescriptors()
+{
+    ElfStringTable elf;
+    TEST_ASSERT_TRUE(elf.Load(make_elf32_with_events()));
+
+    uint64_t addr = 0;
+    TEST_ASSERT_TRUE(elf.FindSymbol("_ej_events_end", addr));
+    TEST_ASSERT_EQUAL(0x3F400008, addr);
+    TEST_ASSERT_FALSE(elf.FindSymbol("_ej_events", addr));
+
+    std::vector<JournalEventEntry> entries;
+    TEST_ASSERT_TRUE(journal_event_table_load(elf, entries));
+    TEST_ASSERT_EQUAL(2, entries.size());
+    TEST_ASSERT_EQUAL(0x1234, entries[0].id);
+    TEST_ASSERT_EQUAL_STRING("NVM", entries[0].tag.c_str());
+    TEST_ASSERT_EQUAL_STRING("Open %d", entries[0].fmt.c_str());
+    TEST_ASSERT_EQUAL(0xBEEF, entries[1].id);
+    TEST_ASSERT_EQUAL_STRING("Boot", entries[1].fmt.c_str());
+}
+
+void EventTable_NoBoundSymbols_Fails()
+{
+    std::vector<uint8_t> img = make_elf32_with_events();
+    img[0x40 + 0x60 + 3 * 16 + 1] = 'X'; // corrupt "_ej_events_start"
+
+    ElfStringTable elf;
+    TEST_ASSERT_TRUE(elf.Load(std::move(img)));
+    std::vector<JournalEventEntry> entries;
+    TEST_ASSERT_FALSE(journal_event_table_load(elf, entries));
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    UnityDefaultTestRun(JournalEvent_Descriptor_HoldsTagFormatAndId,
+                        "JournalEvent_Descriptor_HoldsTagFormatAndId", __FILE__);
+    UnityDefaultTestRun(JournalEvent_Registry_EnumeratesAllCallSites,
+                        "JournalEvent_Registry_EnumeratesAllCallSites", __FILE__);
+    UnityDefaultTestRun(JournalEvent_Find_ById,
+                        "JournalEvent_Find_ById", __FILE__);
+    UnityDefaultTestRun(JournalEvent_IdenticalSites_ShareIdWithoutCollision,
+                        "JournalEvent_IdenticalSites_ShareIdWithoutCollision", __FILE__);
+
+    UnityDefaultTestRun(EventTable_Elf32_ListsDescriptors,
+                        "EventTable_Elf32_ListsDescriptors", __FILE__);
+    UnityDefaultTestRun(EventTable_NoBoundSymbols_Fails,
+                        "EventTable_NoBoundSymbols_Fails", __FILE__);
+
+    return UNITY_END();
+}
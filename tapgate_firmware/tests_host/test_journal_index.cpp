@@ -0,0 +1,335 @@
+#include "unity.h"
+#include "journal_store.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Counting backend
+// ---------------------------------------------------------------------------
+
+class CountingStorage : public JournalStorage
+{
+public:
+    explicit CountingStorage(const char *dir) : m_inner(dir) {}
+
+    size_t reads      = 0;
+    size_t read_bytes = 0;
+
+    esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) override { return m_inner.List(first, last, count); }
+    esp_err_t Size(uint32_t segment, size_t &size) override { return m_inner.Size(segment, size); }
+    esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) override
+    {
+        ++reads;
+        read_bytes += len;
+        return m_inner.Read(segment, offset, buf, len);
+    }
+    esp_err_t Append(uint32_t segment, const void *buf, size_t len) override { return m_inner.Append(segment, buf, len); }
+    esp_err_t Sync(uint32_t segment) override { return m_inner.Sync(segment); }
+    esp_err_t Truncate(uint32_t segment, size_t size) override { return m_inner.Truncate(segment, size); }
+    esp_err_t Remove(uint32_t segment) override { return m_inner.Remove(segment); }
+
+private:
+    JournalFileStorage m_inner;
+};
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+static char g_dir[64];
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_index_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+}
+
+extern "C" void tearDown(void)
+{
+    DIR *dir = opendir(g_dir);
+    if (dir) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const std::string path = std::string(g_dir) + "/" + entry->d_name;
+            std::remove(path.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(g_dir);
+}
+
+// Test record: i64 timestamp, u8 severity, u32 record number, filler
+static constexpr size_t RECORD_HEAD = 13;
+
+static bool test_key(const uint8_t *payload, size_t len, const JournalKey *prev, JournalKey &key)
+{
+    (void)prev;
+    if (len < 9)
+        return false;
+    std::memcpy(&key.timestamp_ms, payload, sizeof(key.timestamp_ms));
+    key.severity = payload[8];
+    return true;
+}
+
+static constexpr uint8_t SEV_INFO  = 0;
+static constexpr uint8_t SEV_ERROR = 2;
+
+// Record i: timestamp 10 * i, every 97th is an error
+static int64_t ts_of(uint32_t i) { return 10 * static_cast<int64_t>(i); }
+static uint8_t sev_of(uint32_t i) { return i % 97 == 5 ? SEV_ERROR : SEV_INFO; }
+
+static size_t make_record(uint32_t i, uint8_t *out, size_t filler = 0)
+{
+    const int64_t ts = ts_of(i);
+    std::memcpy(out, &ts, sizeof(ts));
+    out[8] = sev_of(i);
+    std::memcpy(out + 9, &i, sizeof(i));
+    std::memset(out + RECORD_HEAD, 0x5A, filler);
+    return RECORD_HEAD + filler;
+}
+
+static uint32_t record_number(const uint8_t *payload)
+{
+    uint32_t i = 0;
+    std::memcpy(&i, payload + 9, sizeof(i));
+    return i;
+}
+
+// One boot with the index attached
+struct Boot
+{
+    CountingStorage                            storage;
+    JournalStore                               store;
+    std::vector<JournalStore::SegmentSummary>  summaries;
+    std::vector<JournalStore::IndexBlock>      blocks;
+
+    explicit Boot(const JournalStore::Config &config, bool indexed = true)
+        : storage(g_dir), store(storage, config),
+          summaries(config.max_segments + 1), blocks(JournalStore::MaxBlocks(config, RECORD_HEAD))
+    {
+        if (indexed)
+            store.AttachIndex(test_key, summaries, blocks);
+        TEST_ASSERT_EQUAL(ESP_OK, store.Mount());
+    }
+};
+
+static void append_range(JournalStore &store, uint32_t from, uint32_t to, size_t filler = 0)
+{
+    uint8_t buf[RECORD_HEAD + 64];
+    for (uint32_t i = from; i < to; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, store.Append(buf, make_record(i, buf, filler)));
+}
+
+// Record numbers returned by a reader, checking Seq() against them
+static std::vector<uint32_t> collect(JournalStore::Reader &reader, uint32_t seq_base = 0)
+{
+    std::vector<uint32_t> out;
+    uint8_t buf[RECORD_HEAD + 64];
+    size_t len = 0;
+    while (reader.Next(buf, sizeof(buf), len) == ESP_OK) {
+        out.push_back(record_number(buf));
+        TEST_ASSERT_EQUAL(record_number(buf) - seq_base, reader.Seq());
+    }
+    return out;
+}
+
+// Expected result of a filter over records [from, to)
+static std::vector<uint32_t> expected(uint32_t from, uint32_t to, const JournalStore::Filter &filter)
+{
+    std::vector<uint32_t> out;
+    for (uint32_t i = from; i < to; ++i) {
+        if (ts_of(i) >= filter.since_ms && (filter.severities & (1u << sev_of(i))))
+            out.push_back(i);
+    }
+    return out;
+}
+
+static constexpr JournalStore::Config CONFIG = { 4096, 64, 16 };
+static constexpr uint8_t ERRORS = 1u << SEV_ERROR;
+static constexpr uint8_t ALL    = 0xFF;
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+void JournalIndex_Query_MatchesFilteredFullScan()
+{
+    Boot boot(CONFIG);
+    append_range(boot.store, 0, 3000);
+    TEST_ASSERT_TRUE(boot.store.SegmentCount() > 3);
+
+    const JournalStore::Filter filters[] = {
+        { 0, ERRORS }, { 15000, ERRORS }, { 29990, ERRORS }, { 30000, ERRORS },
+        { 12345, ALL }, { 0, 1u << SEV_INFO }, { 0, 0 },
+    };
+    for (const JournalStore::Filter &filter : filters) {
+        JournalStore::Reader reader = boot.store.Query(filter);
+        TEST_ASSERT_TRUE(collect(reader) == expected(0, 3000, filter));
+        TEST_ASSERT_EQUAL(0, reader.Corrupted());
+    }
+}
+
+void JournalIndex_Query_SkipsBlocksWithoutMatches()
+{
+    Boot boot(CONFIG);
+    append_range(boot.store, 0, 3000);
+
+    JournalStore::Reader all = boot.store.Read();
+    TEST_ASSERT_EQUAL(3000, collect(all).size());
+
+    // Errors are one record in 97: at most one block of 16 is read per error
+    JournalStore::Reader errors = boot.store.Query({ 0, ERRORS });
+    const size_t found = collect(errors).size();
+    TEST_ASSERT_EQUAL(expected(0, 3000, { 0, ERRORS }).size(), found);
+    TEST_ASSERT_TRUE(errors.Visited() <= found * CONFIG.index_interval);
+    TEST_ASSERT_TRUE(errors.Visited() < all.Visited() / 4);
+
+    // Recent records only: older segments are skipped from their summaries
+    JournalStore::Reader recent = boot.store.Query({ ts_of(2990), ALL });
+    TEST_ASSERT_EQUAL(10, collect(recent).size());
+    TEST_ASSERT_TRUE(recent.Visited() <= 10 + CONFIG.index_interval);
+}
+
+void JournalIndex_Remount_IndexAndSequenceRestored()
+{
+    {
+        Boot boot(CONFIG);
+        append_range(boot.store, 0, 1234);
+    }
+
+    Boot boot(CONFIG);
+    uint64_t next = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.NextSeq(next));
+    TEST_ASSERT_EQUAL(1234, next);
+
+    // Blocks of the open segment are rebuilt from the records on disk
+    append_range(boot.store, 1234, 2000);
+    JournalStore::Reader reader = boot.store.Query({ 0, ERRORS });
+    TEST_ASSERT_TRUE(collect(reader) == expected(0, 2000, { 0, ERRORS }));
+    TEST_ASSERT_TRUE(reader.Visited() < 2000 / 4);
+}
+
+void JournalIndex_Rotation_SequenceContinuesAfterOldestRemoved()
+{
+    const JournalStore::Config config = { 1024, 4, 8 };
+    Boot boot(config);
+    append_range(boot.store, 0, 1000);
+
+    JournalStore::Reader reader = boot.store.Read();
+    const std::vector<uint32_t> kept = collect(reader);
+    TEST_ASSERT_TRUE(kept.size() < 1000);
+    TEST_ASSERT_EQUAL(999, kept.back());
+    for (size_t k = 1; k < kept.size(); ++k)
+        TEST_ASSERT_EQUAL(kept[k - 1] + 1, kept[k]);
+
+    JournalStore::Reader errors = boot.store.Query({ 0, ERRORS });
+    TEST_ASSERT_TRUE(collect(errors) == expected(kept.front(), 1000, { 0, ERRORS }));
+}
+
+void JournalIndex_UnindexedSegments_QueryStillCorrect()
+{
+    {
+        Boot boot(CONFIG, false);
+        append_range(boot.store, 0, 800);
+    }
+
+    Boot boot(CONFIG);
+    append_range(boot.store, 800, 1600);
+    JournalStore::Reader reader = boot.store.Query({ 4000, ERRORS });
+    TEST_ASSERT_TRUE(collect(reader) == expected(0, 1600, { 4000, ERRORS }));
+    TEST_ASSERT_EQUAL(0, reader.Corrupted());
+}
+
+void JournalIndex_Query_SeesRecordsAppendedWhileReading()
+{
+    Boot boot(CONFIG);
+    append_range(boot.store, 0, 100);
+
+    JournalStore::Reader reader = boot.store.Query({ 0, ERRORS });
+    TEST_ASSERT_TRUE(collect(reader) == expected(0, 100, { 0, ERRORS }));
+
+    // Fill past the end of the segment so the one being read gets sealed
+    append_range(boot.store, 100, 1000);
+    TEST_ASSERT_TRUE(collect(reader) == expected(100, 1000, { 0, ERRORS }));
+}
+
+// Query latency of "errors in the last 500 records" against the journal size. The
+// journal configuration matches the firmware defaults (16 KiB segments,
+// 16-record blocks); the number of reads must not grow with the size.
+void JournalIndex_Benchmark_QueryLatencyVsJournalSize()
+{
+    static constexpr size_t SEGMENT = 16384;
+    static constexpr size_t FILLER  = 27;  // ~40-byte records, like deferred events
+    static constexpr size_t SIZES_KB[] = { 64, 256, 1024, 1536 };
+
+    size_t first_reads = 0;
+    for (const size_t kb : SIZES_KB) {
+        tearDown();
+        setUp();
+
+        const JournalStore::Config config = { SEGMENT, kb * 1024 / SEGMENT, 16 };
+        Boot boot(config);
+        // Three quarters of the quota: nothing rotated away yet
+        const uint32_t records = static_cast<uint32_t>(kb * 1024 * 3 / 4 / (RECORD_HEAD + FILLER + JournalStore::FRAME_OVERHEAD));
+        append_range(boot.store, 0, records, FILLER);
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+
+        const JournalStore::Filter filter = { ts_of(records - 500), ERRORS };
+
+        boot.storage.reads = 0;
+        auto start = std::chrono::steady_clock::now();
+        JournalStore::Reader indexed = boot.store.Query(filter);
+        const size_t found = collect(indexed).size();
+        const auto indexed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        const size_t indexed_reads = boot.storage.reads;
+
+        boot.storage.reads = 0;
+        start = std::chrono::steady_clock::now();
+        JournalStore::Reader scan = boot.store.Read();
+        collect(scan);
+        const auto scan_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("journal %5zu KiB, %6u records: indexed %4zu reads %6lld us | full scan %7zu reads %7lld us | %zu match\n",
+                    kb, records, indexed_reads, static_cast<long long>(indexed_us),
+                    boot.storage.reads, static_cast<long long>(scan_us), found);
+
+        TEST_ASSERT_EQUAL(expected(0, records, filter).size(), found);
+        // Same matches at every size: the cost must stay flat
+        if (first_reads == 0)
+            first_reads = indexed_reads;
+        TEST_ASSERT_TRUE(indexed_reads <= 2 * first_reads);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalIndex_Query_MatchesFilteredFullScan,
+                        "JournalIndex_Query_MatchesFilteredFullScan", __FILE__);
+    UnityDefaultTestRun(JournalIndex_Query_SkipsBlocksWithoutMatches,
+                        "JournalIndex_Query_SkipsBlocksWithoutMatches", __FILE__);
+    UnityDefaultTestRun(JournalIndex_Remount_IndexAndSequenceRestored,
+                        "JournalIndex_Remount_IndexAndSequenceRestored", __FILE__);
+    UnityDefaultTestRun(JournalIndex_Rotation_SequenceContinuesAfterOldestRemoved,
+                        "JournalIndex_Rotation_SequenceContinuesAfterOldestRemoved", __FILE__);
+    UnityDefaultTestRun(JournalIndex_UnindexedSegments_QueryStillCorrect,
+                        "JournalIndex_UnindexedSegments_QueryStillCorrect", __FILE__);
+    UnityDefaultTestRun(JournalIndex_Query_SeesRecordsAppendedWhileReading,
+                        "JournalIndex_Query_SeesRecordsAppendedWhileReading", __FILE__);
+    UnityDefaultTestRun(JournalIndex_Benchmark_QueryLatencyVsJournalSize,
+                        "JournalIndex_Benchmark_QueryLatencyVsJournalSize", __FILE__);
+    return UNITY_END();
+}
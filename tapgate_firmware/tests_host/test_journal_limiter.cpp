@@ -0,0 +1,276 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_limiter.h"
+
+#include <cstdint>
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+static const char FMT_NVM[]   = "Internal NVM access failed: \"%s\" (0x%x)";
+static const char FMT_FRAME[] = "Invalid frame from peer %u";
+
+static const journal_event_desc_t EV_NVM   = { journal_event_id("TAG_MAIN", FMT_NVM), "TAG_MAIN", FMT_NVM };
+static const journal_event_desc_t EV_FRAME = { journal_event_id("BLE", FMT_FRAME), "BLE", FMT_FRAME };
+static const journal_event_desc_t EV_OTHER = { journal_event_id("BLE", FMT_NVM), "BLE", FMT_NVM };
+
+static constexpr uint8_t INFO    = 0;
+static constexpr uint8_t WARNING = 1;
+static constexpr uint8_t ERROR   = 2;
+static constexpr uint8_t ALERT   = 3;
+
+// Coalescing on, no rate limit
+static constexpr JournalLimiter::Config COALESCE_ONLY = { 5000, { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } } };
+
+// Rate limit only: 60/min with a burst of 3
+static constexpr JournalLimiter::Config RATE_ONLY = { 0, { { 60, 3 }, { 60, 3 }, { 60, 3 }, { 60, 3 } } };
+
+template <typename... Args>
+static journal_record_t make(const journal_event_desc_t &event, uint8_t type, int64_t ts, Args... args)
+{
+    journal_record_t record{};
+    record.timestamp_ms = ts;
+    record.event        = &event;
+    record.type         = type;
+    record.flags        = JOURNAL_RECORD_DEFERRED;
+    record.length       = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), event.fmt, args...));
+    return record;
+}
+
+// Wall-clock timestamps sit far from monotonic time, as on the device
+static constexpr int64_t WALL = 1760000000000;
+
+// ---------------------------------------------------------------------------
+// Coalescing
+// ---------------------------------------------------------------------------
+
+void JournalLimiter_Coalesce_RunEmitsOneSummary()
+{
+    JournalLimiter limiter(COALESCE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = true;
+
+    // First occurrence is recorded right away
+    const journal_record_t first = make(EV_NVM, ERROR, WALL, "ESP_FAIL", -1);
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(first, 100, summary, has_summary));
+    TEST_ASSERT_FALSE(has_summary);
+
+    for (int i = 1; i <= 50; ++i) {
+        const journal_record_t again = make(EV_NVM, ERROR, WALL + i * 20, "ESP_FAIL", -1);
+        TEST_ASSERT_EQUAL(JournalLimiter::COALESCED, limiter.Admit(again, 100 + i * 20, summary, has_summary));
+        TEST_ASSERT_FALSE(has_summary);
+    }
+    TEST_ASSERT_EQUAL(50, limiter.Coalesced());
+
+    // Still within the window: nothing to expire yet
+    TEST_ASSERT_FALSE(limiter.Expire(100 + 50 * 20 + 4999, summary));
+
+    TEST_ASSERT_TRUE(limiter.Expire(100 + 50 * 20 + 5000, summary));
+    TEST_ASSERT_TRUE(summary.flags & JOURNAL_RECORD_REPEAT);
+    TEST_ASSERT_TRUE(summary.flags & JOURNAL_RECORD_DEFERRED);
+    TEST_ASSERT_EQUAL(50, summary.repeat);
+    TEST_ASSERT_EQUAL(WALL + 1000, summary.timestamp_ms);
+    TEST_ASSERT_EQUAL(1000, summary.span_ms);
+    TEST_ASSERT_TRUE(summary.event == &EV_NVM);
+    TEST_ASSERT_EQUAL(first.length, summary.length);
+    TEST_ASSERT_EQUAL_MEMORY(first.data, summary.data, first.length);
+    TEST_ASSERT_FALSE(limiter.Expire(1000000, summary));
+
+    // The event is recorded again after the run ended
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(first, 7000, summary, has_summary));
+    TEST_ASSERT_FALSE(has_summary);
+}
+
+void JournalLimiter_Coalesce_DifferentArgumentsNotFolded()
+{
+    JournalLimiter limiter(COALESCE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, 1u), 0, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, 2u), 1, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, INFO, WALL, 1u), 2, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_OTHER, WARNING, WALL, "ESP_FAIL", -1), 3, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::COALESCED, limiter.Admit(make(EV_FRAME, WARNING, WALL, 2u), 4, summary, has_summary));
+    TEST_ASSERT_EQUAL(1, limiter.Coalesced());
+}
+
+void JournalLimiter_Coalesce_InterleavedRunsAndSlotTakeover()
+{
+    JournalLimiter limiter(COALESCE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    // Two faults flapping in turn are both folded
+    for (int i = 0; i < 10; ++i) {
+        limiter.Admit(make(EV_FRAME, WARNING, WALL + i, 1u), i, summary, has_summary);
+        TEST_ASSERT_FALSE(has_summary);
+        limiter.Admit(make(EV_FRAME, WARNING, WALL + i, 2u), i, summary, has_summary);
+        TEST_ASSERT_FALSE(has_summary);
+    }
+    TEST_ASSERT_EQUAL(18, limiter.Coalesced());
+
+    // Filling every slot ends both runs with a summary
+    unsigned summaries = 0;
+    unsigned folded    = 0;
+    for (unsigned peer = 100; peer < 100 + 8 * JournalLimiter::SIGNATURE_SLOTS; ++peer) {
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL + 20, peer), 20, summary, has_summary));
+        if (has_summary) {
+            TEST_ASSERT_TRUE(summary.flags & JOURNAL_RECORD_REPEAT);
+            ++summaries;
+            folded += summary.repeat;
+        }
+    }
+    TEST_ASSERT_EQUAL(2, summaries);
+    TEST_ASSERT_EQUAL(18, folded);
+
+    // Runs with nothing folded end silently
+    TEST_ASSERT_FALSE(limiter.Drain(summary));
+}
+
+void JournalLimiter_Coalesce_SaturatedCounterReports()
+{
+    JournalLimiter limiter(COALESCE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    const journal_record_t record = make(EV_FRAME, INFO, WALL, 9u);
+    limiter.Admit(record, 0, summary, has_summary);
+
+    unsigned reported = 0;
+    for (uint32_t i = 1; i <= UINT16_MAX + 10u; ++i) {
+        TEST_ASSERT_EQUAL(JournalLimiter::COALESCED, limiter.Admit(record, i / 100, summary, has_summary));
+        if (has_summary) {
+            TEST_ASSERT_EQUAL(UINT16_MAX, summary.repeat);
+            ++reported;
+        }
+    }
+    TEST_ASSERT_EQUAL(1, reported);
+
+    TEST_ASSERT_TRUE(limiter.Drain(summary));
+    TEST_ASSERT_EQUAL(10, summary.repeat);
+    TEST_ASSERT_FALSE(limiter.Drain(summary));
+}
+
+// ---------------------------------------------------------------------------
+// Rate limiting
+// ---------------------------------------------------------------------------
+
+void JournalLimiter_Rate_BurstThenRefill()
+{
+    JournalLimiter limiter(RATE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    for (unsigned i = 0; i < 3; ++i)
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, i), 0, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::SUPPRESSED, limiter.Admit(make(EV_FRAME, WARNING, WALL, 3u), 0, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::SUPPRESSED, limiter.Admit(make(EV_FRAME, WARNING, WALL, 4u), 999, summary, has_summary));
+
+    // 60/min: one token per second
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, 5u), 1000, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::SUPPRESSED, limiter.Admit(make(EV_FRAME, WARNING, WALL, 6u), 1500, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, 7u), 2000, summary, has_summary));
+
+    // A long pause refills only up to the burst
+    for (unsigned i = 0; i < 3; ++i)
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, WARNING, WALL, i), 600000, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::SUPPRESSED, limiter.Admit(make(EV_FRAME, WARNING, WALL, 9u), 600000, summary, has_summary));
+
+    TEST_ASSERT_EQUAL(4, limiter.Suppressed(WARNING));
+    TEST_ASSERT_EQUAL(0, limiter.Suppressed(INFO));
+    TEST_ASSERT_EQUAL(4, limiter.TakeSuppressed());
+    TEST_ASSERT_EQUAL(0, limiter.TakeSuppressed());
+    TEST_ASSERT_EQUAL(4, limiter.Suppressed(WARNING));
+}
+
+void JournalLimiter_Rate_TagsAndSeveritiesIndependent()
+{
+    JournalLimiter limiter(RATE_ONLY);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    for (unsigned i = 0; i < 10; ++i)
+        limiter.Admit(make(EV_FRAME, WARNING, WALL, i), 0, summary, has_summary);
+    TEST_ASSERT_EQUAL(7, limiter.Suppressed(WARNING));
+
+    // Same tag, other severity; other tag, same severity
+    for (unsigned i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_FRAME, ERROR, WALL, i), 0, summary, has_summary));
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_NVM, WARNING, WALL, "E", static_cast<int>(i)), 0, summary, has_summary));
+    }
+    TEST_ASSERT_EQUAL(7, limiter.Suppressed(WARNING));
+    TEST_ASSERT_EQUAL(0, limiter.Suppressed(ERROR));
+}
+
+void JournalLimiter_Alert_NeverDropped()
+{
+    JournalLimiter::Config config = RATE_ONLY;
+    config.coalesce_ms = 5000;
+    JournalLimiter limiter(config);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    // Identical and over any rate, still all admitted
+    const journal_record_t alert = make(EV_NVM, ALERT, WALL, "ESP_ERR_INVALID_CRC", 0x109);
+    for (int i = 0; i < 1000; ++i) {
+        TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(alert, i, summary, has_summary));
+        TEST_ASSERT_FALSE(has_summary);
+    }
+    TEST_ASSERT_EQUAL(0, limiter.Suppressed(ALERT));
+    TEST_ASSERT_EQUAL(0, limiter.Coalesced());
+    TEST_ASSERT_FALSE(limiter.Drain(summary));
+}
+
+void JournalLimiter_Combined_RepeatsDoNotSpendTokens()
+{
+    JournalLimiter::Config config = RATE_ONLY;
+    config.coalesce_ms = 5000;
+    JournalLimiter limiter(config);
+    journal_record_t summary{};
+    bool has_summary = false;
+
+    // A retry loop failing 1000 times costs one token
+    const journal_record_t failure = make(EV_NVM, ERROR, WALL, "ESP_FAIL", -1);
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(failure, 0, summary, has_summary));
+    for (int i = 1; i < 1000; ++i)
+        TEST_ASSERT_EQUAL(JournalLimiter::COALESCED, limiter.Admit(failure, i, summary, has_summary));
+
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_NVM, ERROR, WALL, "ESP_OK", 0), 1000, summary, has_summary));
+    TEST_ASSERT_EQUAL(JournalLimiter::ADMIT, limiter.Admit(make(EV_NVM, ERROR, WALL, "ESP_OK", 1), 1000, summary, has_summary));
+    TEST_ASSERT_EQUAL(0, limiter.Suppressed(ERROR));
+
+    TEST_ASSERT_TRUE(limiter.Drain(summary));
+    TEST_ASSERT_EQUAL(999, summary.repeat);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalLimiter_Coalesce_RunEmitsOneSummary,
+                        "JournalLimiter_Coalesce_RunEmitsOneSummary", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Coalesce_DifferentArgumentsNotFolded,
+                        "JournalLimiter_Coalesce_DifferentArgumentsNotFolded", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Coalesce_InterleavedRunsAndSlotTakeover,
+                        "JournalLimiter_Coalesce_InterleavedRunsAndSlotTakeover", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Coalesce_SaturatedCounterReports,
+                        "JournalLimiter_Coalesce_SaturatedCounterReports", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Rate_BurstThenRefill,
+                        "JournalLimiter_Rate_BurstThenRefill", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Rate_TagsAndSeveritiesIndependent,
+                        "JournalLimiter_Rate_TagsAndSeveritiesIndependent", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Alert_NeverDropped,
+                        "JournalLimiter_Alert_NeverDropped", __FILE__);
+    UnityDefaultTestRun(JournalLimiter_Combined_RepeatsDoNotSpendTokens,
+                        "JournalLimiter_Combined_RepeatsDoNotSpendTokens", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,265 @@
+#include "unity.h"
+#include "journal_ring.h"
+#include "journal_record.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Test payload: producer id + per-producer sequence, with a fill pattern
+// derived from both so torn copies are detectable.
+struct TestItem
+{
+    uint32_t producer;
+    uint32_t seq;
+    uint8_t  fill[48];
+};
+
+static TestItem make_item(uint32_t producer, uint32_t seq)
+{
+    TestItem item{};
+    item.producer = producer;
+    item.seq      = seq;
+    std::memset(item.fill, static_cast<int>((producer * 31u + seq) & 0xFFu), sizeof(item.fill));
+    return item;
+}
+
+static bool item_intact(const TestItem& item)
+{
+    const auto expected = static_cast<uint8_t>((item.producer * 31u + item.seq) & 0xFFu);
+    for (uint8_t b : item.fill)
+        if (b != expected) return false;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Single thread — FIFO order
+// ---------------------------------------------------------------------------
+
+void JournalRing_PushPop_PreservesOrder()
+{
+    static JournalRing<TestItem, 8> ring;
+
+    for (uint32_t i = 0; i < 5; ++i)
+        TEST_ASSERT_TRUE(ring.push(make_item(0, i)));
+
+    TestItem out[8]{};
+    TEST_ASSERT_EQUAL(5, ring.pop(out, 8));
+    for (uint32_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_EQUAL(i, out[i].seq);
+        TEST_ASSERT_TRUE(item_intact(out[i]));
+    }
+    TEST_ASSERT_EQUAL(0, ring.pop(out, 8));
+}
+
+// ---------------------------------------------------------------------------
+// Single thread — pop respects max_count and wraps around
+// ---------------------------------------------------------------------------
+
+void JournalRing_Pop_BatchLimitAndWrap()
+{
+    static JournalRing<TestItem, 4> ring;
+    TestItem out[4]{};
+
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    for (int lap = 0; lap < 10; ++lap) {
+        for (int i = 0; i < 3; ++i)
+            TEST_ASSERT_TRUE(ring.push(make_item(1, next++)));
+
+        TEST_ASSERT_EQUAL(2, ring.pop(out, 2));
+        TEST_ASSERT_EQUAL(expected++, out[0].seq);
+        TEST_ASSERT_EQUAL(expected++, out[1].seq);
+        TEST_ASSERT_EQUAL(1, ring.pop(out, 4));
+        TEST_ASSERT_EQUAL(expected++, out[0].seq);
+    }
+    TEST_ASSERT_EQUAL(0, ring.dropped());
+}
+
+// ---------------------------------------------------------------------------
+// Single thread — overflow drops new values and counts them
+// ---------------------------------------------------------------------------
+
+void JournalRing_Full_DropsAndCounts()
+{
+    static JournalRing<TestItem, 4> ring;
+
+    for (uint32_t i = 0; i < 4; ++i)
+        TEST_ASSERT_TRUE(ring.push(make_item(0, i)));
+
+    TEST_ASSERT_FALSE(ring.push(make_item(0, 4)));
+    TEST_ASSERT_FALSE(ring.push(make_item(0, 5)));
+    TEST_ASSERT_EQUAL(2, ring.dropped());
+    TEST_ASSERT_EQUAL(4, ring.size());
+
+    // Oldest values survive, dropped ones never appear
+    TestItem out[4]{};
+    TEST_ASSERT_EQUAL(4, ring.pop(out, 4));
+    TEST_ASSERT_EQUAL(0, out[0].seq);
+    TEST_ASSERT_EQUAL(3, out[3].seq);
+
+    TEST_ASSERT_EQUAL(2, ring.take_dropped());
+    TEST_ASSERT_EQUAL(0, ring.dropped());
+}
+
+// ---------------------------------------------------------------------------
+// Multithreaded — N producers, 1 consumer: no loss, no tearing, per-producer order
+// ---------------------------------------------------------------------------
+
+void JournalRing_Multithreaded_ManyProducers_AccountedAndOrdered()
+{
+    constexpr int      NUM_PRODUCERS = 8;
+    constexpr uint32_t ITERATIONS    = 20000;
+
+    static JournalRing<TestItem, 64> ring;
+
+    std::atomic<int>  producers_done{0};
+    std::atomic<bool> corruption_detected{false};
+    std::atomic<bool> order_violation{false};
+    uint64_t consumed = 0;
+    std::vector<int64_t> last_seq(NUM_PRODUCERS, -1);
+
+    std::thread consumer([&]() {
+        TestItem batch[16];
+        for (;;) {
+            const bool finished = producers_done.load(std::memory_order_acquire) == NUM_PRODUCERS;
+            const std::size_t n = ring.pop(batch, 16);
+            for (std::size_t i = 0; i < n; ++i) {
+                const TestItem& item = batch[i];
+                if (item.producer >= NUM_PRODUCERS || !item_intact(item)) {
+                    corruption_detected.store(true, std::memory_order_relaxed);
+                    continue;
+                }
+                if (static_cast<int64_t>(item.seq) <= last_seq[item.producer])
+                    order_violation.store(true, std::memory_order_relaxed);
+                last_seq[item.producer] = item.seq;
+            }
+            consumed += n;
+            if (n == 0 && finished)
+                break;
+            if (n == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    producers.reserve(NUM_PRODUCERS);
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        producers.emplace_back([p, &producers_done]() {
+            for (uint32_t j = 0; j < ITERATIONS; ++j)
+                (void)ring.push(make_item(static_cast<uint32_t>(p), j));
+            producers_done.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    for (auto& t : producers)
+        t.join();
+    consumer.join();
+
+    TEST_ASSERT_TRUE(!corruption_detected.load());
+    TEST_ASSERT_TRUE(!order_violation.load());
+    // Every attempted push is either consumed or counted as dropped
+    TEST_ASSERT_EQUAL(static_cast<uint64_t>(NUM_PRODUCERS) * ITERATIONS,
+                      consumed + ring.dropped());
+}
+
+// ---------------------------------------------------------------------------
+// Multithreaded — journal_record_t through a firmware-sized ring
+// ---------------------------------------------------------------------------
+
+void JournalRing_Multithreaded_JournalRecords_MessagesIntact()
+{
+    constexpr int NUM_PRODUCERS = 6;
+    constexpr int ITERATIONS    = 5000;
+
+    static JournalRing<journal_record_t, 32> ring;
+    static constexpr journal_event_desc_t EVENT = { 1, "RingTest", "producer %d event %d" };
+
+    std::atomic<int>  producers_done{0};
+    std::atomic<bool> corruption_detected{false};
+    uint64_t consumed = 0;
+
+    std::thread consumer([&]() {
+        journal_record_t batch[8];
+        for (;;) {
+            const bool finished = producers_done.load(std::memory_order_acquire) == NUM_PRODUCERS;
+            const std::size_t n = ring.pop(batch, 8);
+            for (std::size_t i = 0; i < n; ++i) {
+                char expected[JOURNAL_MSG_MAX_SIZE];
+                std::snprintf(expected, sizeof(expected), "producer %d event %lld",
+                              batch[i].type, static_cast<long long>(batch[i].timestamp_ms));
+                const char* message = reinterpret_cast<const char*>(batch[i].data);
+                if (batch[i].event != &EVENT || std::strcmp(expected, message) != 0
+                    || batch[i].length != std::strlen(expected))
+                    corruption_detected.store(true, std::memory_order_relaxed);
+            }
+            consumed += n;
+            if (n == 0 && finished)
+                break;
+            if (n == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    producers.reserve(NUM_PRODUCERS);
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        producers.emplace_back([p, &producers_done]() {
+            for (int j = 0; j < ITERATIONS; ++j) {
+                journal_record_t rec{};
+                rec.timestamp_ms = j;
+                rec.event        = &EVENT;
+                rec.type         = static_cast<uint8_t>(p);
+                const int len = std::snprintf(reinterpret_cast<char*>(rec.data), sizeof(rec.data),
+                                              "producer %d event %d", p, j);
+                rec.length = static_cast<uint8_t>(len);
+                (void)ring.push(rec);
+            }
+            producers_done.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    for (auto& t : producers)
+        t.join();
+    consumer.join();
+
+    TEST_ASSERT_TRUE(!corruption_detected.load());
+    TEST_ASSERT_EQUAL(static_cast<uint64_t>(NUM_PRODUCERS) * ITERATIONS,
+                      consumed + ring.dropped());
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    UnityDefaultTestRun(JournalRing_PushPop_PreservesOrder,
+                        "JournalRing_PushPop_PreservesOrder", __FILE__);
+
+    UnityDefaultTestRun(JournalRing_Pop_BatchLimitAndWrap,
+                        "JournalRing_Pop_BatchLimitAndWrap", __FILE__);
+
+    UnityDefaultTestRun(JournalRing_Full_DropsAndCounts,
+                        "JournalRing_Full_DropsAndCounts", __FILE__);
+
+    UnityDefaultTestRun(JournalRing_Multithreaded_ManyProducers_AccountedAndOrdered,
+                        "JournalRing_Multithreaded_ManyProducers_AccountedAndOrdered", __FILE__);
+
+    UnityDefaultTestRun(JournalRing_Multithreaded_JournalRecords_MessagesIntact,
+                        "JournalRing_Multithreaded_JournalRecords_MessagesIntact", __FILE__);
+
+    return UNITY_END();
+}
@@ -0,0 +1,348 @@
+#include "unity.h"
+#include "journal_record.h"
+#include "journal_ring.h"
+#include "journal_staging.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+
+extern "C" void setUp(void) {}
+extern "C" void tearDown(void) {}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+struct TestItem
+{
+    int64_t  timestamp;
+    uint32_t producer;
+    uint32_t seq;
+    uint8_t  fill[16];
+};
+
+struct TestItemBefore
+{
+    bool operator()(const TestItem& a, const TestItem& b) const noexcept
+    {
+        return a.timestamp < b.timestamp;
+    }
+};
+
+static TestItem make_item(int64_t timestamp, uint32_t producer = 0, uint32_t seq = 0)
+{
+    TestItem item{};
+    item.timestamp = timestamp;
+    item.producer  = producer;
+    item.seq       = seq;
+    return item;
+}
+
+template <std::size_t N, std::size_t LANES>
+using Staging = JournalStaging<TestItem, N, LANES, TestItemBefore>;
+
+// ---------------------------------------------------------------------------
+// Merge
+// ---------------------------------------------------------------------------
+
+void JournalStaging_Pop_MergesLanesByTimestamp()
+{
+    static Staging<8, 3> staging;
+
+    for (const int64_t ts : { 1, 4, 6 })
+        TEST_ASSERT_TRUE(staging.push(make_item(ts), 0));
+    for (const int64_t ts : { 2, 3, 7 })
+        TEST_ASSERT_TRUE(staging.push(make_item(ts), 1));
+    TEST_ASSERT_TRUE(staging.push(make_item(5), 2));
+
+    // Small batches: the lookahead carries over between calls
+    std::vector<int64_t> order;
+    TestItem out[2];
+    while (const std::size_t n = staging.pop(out, 2)) {
+        for (std::size_t i = 0; i < n; ++i)
+            order.push_back(out[i].timestamp);
+    }
+    TEST_ASSERT_TRUE(order == std::vector<int64_t>({ 1, 2, 3, 4, 5, 6, 7 }));
+
+    // Values staged after a drain are picked up
+    TEST_ASSERT_TRUE(staging.push(make_item(9), 2));
+    TEST_ASSERT_EQUAL(1, staging.pop(out, 2));
+    TEST_ASSERT_EQUAL(9, out[0].timestamp);
+}
+
+void JournalStaging_Pop_TiesToLowerLane_FifoWithinLane()
+{
+    static Staging<8, 2> staging;
+
+    // Lane 1 goes back in time (task preempted between timestamp and push):
+    // its own order is kept
+    staging.push(make_item(10, 1, 0), 1);
+    staging.push(make_item(5, 1, 1), 1);
+    staging.push(make_item(10, 0, 0), 0);
+    staging.push(make_item(10, 0, 1), 0);
+
+    TestItem out[8];
+    TEST_ASSERT_EQUAL(4, staging.pop(out, 8));
+    TEST_ASSERT_EQUAL(0, out[0].producer);
+    TEST_ASSERT_EQUAL(0, out[0].seq);
+    TEST_ASSERT_EQUAL(0, out[1].producer);
+    TEST_ASSERT_EQUAL(1, out[1].seq);
+    TEST_ASSERT_EQUAL(1, out[2].producer);
+    TEST_ASSERT_EQUAL(0, out[2].seq);
+    TEST_ASSERT_EQUAL(5, out[3].timestamp);
+}
+
+void JournalStaging_JournalRecords_EqualTimestampsInStagingOrder()
+{
+    static JournalStaging<journal_record_t, 8, 2, JournalRecordBefore> staging;
+
+    // Same millisecond on both cores: the sequence decides, not the lane,
+    // also where it wraps
+    auto record = [](int64_t timestamp, uint32_t seq) {
+        journal_record_t r{};
+        r.timestamp_ms = timestamp;
+        r.seq          = seq;
+        return r;
+    };
+    staging.push(record(10, 0), 0);
+    staging.push(record(10, 2), 0);
+    staging.push(record(10, 0xFFFFFFFFu), 1);
+    staging.push(record(10, 1), 1);
+    staging.push(record(9, 3), 1);
+
+    journal_record_t out[8];
+    TEST_ASSERT_EQUAL(5, staging.pop(out, 8));
+    TEST_ASSERT_TRUE(out[0].seq == 0xFFFFFFFFu);
+    TEST_ASSERT_EQUAL(0, out[1].seq);
+    TEST_ASSERT_EQUAL(1, out[2].seq);
+    // The timestamp comes first
+    TEST_ASSERT_EQUAL(9, out[3].timestamp_ms);
+    TEST_ASSERT_EQUAL(2, out[4].seq);
+}
+
+void JournalStaging_Full_LanesDropIndependently()
+{
+    static Staging<4, 2> staging;
+
+    for (int i = 0; i < 6; ++i)
+        staging.push(make_item(i), 0);
+    TEST_ASSERT_EQUAL(4, staging.size(0));
+    TEST_ASSERT_EQUAL(2, staging.dropped());
+
+    // The other core is unaffected
+    TEST_ASSERT_TRUE(staging.push(make_item(100), 1));
+    TEST_ASSERT_EQUAL(1, staging.size(1));
+
+    TestItem out[8];
+    TEST_ASSERT_EQUAL(5, staging.pop(out, 8));
+    TEST_ASSERT_EQUAL(2, staging.take_dropped());
+    TEST_ASSERT_EQUAL(0, staging.dropped());
+}
+
+void JournalStaging_CurrentLane_OnePerThread()
+{
+    constexpr std::size_t LANES = 4;
+    using Lanes4 = Staging<4, LANES>;
+    std::vector<std::size_t> lanes(LANES);
+    std::atomic<bool> unstable{false};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < LANES; ++i) {
+        threads.emplace_back([i, &lanes, &unstable]() {
+            const std::size_t lane = Lanes4::current_lane();
+            if (Lanes4::current_lane() != lane)
+                unstable.store(true);
+            lanes[i] = lane;
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT_FALSE(unstable.load());
+    const std::set<std::size_t> distinct(lanes.begin(), lanes.end());
+    TEST_ASSERT_EQUAL(LANES, distinct.size());
+}
+
+// ---------------------------------------------------------------------------
+// Multithreaded — every value accounted for, per-producer order kept
+// ---------------------------------------------------------------------------
+
+void JournalStaging_Multithreaded_ManyProducers_AccountedAndOrdered()
+{
+    constexpr int      NUM_PRODUCERS = 8;
+    constexpr uint32_t ITERATIONS    = 20000;
+
+    static Staging<64, 4> staging;
+
+    std::atomic<int>  producers_done{0};
+    std::atomic<bool> order_violation{false};
+    uint64_t consumed = 0;
+    std::vector<int64_t> last_seq(NUM_PRODUCERS, -1);
+
+    std::thread consumer([&]() {
+        TestItem batch[16];
+        for (;;) {
+            const bool finished = producers_done.load(std::memory_order_acquire) == NUM_PRODUCERS;
+            const std::size_t n = staging.pop(batch, 16);
+            for (std::size_t i = 0; i < n; ++i) {
+                const TestItem& item = batch[i];
+                if (item.producer >= NUM_PRODUCERS || static_cast<int64_t>(item.seq) <= last_seq[item.producer])
+                    order_violation.store(true, std::memory_order_relaxed);
+                else
+                    last_seq[item.producer] = item.seq;
+            }
+            consumed += n;
+            if (n == 0 && finished)
+                break;
+            if (n == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    // Two producers per lane, as with several tasks on one core
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        producers.emplace_back([p, &producers_done]() {
+            for (uint32_t j = 0; j < ITERATIONS; ++j)
+                (void)staging.push(make_item(j, static_cast<uint32_t>(p), j), static_cast<std::size_t>(p) % 4);
+            producers_done.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    for (auto& t : producers)
+        t.join();
+    consumer.join();
+
+    TEST_ASSERT_FALSE(order_violation.load());
+    TEST_ASSERT_EQUAL(static_cast<uint64_t>(NUM_PRODUCERS) * ITERATIONS, consumed + staging.dropped());
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark — one shared ring vs one ring per producer CPU
+// ---------------------------------------------------------------------------
+
+namespace {
+
+constexpr std::size_t BENCH_CAPACITY = 1024;
+constexpr std::size_t BENCH_LANES    = 8;
+constexpr uint32_t    BENCH_PUSHES   = 200000;
+
+struct BenchResult
+{
+    double   ns_per_push;
+    uint64_t consumed;
+    uint64_t dropped;
+};
+
+// Producers push as fast as they can while one consumer drains
+template <typename PushFn, typename PopFn, typename DroppedFn>
+BenchResult run_bench(int producers, PushFn push, PopFn pop, DroppedFn dropped)
+{
+    std::atomic<int>  ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<int>  done{0};
+    uint64_t consumed = 0;
+
+    std::thread consumer([&]() {
+        TestItem batch[32];
+        for (;;) {
+            const bool finished = done.load(std::memory_order_acquire) == producers;
+            const std::size_t n = pop(batch, 32);
+            consumed += n;
+            if (n == 0 && finished)
+                break;
+            if (n == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (uint32_t j = 0; j < BENCH_PUSHES; ++j)
+                push(make_item(j, static_cast<uint32_t>(p), j));
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    while (ready.load() != producers)
+        std::this_thread::yield();
+
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads)
+        t.join();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    consumer.join();
+
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    return { ns / (static_cast<double>(producers) * BENCH_PUSHES), consumed, dropped() };
+}
+
+} // namespace
+
+void JournalStaging_Benchmark_SingleRingVsPerCore()
+{
+    static JournalRing<TestItem, BENCH_CAPACITY> ring;
+    static Staging<BENCH_CAPACITY, BENCH_LANES>  staging;
+
+    // Producers never wait, as in the firmware: a full ring drops. Contention
+    // only shows with at least as many hardware threads as producers.
+    std::printf("\n  %u hardware thread(s)\n", std::thread::hardware_concurrency());
+    std::printf("  producers | single ring ns/push (drop %%) | per-core ns/push (drop %%)\n");
+    for (const int producers : { 1, 2, 4, 8 }) {
+        ring.take_dropped();
+        staging.take_dropped();
+
+        const BenchResult single = run_bench(
+            producers,
+            [](const TestItem& item) { (void)ring.push(item); },
+            [](TestItem* out, std::size_t n) { return ring.pop(out, n); },
+            []() { return static_cast<uint64_t>(ring.dropped()); });
+
+        // Each producer thread picks its own lane, like one task per core
+        const BenchResult lanes = run_bench(
+            producers,
+            [](const TestItem& item) { (void)staging.push(item, staging.current_lane()); },
+            [](TestItem* out, std::size_t n) { return staging.pop(out, n); },
+            []() { return static_cast<uint64_t>(staging.dropped()); });
+
+        const double total = static_cast<double>(producers) * BENCH_PUSHES;
+        std::printf("  %9d | %13.1f (%5.1f)          | %10.1f (%5.1f)\n", producers,
+                    single.ns_per_push, 100.0 * static_cast<double>(single.dropped) / total,
+                    lanes.ns_per_push, 100.0 * static_cast<double>(lanes.dropped) / total);
+
+        TEST_ASSERT_EQUAL(static_cast<uint64_t>(total), single.consumed + single.dropped);
+        TEST_ASSERT_EQUAL(static_cast<uint64_t>(total), lanes.consumed + lanes.dropped);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalStaging_Pop_MergesLanesByTimestamp,
+                        "JournalStaging_Pop_MergesLanesByTimestamp", __FILE__);
+    UnityDefaultTestRun(JournalStaging_Pop_TiesToLowerLane_FifoWithinLane,
+                        "JournalStaging_Pop_TiesToLowerLane_FifoWithinLane", __FILE__);
+    UnityDefaultTestRun(JournalStaging_JournalRecords_EqualTimestampsInStagingOrder,
+                        "JournalStaging_JournalRecords_EqualTimestampsInStagingOrder", __FILE__);
+    UnityDefaultTestRun(JournalStaging_Full_LanesDropIndependently,
+                        "JournalStaging_Full_LanesDropIndependently", __FILE__);
+    UnityDefaultTestRun(JournalStaging_CurrentLane_OnePerThread,
+                        "JournalStaging_CurrentLane_OnePerThread", __FILE__);
+    UnityDefaultTestRun(JournalStaging_Multithreaded_ManyProducers_AccountedAndOrdered,
+                        "JournalStaging_Multithreaded_ManyProducers_AccountedAndOrdered", __FILE__);
+    UnityDefaultTestRun(JournalStaging_Benchmark_SingleRingVsPerCore,
+                        "JournalStaging_Benchmark_SingleRingVsPerCore", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,424 @@
+#include "unity.h"
+#include "journal_store.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// File-backed device with fault injection
+// ---------------------------------------------------------------------------
+
+// Wraps the production stdio backend. After cut_after bytes have been
+// appended the power "fails": the write in progress is torn (only its prefix
+// reaches the file) and every later operation fails until the next boot.
+class FaultyStorage : public JournalStorage
+{
+public:
+    explicit FaultyStorage(const char *dir) : m_inner(dir) {}
+
+    long   cut_after = -1;      // bytes until power cut, -1: never
+    bool   powered   = true;
+    size_t reads     = 0;
+    size_t lists     = 0;
+
+    esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) override
+    {
+        ++lists;
+        return powered ? m_inner.List(first, last, count) : ESP_FAIL;
+    }
+    esp_err_t Size(uint32_t segment, size_t &size) override
+    {
+        return powered ? m_inner.Size(segment, size) : ESP_FAIL;
+    }
+    esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) override
+    {
+        ++reads;
+        return powered ? m_inner.Read(segment, offset, buf, len) : ESP_FAIL;
+    }
+    esp_err_t Append(uint32_t segment, const void *buf, size_t len) override
+    {
+        if (!powered)
+            return ESP_FAIL;
+        if (cut_after >= 0 && static_cast<size_t>(cut_after) < len) {
+            if (cut_after > 0)
+                m_inner.Append(segment, buf, static_cast<size_t>(cut_after));
+            m_inner.Sync(segment);
+            cut_after = 0;
+            powered   = false;
+            return ESP_FAIL;
+        }
+        if (cut_after >= 0)
+            cut_after -= static_cast<long>(len);
+        return m_inner.Append(segment, buf, len);
+    }
+    esp_err_t Sync(uint32_t segment) override
+    {
+        return powered ? m_inner.Sync(segment) : ESP_FAIL;
+    }
+    esp_err_t Truncate(uint32_t segment, size_t size) override
+    {
+        return powered ? m_inner.Truncate(segment, size) : ESP_FAIL;
+    }
+    esp_err_t Remove(uint32_t segment) override
+    {
+        return powered ? m_inner.Remove(segment) : ESP_FAIL;
+    }
+
+private:
+    JournalFileStorage m_inner;
+};
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+static char g_dir[64];
+
+static void remove_dir_contents()
+{
+    DIR *dir = opendir(g_dir);
+    if (!dir)
+        return;
+    while (const struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        const std::string path = std::string(g_dir) + "/" + entry->d_name;
+        std::remove(path.c_str());
+    }
+    closedir(dir);
+}
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_store_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+}
+
+extern "C" void tearDown(void)
+{
+    remove_dir_contents();
+    rmdir(g_dir);
+}
+
+static constexpr JournalStore::Config SMALL = { 256, 4 };
+
+// One "device boot": fresh backend + store, mounted
+struct Boot
+{
+    FaultyStorage storage;
+    JournalStore  store;
+
+    explicit Boot(const JournalStore::Config &config = SMALL)
+        : storage(g_dir), store(storage, config)
+    {
+    }
+};
+
+// Record i: 4-byte sequence number followed by (i % 23) filler bytes
+static size_t make_record(uint32_t i, uint8_t *out)
+{
+    std::memcpy(out, &i, sizeof(i));
+    const size_t filler = i % 23;
+    for (size_t k = 0; k < filler; ++k)
+        out[4 + k] = static_cast<uint8_t>(i + k);
+    return 4 + filler;
+}
+
+static esp_err_t append_record(JournalStore &store, uint32_t i)
+{
+    uint8_t buf[32];
+    return store.Append(buf, make_record(i, buf));
+}
+
+// Reads everything back; checks each record is intact and the sequence
+// numbers are consecutive. Returns the count, first sequence in *first.
+static size_t read_all(JournalStore &store, uint32_t *first = nullptr, size_t *corrupted = nullptr)
+{
+    JournalStore::Reader reader = store.Read();
+    uint8_t buf[64];
+    size_t len = 0;
+    size_t count = 0;
+    uint32_t expected = 0;
+
+    while (reader.Next(buf, sizeof(buf), len) == ESP_OK) {
+        uint32_t seq = 0;
+        std::memcpy(&seq, buf, sizeof(seq));
+        if (count == 0) {
+            expected = seq;
+            if (first)
+                *first = seq;
+        }
+        uint8_t want[32];
+        TEST_ASSERT_EQUAL(expected, seq);
+        TEST_ASSERT_EQUAL(make_record(seq, want), len);
+        TEST_ASSERT_EQUAL_MEMORY(want, buf, len);
+        ++expected;
+        ++count;
+    }
+    if (corrupted)
+        *corrupted = reader.Corrupted();
+    return count;
+}
+
+static void corrupt_byte(uint32_t segment, long offset)
+{
+    char path[96];
+    std::snprintf(path, sizeof(path), "%s/%08x.ejs", g_dir, segment);
+    FILE *f = std::fopen(path, "r+b");
+    TEST_ASSERT_TRUE(f != nullptr);
+    std::fseek(f, offset, SEEK_SET);
+    const int c = std::fgetc(f);
+    std::fseek(f, offset, SEEK_SET);
+    std::fputc(c ^ 0xFF, f);
+    std::fclose(f);
+}
+
+// ---------------------------------------------------------------------------
+// Append / read
+// ---------------------------------------------------------------------------
+
+void JournalStore_Append_ReadBackInOrder()
+{
+    Boot boot({ 4096, 8 });
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    for (uint32_t i = 0; i < 100; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i));
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+
+    uint32_t first = 99;
+    TEST_ASSERT_EQUAL(100, read_all(boot.store, &first));
+    TEST_ASSERT_EQUAL(0, first);
+}
+
+void JournalStore_Append_BeforeMount_InvalidState()
+{
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, append_record(boot.store, 0));
+}
+
+void JournalStore_Append_Oversized_Rejected()
+{
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    static uint8_t big[300];
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, boot.store.Append(big, sizeof(big)));
+    TEST_ASSERT_TRUE(boot.store.Mounted());
+}
+
+void JournalStore_Reader_SmallBuffer_SkipsRecord()
+{
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, 22)); // 26 bytes
+    TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, 23)); // 4 bytes
+
+    JournalStore::Reader reader = boot.store.Read();
+    uint8_t buf[8];
+    size_t len = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, reader.Next(buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(26, len);
+    TEST_ASSERT_EQUAL(ESP_OK, reader.Next(buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(4, len);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, reader.Next(buf, sizeof(buf), len));
+}
+
+// ---------------------------------------------------------------------------
+// Rotation
+// ---------------------------------------------------------------------------
+
+void JournalStore_Rotation_QuotaRemovesOldestSegment()
+{
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    for (uint32_t i = 0; i < 200; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i));
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+
+    TEST_ASSERT_EQUAL(SMALL.max_segments, boot.store.SegmentCount());
+    TEST_ASSERT_TRUE(boot.store.FirstSegment() > 0);
+
+    uint32_t first = 0;
+    const size_t count = read_all(boot.store, &first);
+    TEST_ASSERT_TRUE(first > 0);
+    TEST_ASSERT_EQUAL(200, first + count); // newest records always kept
+}
+
+void JournalStore_Remount_ContinuesWhereItStopped()
+{
+    {
+        Boot boot({ 4096, 8 });
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+        for (uint32_t i = 0; i < 30; ++i)
+            TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i));
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+    }
+    Boot boot({ 4096, 8 });
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    TEST_ASSERT_FALSE(boot.store.Recovery().scanned);
+    TEST_ASSERT_EQUAL(0, boot.store.Recovery().truncated);
+    for (uint32_t i = 30; i < 60; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i));
+
+    uint32_t first = 99;
+    TEST_ASSERT_EQUAL(60, read_all(boot.store, &first));
+    TEST_ASSERT_EQUAL(0, first);
+}
+
+// ---------------------------------------------------------------------------
+// Power cuts
+// ---------------------------------------------------------------------------
+
+// Cuts power at every byte position over several segments' worth of writes
+// (segment headers, frame heads, payloads, tails and commit markers). After
+// each reboot every acknowledged record must be readable, nothing torn may
+// surface, and the store must accept new records.
+void JournalStore_PowerCut_EveryByte_RecoversCommittedPrefix()
+{
+    constexpr uint32_t COMMITTED = 5;
+
+    for (long cut = 0; cut < 700; ++cut) {
+        remove_dir_contents();
+
+        uint32_t acknowledged = 0;
+        {
+            Boot boot;
+            TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+            for (; acknowledged < COMMITTED; ++acknowledged)
+                TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, acknowledged));
+            TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+
+            boot.storage.cut_after = cut;
+            while (append_record(boot.store, acknowledged) == ESP_OK)
+                ++acknowledged;
+            TEST_ASSERT_FALSE(boot.store.Mounted());
+        }
+
+        Boot boot;
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+
+        uint32_t first = 0;
+        const size_t count = read_all(boot.store, &first);
+        TEST_ASSERT_EQUAL(0, first);
+        TEST_ASSERT_TRUE(count >= COMMITTED);
+        TEST_ASSERT_TRUE(count >= acknowledged);    // the torn record may not appear...
+        TEST_ASSERT_TRUE(count <= acknowledged + 1); // ...unless it landed completely
+
+        TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, static_cast<uint32_t>(count)));
+        TEST_ASSERT_EQUAL(count + 1, read_all(boot.store));
+    }
+}
+
+void JournalStore_PowerCut_TornSegmentHeader_SegmentDropped()
+{
+    {
+        Boot boot;
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+        uint32_t i = 0;
+        while (boot.store.SegmentCount() < 2)
+            TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i++));
+    }
+    // Simulate a cut inside the header of segment 2
+    char path[96];
+    std::snprintf(path, sizeof(path), "%s/%08x.ejs", g_dir, 2u);
+    FILE *f = std::fopen(path, "wb");
+    std::fputs("EJS", f);
+    std::fclose(f);
+
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    TEST_ASSERT_TRUE(boot.store.Recovery().dropped_tail);
+    TEST_ASSERT_EQUAL(2, boot.store.SegmentCount());
+    TEST_ASSERT_EQUAL(1, boot.store.LastSegment());
+}
+
+// ---------------------------------------------------------------------------
+// Recovery cost and corruption
+// ---------------------------------------------------------------------------
+
+static size_t mount_reads(size_t records, const JournalStore::Config &config)
+{
+    remove_dir_contents();
+    {
+        Boot boot(config);
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+        for (uint32_t i = 0; i < records; ++i)
+            TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i));
+        TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+    }
+    Boot boot(config);
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    TEST_ASSERT_FALSE(boot.store.Recovery().scanned);
+    TEST_ASSERT_EQUAL(1, boot.storage.lists);
+    return boot.storage.reads;
+}
+
+void JournalStore_Recovery_CostIndependentOfRecordCount()
+{
+    const JournalStore::Config big = { 65536, 64 };
+    const size_t few  = mount_reads(10, big);
+    const size_t many = mount_reads(2000, big);     // still one open segment
+    const size_t rot  = mount_reads(20000, big);    // many sealed segments
+    TEST_ASSERT_EQUAL(few, many);
+    TEST_ASSERT_EQUAL(few, rot);
+    TEST_ASSERT_TRUE(few <= 6);
+}
+
+void JournalStore_Reader_CorruptFrame_SkipsRestOfSegment()
+{
+    Boot boot;
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Mount());
+    uint32_t i = 0;
+    while (boot.store.SegmentCount() < 3)
+        TEST_ASSERT_EQUAL(ESP_OK, append_record(boot.store, i++));
+    TEST_ASSERT_EQUAL(ESP_OK, boot.store.Sync());
+
+    // First payload byte of the first frame in segment 0
+    corrupt_byte(0, JournalStore::HEADER_SIZE + JournalStore::FRAME_HEAD);
+
+    JournalStore::Reader reader = boot.store.Read();
+    uint8_t buf[64];
+    size_t len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, reader.Next(buf, sizeof(buf), len));
+    TEST_ASSERT_EQUAL(1, reader.Corrupted());
+    TEST_ASSERT_EQUAL(1, reader.Tell().segment);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    UnityDefaultTestRun(JournalStore_Append_ReadBackInOrder,
+                        "JournalStore_Append_ReadBackInOrder", __FILE__);
+    UnityDefaultTestRun(JournalStore_Append_BeforeMount_InvalidState,
+                        "JournalStore_Append_BeforeMount_InvalidState", __FILE__);
+    UnityDefaultTestRun(JournalStore_Append_Oversized_Rejected,
+                        "JournalStore_Append_Oversized_Rejected", __FILE__);
+    UnityDefaultTestRun(JournalStore_Reader_SmallBuffer_SkipsRecord,
+                        "JournalStore_Reader_SmallBuffer_SkipsRecord", __FILE__);
+
+    UnityDefaultTestRun(JournalStore_Rotation_QuotaRemovesOldestSegment,
+                        "JournalStore_Rotation_QuotaRemovesOldestSegment", __FILE__);
+    UnityDefaultTestRun(JournalStore_Remount_ContinuesWhereItStopped,
+                        "JournalStore_Remount_ContinuesWhereItStopped", __FILE__);
+
+    UnityDefaultTestRun(JournalStore_PowerCut_EveryByte_RecoversCommittedPrefix,
+                        "JournalStore_PowerCut_EveryByte_RecoversCommittedPrefix", __FILE__);
+    UnityDefaultTestRun(JournalStore_PowerCut_TornSegmentHeader_SegmentDropped,
+                        "JournalStore_PowerCut_TornSegmentHeader_SegmentDropped", __FILE__);
+
+    UnityDefaultTestRun(JournalStore_Recovery_CostIndependentOfRecordCount,
+                        "JournalStore_Recovery_CostIndependentOfRecordCount", __FILE__);
+    UnityDefaultTestRun(JournalStore_Reader_CorruptFrame_SkipsRestOfSegment,
+                        "JournalStore_Reader_CorruptFrame_SkipsRestOfSegment", __FILE__);
+
+    return UNITY_END();
+}
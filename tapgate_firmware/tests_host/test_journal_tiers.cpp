@@ -0,0 +1,301 @@
+#include "unity.h"
+#include "journal_args.h"
+#include "journal_codec.h"
+#include "journal_store.h"
+#include "journal_tiers.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Fixtures
+// ---------------------------------------------------------------------------
+
+// One directory per tier
+static char g_dir[64];
+static char g_retained_dir[64];
+
+extern "C" void setUp(void)
+{
+    std::snprintf(g_dir, sizeof(g_dir), "/tmp/ej_tiers_XXXXXX");
+    std::snprintf(g_retained_dir, sizeof(g_retained_dir), "/tmp/ej_tiers_XXXXXX");
+    TEST_ASSERT_TRUE(mkdtemp(g_dir) != nullptr);
+    TEST_ASSERT_TRUE(mkdtemp(g_retained_dir) != nullptr);
+}
+
+static void remove_dir(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (dir) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const std::string file = std::string(path) + "/" + entry->d_name;
+            std::remove(file.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+extern "C" void tearDown(void)
+{
+    remove_dir(g_dir);
+    remove_dir(g_retained_dir);
+}
+
+// Counts every write-side operation of one tier
+class CountingStorage : public JournalStorage
+{
+public:
+    explicit CountingStorage(const char *dir) : m_inner(dir) {}
+
+    size_t appends = 0;
+    size_t syncs   = 0;
+    size_t removes = 0;
+    size_t reads   = 0;
+
+    size_t Writes() const { return appends + syncs + removes; }
+    void Reset() { appends = syncs = removes = reads = 0; }
+
+    esp_err_t List(uint32_t &first, uint32_t &last, size_t &count) override { return m_inner.List(first, last, count); }
+    esp_err_t Size(uint32_t segment, size_t &size) override { return m_inner.Size(segment, size); }
+    esp_err_t Read(uint32_t segment, size_t offset, void *buf, size_t len) override
+    {
+        ++reads;
+        return m_inner.Read(segment, offset, buf, len);
+    }
+    esp_err_t Append(uint32_t segment, const void *buf, size_t len) override
+    {
+        ++appends;
+        return m_inner.Append(segment, buf, len);
+    }
+    esp_err_t Sync(uint32_t segment) override
+    {
+        ++syncs;
+        return m_inner.Sync(segment);
+    }
+    esp_err_t Truncate(uint32_t segment, size_t size) override
+    {
+        ++removes;
+        return m_inner.Truncate(segment, size);
+    }
+    esp_err_t Remove(uint32_t segment) override
+    {
+        ++removes;
+        return m_inner.Remove(segment);
+    }
+
+private:
+    JournalFileStorage m_inner;
+};
+
+static const char FMT_BOOT[] = "Boot Info: %s, reset reason %d, heap %u";
+static const char FMT_FAIL[] = "Commit failed: %d";
+
+static const journal_event_desc_t EV_BOOT = { journal_event_id("Main", FMT_BOOT), "Main", FMT_BOOT };
+static const journal_event_desc_t EV_FAIL = { journal_event_id("NVM", FMT_FAIL), "NVM", FMT_FAIL };
+
+static journal_record_t make_event(int64_t timestamp_ms, uint8_t type, int value)
+{
+    journal_record_t record{};
+    record.timestamp_ms = timestamp_ms;
+    record.type         = type;
+    record.flags        = JOURNAL_RECORD_DEFERRED;
+    if (type >= JournalTiers::RETAINED_MIN_TYPE) {
+        record.event  = &EV_FAIL;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_FAIL, value));
+    } else {
+        record.event  = &EV_BOOT;
+        record.length = static_cast<uint8_t>(journal_args_pack_v(record.data, sizeof(record.data), FMT_BOOT,
+                                                                 "tapgate 1.4.2 (a1b2c3d)", value, 180000u));
+    }
+    return record;
+}
+
+struct Tier
+{
+    CountingStorage                            storage;
+    JournalStore                               store;
+    std::vector<JournalStore::SegmentSummary>  summaries;
+    std::vector<JournalStore::IndexBlock>      blocks;
+
+    Tier(const char *dir, const JournalStore::Config &config, bool indexed)
+        : storage(dir), store(storage, config),
+          summaries(config.max_segments + 1), blocks(JournalStore::MaxBlocks(config, JOURNAL_CODEC_RECORD_MIN))
+    {
+        if (indexed)
+            store.AttachIndex(journal_codec_key, summaries, blocks);
+    }
+};
+
+struct Journal
+{
+    Tier         rolling;
+    Tier         retained;
+    JournalTiers tiers;
+
+    Journal(const JournalStore::Config &rolling_config, const JournalStore::Config &retained_config,
+            bool indexed = true)
+        : rolling(g_dir, rolling_config, indexed), retained(g_retained_dir, retained_config, indexed),
+          tiers(rolling.store, retained.store)
+    {
+        TEST_ASSERT_EQUAL(ESP_OK, tiers.Mount());
+    }
+
+    void Append(const journal_record_t &record)
+    {
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        TEST_ASSERT_EQUAL(ESP_OK, tiers.Append(record, buf, sizeof(buf)));
+    }
+
+    // Decoded records of the merged view matching the filter
+    std::vector<journal_record_t> Query(int64_t since_ms, uint8_t severities)
+    {
+        uint8_t buf[JournalTiers::COUNT * JOURNAL_CODEC_RECORD_MAX];
+        JournalTiers::Reader reader = tiers.Query({ since_ms, severities }, nullptr, buf, JOURNAL_CODEC_RECORD_MAX);
+        std::vector<journal_record_t> records;
+        const JournalTiers::Entry *entry = nullptr;
+        while (reader.Next(entry) == ESP_OK) {
+            TEST_ASSERT_TRUE(entry->decoded);
+            if (entry->record.timestamp_ms >= since_ms && (severities & (1u << entry->record.type)))
+                records.push_back(entry->record);
+        }
+        TEST_ASSERT_EQUAL(0, reader.Corrupted());
+        return records;
+    }
+};
+
+static constexpr JournalStore::Config ROLLING  = { 1024, 4, 8 };
+static constexpr JournalStore::Config RETAINED = { 1024, 8, 8 };
+
+static constexpr int64_t T0 = 1760000000000;
+
+// ---------------------------------------------------------------------------
+// Routing
+// ---------------------------------------------------------------------------
+
+void JournalTiers_Append_RoutesBySeverity()
+{
+    Journal journal(ROLLING, RETAINED);
+    for (uint8_t type = 0; type < 4; ++type)
+        journal.Append(make_event(T0 + type, type, type));
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+
+    uint64_t rolling = 0;
+    uint64_t retained = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, journal.rolling.store.NextSeq(rolling));
+    TEST_ASSERT_EQUAL(ESP_OK, journal.retained.store.NextSeq(retained));
+    TEST_ASSERT_EQUAL(2, rolling);      // INFO, WARNING
+    TEST_ASSERT_EQUAL(2, retained);     // ERROR, ALERT
+}
+
+void JournalTiers_Sync_OnlyTiersWritten()
+{
+    Journal journal(ROLLING, RETAINED);
+    journal.rolling.storage.Reset();
+    journal.retained.storage.Reset();
+
+    journal.Append(make_event(T0, 0, 1));
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+    TEST_ASSERT_EQUAL(1, journal.rolling.storage.syncs);
+    TEST_ASSERT_EQUAL(0, journal.retained.storage.syncs);
+
+    // Nothing new: no sync at all
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+    TEST_ASSERT_EQUAL(1, journal.rolling.storage.syncs);
+}
+
+// ---------------------------------------------------------------------------
+// Retention
+// ---------------------------------------------------------------------------
+
+void JournalTiers_InfoChurn_NeverTouchesRetainedTier()
+{
+    Journal journal(ROLLING, RETAINED);
+    for (int i = 0; i < 10; ++i)
+        journal.Append(make_event(T0 + i, 2 + (i & 1), -i));
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+    journal.retained.storage.Reset();
+
+    // A boot banner storm rotates the rolling tier many times over
+    for (int i = 0; i < 2000; ++i) {
+        journal.Append(make_event(T0 + 1000 + i, i & 1, i));
+        if (i % 8 == 7)
+            TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+
+    TEST_ASSERT_TRUE(journal.rolling.storage.removes > 0);
+    TEST_ASSERT_EQUAL(ROLLING.max_segments, journal.rolling.store.SegmentCount());
+    TEST_ASSERT_EQUAL(0, journal.retained.storage.Writes());
+
+    // Every error survives
+    const std::vector<journal_record_t> errors = journal.Query(INT64_MIN, 0x0C);
+    TEST_ASSERT_EQUAL(10, errors.size());
+    for (int i = 0; i < 10; ++i)
+        TEST_ASSERT_EQUAL(T0 + i, errors[i].timestamp_ms);
+}
+
+// ---------------------------------------------------------------------------
+// Merged view
+// ---------------------------------------------------------------------------
+
+static void check_merged(Journal &journal)
+{
+    // Errors every fifth record, interleaved with info by timestamp
+    for (int i = 0; i < 200; ++i)
+        journal.Append(make_event(T0 + 10 * i, i % 5 == 4 ? 2 : 0, i));
+    TEST_ASSERT_EQUAL(ESP_OK, journal.tiers.Sync());
+
+    const std::vector<journal_record_t> all = journal.Query(INT64_MIN, 0xFF);
+    TEST_ASSERT_EQUAL(200, all.size());
+    for (int i = 0; i < 200; ++i) {
+        TEST_ASSERT_EQUAL(T0 + 10 * i, all[i].timestamp_ms);
+        TEST_ASSERT_EQUAL(i % 5 == 4 ? 2 : 0, all[i].type);
+    }
+
+    const std::vector<journal_record_t> recent = journal.Query(T0 + 1500, 0xFF);
+    TEST_ASSERT_EQUAL(50, recent.size());
+    TEST_ASSERT_EQUAL(T0 + 1500, recent.front().timestamp_ms);
+}
+
+void JournalTiers_Query_MergesTiersByTimestamp()
+{
+    Journal journal({ 1024, 64, 8 }, RETAINED);
+    check_merged(journal);
+}
+
+void JournalTiers_Query_WithoutIndex()
+{
+    // As opened by tools/journal_decode
+    Journal journal({ 1024, 64, 0 }, { 1024, 8, 0 }, false);
+    check_merged(journal);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(JournalTiers_Append_RoutesBySeverity,
+                        "JournalTiers_Append_RoutesBySeverity", __FILE__);
+    UnityDefaultTestRun(JournalTiers_Sync_OnlyTiersWritten,
+                        "JournalTiers_Sync_OnlyTiersWritten", __FILE__);
+    UnityDefaultTestRun(JournalTiers_InfoChurn_NeverTouchesRetainedTier,
+                        "JournalTiers_InfoChurn_NeverTouchesRetainedTier", __FILE__);
+    UnityDefaultTestRun(JournalTiers_Query_MergesTiersByTimestamp,
+                        "JournalTiers_Query_MergesTiersByTimestamp", __FILE__);
+    UnityDefaultTestRun(JournalTiers_Query_WithoutIndex,
+                        "JournalTiers_Query_WithoutIndex", __FILE__);
+    return UNITY_END();
+}
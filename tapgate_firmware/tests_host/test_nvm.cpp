@@ -0,0 +1,503 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvs_flash.h"
+#include "nvs_mock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Real NVMWrapper (main/common/nvm/nvm.cpp) over the NVS mock
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+}
+
+static constexpr char NS[] = "CtxDevice";
+
+// ---------------------------------------------------------------------------
+// Handle cache
+// ---------------------------------------------------------------------------
+
+void NVM_NonceReadWrite_OpensNamespaceOnce()
+{
+    constexpr uint32_t UPDATES = 100;
+
+    // The DoAction pattern: read the nonce, store the next one
+    for (uint32_t i = 1; i <= UPDATES; ++i) {
+        uint32_t value = 0;
+        const esp_err_t read_err = NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value);
+        TEST_ASSERT_TRUE(read_err == ESP_OK || read_err == ESP_ERR_NVS_NOT_FOUND);
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", i));
+    }
+
+    const NvsMockCounters counters = nvs_mock_counters();
+    std::printf("\n  %u nonce updates: %zu opens, %zu closes (uncached: %u opens)\n",
+                static_cast<unsigned>(UPDATES), counters.opens, counters.closes, 2 * UPDATES);
+
+    // First read: namespace absent, nothing cached. First write opens it
+    // read-write; that handle serves every later read and write.
+    TEST_ASSERT_EQUAL(1, counters.opens);
+    TEST_ASSERT_EQUAL(0, counters.closes);
+    TEST_ASSERT_EQUAL(UPDATES, counters.commits);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(UPDATES, value);
+}
+
+void NVM_ReadOnlyHandle_UpgradedInPlaceByWrite()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU8(NVM_PARTITION_DEFAULT, "ns", "k", 1));
+    NVM.InvalidateHandles();
+    nvs_mock_clear_counters();
+
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU8(NVM_PARTITION_DEFAULT, "ns", "k", &value));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU8(NVM_PARTITION_DEFAULT, "ns", "k", 2));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU8(NVM_PARTITION_DEFAULT, "ns", "k", &value));
+    TEST_ASSERT_EQUAL(2, value);
+
+    // Read-only handle, then a read-write one replacing it
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(2, counters.opens);
+    TEST_ASSERT_EQUAL(1, counters.closes);
+    TEST_ASSERT_EQUAL(1, counters.open_handles);
+}
+
+void NVM_MoreNamespacesThanSlots_EvictsLeastRecentlyUsed()
+{
+    constexpr size_t NAMESPACES = NVM_HANDLE_CACHE_SIZE + 1;
+    char names[NAMESPACES][8];
+    for (size_t i = 0; i < NAMESPACES; ++i) {
+        std::snprintf(names[i], sizeof(names[i]), "ns%zu", i);
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, names[i], "k", static_cast<uint32_t>(i)));
+    }
+
+    // ns0 was evicted by the last write; the others are cached
+    NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(NAMESPACES, counters.opens);
+    TEST_ASSERT_EQUAL(1, counters.closes);
+    TEST_ASSERT_EQUAL(NVM_HANDLE_CACHE_SIZE, counters.open_handles);
+
+    uint32_t value = 0;
+    for (size_t i = 1; i < NAMESPACES; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, names[i], "k", &value));
+    TEST_ASSERT_EQUAL(NAMESPACES, nvs_mock_counters().opens);
+
+    // Reopening ns0 evicts ns1, the least recently used now
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, names[0], "k", &value));
+    TEST_ASSERT_EQUAL(0, value);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, names[NAMESPACES - 1], "k", &value));
+    TEST_ASSERT_EQUAL(NAMESPACES + 1, nvs_mock_counters().opens);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, names[1], "k", &value));
+    TEST_ASSERT_EQUAL(NAMESPACES + 2, nvs_mock_counters().opens);
+
+    counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(NVM_HANDLE_CACHE_SIZE, counters.open_handles);
+}
+
+void NVM_FailedOpen_NotCached()
+{
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_DEFAULT, "absent", "k", &value));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_KEY_TOO_LONG,
+                      NVM.ReadU32(NVM_PARTITION_DEFAULT, "namespace_too_long", "k", &value));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_PART_NOT_FOUND, NVM.ReadU32("no_such_part", "ns", "k", &value));
+
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(0, counters.opens);
+    TEST_ASSERT_EQUAL(0, counters.open_handles);
+}
+
+// ---------------------------------------------------------------------------
+// Invalidation
+// ---------------------------------------------------------------------------
+
+void NVM_InvalidateHandles_ClosesOnlyThatPartition()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_ENTITY, NS, "Other", 1));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().open_handles);
+
+    NVM.InvalidateHandles(NVM_PARTITION_NONCE);
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().open_handles);
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_ENTITY, NS, "Other", 2));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().opens);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 2));
+    TEST_ASSERT_EQUAL(3, nvs_mock_counters().opens);
+}
+
+void NVM_ReInit_ClosesAllHandles()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 7));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "gate"));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().open_handles);
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.Init());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().open_handles);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(7, value);
+}
+
+void NVM_HandleInvalidatedBehindCache_DroppedAndReopened()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+
+    // Partition erased without going through NVMWrapper: the cached handle
+    // is stale. The call reports it once, the next one reopens.
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_erase_partition(NVM_PARTITION_NONCE));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init_partition(NVM_PARTITION_NONCE));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_INVALID_HANDLE, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 2));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 2));
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(2, value);
+}
+
+// ---------------------------------------------------------------------------
+// Values through cached handles
+// ---------------------------------------------------------------------------
+
+void NVM_WriteSameValue_NoWriteNoCommit()
+{
+    const uint8_t blob[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_ENTITY, NS, "Entity", blob, sizeof(blob)));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_ENTITY, NS, "Name", "gate"));
+    nvs_mock_clear_counters();
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_ENTITY, NS, "Entity", blob, sizeof(blob)));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_ENTITY, NS, "Name", "gate"));
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(0, counters.writes);
+    TEST_ASSERT_EQUAL(0, counters.commits);
+    TEST_ASSERT_EQUAL(0, counters.opens);
+
+    uint8_t out[16] = {};
+    char name[8] = {};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_ENTITY, NS, "Entity", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(blob, out, sizeof(blob));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_ENTITY, NS, "Name", name, sizeof(name)));
+    TEST_ASSERT_EQUAL_STRING("gate", name);
+}
+
+// ---------------------------------------------------------------------------
+// Large values — compared through the digest key
+// ---------------------------------------------------------------------------
+
+static void fill_pattern(uint8_t* data, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<uint8_t>(seed + i * 7);
+}
+
+void NVM_Identical4KiBBlob_NotRewritten()
+{
+    static uint8_t blob[4096];
+    fill_pattern(blob, sizeof(blob), 1);
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", blob, sizeof(blob)));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().writes);     // value + digest
+    nvs_mock_clear_counters();
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", blob, sizeof(blob)));
+    NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(0, counters.writes);
+    TEST_ASSERT_EQUAL(0, counters.commits);
+
+    // One byte changed: written again
+    blob[2048] ^= 0xFF;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", blob, sizeof(blob)));
+    counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(2, counters.writes);
+    TEST_ASSERT_EQUAL(1, counters.commits);
+
+    static uint8_t out[4096];
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, "Scan", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(blob, out, sizeof(blob));
+}
+
+void NVM_IdenticalLongString_NotRewritten()
+{
+    const std::string text(NVM_STR_COMPARE_CAP + 100, 'a');
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_DEFAULT, NS, "Banner", text.c_str()));
+    nvs_mock_clear_counters();
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_DEFAULT, NS, "Banner", text.c_str()));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+
+    const std::string other = text.substr(1) + "b";
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_DEFAULT, NS, "Banner", other.c_str()));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().writes);
+
+    static char out[NVM_STR_COMPARE_CAP + 128];
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_DEFAULT, NS, "Banner", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING(other.c_str(), out);
+}
+
+void NVM_LargeBlob_SameContentOtherKey_Written()
+{
+    static uint8_t blob[1024];
+    fill_pattern(blob, sizeof(blob), 5);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "A", blob, sizeof(blob)));
+    nvs_mock_clear_counters();
+
+    // The digest covers the key: no match against another key's value
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "B", blob, sizeof(blob)));
+    TEST_ASSERT_EQUAL(2, nvs_mock_counters().writes);
+}
+
+void NVM_LargeBlob_DigestLost_NextWriteNotSkipped()
+{
+    static uint8_t a[1024];
+    static uint8_t b[1024];
+    fill_pattern(a, sizeof(a), 1);
+    fill_pattern(b, sizeof(b), 2);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", a, sizeof(a)));
+
+    // Reset between storing b and its digest: b is stored, no digest
+    nvs_mock_fail_write(1, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", b, sizeof(b)));
+
+    // Writing a again must not be mistaken for a no-op
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", a, sizeof(a)));
+    static uint8_t out[1024];
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, "Scan", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(a, out, sizeof(a));
+
+    // Digest stored again with it
+    nvs_mock_clear_counters();
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Scan", a, sizeof(a)));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+}
+
+// ---------------------------------------------------------------------------
+// Telemetry
+// ---------------------------------------------------------------------------
+
+void NVM_Stats_WritesSkipsAndEntriesCounted()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 2));
+    const uint8_t record[40] = {1};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_NONCE, NS, "Rec", record, sizeof(record)));
+    // Above the compare cap: value, data entries and digest key
+    static uint8_t large[300] = {2};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_NONCE, NS, "Large", large, sizeof(large)));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_NONCE, NS, "Large", large, sizeof(large)));
+
+    NVMPartitionStats s;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_NONCE, s));
+    TEST_ASSERT_EQUAL(4u, s.writes);
+    TEST_ASSERT_EQUAL(2u, s.skipped);
+    TEST_ASSERT_EQUAL(1u + 1u + (1u + 2u) + (1u + 10u + 1u), s.entries_written);
+    TEST_ASSERT_EQUAL(4u, s.commits);
+    TEST_ASSERT_EQUAL(0u, s.keys_untracked);
+
+    // From nvs_get_stats(): the namespace, Nonce, Rec, Large and its digest
+    TEST_ASSERT_EQUAL(1u, s.nvs.namespace_count);
+    TEST_ASSERT_EQUAL(1u + 1u + (1u + 2u) + (1u + 10u) + 1u, s.nvs.used_entries);
+    TEST_ASSERT_EQUAL(NVS_MOCK_PAGES * 126, s.nvs.total_entries);
+
+    // Other partitions untouched
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_DEFAULT, s));
+    TEST_ASSERT_EQUAL(0u, s.writes);
+    TEST_ASSERT_EQUAL(0u, s.commits);
+}
+
+void NVM_Stats_KeysMostWrittenFirst()
+{
+    for (uint32_t i = 1; i <= 3; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU8(NVM_PARTITION_DEFAULT, NS, "Once", 7));
+    for (uint32_t i = 1; i <= 5; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, "Client", "Nonce3", i));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Elsewhere", 1));
+
+    NVMKeyStats keys[4];
+    TEST_ASSERT_EQUAL(2u, NVM.GetKeyStats(NVM_PARTITION_DEFAULT, keys, 4));
+    TEST_ASSERT_EQUAL_STRING("Client", keys[0].namespace_name);
+    TEST_ASSERT_EQUAL_STRING("Nonce3", keys[0].key);
+    TEST_ASSERT_EQUAL(5u, keys[0].writes);
+    TEST_ASSERT_EQUAL(0u, keys[0].skipped);
+    TEST_ASSERT_EQUAL_STRING("Once", keys[1].key);
+    TEST_ASSERT_EQUAL(1u, keys[1].writes);
+    TEST_ASSERT_EQUAL(2u, keys[1].skipped);
+
+    // Only the top of the list
+    TEST_ASSERT_EQUAL(1u, NVM.GetKeyStats(NVM_PARTITION_DEFAULT, keys, 1));
+    TEST_ASSERT_EQUAL_STRING("Nonce3", keys[0].key);
+}
+
+void NVM_Stats_KeyTableFull_PartitionStillCounted()
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    for (size_t i = 0; i < NVM_STATS_KEY_SLOTS + 2; ++i) {
+        std::snprintf(key, sizeof(key), "K%zu", i);
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, key, 1));
+    }
+
+    NVMPartitionStats s;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_DEFAULT, s));
+    TEST_ASSERT_EQUAL(NVM_STATS_KEY_SLOTS + 2, s.writes);
+    TEST_ASSERT_EQUAL(2u, s.keys_untracked);
+
+    // Counters start over with Init()
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.Init());
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_DEFAULT, s));
+    TEST_ASSERT_EQUAL(0u, s.writes);
+    NVMKeyStats keys[1];
+    TEST_ASSERT_EQUAL(0u, NVM.GetKeyStats(NVM_PARTITION_DEFAULT, keys, 1));
+}
+
+void NVM_Stats_CommitLatencyHistogram()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Fast", 1));
+    nvs_mock_set_commit_delay(5);   // page garbage collection
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Slow", 1));
+
+    NVMPartitionStats s;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_DEFAULT, s));
+    TEST_ASSERT_EQUAL(2u, s.commits);
+    TEST_ASSERT_EQUAL(1u, s.commit_latency[0]);
+    // 5 ms: the [4, 8) ms bucket, later ones if the host is slow
+    uint32_t slow = 0;
+    for (size_t b = 3; b < NVM_STATS_LATENCY_BUCKETS; ++b)
+        slow += s.commit_latency[b];
+    TEST_ASSERT_EQUAL(1u, slow);
+    TEST_ASSERT_TRUE(s.commit_max_us >= 5000);
+}
+
+void NVM_Stats_UnknownPartition_NotFound()
+{
+    NVMPartitionStats s;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, NVM.GetStats("other", s));
+    NVMKeyStats keys[1];
+    TEST_ASSERT_EQUAL(0u, NVM.GetKeyStats("other", keys, 1));
+}
+
+// ---------------------------------------------------------------------------
+// Multithreaded — eviction while other tasks use their handles
+// ---------------------------------------------------------------------------
+
+void NVM_Multithreaded_MoreNamespacesThanSlots_AllValuesKept()
+{
+    constexpr int      THREADS    = 6;      // > NVM_HANDLE_CACHE_SIZE namespaces
+    constexpr uint32_t ITERATIONS = 2000;
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([t, &failures]() {
+            char ns[8];
+            std::snprintf(ns, sizeof(ns), "task%d", t);
+            for (uint32_t i = 1; i <= ITERATIONS; ++i) {
+                uint32_t value = 0;
+                if (NVM.WriteU32(NVM_PARTITION_NONCE, ns, "Nonce", i) != ESP_OK
+                    || NVM.ReadU32(NVM_PARTITION_NONCE, ns, "Nonce", &value) != ESP_OK
+                    || value != i)
+                    failures.fetch_add(1);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT_EQUAL(0, failures.load());
+    TEST_ASSERT_TRUE(nvs_mock_counters().open_handles <= NVM_HANDLE_CACHE_SIZE);
+}
+
+void NVM_Multithreaded_SlowCommit_OtherPartitionNotBlocked()
+{
+    constexpr uint32_t GC_MS = 1000;
+
+    // An entity commit stuck in page garbage collection
+    nvs_mock_set_commit_delay(GC_MS);
+    std::atomic<bool> entity_done{false};
+    esp_err_t entity_err = ESP_FAIL;
+    std::thread entity([&entity_done, &entity_err]() {
+        const uint8_t blob[64]{1};
+        entity_err  = NVM.WriteBlob(NVM_PARTITION_ENTITY, NS, "Entity", blob, sizeof(blob));
+        entity_done = true;
+    });
+    while (nvs_mock_counters().commits == 0)
+        std::this_thread::yield();
+    nvs_mock_set_commit_delay(0);
+
+    // The nonce partition has its own lock
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 7));
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(7u, value);
+    TEST_ASSERT_FALSE(entity_done.load());
+
+    entity.join();
+    TEST_ASSERT_EQUAL(ESP_OK, entity_err);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVM_NonceReadWrite_OpensNamespaceOnce,
+                        "NVM_NonceReadWrite_OpensNamespaceOnce", __FILE__);
+    UnityDefaultTestRun(NVM_ReadOnlyHandle_UpgradedInPlaceByWrite,
+                        "NVM_ReadOnlyHandle_UpgradedInPlaceByWrite", __FILE__);
+    UnityDefaultTestRun(NVM_MoreNamespacesThanSlots_EvictsLeastRecentlyUsed,
+                        "NVM_MoreNamespacesThanSlots_EvictsLeastRecentlyUsed", __FILE__);
+    UnityDefaultTestRun(NVM_FailedOpen_NotCached,
+                        "NVM_FailedOpen_NotCached", __FILE__);
+    UnityDefaultTestRun(NVM_InvalidateHandles_ClosesOnlyThatPartition,
+                        "NVM_InvalidateHandles_ClosesOnlyThatPartition", __FILE__);
+    UnityDefaultTestRun(NVM_ReInit_ClosesAllHandles,
+                        "NVM_ReInit_ClosesAllHandles", __FILE__);
+    UnityDefaultTestRun(NVM_HandleInvalidatedBehindCache_DroppedAndReopened,
+                        "NVM_HandleInvalidatedBehindCache_DroppedAndReopened", __FILE__);
+    UnityDefaultTestRun(NVM_WriteSameValue_NoWriteNoCommit,
+                        "NVM_WriteSameValue_NoWriteNoCommit", __FILE__);
+    UnityDefaultTestRun(NVM_Identical4KiBBlob_NotRewritten,
+                        "NVM_Identical4KiBBlob_NotRewritten", __FILE__);
+    UnityDefaultTestRun(NVM_IdenticalLongString_NotRewritten,
+                        "NVM_IdenticalLongString_NotRewritten", __FILE__);
+    UnityDefaultTestRun(NVM_LargeBlob_SameContentOtherKey_Written,
+                        "NVM_LargeBlob_SameContentOtherKey_Written", __FILE__);
+    UnityDefaultTestRun(NVM_LargeBlob_DigestLost_NextWriteNotSkipped,
+                        "NVM_LargeBlob_DigestLost_NextWriteNotSkipped", __FILE__);
+    UnityDefaultTestRun(NVM_Stats_WritesSkipsAndEntriesCounted,
+                        "NVM_Stats_WritesSkipsAndEntriesCounted", __FILE__);
+    UnityDefaultTestRun(NVM_Stats_KeysMostWrittenFirst,
+                        "NVM_Stats_KeysMostWrittenFirst", __FILE__);
+    UnityDefaultTestRun(NVM_Stats_KeyTableFull_PartitionStillCounted,
+                        "NVM_Stats_KeyTableFull_PartitionStillCounted", __FILE__);
+    UnityDefaultTestRun(NVM_Stats_CommitLatencyHistogram,
+                        "NVM_Stats_CommitLatencyHistogram", __FILE__);
+    UnityDefaultTestRun(NVM_Stats_UnknownPartition_NotFound,
+                        "NVM_Stats_UnknownPartition_NotFound", __FILE__);
+    UnityDefaultTestRun(NVM_Multithreaded_SlowCommit_OtherPartitionNotBlocked,
+                        "NVM_Multithreaded_SlowCommit_OtherPartitionNotBlocked", __FILE__);
+    UnityDefaultTestRun(NVM_Multithreaded_MoreNamespacesThanSlots_AllValuesKept,
+                        "NVM_Multithreaded_MoreNamespacesThanSlots_AllValuesKept", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,234 @@
+#include "unity.h"
+
+#include "nvm_counter.h"
+#include "nor_flash_mock.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// NVMCounter over the emulated NOR flash (bits only go 1 -> 0 without an erase)
+
+static constexpr char PART[] = "nonce_ctr";
+
+extern "C" void setUp(void)
+{
+    nor_mock_reset();
+    nor_mock_add_partition(PART, 2 * NOR_MOCK_SECTOR_SIZE);
+}
+
+extern "C" void tearDown(void)
+{
+    TEST_ASSERT_EQUAL(0, nor_mock_counters().violations);
+}
+
+// A reset: the next boot mounts the partition again
+static uint64_t reboot_value()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    return counter.Value();
+}
+
+// ---------------------------------------------------------------------------
+// Mount
+// ---------------------------------------------------------------------------
+
+void NVMCounter_FreshPartition_CreatedAtZero()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    TEST_ASSERT_TRUE(counter.Created());
+    TEST_ASSERT_TRUE(counter.Value() == 0);
+    TEST_ASSERT_EQUAL(1, nor_mock_counters().erases);
+
+    NVMCounter again;
+    TEST_ASSERT_EQUAL(ESP_OK, again.Init(PART));
+    TEST_ASSERT_FALSE(again.Created());
+    TEST_ASSERT_TRUE(again.Value() == 0);
+    TEST_ASSERT_EQUAL(1, nor_mock_counters().erases);
+}
+
+void NVMCounter_BadPartition_Rejected()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, counter.Init("absent"));
+    nor_mock_add_partition("small", NOR_MOCK_SECTOR_SIZE);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, counter.Init("small"));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, counter.Increment());
+}
+
+// ---------------------------------------------------------------------------
+// Counting
+// ---------------------------------------------------------------------------
+
+void NVMCounter_Increments_SurviveReboot()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    uint64_t value = 0;
+    for (int i = 0; i < 1000; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, counter.Increment(&value));
+    TEST_ASSERT_TRUE(value == 1000);
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Add(37, &value));
+    TEST_ASSERT_TRUE(value == 1037);
+
+    TEST_ASSERT_TRUE(reboot_value() == 1037);
+    // No erase past the initial one: every increment cleared bits
+    TEST_ASSERT_EQUAL(1, nor_mock_counters().erases);
+}
+
+void NVMCounter_FullSector_CheckpointsIntoOtherSector()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));     // sector 0
+    const uint64_t target = 2ull * NVMCounter::BITS_PER_SECTOR + 5;
+    uint64_t value = 0;
+    while (value < target)
+        TEST_ASSERT_EQUAL(ESP_OK, counter.Add(value % 7 + 1, &value));
+
+    // Sector 0 -> 1 -> 0: A/B rotation
+    TEST_ASSERT_EQUAL(2, nor_mock_sector_erases(PART, 0));
+    TEST_ASSERT_EQUAL(1, nor_mock_sector_erases(PART, 1));
+    TEST_ASSERT_TRUE(reboot_value() == value);
+}
+
+void NVMCounter_LargeAdd_JumpsByCheckpoint()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    uint64_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Add(3, &value));
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Add(1000000, &value));
+    TEST_ASSERT_TRUE(value == 1000003);
+    TEST_ASSERT_EQUAL(2, nor_mock_counters().erases);
+    TEST_ASSERT_TRUE(reboot_value() == 1000003);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, counter.Add(0));
+}
+
+void NVMCounter_Wear_IncrementsPerErase()
+{
+    constexpr uint32_t INCREMENTS = 100000;
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    const NorMockCounters before = nor_mock_counters();
+    for (uint32_t i = 0; i < INCREMENTS; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, counter.Increment());
+    const NorMockCounters after = nor_mock_counters();
+
+    const size_t erases = after.erases - before.erases;
+    TEST_ASSERT_EQUAL(INCREMENTS / NVMCounter::BITS_PER_SECTOR, erases);
+    // NVS: one 32-byte entry per update, 126 entries per page
+    std::printf("\n  %u increments: %zu sector erases (%u per erase; NVS u32: <= 126 per page)\n",
+                static_cast<unsigned>(INCREMENTS), erases,
+                static_cast<unsigned>(INCREMENTS / (erases ? erases : 1)));
+}
+
+// ---------------------------------------------------------------------------
+// Power loss
+// ---------------------------------------------------------------------------
+
+// Cut the power at every flash operation of a run that crosses checkpoints:
+// after each reboot the counter is at least at the last value returned, and
+// counts on from there
+void NVMCounter_PowerLossAtEveryOperation_NeverGoesBack()
+{
+    constexpr size_t OPERATIONS = 40;
+    for (size_t cut = 0; cut < OPERATIONS; ++cut) {
+        for (size_t keep = 0; keep < 2; ++keep) {
+            nor_mock_reset();
+            nor_mock_add_partition(PART, 2 * NOR_MOCK_SECTOR_SIZE);
+
+            NVMCounter counter;
+            TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+            nor_mock_fail_after(cut, keep);
+
+            uint64_t acknowledged = 0;
+            for (size_t i = 0; i < OPERATIONS; ++i) {
+                // Mostly single increments; every 8th one crosses a sector
+                const uint32_t n = i % 8 == 7 ? NVMCounter::BITS_PER_SECTOR : 1 + i % 3;
+                uint64_t value = 0;
+                if (counter.Add(n, &value) != ESP_OK)
+                    break;
+                TEST_ASSERT_TRUE(value > acknowledged);
+                acknowledged = value;
+            }
+
+            NVMCounter rebooted;
+            TEST_ASSERT_EQUAL(ESP_OK, rebooted.Init(PART));
+            TEST_ASSERT_TRUE(rebooted.Value() >= acknowledged);
+            uint64_t next = 0;
+            TEST_ASSERT_EQUAL(ESP_OK, rebooted.Increment(&next));
+            TEST_ASSERT_TRUE(next > acknowledged);
+            TEST_ASSERT_TRUE(reboot_value() == next);
+        }
+    }
+}
+
+void NVMCounter_FailedWrite_NextAddSkipsPastIt()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Add(10));
+
+    // Half of the bits of a 20-bit clear reach the flash
+    nor_mock_fail_after(0, 1);
+    TEST_ASSERT_EQUAL(ESP_FAIL, counter.Add(20));
+    TEST_ASSERT_TRUE(counter.Value() == 10);
+
+    uint64_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Increment(&value));
+    TEST_ASSERT_TRUE(value == 31);
+    TEST_ASSERT_TRUE(reboot_value() == 31);
+}
+
+void NVMCounter_BitsOutOfOrder_CountedAndMovedOn()
+{
+    NVMCounter counter;
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Init(PART));
+    TEST_ASSERT_EQUAL(ESP_OK, counter.Add(12));
+
+    // Stray cleared bits past the boundary, as an interrupted write may leave
+    uint8_t* bitmap = nor_mock_data(PART) + NVMCounter::HEADER_SIZE;
+    bitmap[5] &= 0x7F;
+    bitmap[6] &= 0xFE;
+
+    NVMCounter rebooted;
+    TEST_ASSERT_EQUAL(ESP_OK, rebooted.Init(PART));
+    TEST_ASSERT_TRUE(rebooted.Value() == 14);
+    TEST_ASSERT_EQUAL(1, nor_mock_sector_erases(PART, 1));     // moved on to sector 1
+
+    uint64_t value = 0;
+    for (int i = 0; i < 20; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, rebooted.Increment(&value));
+    TEST_ASSERT_TRUE(value == 34);
+    TEST_ASSERT_TRUE(reboot_value() == 34);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVMCounter_FreshPartition_CreatedAtZero,
+                        "NVMCounter_FreshPartition_CreatedAtZero", __FILE__);
+    UnityDefaultTestRun(NVMCounter_BadPartition_Rejected,
+                        "NVMCounter_BadPartition_Rejected", __FILE__);
+    UnityDefaultTestRun(NVMCounter_Increments_SurviveReboot,
+                        "NVMCounter_Increments_SurviveReboot", __FILE__);
+    UnityDefaultTestRun(NVMCounter_FullSector_CheckpointsIntoOtherSector,
+                        "NVMCounter_FullSector_CheckpointsIntoOtherSector", __FILE__);
+    UnityDefaultTestRun(NVMCounter_LargeAdd_JumpsByCheckpoint,
+                        "NVMCounter_LargeAdd_JumpsByCheckpoint", __FILE__);
+    UnityDefaultTestRun(NVMCounter_Wear_IncrementsPerErase,
+                        "NVMCounter_Wear_IncrementsPerErase", __FILE__);
+    UnityDefaultTestRun(NVMCounter_PowerLossAtEveryOperation_NeverGoesBack,
+                        "NVMCounter_PowerLossAtEveryOperation_NeverGoesBack", __FILE__);
+    UnityDefaultTestRun(NVMCounter_FailedWrite_NextAddSkipsPastIt,
+                        "NVMCounter_FailedWrite_NextAddSkipsPastIt", __FILE__);
+    UnityDefaultTestRun(NVMCounter_BitsOutOfOrder_CountedAndMovedOn,
+                        "NVMCounter_BitsOutOfOrder_CountedAndMovedOn", __FILE__);
+    return UNITY_END();
+}
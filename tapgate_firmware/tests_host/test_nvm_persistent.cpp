@@ -0,0 +1,382 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvm_persistent.h"
+#include "nvm_writer.h"
+#include "nvs_mock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+// Persistent<T, Key> over the real NVMWrapper and the NVS mock. Time is
+// passed explicitly (now_ms) wherever the deferred write-back is tested.
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    (void)NVMAsync.Flush();
+    NVM.InvalidateHandles();
+}
+
+struct Settings
+{
+    uint8_t  volume;
+    uint8_t  brightness;
+    uint16_t timeout_s;
+    uint8_t  label[12];
+};
+
+struct SettingsKey
+{
+    static constexpr const char *partition        = NVM_PARTITION_DEFAULT;
+    static constexpr char        namespace_name[] = "Settings";
+    static constexpr char        key[]            = "Panel";
+    static constexpr NVMStorage  storage          = NVMStorage::BLOB;
+    static constexpr uint32_t    write_delay_ms   = 1000;
+};
+
+struct RecordKey
+{
+    static constexpr const char *partition        = NVM_PARTITION_DEFAULT;
+    static constexpr char        namespace_name[] = "Settings";
+    static constexpr char        key[]            = "PanelRec";
+    static constexpr NVMStorage  storage          = NVMStorage::SLOT_RECORD;
+    static constexpr uint32_t    write_delay_ms   = 1000;
+};
+
+struct QueuedRecordKey
+{
+    static constexpr const char *partition        = NVM_PARTITION_DEFAULT;
+    static constexpr char        namespace_name[] = "Settings";
+    static constexpr char        key[]            = "PanelQ";
+    static constexpr NVMStorage  storage          = NVMStorage::SLOT_RECORD;
+    static constexpr uint32_t    write_delay_ms   = 1000;
+    static constexpr bool        queued           = true;
+};
+
+using PersistentSettings = Persistent<Settings, SettingsKey>;
+
+static constexpr uint32_t DELAY = SettingsKey::write_delay_ms;
+
+static Settings make_settings(uint8_t volume)
+{
+    Settings s{};
+    s.volume     = volume;
+    s.brightness = 50;
+    s.timeout_s  = 30;
+    std::memcpy(s.label, "Hall", 4);
+    return s;
+}
+
+static NVMPersist set_volume(Settings &s, uint8_t volume, NVMPersist when)
+{
+    s.volume = volume;
+    return when;
+}
+
+static Settings stored_settings()
+{
+    Settings s{};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, "Settings", "Panel", &s, sizeof(s)));
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Load
+// ---------------------------------------------------------------------------
+
+void Persistent_Load_Absent_NotFoundValueKept()
+{
+    PersistentSettings p;
+    const Settings initial = make_settings(3);
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(initial, NVMPersist::DEFERRED, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, p.Load());
+
+    const Settings s = p.Get();
+    TEST_ASSERT_EQUAL_MEMORY(&initial, &s, sizeof(s));
+    TEST_ASSERT_TRUE(p.Dirty());
+}
+
+void Persistent_Load_Stored_ReplacesPendingChange()
+{
+    const Settings stored = make_settings(7);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, "Settings", "Panel", &stored, sizeof(stored)));
+
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(9), NVMPersist::DEFERRED, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Load());
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(7, p.Read([](const Settings &s) { return s.volume; }));
+}
+
+// ---------------------------------------------------------------------------
+// Deferred write-back
+// ---------------------------------------------------------------------------
+
+void Persistent_DeferredBurst_OneWriteAfterQuietPeriod()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(0), NVMPersist::NOW, 0));
+    nvs_mock_clear_counters();
+
+    // A slider dragged through ten values, 100 ms apart
+    for (uint8_t v = 1; v <= 10; ++v)
+    {
+        const int64_t now = v * 100;
+        TEST_ASSERT_EQUAL(ESP_OK, p.Update([v](Settings &s) { return set_volume(s, v, NVMPersist::DEFERRED); }, now));
+        TEST_ASSERT_EQUAL(ESP_OK, p.Poll(now));
+    }
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+    TEST_ASSERT_TRUE(p.Dirty());
+
+    // The quiet period counts from the last change
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(1000 + DELAY - 1));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(1000 + DELAY));
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(10, stored_settings().volume);
+
+    // Nothing pending: polling writes nothing
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(10 * DELAY));
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+}
+
+void Persistent_Now_StoresPendingDeferredChange()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Update([](Settings &s) { s.brightness = 80; return NVMPersist::DEFERRED; }, 0));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+
+    TEST_ASSERT_EQUAL(ESP_OK, p.Update([](Settings &s) { return set_volume(s, 4, NVMPersist::NOW); }, 10));
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+    TEST_ASSERT_FALSE(p.Dirty());
+
+    const Settings s = stored_settings();
+    TEST_ASSERT_EQUAL(80, s.brightness);
+    TEST_ASSERT_EQUAL(4, s.volume);
+}
+
+void Persistent_Unchanged_NotDirtyNothingWritten()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(5), NVMPersist::NOW, 0));
+    nvs_mock_clear_counters();
+
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(5), NVMPersist::DEFERRED, 100));
+    TEST_ASSERT_FALSE(p.Dirty());
+
+    // Changed and changed back before the delay: stored, but NVS skips it
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(6), NVMPersist::DEFERRED, 200));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(5), NVMPersist::DEFERRED, 300));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(300 + DELAY));
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+}
+
+void Persistent_Flush_StoresBeforeDelay()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(8), NVMPersist::DEFERRED));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Flush());
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+    TEST_ASSERT_EQUAL(8, stored_settings().volume);
+
+    TEST_ASSERT_EQUAL(ESP_OK, p.Flush());
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+}
+
+// ---------------------------------------------------------------------------
+// Failures and storage
+// ---------------------------------------------------------------------------
+
+void Persistent_WriteFails_RetriedAfterDelay()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(2), NVMPersist::DEFERRED, 0));
+
+    nvs_mock_fail_write(0, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, p.Poll(DELAY));
+    TEST_ASSERT_TRUE(p.Dirty());
+
+    // Not before another delay
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY - 1));
+    TEST_ASSERT_TRUE(p.Dirty());
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY));
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(2, stored_settings().volume);
+}
+
+void Persistent_SlotRecord_Roundtrip()
+{
+    {
+        Persistent<Settings, RecordKey> p;
+        TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(1), NVMPersist::NOW, 0));
+        TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(2), NVMPersist::DEFERRED, 0));
+        TEST_ASSERT_EQUAL(ESP_OK, p.Poll(DELAY));
+    }
+
+    // Version 1 in slot a, version 2 in slot b
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, "Settings", "PanelRec");
+    Settings raw{};
+    TEST_ASSERT_EQUAL(ESP_OK, record.Load(&raw, sizeof(raw)));
+    TEST_ASSERT_EQUAL(2u, record.Version());
+
+    Persistent<Settings, RecordKey> p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Load());
+    const Settings expected = make_settings(2);
+    const Settings s = p.Get();
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &s, sizeof(s));
+}
+
+// ---------------------------------------------------------------------------
+// Queued stores (the NVMAsync task is not started: Flush() stores the queue)
+// ---------------------------------------------------------------------------
+
+static Settings stored_record(uint32_t expected_version)
+{
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, "Settings", "PanelQ");
+    Settings s{};
+    TEST_ASSERT_EQUAL(ESP_OK, record.Load(&s, sizeof(s)));
+    TEST_ASSERT_EQUAL(expected_version, record.Version());
+    return s;
+}
+
+void Persistent_Queued_NextStoreWaitsForQueuedWrite()
+{
+    Persistent<Settings, QueuedRecordKey> p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(1), NVMPersist::DEFERRED, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(DELAY));
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+
+    // NVS still holds no version: nothing queued on top
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(2), NVMPersist::DEFERRED, DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY));
+    TEST_ASSERT_TRUE(p.Dirty());
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVMAsync.Flush());
+    TEST_ASSERT_EQUAL(1, stored_record(1).volume);
+
+    // Version 2 goes to the other slot
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY));
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(ESP_OK, NVMAsync.Flush());
+    TEST_ASSERT_EQUAL(2, stored_record(2).volume);
+}
+
+void Persistent_Queued_FlushStoresQueuedWrite()
+{
+    Persistent<Settings, QueuedRecordKey> p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(4), NVMPersist::DEFERRED, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(DELAY));
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+
+    TEST_ASSERT_EQUAL(ESP_OK, p.Flush());
+    TEST_ASSERT_EQUAL(0, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(4, stored_record(1).volume);
+}
+
+void Persistent_Queued_WriteFails_DirtyAgain()
+{
+    Persistent<Settings, QueuedRecordKey> p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(3), NVMPersist::DEFERRED, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(DELAY));
+    TEST_ASSERT_FALSE(p.Dirty());
+
+    nvs_mock_fail_write(0, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, NVMAsync.Flush());
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, p.Poll(DELAY + 1));
+    TEST_ASSERT_TRUE(p.Dirty());
+
+    // Queued again after another delay
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY));
+    TEST_ASSERT_EQUAL(0, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(ESP_OK, p.Poll(2 * DELAY + 1));
+    TEST_ASSERT_EQUAL(1, NVMAsync.Pending());
+    TEST_ASSERT_EQUAL(ESP_OK, NVMAsync.Flush());
+    TEST_ASSERT_EQUAL(3, stored_record(1).volume);
+}
+
+// ---------------------------------------------------------------------------
+// Views
+// ---------------------------------------------------------------------------
+
+void Persistent_ChangeWaitingForView_DirtyAndPollNotBlocked()
+{
+    PersistentSettings p;
+    TEST_ASSERT_EQUAL(ESP_OK, p.Set(make_settings(1), NVMPersist::DEFERRED, 0));
+
+    std::atomic<bool> started{false};
+    std::thread writer;
+    {
+        const PersistentSettings::View view = p.Pin();
+
+        // The second change reuses the pinned snapshot and waits for it
+        writer = std::thread([&] {
+            started = true;
+            p.Update([](Settings &s) { return set_volume(s, 2, NVMPersist::DEFERRED); }, 0);
+            p.Update([](Settings &s) { return set_volume(s, 3, NVMPersist::DEFERRED); }, 0);
+        });
+        while (!started)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        // Would deadlock if the waiting change held the dirty-state lock
+        TEST_ASSERT_TRUE(p.Dirty());
+        TEST_ASSERT_EQUAL(ESP_OK, p.Poll(DELAY));
+        TEST_ASSERT_EQUAL(1, view->volume);
+    }
+    writer.join();
+
+    TEST_ASSERT_EQUAL(3, p.Get().volume);
+    TEST_ASSERT_EQUAL(ESP_OK, p.Flush());
+    TEST_ASSERT_FALSE(p.Dirty());
+    TEST_ASSERT_EQUAL(3, stored_settings().volume);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(Persistent_Load_Absent_NotFoundValueKept,
+                        "Persistent_Load_Absent_NotFoundValueKept", __FILE__);
+    UnityDefaultTestRun(Persistent_Load_Stored_ReplacesPendingChange,
+                        "Persistent_Load_Stored_ReplacesPendingChange", __FILE__);
+    UnityDefaultTestRun(Persistent_DeferredBurst_OneWriteAfterQuietPeriod,
+                        "Persistent_DeferredBurst_OneWriteAfterQuietPeriod", __FILE__);
+    UnityDefaultTestRun(Persistent_Now_StoresPendingDeferredChange,
+                        "Persistent_Now_StoresPendingDeferredChange", __FILE__);
+    UnityDefaultTestRun(Persistent_Unchanged_NotDirtyNothingWritten,
+                        "Persistent_Unchanged_NotDirtyNothingWritten", __FILE__);
+    UnityDefaultTestRun(Persistent_Flush_StoresBeforeDelay,
+                        "Persistent_Flush_StoresBeforeDelay", __FILE__);
+    UnityDefaultTestRun(Persistent_WriteFails_RetriedAfterDelay,
+                        "Persistent_WriteFails_RetriedAfterDelay", __FILE__);
+    UnityDefaultTestRun(Persistent_SlotRecord_Roundtrip,
+                        "Persistent_SlotRecord_Roundtrip", __FILE__);
+    UnityDefaultTestRun(Persistent_Queued_NextStoreWaitsForQueuedWrite,
+                        "Persistent_Queued_NextStoreWaitsForQueuedWrite", __FILE__);
+    UnityDefaultTestRun(Persistent_Queued_FlushStoresQueuedWrite,
+                        "Persistent_Queued_FlushStoresQueuedWrite", __FILE__);
+    UnityDefaultTestRun(Persistent_Queued_WriteFails_DirtyAgain,
+                        "Persistent_Queued_WriteFails_DirtyAgain", __FILE__);
+    UnityDefaultTestRun(Persistent_ChangeWaitingForView_DirtyAndPollNotBlocked,
+                        "Persistent_ChangeWaitingForView_DirtyAndPollNotBlocked", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,263 @@
+#include "unity.h"
+
+#include "crc32.h"
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvm_slot_record.h"
+#include "nvs_mock.h"
+
+#include <cstdint>
+#include <cstring>
+
+// NVMSlotRecord over the real NVMWrapper and the NVS mock
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+}
+
+static constexpr char NS[]  = "Client";
+static constexpr char KEY[] = "Rec3";
+
+struct Record
+{
+    uint8_t id[16];
+    uint8_t key[32];
+};
+
+static Record make_record(uint8_t seed)
+{
+    Record r{};
+    for (size_t i = 0; i < sizeof(r.id); ++i)
+        r.id[i] = static_cast<uint8_t>(seed + i);
+    for (size_t i = 0; i < sizeof(r.key); ++i)
+        r.key[i] = static_cast<uint8_t>(seed * 3 + i);
+    return r;
+}
+
+static esp_err_t store(const Record& r)
+{
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    return record.Store(&r, sizeof(r));
+}
+
+static void assert_loaded(const Record& expected, uint32_t version)
+{
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    Record loaded{};
+    TEST_ASSERT_EQUAL(ESP_OK, record.Load(&loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &loaded, sizeof(loaded));
+    TEST_ASSERT_EQUAL(version, record.Version());
+}
+
+// Raw slot image: header (8), payload, CRC-32
+static constexpr size_t IMAGE_SIZE = 8 + sizeof(Record) + 4;
+
+static void read_slot(const char* slot_key, uint8_t (&image)[IMAGE_SIZE])
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, slot_key, image, sizeof(image)));
+}
+
+static void write_slot(const char* slot_key, const uint8_t (&image)[IMAGE_SIZE])
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, slot_key, image, sizeof(image)));
+}
+
+static void damage_slot(const char* slot_key)
+{
+    uint8_t image[IMAGE_SIZE];
+    read_slot(slot_key, image);
+    image[8 + 5] ^= 0x01;
+    write_slot(slot_key, image);
+}
+
+// ---------------------------------------------------------------------------
+// Alternating slots
+// ---------------------------------------------------------------------------
+
+void NVMSlotRecord_Absent_NotFound()
+{
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    Record r = make_record(9);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, record.Load(&r, sizeof(r)));
+    TEST_ASSERT_EQUAL(0u, record.Version());
+    // Untouched on error
+    const Record expected = make_record(9);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &r, sizeof(r));
+}
+
+void NVMSlotRecord_Stores_AlternateSlots_NewestLoaded()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(2)));
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(3)));
+    assert_loaded(make_record(3), 3);
+
+    // Versions 1 and 3 in slot a, 2 in slot b: one write each
+    TEST_ASSERT_EQUAL(3, nvs_mock_counters().writes);
+    uint8_t a[IMAGE_SIZE];
+    uint8_t b[IMAGE_SIZE];
+    read_slot("Rec3.a", a);
+    read_slot("Rec3.b", b);
+    TEST_ASSERT_EQUAL(3, a[0]);
+    TEST_ASSERT_EQUAL(2, b[0]);
+}
+
+void NVMSlotRecord_SamePayload_NothingWritten()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    nvs_mock_clear_counters();
+
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    const Record r = make_record(1);
+    TEST_ASSERT_EQUAL(ESP_OK, record.Store(&r, sizeof(r)));
+    TEST_ASSERT_EQUAL(1u, record.Version());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().commits);
+}
+
+// ---------------------------------------------------------------------------
+// Damaged and failed writes
+// ---------------------------------------------------------------------------
+
+void NVMSlotRecord_NewestDamaged_PreviousVersionLoaded()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(2)));
+    damage_slot("Rec3.b");
+    assert_loaded(make_record(1), 1);
+
+    // The damaged slot is the one written next: version 1 stays in slot a
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(3)));
+    assert_loaded(make_record(3), 2);
+    uint8_t a[IMAGE_SIZE];
+    read_slot("Rec3.a", a);
+    TEST_ASSERT_EQUAL(1, a[0]);
+}
+
+void NVMSlotRecord_BothDamaged_InvalidCrc()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(2)));
+    damage_slot("Rec3.a");
+    damage_slot("Rec3.b");
+
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    Record r{};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, record.Load(&r, sizeof(r)));
+
+    // A new store recovers the record
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(3)));
+    assert_loaded(make_record(3), 1);
+}
+
+void NVMSlotRecord_WriteFails_PreviousVersionKept()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    nvs_mock_fail_write(0, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, store(make_record(2)));
+    assert_loaded(make_record(1), 1);
+}
+
+void NVMSlotRecord_OtherPayloadSize_NotLoaded()
+{
+    const uint8_t small[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    TEST_ASSERT_EQUAL(ESP_OK, record.Store(small, sizeof(small)));
+
+    Record r{};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, record.Load(&r, sizeof(r)));
+}
+
+void NVMSlotRecord_VersionWraps_NewerStillWins()
+{
+    // Slot a at the last version before the wrap
+    const Record old = make_record(1);
+    uint8_t image[IMAGE_SIZE];
+    const uint32_t version = 0xFFFFFFFFu;
+    const uint16_t size = sizeof(Record);
+    const uint16_t format = NVMSlotRecord::FORMAT;
+    std::memcpy(image, &version, 4);
+    std::memcpy(image + 4, &size, 2);
+    std::memcpy(image + 6, &format, 2);
+    std::memcpy(image + 8, &old, sizeof(old));
+    const uint32_t crc = crc32_calculate(image, 8 + sizeof(old));
+    std::memcpy(image + 8 + sizeof(old), &crc, 4);
+    write_slot("Rec3.a", image);
+    assert_loaded(old, 0xFFFFFFFFu);
+
+    // Version 0 is skipped
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(2)));
+    assert_loaded(make_record(2), 1);
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(3)));
+    assert_loaded(make_record(3), 2);
+}
+
+// ---------------------------------------------------------------------------
+// Erase and arguments
+// ---------------------------------------------------------------------------
+
+void NVMSlotRecord_Erase_BothSlotsGone()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(1)));
+    TEST_ASSERT_EQUAL(ESP_OK, store(make_record(2)));
+
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    TEST_ASSERT_EQUAL(ESP_OK, record.Erase());
+    Record r{};
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, record.Load(&r, sizeof(r)));
+    // Erasing nothing is fine
+    TEST_ASSERT_EQUAL(ESP_OK, record.Erase());
+}
+
+void NVMSlotRecord_InvalidArgs_Rejected()
+{
+    Record r{};
+    NVMSlotRecord long_key(NVM_PARTITION_DEFAULT, NS, "KeyOf14CharsXX");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, long_key.Store(&r, sizeof(r)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, long_key.Load(&r, sizeof(r)));
+
+    NVMSlotRecord record(NVM_PARTITION_DEFAULT, NS, KEY);
+    static uint8_t large[NVMSlotRecord::MAX_PAYLOAD + 1];
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, record.Store(large, sizeof(large)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, record.Store(nullptr, sizeof(r)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, record.Load(&r, 0));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVMSlotRecord_Absent_NotFound,
+                        "NVMSlotRecord_Absent_NotFound", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_Stores_AlternateSlots_NewestLoaded,
+                        "NVMSlotRecord_Stores_AlternateSlots_NewestLoaded", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_SamePayload_NothingWritten,
+                        "NVMSlotRecord_SamePayload_NothingWritten", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_NewestDamaged_PreviousVersionLoaded,
+                        "NVMSlotRecord_NewestDamaged_PreviousVersionLoaded", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_BothDamaged_InvalidCrc,
+                        "NVMSlotRecord_BothDamaged_InvalidCrc", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_WriteFails_PreviousVersionKept,
+                        "NVMSlotRecord_WriteFails_PreviousVersionKept", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_OtherPayloadSize_NotLoaded,
+                        "NVMSlotRecord_OtherPayloadSize_NotLoaded", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_VersionWraps_NewerStillWins,
+                        "NVMSlotRecord_VersionWraps_NewerStillWins", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_Erase_BothSlotsGone,
+                        "NVMSlotRecord_Erase_BothSlotsGone", __FILE__);
+    UnityDefaultTestRun(NVMSlotRecord_InvalidArgs_Rejected,
+                        "NVMSlotRecord_InvalidArgs_Rejected", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,297 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvm_snapshot.h"
+#include "nvs_mock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// NVMWrapper::LoadNamespace() into NVMSnapshot, over the NVS mock
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+}
+
+static constexpr char NS[] = "Client";
+
+// Same shape as client_entity_t
+struct Record
+{
+    uint8_t  allow_flags;
+    uint32_t nonce;
+    uint8_t  id[16];
+    char     name[32];
+    uint8_t  pub_key[32];
+};
+
+static Record make_record(size_t seed)
+{
+    Record r{};
+    r.allow_flags = static_cast<uint8_t>(seed);
+    r.nonce = static_cast<uint32_t>(seed * 1000);
+    for (size_t i = 0; i < sizeof(r.id); ++i)
+        r.id[i] = static_cast<uint8_t>(seed + i);
+    std::snprintf(r.name, sizeof(r.name), "client %zu", seed);
+    for (size_t i = 0; i < sizeof(r.pub_key); ++i)
+        r.pub_key[i] = static_cast<uint8_t>(seed * 3 + i);
+    return r;
+}
+
+static void record_key(char (&key)[NVS_KEY_NAME_MAX_SIZE], size_t index)
+{
+    std::snprintf(key, sizeof(key), "Rec%zu", index);
+}
+
+static void nonce_key(char (&key)[NVS_KEY_NAME_MAX_SIZE], size_t index)
+{
+    std::snprintf(key, sizeof(key), "Nonce%zu", index);
+}
+
+// ---------------------------------------------------------------------------
+// Contents
+// ---------------------------------------------------------------------------
+
+void NVMSnapshot_Load_AllTypesReadBack()
+{
+    const Record record = make_record(7);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU8(NVM_PARTITION_DEFAULT, NS, "Flags", 0x5A));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Count", 123456));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "gate"));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Rec7", &record, sizeof(record)));
+
+    static uint8_t arena[1024];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(4, snapshot.Count());
+
+    uint8_t flags = 0;
+    uint32_t count = 0;
+    char name[8];
+    Record out{};
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetU8("Flags", &flags));
+    TEST_ASSERT_EQUAL(0x5A, flags);
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetU32("Count", &count));
+    TEST_ASSERT_EQUAL(123456, count);
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetString("Name", name, sizeof(name)));
+    TEST_ASSERT_EQUAL_STRING("gate", name);
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetBlob("Rec7", &out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(&record, &out, sizeof(record));
+
+    // Missing key, other type, short buffer: as NVS reports them
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, snapshot.GetU8("Rec8", &flags));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, snapshot.GetU32("Flags", &count));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_INVALID_LENGTH, snapshot.GetString("Name", name, 4));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_INVALID_LENGTH, snapshot.GetBlob("Rec7", &out, sizeof(out) - 1));
+}
+
+void NVMSnapshot_Load_KeysSortedWhateverWriteOrder()
+{
+    const char* keys[] = { "zeta", "Alpha", "mid", "B", "alpha" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, keys[i], static_cast<uint32_t>(i)));
+
+    static uint8_t arena[512];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(5, snapshot.Count());
+    for (size_t i = 1; i < snapshot.Count(); ++i)
+        TEST_ASSERT_TRUE(std::strcmp(snapshot.Key(i - 1), snapshot.Key(i)) < 0);
+    TEST_ASSERT_TRUE(snapshot.Key(snapshot.Count()) == nullptr);
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        uint32_t value = 0;
+        TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetU32(keys[i], &value));
+        TEST_ASSERT_EQUAL(i, value);
+    }
+}
+
+void NVMSnapshot_Load_DigestKeysLeftOut()
+{
+    static uint8_t blob[1024];
+    std::memset(blob, 0xA5, sizeof(blob));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Large", blob, sizeof(blob)));
+
+    static uint8_t arena[2048];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(1, snapshot.Count());
+    TEST_ASSERT_EQUAL_STRING("Large", snapshot.Key(0));
+}
+
+void NVMSnapshot_AbsentNamespace_EmptyNoOpen()
+{
+    static uint8_t arena[256];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(0, snapshot.Count());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().opens);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, snapshot.GetU32("Count", &value));
+}
+
+void NVMSnapshot_ArenaTooSmall_NoMemAndEmpty()
+{
+    for (size_t i = 0; i < 8; ++i) {
+        const Record record = make_record(i);
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        record_key(key, i);
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, key, &record, sizeof(record)));
+    }
+
+    static uint8_t arena[4 * sizeof(Record)];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(0, snapshot.Count());
+    TEST_ASSERT_EQUAL(0, snapshot.Used());
+
+    // Not even one table entry fits
+    NVMSnapshot tiny(arena, 8);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, tiny));
+}
+
+void NVMSnapshot_Reload_ReplacesContents()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "A", 1));
+    static uint8_t arena[512];
+    NVMSnapshot snapshot(arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "A", 2));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "B", 3));
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetU32("A", &value));
+    TEST_ASSERT_EQUAL(1, value);     // a snapshot does not follow writes
+
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+    TEST_ASSERT_EQUAL(2, snapshot.Count());
+    TEST_ASSERT_EQUAL(ESP_OK, snapshot.GetU32("A", &value));
+    TEST_ASSERT_EQUAL(2, value);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark: boot-time initialisation of N enrolled clients
+// ---------------------------------------------------------------------------
+
+// A registry of SLOTS client slots, N of them enrolled: record blob + nonce
+// per client. Boot reads every slot, by point lookups or from one preload.
+// The mock has no flash latency: the NVS read counts carry over to the
+// device, the host times only show the CPU overhead of either path.
+void NVMSnapshot_Benchmark_PreloadVsPointLookups()
+{
+    constexpr size_t SLOTS = 200;
+    constexpr size_t CLIENTS[] = { 10, 50, 100, 200 };
+    constexpr int ROUNDS = 200;
+    using Clock = std::chrono::steady_clock;
+
+    static uint8_t arena[SLOTS * (sizeof(Record) + sizeof(uint32_t) + 64)];
+    std::printf("\n  %zu slots\n  clients  point lookups (us, opens, reads)  preload (us, opens, reads, arena bytes)\n",
+                SLOTS);
+
+    for (const size_t clients : CLIENTS) {
+        nvs_mock_reset();
+        NVM.Init();
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        for (size_t i = 0; i < clients; ++i) {
+            const Record record = make_record(i);
+            record_key(key, i);
+            TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, key, &record, sizeof(record)));
+            nonce_key(key, i);
+            TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, key, record.nonce));
+        }
+
+        // Cold handle cache at every boot
+        uint64_t checksum_point = 0;
+        Clock::duration point{};
+        NvsMockCounters point_counters{};
+        for (int round = 0; round < ROUNDS; ++round) {
+            NVM.InvalidateHandles();
+            nvs_mock_clear_counters();
+            const auto start = Clock::now();
+            for (size_t i = 0; i < SLOTS; ++i) {
+                Record record{};
+                uint32_t nonce = 0;
+                record_key(key, i);
+                NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, key, &record, sizeof(record));
+                nonce_key(key, i);
+                NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, key, &nonce);
+                checksum_point += record.allow_flags + nonce;
+            }
+            point += Clock::now() - start;
+            point_counters = nvs_mock_counters();
+        }
+
+        uint64_t checksum_preload = 0;
+        Clock::duration preload{};
+        NvsMockCounters preload_counters{};
+        size_t used = 0;
+        for (int round = 0; round < ROUNDS; ++round) {
+            NVM.InvalidateHandles();
+            nvs_mock_clear_counters();
+            const auto start = Clock::now();
+            NVMSnapshot snapshot(arena, sizeof(arena));
+            TEST_ASSERT_EQUAL(ESP_OK, NVM.LoadNamespace(NVM_PARTITION_DEFAULT, NS, snapshot));
+            for (size_t i = 0; i < SLOTS; ++i) {
+                Record record{};
+                uint32_t nonce = 0;
+                record_key(key, i);
+                snapshot.GetBlob(key, &record, sizeof(record));
+                nonce_key(key, i);
+                snapshot.GetU32(key, &nonce);
+                checksum_preload += record.allow_flags + nonce;
+            }
+            preload += Clock::now() - start;
+            preload_counters = nvs_mock_counters();
+            used = snapshot.Used();
+        }
+
+        TEST_ASSERT_TRUE(checksum_point == checksum_preload);
+        // One open and one read per key, no size queries
+        TEST_ASSERT_EQUAL(1, preload_counters.opens);
+        TEST_ASSERT_EQUAL(2 * clients, preload_counters.reads);
+
+        const auto us = [](Clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count() / ROUNDS;
+        };
+        std::printf("  %7zu  %8.1f %5zu %6zu                    %8.1f %5zu %6zu %6zu\n",
+                    clients, us(point), point_counters.opens, point_counters.reads,
+                    us(preload), preload_counters.opens, preload_counters.reads, used);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVMSnapshot_Load_AllTypesReadBack,
+                        "NVMSnapshot_Load_AllTypesReadBack", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_Load_KeysSortedWhateverWriteOrder,
+                        "NVMSnapshot_Load_KeysSortedWhateverWriteOrder", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_Load_DigestKeysLeftOut,
+                        "NVMSnapshot_Load_DigestKeysLeftOut", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_AbsentNamespace_EmptyNoOpen,
+                        "NVMSnapshot_AbsentNamespace_EmptyNoOpen", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_ArenaTooSmall_NoMemAndEmpty,
+                        "NVMSnapshot_ArenaTooSmall_NoMemAndEmpty", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_Reload_ReplacesContents,
+                        "NVMSnapshot_Reload_ReplacesContents", __FILE__);
+    UnityDefaultTestRun(NVMSnapshot_Benchmark_PreloadVsPointLookups,
+                        "NVMSnapshot_Benchmark_PreloadVsPointLookups", __FILE__);
+    return UNITY_END();
+}
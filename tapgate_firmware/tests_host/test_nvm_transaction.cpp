@@ -0,0 +1,253 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvm_transaction.h"
+#include "nvs_mock.h"
+
+#include <cstdint>
+#include <cstring>
+
+// NVMTransaction over the real NVMWrapper and the NVS mock
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+}
+
+static constexpr char NS[] = "Client";
+
+struct Record
+{
+    uint8_t id[16];
+    uint8_t key[32];
+};
+
+static Record make_record(uint8_t seed)
+{
+    Record r{};
+    for (size_t i = 0; i < sizeof(r.id); ++i)
+        r.id[i] = static_cast<uint8_t>(seed + i);
+    for (size_t i = 0; i < sizeof(r.key); ++i)
+        r.key[i] = static_cast<uint8_t>(seed * 3 + i);
+    return r;
+}
+
+// Stores record, nonce, flags and name as one batch
+static esp_err_t enroll(const Record& record, uint32_t nonce, uint8_t flags, const char* name)
+{
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    txn.SetBlob("Rec", &record, sizeof(record));
+    txn.SetU32("Nonce", nonce);
+    txn.SetU8("Flags", flags);
+    txn.SetString("Name", name);
+    return txn.Commit();
+}
+
+static void assert_enrolled(const Record& record, uint32_t nonce, uint8_t flags, const char* name)
+{
+    Record   stored{};
+    uint32_t stored_nonce = 0;
+    uint8_t  stored_flags = 0;
+    char     stored_name[32] = {};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, "Rec", &stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_MEMORY(&record, &stored, sizeof(record));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &stored_nonce));
+    TEST_ASSERT_EQUAL(nonce, stored_nonce);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU8(NVM_PARTITION_DEFAULT, NS, "Flags", &stored_flags));
+    TEST_ASSERT_EQUAL(flags, stored_flags);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_DEFAULT, NS, "Name", stored_name, sizeof(stored_name)));
+    TEST_ASSERT_EQUAL_STRING(name, stored_name);
+}
+
+// ---------------------------------------------------------------------------
+// Batching
+// ---------------------------------------------------------------------------
+
+void NVMTransaction_Commit_WritesAllKeys_OneCommit()
+{
+    const Record record = make_record(1);
+    TEST_ASSERT_EQUAL(ESP_OK, enroll(record, 7, 0x3, "phone"));
+
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(4, counters.writes);
+    TEST_ASSERT_EQUAL(1, counters.commits);
+    TEST_ASSERT_EQUAL(1, counters.opens);
+    assert_enrolled(record, 7, 0x3, "phone");
+}
+
+void NVMTransaction_SameValues_NoWriteNoCommit()
+{
+    const Record record = make_record(1);
+    TEST_ASSERT_EQUAL(ESP_OK, enroll(record, 7, 0x3, "phone"));
+    nvs_mock_clear_counters();
+
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    txn.SetBlob("Rec", &record, sizeof(record));
+    txn.SetU32("Nonce", 7);
+    txn.SetU8("Flags", 0x3);
+    txn.SetString("Name", "phone");
+    TEST_ASSERT_EQUAL(ESP_OK, txn.Commit());
+    TEST_ASSERT_EQUAL(0, txn.Written());
+
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(0, counters.writes);
+    TEST_ASSERT_EQUAL(0, counters.commits);
+}
+
+void NVMTransaction_PartlyChanged_WritesOnlyChangedKeys()
+{
+    const Record record = make_record(1);
+    TEST_ASSERT_EQUAL(ESP_OK, enroll(record, 7, 0x3, "phone"));
+    nvs_mock_clear_counters();
+
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    txn.SetBlob("Rec", &record, sizeof(record));
+    txn.SetU32("Nonce", 8);
+    txn.SetU8("Flags", 0x3);
+    txn.SetString("Name", "tablet");
+    TEST_ASSERT_EQUAL(ESP_OK, txn.Commit());
+    TEST_ASSERT_EQUAL(2, txn.Written());
+
+    const NvsMockCounters counters = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(2, counters.writes);
+    TEST_ASSERT_EQUAL(1, counters.commits);
+    assert_enrolled(record, 8, 0x3, "tablet");
+
+    // Telemetry: both batches, unchanged keys as skipped writes
+    NVMPartitionStats s;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_DEFAULT, s));
+    TEST_ASSERT_EQUAL(4u + 2u, s.writes);
+    TEST_ASSERT_EQUAL(2u, s.skipped);
+    TEST_ASSERT_EQUAL((3u + 1u + 1u + 2u) + (1u + 2u), s.entries_written);
+    TEST_ASSERT_EQUAL(2u, s.commits);
+}
+
+void NVMTransaction_SameKeyStagedTwice_LastValueWrittenOnce()
+{
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    txn.SetU32("Nonce", 1);
+    txn.SetU32("Nonce", 2);
+    TEST_ASSERT_EQUAL(1, txn.Size());
+    TEST_ASSERT_EQUAL(ESP_OK, txn.Commit());
+
+    TEST_ASSERT_EQUAL(1, nvs_mock_counters().writes);
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(2, value);
+}
+
+void NVMTransaction_NotCommitted_NothingWritten()
+{
+    {
+        NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+        txn.SetU32("Nonce", 1);
+    }
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+}
+
+// ---------------------------------------------------------------------------
+// All or nothing
+// ---------------------------------------------------------------------------
+
+void NVMTransaction_WriteFailsMidBatch_PreviousValuesRestored()
+{
+    const Record old_record = make_record(1);
+    TEST_ASSERT_EQUAL(ESP_OK, enroll(old_record, 7, 0x3, "phone"));
+
+    // Fail each write position in turn
+    for (size_t fail_at = 0; fail_at < 4; ++fail_at) {
+        nvs_mock_fail_write(fail_at, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+        TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, enroll(make_record(9), 100, 0x1, "tablet"));
+        assert_enrolled(old_record, 7, 0x3, "phone");
+    }
+
+    // Without a failure the batch goes through
+    TEST_ASSERT_EQUAL(ESP_OK, enroll(make_record(9), 100, 0x1, "tablet"));
+    assert_enrolled(make_record(9), 100, 0x1, "tablet");
+}
+
+void NVMTransaction_WriteFails_NewKeysErased()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 5));
+
+    nvs_mock_fail_write(2, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, enroll(make_record(2), 6, 0x1, "watch"));
+
+    uint32_t nonce = 0;
+    uint8_t  flags = 0;
+    Record   record{};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &nonce));
+    TEST_ASSERT_EQUAL(5, nonce);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU8(NVM_PARTITION_DEFAULT, NS, "Flags", &flags));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, "Rec", &record, sizeof(record)));
+}
+
+void NVMTransaction_UndoDoesNotFit_NothingWritten()
+{
+    uint8_t big[NVMTransaction::UNDO_CAP + 1] = {};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Big", big, sizeof(big)));
+    nvs_mock_clear_counters();
+
+    big[0] = 1;
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    txn.SetU32("Nonce", 1);
+    txn.SetBlob("Big", big, sizeof(big));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, txn.Commit());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+}
+
+void NVMTransaction_StagingErrors_ReturnedByCommit()
+{
+    NVMTransaction txn(NVM_PARTITION_DEFAULT, NS);
+    static const char* const KEYS[] = { "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8" };
+    static_assert(sizeof(KEYS) / sizeof(KEYS[0]) == NVMTransaction::MAX_WRITES + 1);
+    for (size_t i = 0; i < NVMTransaction::MAX_WRITES; ++i)
+        TEST_ASSERT_EQUAL(ESP_OK, txn.SetU8(KEYS[i], 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, txn.SetU8(KEYS[NVMTransaction::MAX_WRITES], 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, txn.Commit());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+
+    NVMTransaction bad(NVM_PARTITION_DEFAULT, NS);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bad.SetBlob("Rec", nullptr, 4));
+    bad.SetU32("Nonce", 1);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bad.Commit());
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVMTransaction_Commit_WritesAllKeys_OneCommit,
+                        "NVMTransaction_Commit_WritesAllKeys_OneCommit", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_SameValues_NoWriteNoCommit,
+                        "NVMTransaction_SameValues_NoWriteNoCommit", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_PartlyChanged_WritesOnlyChangedKeys,
+                        "NVMTransaction_PartlyChanged_WritesOnlyChangedKeys", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_SameKeyStagedTwice_LastValueWrittenOnce,
+                        "NVMTransaction_SameKeyStagedTwice_LastValueWrittenOnce", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_NotCommitted_NothingWritten,
+                        "NVMTransaction_NotCommitted_NothingWritten", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_WriteFailsMidBatch_PreviousValuesRestored,
+                        "NVMTransaction_WriteFailsMidBatch_PreviousValuesRestored", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_WriteFails_NewKeysErased,
+                        "NVMTransaction_WriteFails_NewKeysErased", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_UndoDoesNotFit_NothingWritten,
+                        "NVMTransaction_UndoDoesNotFit_NothingWritten", __FILE__);
+    UnityDefaultTestRun(NVMTransaction_StagingErrors_ReturnedByCommit,
+                        "NVMTransaction_StagingErrors_ReturnedByCommit", __FILE__);
+    return UNITY_END();
+}
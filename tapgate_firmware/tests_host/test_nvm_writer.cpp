@@ -0,0 +1,391 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvm_transaction.h"
+#include "nvm_writer.h"
+#include "nvs_mock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// NVMWriter over the real NVMWrapper and the NVS mock. Most tests store the
+// queue with Flush() in the test thread; the writer task is a std::thread
+// running Run().
+
+extern "C" void setUp(void)
+{
+    nvs_mock_reset();
+    NVM.Init();
+    nvs_mock_clear_counters();
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+}
+
+static constexpr char NS[]    = "Client";
+static constexpr char NS_B[]  = "CtxDevice";
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// ---------------------------------------------------------------------------
+// Queue
+// ---------------------------------------------------------------------------
+
+void NVMWriter_Write_StoredOnFlush()
+{
+    NVMWriter writer;
+    NVMWriter::Token token = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 42, &token));
+    TEST_ASSERT_TRUE(token != 0);
+    TEST_ASSERT_EQUAL(1, writer.Pending());
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, writer.Status(token));
+    TEST_ASSERT_EQUAL(0, nvs_mock_counters().writes);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    TEST_ASSERT_EQUAL(0, writer.Pending());
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Status(token));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Wait(token, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(42u, value);
+}
+
+void NVMWriter_SameKey_CoalescedLatestWins()
+{
+    NVMWriter writer;
+    NVMWriter::Token first = 0;
+    NVMWriter::Token token = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 1, &first));
+    for (uint32_t v = 2; v <= 10; ++v) {
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", v, &token));
+        TEST_ASSERT_EQUAL(first, token);
+    }
+    TEST_ASSERT_EQUAL(1, writer.Pending());
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    const NvsMockCounters c = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(1, c.writes);
+    TEST_ASSERT_EQUAL(1, c.commits);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(10u, value);
+
+    const NVMWriter::Stats stats = writer.GetStats();
+    TEST_ASSERT_EQUAL(10, stats.queued);
+    TEST_ASSERT_EQUAL(9, stats.coalesced);
+    TEST_ASSERT_EQUAL(1, stats.batches);
+}
+
+void NVMWriter_Batch_OneCommitPerNamespace()
+{
+    NVMWriter writer;
+    const uint8_t rec[24] = {1, 2, 3, 4, 5, 6, 7, 8};
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU8(NVM_PARTITION_DEFAULT, NS, "Flags", 0x5A));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 7));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "phone"));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Rec", rec, sizeof(rec)));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteString(NVM_PARTITION_ENTITY, NS_B, "Name", "gate"));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_ENTITY, NS_B, "Count", 3));
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    const NvsMockCounters c = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(6, c.writes);
+    TEST_ASSERT_EQUAL(2, c.commits);
+
+    uint8_t  flags = 0;
+    uint32_t nonce = 0;
+    char     name[16] = {};
+    uint8_t  stored[sizeof(rec)] = {};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU8(NVM_PARTITION_DEFAULT, NS, "Flags", &flags));
+    TEST_ASSERT_EQUAL(0x5A, flags);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &nonce));
+    TEST_ASSERT_EQUAL(7u, nonce);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_DEFAULT, NS, "Name", name, sizeof(name)));
+    TEST_ASSERT_EQUAL_STRING("phone", name);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, "Rec", stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_MEMORY(rec, stored, sizeof(rec));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_ENTITY, NS_B, "Name", name, sizeof(name)));
+    TEST_ASSERT_EQUAL_STRING("gate", name);
+}
+
+void NVMWriter_ManyKeys_SplitIntoTransactions()
+{
+    static_assert(NVMWriter::QUEUE_SIZE > NVMTransaction::MAX_WRITES);
+    NVMWriter writer;
+    char key[8];
+    for (uint32_t i = 0; i < NVMWriter::QUEUE_SIZE; ++i) {
+        std::snprintf(key, sizeof(key), "K%lu", static_cast<unsigned long>(i));
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, key, i * 3));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+
+    const size_t txns = (NVMWriter::QUEUE_SIZE + NVMTransaction::MAX_WRITES - 1) / NVMTransaction::MAX_WRITES;
+    TEST_ASSERT_EQUAL(txns, nvs_mock_counters().commits);
+    for (uint32_t i = 0; i < NVMWriter::QUEUE_SIZE; ++i) {
+        std::snprintf(key, sizeof(key), "K%lu", static_cast<unsigned long>(i));
+        uint32_t value = 0;
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, key, &value));
+        TEST_ASSERT_EQUAL(i * 3, value);
+    }
+}
+
+void NVMWriter_UnchangedValue_NoWrite()
+{
+    NVMWriter writer;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "phone"));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    nvs_mock_clear_counters();
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "phone"));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    const NvsMockCounters c = nvs_mock_counters();
+    TEST_ASSERT_EQUAL(0, c.writes);
+    TEST_ASSERT_EQUAL(0, c.commits);
+}
+
+void NVMWriter_LargePreviousValues_WrittenKeyByKey()
+{
+    // Three VALUE_CAP blobs exceed the transaction undo buffer
+    constexpr size_t BLOBS = 3;
+    static_assert(BLOBS * NVMWriter::VALUE_CAP > NVMTransaction::UNDO_CAP);
+    static const char* const KEYS[BLOBS] = {"A", "B", "C"};
+    uint8_t blob[NVMWriter::VALUE_CAP];
+    for (size_t i = 0; i < BLOBS; ++i) {
+        std::memset(blob, 0xA0 + static_cast<int>(i), sizeof(blob));
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_DEFAULT, NS, KEYS[i], blob, sizeof(blob)));
+    }
+
+    NVMWriter writer;
+    for (size_t i = 0; i < BLOBS; ++i) {
+        std::memset(blob, 0x10 + static_cast<int>(i), sizeof(blob));
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteBlob(NVM_PARTITION_DEFAULT, NS, KEYS[i], blob, sizeof(blob)));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+
+    uint8_t stored[NVMWriter::VALUE_CAP];
+    for (size_t i = 0; i < BLOBS; ++i) {
+        std::memset(blob, 0x10 + static_cast<int>(i), sizeof(blob));
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_DEFAULT, NS, KEYS[i], stored, sizeof(stored)));
+        TEST_ASSERT_EQUAL_MEMORY(blob, stored, sizeof(blob));
+    }
+}
+
+void NVMWriter_QueueFull_Rejected()
+{
+    NVMWriter writer;
+    char key[8];
+    for (uint32_t i = 0; i < NVMWriter::QUEUE_SIZE; ++i) {
+        std::snprintf(key, sizeof(key), "K%lu", static_cast<unsigned long>(i));
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, key, i));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Other", 1));
+    // A queued key still takes new values
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "K0", 99));
+    TEST_ASSERT_EQUAL(1, writer.GetStats().rejected);
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Other", 1));
+}
+
+void NVMWriter_InvalidWrites_Rejected()
+{
+    NVMWriter writer;
+    uint8_t big[NVMWriter::VALUE_CAP + 1] = {};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, writer.WriteBlob(NVM_PARTITION_DEFAULT, NS, "Big", big, sizeof(big)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, writer.WriteU8(NVM_PARTITION_DEFAULT, NS, "KeyNameTooLong16", 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, writer.WriteU8(NVM_PARTITION_DEFAULT, NS, "~digest", 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, writer.WriteU8(nullptr, NS, "Key", 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, writer.WriteString(NVM_PARTITION_DEFAULT, NS, "Key", nullptr));
+    TEST_ASSERT_EQUAL(0, writer.Pending());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, writer.Status(1));
+}
+
+// ---------------------------------------------------------------------------
+// Errors
+// ---------------------------------------------------------------------------
+
+void NVMWriter_WriteError_ReportedByTokenAndFlush()
+{
+    NVMWriter writer;
+    NVMWriter::Token token = 0;
+    NVMWriter::Token other = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 5, &token));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_ENTITY, NS_B, "Count", 6, &other));
+    nvs_mock_fail_write(0, ESP_FAIL);
+
+    TEST_ASSERT_EQUAL(ESP_FAIL, writer.Flush());
+    TEST_ASSERT_EQUAL(ESP_FAIL, writer.Status(token));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Status(other));
+    TEST_ASSERT_EQUAL(1, writer.GetStats().failed);
+    // Reported once
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+
+    // Old failures are forgotten, not reported as success
+    for (size_t i = 0; i < NVMWriter::FAILURE_HISTORY; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 5));
+        nvs_mock_fail_write(0, ESP_FAIL);
+        TEST_ASSERT_EQUAL(ESP_FAIL, writer.Flush());
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, writer.Status(token));
+}
+
+// ---------------------------------------------------------------------------
+// Writer task
+// ---------------------------------------------------------------------------
+
+void NVMWriter_Task_StoresInBackground()
+{
+    NVMWriter writer;
+    std::thread task([&writer] { writer.Run(); });
+
+    NVMWriter::Token token = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 77, &token));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Wait(token, 2000));
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(77u, value);
+
+    writer.Stop();
+    task.join();
+}
+
+void NVMWriter_Task_BurstGroupedIntoOneCommit()
+{
+    NVMWriter writer;
+    std::thread task([&writer] { writer.Run(); });
+
+    // Well inside GROUP_DELAY_MS of the first write
+    NVMWriter::Token token = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU8(NVM_PARTITION_DEFAULT, NS, "Flags", 1));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", 2));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteString(NVM_PARTITION_DEFAULT, NS, "Name", "phone", &token));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Wait(token, 2000));
+
+    TEST_ASSERT_EQUAL(3, nvs_mock_counters().writes);
+    TEST_ASSERT_TRUE(nvs_mock_counters().commits <= 2);
+
+    writer.Stop();
+    task.join();
+}
+
+void NVMWriter_Flush_WaitsForBatchInProgress()
+{
+    NVMWriter writer;
+    std::thread task([&writer] { writer.Run(); });
+    nvs_mock_set_commit_delay(30);
+
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "A", 1));
+    // The writer task is now inside its (slow) commit
+    std::this_thread::sleep_for(std::chrono::milliseconds(NVMWriter::GROUP_DELAY_MS + 10));
+    TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "B", 2));
+
+    // Shutdown path: both stored when Flush() returns
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Flush());
+    uint32_t a = 0;
+    uint32_t b = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "A", &a));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "B", &b));
+    TEST_ASSERT_EQUAL(1u, a);
+    TEST_ASSERT_EQUAL(2u, b);
+
+    nvs_mock_set_commit_delay(0);
+    writer.Stop();
+    task.join();
+}
+
+// A write that stalls in page GC: the caller of NVMWrapper waits it out, the
+// caller of NVMWriter does not
+void NVMWriter_Latency_FlatDuringSlowCommits()
+{
+    constexpr uint32_t COMMIT_DELAY_MS = 25;
+    constexpr int      WRITES          = 50;
+
+    NVMWriter writer;
+    std::thread task([&writer] { writer.Run(); });
+    nvs_mock_set_commit_delay(COMMIT_DELAY_MS);
+
+    Clock::time_point start = Clock::now();
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Sync", 1));
+    const double sync_ms = elapsed_ms(start);
+
+    double worst_ms = 0;
+    NVMWriter::Token token = 0;
+    for (int i = 0; i < WRITES; ++i) {
+        start = Clock::now();
+        TEST_ASSERT_EQUAL(ESP_OK, writer.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce",
+                                                  static_cast<uint32_t>(i), &token));
+        const double ms = elapsed_ms(start);
+        worst_ms = ms > worst_ms ? ms : worst_ms;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, writer.Wait(token, 5000));
+
+    std::printf("\n  commit stall %lu ms: NVMWrapper write %.2f ms, NVMWriter enqueue worst %.3f ms "
+                "(%d writes, %lu batch(es))\n",
+                static_cast<unsigned long>(COMMIT_DELAY_MS), sync_ms, worst_ms, WRITES,
+                static_cast<unsigned long>(writer.GetStats().batches));
+    TEST_ASSERT_TRUE(sync_ms >= COMMIT_DELAY_MS);
+    TEST_ASSERT_TRUE(worst_ms < COMMIT_DELAY_MS);
+
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(static_cast<uint32_t>(WRITES - 1), value);
+
+    nvs_mock_set_commit_delay(0);
+    writer.Stop();
+    task.join();
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NVMWriter_Write_StoredOnFlush,
+                        "NVMWriter_Write_StoredOnFlush", __FILE__);
+    UnityDefaultTestRun(NVMWriter_SameKey_CoalescedLatestWins,
+                        "NVMWriter_SameKey_CoalescedLatestWins", __FILE__);
+    UnityDefaultTestRun(NVMWriter_Batch_OneCommitPerNamespace,
+                        "NVMWriter_Batch_OneCommitPerNamespace", __FILE__);
+    UnityDefaultTestRun(NVMWriter_ManyKeys_SplitIntoTransactions,
+                        "NVMWriter_ManyKeys_SplitIntoTransactions", __FILE__);
+    UnityDefaultTestRun(NVMWriter_UnchangedValue_NoWrite,
+                        "NVMWriter_UnchangedValue_NoWrite", __FILE__);
+    UnityDefaultTestRun(NVMWriter_LargePreviousValues_WrittenKeyByKey,
+                        "NVMWriter_LargePreviousValues_WrittenKeyByKey", __FILE__);
+    UnityDefaultTestRun(NVMWriter_QueueFull_Rejected,
+                        "NVMWriter_QueueFull_Rejected", __FILE__);
+    UnityDefaultTestRun(NVMWriter_InvalidWrites_Rejected,
+                        "NVMWriter_InvalidWrites_Rejected", __FILE__);
+    UnityDefaultTestRun(NVMWriter_WriteError_ReportedByTokenAndFlush,
+                        "NVMWriter_WriteError_ReportedByTokenAndFlush", __FILE__);
+    UnityDefaultTestRun(NVMWriter_Task_StoresInBackground,
+                        "NVMWriter_Task_StoresInBackground", __FILE__);
+    UnityDefaultTestRun(NVMWriter_Task_BurstGroupedIntoOneCommit,
+                        "NVMWriter_Task_BurstGroupedIntoOneCommit", __FILE__);
+    UnityDefaultTestRun(NVMWriter_Flush_WaitsForBatchInProgress,
+                        "NVMWriter_Flush_WaitsForBatchInProgress", __FILE__);
+    UnityDefaultTestRun(NVMWriter_Latency_FlatDuringSlowCommits,
+                        "NVMWriter_Latency_FlatDuringSlowCommits", __FILE__);
+    return UNITY_END();
+}
@@ -0,0 +1,302 @@
+#include "unity.h"
+
+#include "nvm.h"
+#include "nvm_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "nvs_flash_emu.h"
+#include "nor_flash_mock.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// The real NVMWrapper over the NVS page emulator: flash layout, garbage
+// collection, remount, and wear of the nonce workloads measured rather than
+// estimated (docs/partitions.md)
+
+extern "C" void setUp(void)
+{
+    nvs_emu_reset();
+    nvs_emu_add_default_partitions();
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.Init());
+}
+
+extern "C" void tearDown(void)
+{
+    NVM.InvalidateHandles();
+    TEST_ASSERT_EQUAL(0, nor_mock_counters().violations);
+}
+
+static constexpr char NS[] = "CtxClient";
+
+// A reset: RAM state dropped, every partition mounted again from flash
+static void reboot()
+{
+    NVM.InvalidateHandles();
+    for (const char* label : NVM_PARTITION_LABELS)
+        TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_deinit_partition(label));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.Init());
+}
+
+static nvs_stats_t stats(const char* partition)
+{
+    nvs_stats_t s{};
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_get_stats(partition, &s));
+    return s;
+}
+
+static void key_name(char (&key)[NVS_KEY_NAME_MAX_SIZE], const char* prefix, unsigned i)
+{
+    std::snprintf(key, sizeof(key), "%s%u", prefix, i);
+}
+
+// ---------------------------------------------------------------------------
+// Values
+// ---------------------------------------------------------------------------
+
+void NvsEmu_Values_SurviveRemount()
+{
+    uint8_t blob[300];
+    for (size_t i = 0; i < sizeof(blob); ++i)
+        blob[i] = static_cast<uint8_t>(i * 7);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU8(NVM_PARTITION_DEFAULT, NS, "Flags", 0xA5));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 0xCAFEBABE));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_ENTITY, NS, "Name", "front door"));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteBlob(NVM_PARTITION_ENTITY, NS, "Rec", blob, sizeof(blob)));
+
+    reboot();
+
+    uint8_t  flags = 0;
+    uint32_t nonce = 0;
+    char     name[32] = {};
+    uint8_t  stored[sizeof(blob)] = {};
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU8(NVM_PARTITION_DEFAULT, NS, "Flags", &flags));
+    TEST_ASSERT_EQUAL(0xA5, flags);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &nonce));
+    TEST_ASSERT_EQUAL(0xCAFEBABEu, nonce);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadString(NVM_PARTITION_ENTITY, NS, "Name", name, sizeof(name)));
+    TEST_ASSERT_EQUAL_STRING("front door", name);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadBlob(NVM_PARTITION_ENTITY, NS, "Rec", stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_MEMORY(blob, stored, sizeof(blob));
+}
+
+// ---------------------------------------------------------------------------
+// Layout
+// ---------------------------------------------------------------------------
+
+void NvsEmu_Entries_CountedPerItem()
+{
+    const nvs_stats_t empty = stats(NVM_PARTITION_NONCE);
+    TEST_ASSERT_EQUAL(13 * NVS_EMU_ENTRIES_PER_PAGE, empty.total_entries);
+    TEST_ASSERT_EQUAL(0, empty.used_entries);
+
+    // Namespace item + u32 item
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+    nvs_stats_t s = stats(NVM_PARTITION_NONCE);
+    TEST_ASSERT_EQUAL(2, s.used_entries);
+    TEST_ASSERT_EQUAL(1, s.namespace_count);
+
+    // An update takes a new entry and erases the old one
+    for (uint32_t v = 2; v <= 10; ++v)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", v));
+    s = stats(NVM_PARTITION_NONCE);
+    TEST_ASSERT_EQUAL(2, s.used_entries);
+    TEST_ASSERT_EQUAL(empty.free_entries - 11, s.free_entries);
+
+    // 100-byte string: item + 4 data entries
+    char name[101];
+    std::memset(name, 'n', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteString(NVM_PARTITION_NONCE, NS, "Name", name));
+    TEST_ASSERT_EQUAL(2 + 5, stats(NVM_PARTITION_NONCE).used_entries);
+}
+
+void NvsEmu_Full_ReserveKeptAndReclaimed()
+{
+    // "nvs": 3 pages, one kept free for garbage collection
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    unsigned written = 0;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK) {
+        key_name(key, "K", written);
+        err = NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, key, written);
+        written += err == ESP_OK ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, err);
+    TEST_ASSERT_EQUAL(2 * NVS_EMU_ENTRIES_PER_PAGE - 1, written);     // - namespace item
+    TEST_ASSERT_EQUAL(NVS_EMU_ENTRIES_PER_PAGE, stats(NVM_PARTITION_DEFAULT).free_entries);
+
+    // Nothing erased: nothing for GC to reclaim
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "K0", 1000));
+
+    // One erased entry is reclaimed by GC into the reserve
+    nvs_handle_t handle;
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open_from_partition(NVM_PARTITION_DEFAULT, NS, NVS_READWRITE, &handle));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_erase_key(handle, "K1"));
+    nvs_close(handle);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "K0", 1000));
+    TEST_ASSERT_EQUAL(1, nvs_emu_stats(NVM_PARTITION_DEFAULT).gc_runs);
+
+    reboot();
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "K0", &value));
+    TEST_ASSERT_EQUAL(1000u, value);
+    key_name(key, "K", written - 1);
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, key, &value));
+    TEST_ASSERT_EQUAL(written - 1, value);
+}
+
+void NvsEmu_GC_RotatesPages()
+{
+    constexpr uint32_t UPDATES = 5000;
+    for (uint32_t v = 1; v <= UPDATES; ++v)
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_DEFAULT, NS, "Nonce", v));
+
+    const NvsEmuStats s = nvs_emu_stats(NVM_PARTITION_DEFAULT);
+    TEST_ASSERT_TRUE(s.gc_runs > 0);
+    // The page holding the namespace item has the fewest erased entries and
+    // is never collected (as with ESP-IDF); the other two share the erases
+    TEST_ASSERT_TRUE(s.max_page_erases * 2 <= s.page_erases + 2);
+    size_t erased_pages = 0;
+    for (size_t page = 0; page < 3; ++page)
+        erased_pages += nor_mock_sector_erases(NVM_PARTITION_DEFAULT, page) != 0;
+    TEST_ASSERT_EQUAL(2u, erased_pages);
+
+    reboot();
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_DEFAULT, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(UPDATES, value);
+}
+
+// ---------------------------------------------------------------------------
+// Mount
+// ---------------------------------------------------------------------------
+
+void NvsEmu_Mount_UpdateCutBeforeOldErased_NewValueWins()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 1));
+
+    // Update: item write, its WRITTEN mark, then the old item's ERASED mark
+    nor_mock_fail_after(2);
+    TEST_ASSERT_EQUAL(ESP_FAIL, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "Nonce", 2));
+
+    reboot();
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "Nonce", &value));
+    TEST_ASSERT_EQUAL(2u, value);
+    TEST_ASSERT_EQUAL(2, stats(NVM_PARTITION_NONCE).used_entries);
+}
+
+void NvsEmu_Mount_CorruptItemDropped()
+{
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "A", 1));
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, "B", 2));
+
+    // Entry 2 of page 0 is "B" (0: namespace, 1: "A"); clear a bit of its value
+    uint8_t* flash = nor_mock_data(NVM_PARTITION_NONCE);
+    flash[64 + 2 * 32 + 24] &= 0xFD;
+
+    reboot();
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "A", &value));
+    TEST_ASSERT_EQUAL(1u, value);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, NVM.ReadU32(NVM_PARTITION_NONCE, NS, "B", &value));
+}
+
+// ---------------------------------------------------------------------------
+// Wear (nvs_nonce, 13 pages)
+// ---------------------------------------------------------------------------
+
+struct Wear
+{
+    double   updates_per_erase;
+    size_t   max_page_erases;
+};
+
+// `updates` writes round robin over `keys` u32 keys
+static Wear run_nonce_workload(unsigned keys, uint32_t updates)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    for (uint32_t i = 0; i < updates; ++i) {
+        key_name(key, "N", i % keys);
+        TEST_ASSERT_EQUAL(ESP_OK, NVM.WriteU32(NVM_PARTITION_NONCE, NS, key, i));
+    }
+    const NvsEmuStats s = nvs_emu_stats(NVM_PARTITION_NONCE);
+    TEST_ASSERT_TRUE(s.page_erases > 0);
+    return Wear{static_cast<double>(updates) / s.page_erases, s.max_page_erases};
+}
+
+static void print_wear(const char* name, unsigned keys, uint32_t updates, const Wear& w,
+                       double updates_per_day)
+{
+    // Pages holding keys that are rarely rewritten are rarely collected, so
+    // the lifetime is that of the most erased page, not 13 times the average
+    const double erases_per_day = updates_per_day / w.updates_per_erase;
+    const double max_page_erases_per_day = updates_per_day * w.max_page_erases / updates;
+    const double years = 100000.0 / max_page_erases_per_day / 365.0;
+    std::printf("\n  %s: %u key(s), %lu updates: %.1f updates per page erase, "
+                "max %zu erases per page; %.0f updates/day -> %.3f erases/day, ~%.0f years @100k",
+                name, keys, static_cast<unsigned long>(updates), w.updates_per_erase,
+                w.max_page_erases, updates_per_day, erases_per_day, years);
+}
+
+void NvsEmu_Wear_ClientNonces()
+{
+    // docs/partitions.md: 50 live nonces, 126 - 50 = 76 updates per erase
+    constexpr unsigned KEYS    = 50;
+    constexpr uint32_t UPDATES = 100000;
+    const Wear w = run_nonce_workload(KEYS, UPDATES);
+    print_wear("client nonces", KEYS, UPDATES, w, 500);
+    TEST_ASSERT_TRUE(w.updates_per_erase >= 76);
+
+    // NVMWrapper telemetry: the erase estimate from the entries it wrote
+    // against the erases of the emulated flash
+    NVMPartitionStats st;
+    TEST_ASSERT_EQUAL(ESP_OK, NVM.GetStats(NVM_PARTITION_NONCE, st));
+    const size_t erases = nvs_emu_stats(NVM_PARTITION_NONCE).page_erases;
+    std::printf("\n  telemetry: %lu erases estimated, %zu on flash; %zu/%zu entries used",
+                static_cast<unsigned long>(st.estimated_erases), erases,
+                st.nvs.used_entries, st.nvs.total_entries);
+    TEST_ASSERT_EQUAL(UPDATES, st.writes);
+    TEST_ASSERT_EQUAL(UPDATES, st.entries_written);
+    TEST_ASSERT_TRUE(st.estimated_erases * 10 >= erases * 9 && st.estimated_erases * 10 <= erases * 11);
+    TEST_ASSERT_TRUE(st.nvs.used_entries >= KEYS + 1);
+    TEST_ASSERT_EQUAL(13u * NVS_EMU_ENTRIES_PER_PAGE, st.nvs.total_entries);
+}
+
+void NvsEmu_Wear_DeviceNonceLease()
+{
+    // One write per TAPGATE_NONCE_LEASE_SIZE (64) actions
+    constexpr uint32_t ACTIONS = 100000;
+    constexpr uint32_t LEASE   = 64;
+    const Wear w = run_nonce_workload(1, ACTIONS / LEASE);
+    print_wear("device nonce lease", 1, ACTIONS / LEASE, w, 500.0 / LEASE);
+    TEST_ASSERT_TRUE(w.updates_per_erase >= 100);
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+int main()
+{
+    UNITY_BEGIN();
+    UnityDefaultTestRun(NvsEmu_Values_SurviveRemount,
+                        "NvsEmu_Values_SurviveRemount", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Entries_CountedPerItem,
+                        "NvsEmu_Entries_CountedPerItem", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Full_ReserveKeptAndReclaimed,
+                        "NvsEmu_Full_ReserveKeptAndReclaimed", __FILE__);
+    UnityDefaultTestRun(NvsEmu_GC_RotatesPages,
+                        "NvsEmu_GC_RotatesPages", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Mount_UpdateCutBeforeOldErased_NewValueWins,
+                        "NvsEmu_Mount_UpdateCutBeforeOldErased_NewValueWins", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Mount_CorruptItemDropped,
+                        "NvsEmu_Mount_CorruptItemDropped", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Wear_ClientNonces,
+                        "NvsEmu_Wear_ClientNonces", __FILE__);
+    UnityDefaultTestRun(NvsEmu_Wear_DeviceNonceLease,
+                        "NvsEmu_Wear_DeviceNonceLease", __FILE__);
+    return UNITY_END();
+}
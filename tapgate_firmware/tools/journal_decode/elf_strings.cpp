@@ -0,0 +1,154 @@
+#include "elf_strings.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// ELF constants used below (see System V ABI, "Object Files")
+static constexpr uint8_t  ELFCLASS32    = 1;
+static constexpr uint8_t  ELFCLASS64    = 2;
+static constexpr uint8_t  ELFDATA2LSB   = 1;
+static constexpr uint32_t SHT_SYMTAB    = 2;
+static constexpr uint32_t SHT_NOBITS    = 8;
+static constexpr uint16_t SHN_UNDEF     = 0;
+static constexpr uint64_t SHF_ALLOC     = 0x2;
+
+static uint64_t read_le(const uint8_t* p, std::size_t n)
+{
+    uint64_t v = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+bool ElfStringTable::Load(std::vector<uint8_t> image)
+{
+    m_image = std::move(image);
+    m_sections.clear();
+    m_symtab_offset = m_symtab_size = m_symtab_entsize = 0;
+    m_strtab_offset = m_strtab_size = 0;
+
+    const std::size_t size = m_image.size();
+    const uint8_t* d = m_image.data();
+    if (size < 52 || std::memcmp(d, "\x7f" "ELF", 4) != 0 || d[5] != ELFDATA2LSB)
+        return false;
+
+    const bool is64 = d[4] == ELFCLASS64;
+    if (!is64 && d[4] != ELFCLASS32)
+        return false;
+    m_is64 = is64;
+
+    // Field offsets differ between ELF32 and ELF64 headers
+    const uint64_t shoff     = is64 ? read_le(d + 0x28, 8) : read_le(d + 0x20, 4);
+    const uint64_t shentsize = is64 ? read_le(d + 0x3A, 2) : read_le(d + 0x2E, 2);
+    const uint64_t shnum     = is64 ? read_le(d + 0x3C, 2) : read_le(d + 0x30, 2);
+
+    if (shoff == 0 || shentsize == 0 || shoff > size || shnum > (size - shoff) / shentsize)
+        return false;
+
+    for (uint64_t i = 0; i < shnum; ++i) {
+        const uint8_t* sh = d + shoff + i * shentsize;
+        const uint32_t type   = static_cast<uint32_t>(read_le(sh + 0x04, 4));
+        const uint64_t flags  = is64 ? read_le(sh + 0x08, 8) : read_le(sh + 0x08, 4);
+        const uint64_t addr   = is64 ? read_le(sh + 0x10, 8) : read_le(sh + 0x0C, 4);
+        const uint64_t offset = is64 ? read_le(sh + 0x18, 8) : read_le(sh + 0x10, 4);
+        const uint64_t sz     = is64 ? read_le(sh + 0x20, 8) : read_le(sh + 0x14, 4);
+
+        if (type == SHT_SYMTAB && offset <= size && sz <= size - offset) {
+            const uint64_t link    = read_le(sh + (is64 ? 0x28 : 0x18), 4);
+            const uint64_t entsize = is64 ? read_le(sh + 0x38, 8) : read_le(sh + 0x24, 4);
+            if (link < shnum && entsize != 0) {
+                const uint8_t* str = d + shoff + link * shentsize;
+                const uint64_t str_off = is64 ? read_le(str + 0x18, 8) : read_le(str + 0x10, 4);
+                const uint64_t str_sz  = is64 ? read_le(str + 0x20, 8) : read_le(str + 0x14, 4);
+                if (str_off <= size && str_sz <= size - str_off) {
+                    m_symtab_offset  = offset;
+                    m_symtab_size    = sz;
+                    m_symtab_entsize = entsize;
+                    m_strtab_offset  = str_off;
+                    m_strtab_size    = str_sz;
+                }
+            }
+            continue;
+        }
+
+        if (!(flags & SHF_ALLOC) || type == SHT_NOBITS || sz == 0)
+            continue;
+        if (offset > size || sz > size - offset)
+            continue;
+        m_sections.push_back({addr, sz, offset});
+    }
+    return true;
+}
+
+bool ElfStringTable::LoadFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return Load(std::move(image));
+}
+
+const char* ElfStringTable::Resolve(uint64_t addr) const noexcept
+{
+    for (const Section& s : m_sections) {
+        if (addr < s.addr || addr - s.addr >= s.size)
+            continue;
+        const uint64_t start = s.offset + (addr - s.addr);
+        const uint64_t end   = s.offset + s.size;
+        const void* nul = std::memchr(m_image.data() + start, '\0', static_cast<std::size_t>(end - start));
+        if (!nul)
+            return nullptr;
+        return reinterpret_cast<const char*>(m_image.data() + start);
+    }
+    return nullptr;
+}
+
+bool ElfStringTable::FindSymbol(const std::string& name, uint64_t& addr) const
+{
+    // Elf32_Sym: name@0 value@4 ... shndx@14; Elf64_Sym: name@0 shndx@6 value@8
+    const std::size_t min_entsize = m_is64 ? 24 : 16;
+    if (m_symtab_entsize < min_entsize)
+        return false;
+
+    const uint8_t* d = m_image.data();
+    const uint64_t count = m_symtab_size / m_symtab_entsize;
+    for (uint64_t i = 1; i < count; ++i) {
+        const uint8_t* sym = d + m_symtab_offset + i * m_symtab_entsize;
+        const uint64_t name_off = read_le(sym, 4);
+        const uint64_t shndx    = read_le(sym + (m_is64 ? 0x06 : 0x0E), 2);
+        if (shndx == SHN_UNDEF || name_off >= m_strtab_size)
+            continue;
+
+        const char* sym_name = reinterpret_cast<const char*>(d + m_strtab_offset + name_off);
+        const std::size_t max_len = static_cast<std::size_t>(m_strtab_size - name_off);
+        if (strnlen(sym_name, max_len) != name.size() || name.compare(0, name.size(), sym_name, name.size()) != 0)
+            continue;
+
+        addr = m_is64 ? read_le(sym + 0x08, 8) : read_le(sym + 0x04, 4);
+        return true;
+    }
+    return false;
+}
+
+const uint8_t* ElfStringTable::Map(uint64_t addr, uint64_t size) const noexcept
+{
+    for (const Section& s : m_sections) {
+        if (addr < s.addr || addr - s.addr > s.size || size > s.size - (addr - s.addr))
+            continue;
+        return m_image.data() + s.offset + (addr - s.addr);
+    }
+    return nullptr;
+}
+
+bool ElfStringTable::ReadWord(uint64_t addr, std::size_t bytes, uint64_t& value) const noexcept
+{
+    if (bytes == 0 || bytes > 8)
+        return false;
+    const uint8_t* p = Map(addr, bytes);
+    if (!p)
+        return false;
+    value = read_le(p, bytes);
+    return true;
+}
@@ -0,0 +1,70 @@
+//
+// ElfStringTable - resolve firmware rodata addresses to strings (host only)
+//
+// Deferred journal records store the address of their format string, which
+// points into the firmware's flash rodata. Given the firmware ELF, this class
+// maps such an address back to the NUL-terminated string it referenced.
+//
+// It also exposes symbol lookup and raw word reads, which is enough to walk
+// the "ej_events" descriptor table (see event_table.h).
+//
+// Supports little-endian ELF32 (Xtensa / RISC-V ESP targets) and ELF64 (host
+// builds). Only allocated sections with file contents are indexed.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ElfStringTable
+{
+public:
+    // Parses an ELF image held in memory. Returns false if it is not a
+    // supported ELF file.
+    bool Load(std::vector<uint8_t> image);
+
+    // Reads and parses an ELF file from disk.
+    bool LoadFile(const std::string& path);
+
+    // Returns the string stored at addr, or nullptr if addr is not inside an
+    // indexed section or the string is not terminated within the section.
+    [[nodiscard]] const char* Resolve(uint64_t addr) const noexcept;
+
+    // Looks up a symbol by name in .symtab. Returns false if the image has
+    // no symbol table or the symbol is not defined.
+    bool FindSymbol(const std::string& name, uint64_t& addr) const;
+
+    // Reads a little-endian word of `bytes` (1..8) at addr from an indexed
+    // section. Returns false if the range is not backed by file contents.
+    bool ReadWord(uint64_t addr, std::size_t bytes, uint64_t& value) const noexcept;
+
+    // Pointer size of the target: 4 for ELF32, 8 for ELF64.
+    [[nodiscard]] std::size_t PointerSize() const noexcept { return m_is64 ? 8 : 4; }
+
+    [[nodiscard]] std::size_t SectionCount() const noexcept { return m_sections.size(); }
+
+private:
+    struct Section
+    {
+        uint64_t addr;
+        uint64_t size;
+        uint64_t offset;
+    };
+
+    const uint8_t* Map(uint64_t addr, uint64_t size) const noexcept;
+
+    std::vector<uint8_t> m_image;
+    std::vector<Section> m_sections;
+    bool                 m_is64 = false;
+
+    // .symtab and its linked string table (file offsets, 0 size if absent)
+    uint64_t m_symtab_offset = 0;
+    uint64_t m_symtab_size   = 0;
+    uint64_t m_symtab_entsize = 0;
+    uint64_t m_strtab_offset = 0;
+    uint64_t m_strtab_size   = 0;
+
+}; // class ElfStringTable
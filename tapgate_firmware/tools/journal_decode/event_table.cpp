@@ -0,0 +1,41 @@
+#include "event_table.h"
+
+// Bound symbols: ESP-IDF linker fragment (main/linker.lf) or GNU ld orphan section
+static constexpr const char* BOUNDS[][2] = {
+    { "_ej_events_start",  "_ej_events_end"   },
+    { "__start_ej_events", "__stop_ej_events" },
+};
+
+bool journal_event_table_load(const ElfStringTable& elf, std::vector<JournalEventEntry>& entries)
+{
+    entries.clear();
+
+    uint64_t begin = 0;
+    uint64_t end   = 0;
+    bool found = false;
+    for (const auto& bound : BOUNDS) {
+        if (elf.FindSymbol(bound[0], begin) && elf.FindSymbol(bound[1], end)) {
+            found = true;
+            break;
+        }
+    }
+    if (!found || end < begin)
+        return false;
+
+    // Descriptor layout: id (u16, padded to pointer alignment), tag, fmt
+    const std::size_t ptr = elf.PointerSize();
+    for (uint64_t slot = begin; slot + ptr <= end; slot += ptr) {
+        uint64_t desc = 0;
+        uint64_t id   = 0;
+        uint64_t tag  = 0;
+        uint64_t fmt  = 0;
+        if (!elf.ReadWord(slot, ptr, desc) || !elf.ReadWord(desc, 2, id)
+            || !elf.ReadWord(desc + ptr, ptr, tag) || !elf.ReadWord(desc + 2 * ptr, ptr, fmt))
+            return false;
+
+        const char* tag_str = elf.Resolve(tag);
+        const char* fmt_str = elf.Resolve(fmt);
+        entries.push_back({ static_cast<uint16_t>(id), tag_str ? tag_str : "", fmt_str ? fmt_str : "" });
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+//
+// Journal event table - read the ID-to-format table from a firmware ELF (host only)
+//
+// The "ej_events" section holds one pointer per EVENT_JOURNAL_ADD call site,
+// each pointing at a journal_event_desc_t { uint16_t id; const char* tag;
+// const char* fmt; }. This walks the section using its bound symbols and
+// resolves the strings, so persisted event IDs can be decoded offline.
+//
+
+#pragma once
+
+#include "elf_strings.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct JournalEventEntry
+{
+    uint16_t    id;
+    std::string tag;
+    std::string fmt;
+};
+
+// Fills entries with every descriptor found in the image. Returns false if
+// the section bounds are missing or a descriptor cannot be read.
+bool journal_event_table_load(const ElfStringTable& elf, std::vector<JournalEventEntry>& entries);
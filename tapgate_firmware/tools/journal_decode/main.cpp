@@ -0,0 +1,123 @@
+//
+// journal_decode - print the event ID table of a firmware image, or decode
+// a copy of the journal directory against it
+//
+// Usage: journal_decode <firmware.elf> [journal_dir [retained_dir]]
+//
+// journal_dir is a copy of /littlefs/journal taken from the device, the
+// rolling tier; retained_dir a copy of /littlefs/journal_retained, the tier
+// holding ERROR and ALERT records. Given both, the tiers are merged by
+// timestamp. Copies are mounted like on the device, so a torn tail is
+// trimmed from them.
+//
+
+#include "event_table.h"
+#include "journal_codec.h"
+#include "journal_store.h"
+#include "journal_tiers.h"
+
+#include <cstdio>
+#include <map>
+
+static const char* TYPE_NAMES[] = { "INFO", "WARNING", "ERROR", "ALERT" };
+
+static void print_record(const std::map<uint16_t, journal_event_desc_t>& events, const char* tier,
+                         uint64_t seq, journal_record_t record, uint16_t id)
+{
+    const auto it = events.find(id);
+    record.event = it != events.end() ? &it->second : nullptr;
+    char text[JOURNAL_MSG_MAX_SIZE];
+    journal_record_render(record, text, sizeof(text));
+    std::printf("%s%10llu  %13lld  %-7s  %-16s  %s\n", tier,
+                static_cast<unsigned long long>(seq), static_cast<long long>(record.timestamp_ms),
+                TYPE_NAMES[record.type & 3], record.event ? record.event->tag : "?", text);
+}
+
+static int dump_journal(const char* dir, const char* retained_dir, const std::vector<JournalEventEntry>& entries)
+{
+    std::map<uint16_t, journal_event_desc_t> events;
+    for (const JournalEventEntry& e : entries)
+        events[e.id] = { e.id, e.tag.c_str(), e.fmt.c_str() };
+
+    const JournalStore::Config config = { JournalStore::PAYLOAD_MAX, SIZE_MAX, 0 };
+    JournalFileStorage storage(dir);
+    JournalStore store(storage, config);
+    if (store.Mount() != ESP_OK) {
+        std::fprintf(stderr, "%s: cannot open journal\n", dir);
+        return 1;
+    }
+
+    size_t undecodable = 0;
+    size_t corrupted   = 0;
+    if (retained_dir) {
+        JournalFileStorage retained_storage(retained_dir);
+        JournalStore retained(retained_storage, config);
+        JournalTiers tiers(store, retained);
+        if (retained.Mount() != ESP_OK) {
+            std::fprintf(stderr, "%s: cannot open journal\n", retained_dir);
+            return 1;
+        }
+
+        static const char* TIER_NAMES[] = { "R ", "E " };
+        uint8_t buf[JournalTiers::COUNT * JOURNAL_CODEC_RECORD_MAX];
+        JournalTiers::Reader reader = tiers.Query({ INT64_MIN, 0xFF }, nullptr, buf, JOURNAL_CODEC_RECORD_MAX);
+        const JournalTiers::Entry* entry = nullptr;
+        while (reader.Next(entry) == ESP_OK) {
+            if (!entry->decoded) {
+                ++undecodable;
+                continue;
+            }
+            print_record(events, TIER_NAMES[entry->tier], entry->seq, entry->record, entry->event_id);
+        }
+        corrupted = reader.Corrupted();
+    } else {
+        JournalStore::Reader reader = store.Read();
+        JournalCodecState state{};
+        uint8_t buf[JOURNAL_CODEC_RECORD_MAX];
+        size_t len = 0;
+        for (;;) {
+            const esp_err_t err = reader.Next(buf, sizeof(buf), len);
+            if (err == ESP_ERR_NOT_FOUND)
+                break;
+            journal_record_t record{};
+            uint16_t id = 0;
+            if (err != ESP_OK || !journal_codec_decode(buf, len, state, record, id)) {
+                ++undecodable;
+                continue;
+            }
+            print_record(events, "", reader.Seq(), record, id);
+        }
+        corrupted = reader.Corrupted();
+    }
+
+    if (undecodable != 0 || corrupted != 0)
+        std::fprintf(stderr, "%zu undecodable record(s), %zu corrupted frame(s)\n", undecodable, corrupted);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 4) {
+        std::fprintf(stderr, "usage: %s <firmware.elf> [journal_dir [retained_dir]]\n", argv[0]);
+        return 2;
+    }
+
+    ElfStringTable elf;
+    if (!elf.LoadFile(argv[1])) {
+        std::fprintf(stderr, "%s: not a supported ELF file\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<JournalEventEntry> entries;
+    if (!journal_event_table_load(elf, entries)) {
+        std::fprintf(stderr, "%s: no readable ej_events table\n", argv[1]);
+        return 1;
+    }
+
+    if (argc >= 3)
+        return dump_journal(argv[2], argc == 4 ? argv[3] : nullptr, entries);
+
+    for (const JournalEventEntry& e : entries)
+        std::printf("0x%04x  %-16s  \"%s\"\n", e.id, e.tag.c_str(), e.fmt.c_str());
+    return 0;
+}